@@ -0,0 +1,75 @@
+/**
+ * \file baseline.h
+ * \brief Baseline table of the benchmark header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#ifndef __BASELINE_H
+#define __BASELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Create a std::unordered_map from byte strings to integers.
+ * \param expected The number of keys expected.
+ */
+void* HT_baseline_create(size_t expected);
+
+/**
+ * \brief Add a key to the map.
+ * \retval 0 If the key is added.
+ * \retval 1 If the key is already present.
+ */
+int HT_baseline_add(void* table, const void* key, size_t key_size, uint64_t value);
+
+/**
+ * \brief Search a key in the map.
+ * \retval 0 If the key is found and value is set.
+ * \retval 1 If the key is not found.
+ */
+int HT_baseline_get(void* table, const void* key, size_t key_size, uint64_t* value);
+
+/**
+ * \brief Remove a key from the map.
+ * \retval 0 If the key is removed.
+ * \retval 1 If the key is not found.
+ */
+int HT_baseline_remove(void* table, const void* key, size_t key_size);
+
+/**
+ * \brief Delete the map.
+ */
+void HT_baseline_destroy(void* table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ( __BASELINE_H )
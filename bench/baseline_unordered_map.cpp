@@ -0,0 +1,63 @@
+/**
+ * \file baseline_unordered_map.cpp
+ * \brief std::unordered_map baseline of the benchmark.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#include <string>
+#include <unordered_map>
+
+#include "baseline.h"
+
+typedef std::unordered_map<std::string, uint64_t> HT_baseline_map;
+
+void* HT_baseline_create(size_t expected){
+    HT_baseline_map *map = new HT_baseline_map();
+    map->reserve(expected);
+    return map;
+}
+
+int HT_baseline_add(void* table, const void* key, size_t key_size, uint64_t value){
+    HT_baseline_map *map = static_cast<HT_baseline_map*>(table);
+    return !map->emplace(std::string(static_cast<const char*>(key), key_size), value).second;
+}
+
+int HT_baseline_get(void* table, const void* key, size_t key_size, uint64_t* value){
+    HT_baseline_map *map = static_cast<HT_baseline_map*>(table);
+    HT_baseline_map::const_iterator it = map->find(std::string(static_cast<const char*>(key), key_size));
+    if( it == map->end() )
+        return 1;
+    *value = it->second;
+    return 0;
+}
+
+int HT_baseline_remove(void* table, const void* key, size_t key_size){
+    HT_baseline_map *map = static_cast<HT_baseline_map*>(table);
+    return map->erase(std::string(static_cast<const char*>(key), key_size)) == 0;
+}
+
+void HT_baseline_destroy(void* table){
+    delete static_cast<HT_baseline_map*>(table);
+}
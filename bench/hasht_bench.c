@@ -0,0 +1,576 @@
+/**
+ * \file hasht_bench.c
+ * \brief Benchmark of the hash tables on reproducible workloads.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "generic_hash_table.h"
+#include "flat_hash_table.h"
+#include "robin_hood_hash_table.h"
+#include "compact_hash_table.h"
+#include "hash_functions.h"
+#include "baseline.h"
+
+/**
+ * \brief One operation out of HT_BENCH_SAMPLING has its latency recorded.
+ */
+#define HT_BENCH_SAMPLING 16
+
+/**
+ * \brief The number of duplicates of each key in the duplicate workload.
+ */
+#define HT_BENCH_DUPLICATES 4
+
+/**
+ * \brief The largest key, string keys included.
+ */
+#define HT_BENCH_MAX_KEY_SIZE 32
+
+/**
+ * \brief The operations of a benchmarked table.
+ */
+typedef struct{
+    const char *name;           /**<- The name printed in the report. */
+    void* (*create)(size_t expected); /**<- Create a table for about expected keys. */
+    int (*add)(void* table, const void* key, size_t key_size, uint64_t value); /**<- Add a key not present. */
+    int (*get)(void* table, const void* key, size_t key_size, uint64_t* value); /**<- 0 if the key is found. */
+    int (*remove)(void* table, const void* key, size_t key_size); /**<- 0 if the key is removed. */
+    void (*destroy)(void* table); /**<- Delete the table. */
+} HT_bench_table;
+
+/**
+ * \brief The keys of a workload.
+ */
+typedef struct{
+    unsigned char *_keys;       /**<- HT_BENCH_MAX_KEY_SIZE bytes per key. */
+    size_t *_sizes;             /**<- The size of each key. */
+    size_t _nb_keys;            /**<- The number of keys. */
+} HT_bench_keys;
+
+/**
+ * \brief The state of the xorshift64* generator, fixed by the seed option.
+ */
+static uint64_t HT_bench_state;
+
+/**
+ * \brief Draw a pseudo random number.
+ */
+static inline uint64_t HT_bench_random(void){
+    HT_bench_state ^= HT_bench_state >> 12;
+    HT_bench_state ^= HT_bench_state << 25;
+    HT_bench_state ^= HT_bench_state >> 27;
+    return HT_bench_state * UINT64_C(0x2545F4914F6CDD1D);
+}
+
+/**
+ * \brief Get a monotonic time in nanoseconds.
+ */
+static inline uint64_t HT_bench_now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * UINT64_C(1000000000) + (uint64_t) t.tv_nsec;
+}
+
+/**
+ * \brief Get the number of bytes allocated by malloc.
+ */
+static size_t HT_bench_heap_size(void){
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/**
+ * \brief Build the keys of a workload.
+ * \param keys The keys to fill.
+ * \param nb_keys The number of keys.
+ * \param strings 0 for 8 bytes binary keys and any other integer for printable ones.
+ */
+static void HT_bench_make_keys(HT_bench_keys* keys, const size_t nb_keys, const int strings){
+    size_t i;
+    keys->_keys = malloc(nb_keys * HT_BENCH_MAX_KEY_SIZE);
+    keys->_sizes = malloc(nb_keys * sizeof(size_t));
+    keys->_nb_keys = nb_keys;
+    if( keys->_keys == NULL || keys->_sizes == NULL ){
+        perror("hasht_bench");
+        exit(EXIT_FAILURE);
+    }
+    for(i = 0; i < nb_keys; ++i){
+        unsigned char *key = &keys->_keys[i * HT_BENCH_MAX_KEY_SIZE];
+        uint64_t id = HT_bench_random();
+        if( strings )
+            keys->_sizes[i] = (size_t) snprintf((char*) key, HT_BENCH_MAX_KEY_SIZE, "user:%016llx", (unsigned long long) id);
+        else{
+            memcpy(key, &id, sizeof(id));
+            keys->_sizes[i] = sizeof(id);
+        }
+    }
+}
+
+/**
+ * \brief Free the keys of a workload.
+ * \param keys The keys.
+ */
+static void HT_bench_free_keys(HT_bench_keys* keys){
+    free(keys->_keys);
+    free(keys->_sizes);
+}
+
+/**
+ * \brief Get a key of a workload.
+ */
+static inline const void* HT_bench_key(const HT_bench_keys* keys, const size_t i){
+    return &keys->_keys[i * HT_BENCH_MAX_KEY_SIZE];
+}
+
+/**
+ * \brief Build the cumulative distribution of a Zipfian law.
+ * \param nb_keys The number of keys, the rank 0 key is the most frequent.
+ * \param exponent The exponent of the law.
+ * \return The distribution, to free.
+ */
+static double* HT_bench_zipf(const size_t nb_keys, const double exponent){
+    double *cdf = malloc(nb_keys * sizeof(double)),
+           sum = 0.0;
+    size_t i;
+    if( cdf == NULL ){
+        perror("hasht_bench");
+        exit(EXIT_FAILURE);
+    }
+    for(i = 0; i < nb_keys; ++i){
+        sum += 1.0 / pow((double) (i + 1), exponent);
+        cdf[i] = sum;
+    }
+    for(i = 0; i < nb_keys; ++i)
+        cdf[i] /= sum;
+    return cdf;
+}
+
+/**
+ * \brief Draw a rank from a Zipfian distribution.
+ */
+static size_t HT_bench_zipf_draw(const double* cdf, const size_t nb_keys){
+    const double u = (double) (HT_bench_random() >> 11) * 0x1.0p-53;
+    size_t low = 0,
+           high = nb_keys - 1;
+    while( low < high ){
+        size_t middle = low + (high - low) / 2;
+        if( cdf[middle] < u )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/**
+ * \brief The latencies of a run.
+ */
+typedef struct{
+    uint64_t *_samples;         /**<- The sampled latencies in nanoseconds. */
+    size_t _nb_samples;         /**<- The number of samples. */
+    uint64_t _begin;            /**<- The start of the run. */
+    size_t _nb_operations;      /**<- The number of operations. */
+} HT_bench_run;
+
+/**
+ * \brief Compare two latencies for qsort.
+ */
+static int HT_bench_compare(const void* a, const void* b){
+    const uint64_t x = *(const uint64_t*) a,
+                   y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * \brief Start a run of operations.
+ * \param run The run.
+ * \param nb_operations The number of operations of the run.
+ */
+static void HT_bench_start(HT_bench_run* run, const size_t nb_operations){
+    run->_samples = malloc((nb_operations / HT_BENCH_SAMPLING + 1) * sizeof(uint64_t));
+    if( run->_samples == NULL ){
+        perror("hasht_bench");
+        exit(EXIT_FAILURE);
+    }
+    run->_nb_samples = 0;
+    run->_nb_operations = nb_operations;
+    run->_begin = HT_bench_now();
+}
+
+/**
+ * \brief Print the throughput and the percentiles of a run.
+ * \param run The run.
+ * \param table The name of the table.
+ * \param workload The name of the workload.
+ * \param bytes The bytes per entry, 0 if not measured.
+ */
+static void HT_bench_report(HT_bench_run* run, const char* table, const char* workload, const double bytes){
+    const uint64_t elapsed = HT_bench_now() - run->_begin;
+    uint64_t p50 = 0,
+             p99 = 0,
+             p999 = 0;
+    if( run->_nb_samples != 0 ){
+        qsort(run->_samples, run->_nb_samples, sizeof(uint64_t), HT_bench_compare);
+        p50 = run->_samples[run->_nb_samples / 2];
+        p99 = run->_samples[run->_nb_samples * 99 / 100];
+        p999 = run->_samples[run->_nb_samples * 999 / 1000];
+    }
+    printf("%-14s %-20s %10.1f %8llu %8llu %8llu", table, workload,
+            (double) elapsed / (double) run->_nb_operations,
+            (unsigned long long) p50, (unsigned long long) p99, (unsigned long long) p999);
+    if( bytes > 0.0 )
+        printf(" %10.1f", bytes);
+    printf("\n");
+    free(run->_samples);
+}
+
+/**
+ * \brief Time one operation out of ::HT_BENCH_SAMPLING.
+ * \param run The run.
+ * \param i The index of the operation.
+ * \param operation The operation.
+ */
+#define HT_BENCH_TIME(run, i, operation) do{                                    \
+    if( (i) % HT_BENCH_SAMPLING == 0 ){                                         \
+        const uint64_t HT_bench_begin = HT_bench_now();                         \
+        operation;                                                              \
+        (run)->_samples[(run)->_nb_samples++] = HT_bench_now() - HT_bench_begin;\
+    }                                                                           \
+    else{                                                                       \
+        operation;                                                              \
+    }                                                                           \
+}while(0)
+
+/**
+ * \brief Keep the compiler from removing the lookups.
+ */
+static volatile uint64_t HT_bench_sink;
+
+/**
+ * \brief Run the workloads of one key kind on one table.
+ * \param table The table.
+ * \param keys The keys, the first half is inserted and the second half never is.
+ * \param kind The name of the kind of keys.
+ * \param nb_operations The number of operations of each lookup workload.
+ * \param cdf The Zipfian distribution of the inserted keys.
+ */
+static void HT_bench_table_run(const HT_bench_table* table, const HT_bench_keys* keys, const char* kind, const size_t nb_operations, const double* cdf){
+    const size_t nb_present = keys->_nb_keys / 2;
+    char workload[64];
+    HT_bench_run run;
+    size_t i,
+           heap = HT_bench_heap_size();
+    uint64_t value,
+             sum = 0;
+    void *t = table->create(nb_present);
+
+    snprintf(workload, sizeof(workload), "%s insert", kind);
+    HT_bench_start(&run, nb_present);
+    for(i = 0; i < nb_present; ++i)
+        HT_BENCH_TIME(&run, i, table->add(t, HT_bench_key(keys, i), keys->_sizes[i], i));
+    HT_bench_report(&run, table->name, workload, (double) (HT_bench_heap_size() - heap) / (double) nb_present);
+
+    snprintf(workload, sizeof(workload), "%s hit", kind);
+    HT_bench_start(&run, nb_operations);
+    for(i = 0; i < nb_operations; ++i){
+        const size_t k = HT_bench_random() % nb_present;
+        HT_BENCH_TIME(&run, i, table->get(t, HT_bench_key(keys, k), keys->_sizes[k], &value));
+        sum += value;
+    }
+    HT_bench_report(&run, table->name, workload, 0.0);
+
+    snprintf(workload, sizeof(workload), "%s 50%% miss", kind);
+    HT_bench_start(&run, nb_operations);
+    for(i = 0; i < nb_operations; ++i){
+        const size_t k = HT_bench_random() % keys->_nb_keys;
+        HT_BENCH_TIME(&run, i, sum += (uint64_t) table->get(t, HT_bench_key(keys, k), keys->_sizes[k], &value));
+    }
+    HT_bench_report(&run, table->name, workload, 0.0);
+
+    snprintf(workload, sizeof(workload), "%s zipf hit", kind);
+    HT_bench_start(&run, nb_operations);
+    for(i = 0; i < nb_operations; ++i){
+        const size_t k = HT_bench_zipf_draw(cdf, nb_present);
+        HT_BENCH_TIME(&run, i, table->get(t, HT_bench_key(keys, k), keys->_sizes[k], &value));
+        sum += value;
+    }
+    HT_bench_report(&run, table->name, workload, 0.0);
+
+    // Each step removes a present key and inserts the absent one of the same index
+    snprintf(workload, sizeof(workload), "%s churn", kind);
+    HT_bench_start(&run, nb_operations);
+    for(i = 0; i < nb_operations; ++i){
+        const size_t k = HT_bench_random() % nb_present,
+                     present = table->get(t, HT_bench_key(keys, k), keys->_sizes[k], &value) == 0 ? k : k + nb_present,
+                     absent = present == k ? k + nb_present : k;
+        HT_BENCH_TIME(&run, i, (table->remove(t, HT_bench_key(keys, present), keys->_sizes[present]),
+                    table->add(t, HT_bench_key(keys, absent), keys->_sizes[absent], absent)));
+    }
+    HT_bench_report(&run, table->name, workload, 0.0);
+
+    HT_bench_sink = sum;
+    table->destroy(t);
+}
+
+static void* HT_bench_generic_create(size_t expected){
+    HT_hash_table *ht = HT_new_hash((unsigned int) expected, HT_hash_wy);
+    if( ht == NULL ){
+        perror("hasht_bench");
+        exit(EXIT_FAILURE);
+    }
+    return ht;
+}
+
+static int HT_bench_generic_add(void* table, const void* key, size_t key_size, uint64_t value){
+    return HT_add_element_position(table, key, key_size, &value, sizeof(value), 0, 0);
+}
+
+static int HT_bench_generic_get(void* table, const void* key, size_t key_size, uint64_t* value){
+    void *stored;
+    size_t stored_size;
+    int retval = HT_get_element(table, key, key_size, &stored, &stored_size);
+    if( retval == 0 )
+        memcpy(value, stored, sizeof(*value));
+    return retval;
+}
+
+static int HT_bench_generic_remove(void* table, const void* key, size_t key_size){
+    return HT_remove_element_position(table, key, key_size, 0, 0);
+}
+
+static void HT_bench_generic_destroy(void* table){
+    HT_delete_pointer(table);
+}
+
+static void* HT_bench_flat_create(size_t expected){
+    HT_flat_table *ft = HT_flat_new_hash((unsigned int) expected, HT_hash_wy);
+    if( ft == NULL ){
+        perror("hasht_bench");
+        exit(EXIT_FAILURE);
+    }
+    return ft;
+}
+
+static int HT_bench_flat_add(void* table, const void* key, size_t key_size, uint64_t value){
+    return HT_flat_add_element(table, key, key_size, &value, sizeof(value));
+}
+
+static int HT_bench_flat_get(void* table, const void* key, size_t key_size, uint64_t* value){
+    void *stored;
+    size_t stored_size;
+    int retval = HT_flat_get_element(table, key, key_size, &stored, &stored_size);
+    if( retval == 0 )
+        memcpy(value, stored, sizeof(*value));
+    return retval;
+}
+
+static int HT_bench_flat_remove(void* table, const void* key, size_t key_size){
+    return HT_flat_remove_element(table, key, key_size);
+}
+
+static void HT_bench_flat_destroy(void* table){
+    HT_flat_delete_pointer(table);
+}
+
+static void* HT_bench_robin_create(size_t expected){
+    HT_robin_table *rt = HT_robin_new_hash((unsigned int) expected, HT_hash_wy);
+    if( rt == NULL ){
+        perror("hasht_bench");
+        exit(EXIT_FAILURE);
+    }
+    return rt;
+}
+
+static int HT_bench_robin_add(void* table, const void* key, size_t key_size, uint64_t value){
+    return HT_robin_add_element(table, key, key_size, &value, sizeof(value));
+}
+
+static int HT_bench_robin_get(void* table, const void* key, size_t key_size, uint64_t* value){
+    void *stored;
+    size_t stored_size;
+    int retval = HT_robin_get_element(table, key, key_size, &stored, &stored_size);
+    if( retval == 0 )
+        memcpy(value, stored, sizeof(*value));
+    return retval;
+}
+
+static int HT_bench_robin_remove(void* table, const void* key, size_t key_size){
+    return HT_robin_remove_element(table, key, key_size);
+}
+
+static void HT_bench_robin_destroy(void* table){
+    HT_robin_delete_pointer(table);
+}
+
+static void* HT_bench_compact_create(size_t expected){
+    HT_compact_table *ct = HT_compact_new_hash((unsigned int) expected, HT_hash_wy);
+    if( ct == NULL ){
+        perror("hasht_bench");
+        exit(EXIT_FAILURE);
+    }
+    return ct;
+}
+
+static int HT_bench_compact_add(void* table, const void* key, size_t key_size, uint64_t value){
+    return HT_compact_add_element(table, key, key_size, &value, sizeof(value));
+}
+
+static int HT_bench_compact_get(void* table, const void* key, size_t key_size, uint64_t* value){
+    void *stored;
+    size_t stored_size;
+    int retval = HT_compact_get_element(table, key, key_size, &stored, &stored_size);
+    if( retval == 0 )
+        memcpy(value, stored, sizeof(*value));
+    return retval;
+}
+
+static int HT_bench_compact_remove(void* table, const void* key, size_t key_size){
+    return HT_compact_remove_element(table, key, key_size);
+}
+
+static void HT_bench_compact_destroy(void* table){
+    HT_compact_delete_pointer(table);
+}
+
+/**
+ * \brief The benchmarked tables.
+ */
+static const HT_bench_table HT_bench_tables[] = {
+    { "chained", HT_bench_generic_create, HT_bench_generic_add, HT_bench_generic_get, HT_bench_generic_remove, HT_bench_generic_destroy },
+    { "flat", HT_bench_flat_create, HT_bench_flat_add, HT_bench_flat_get, HT_bench_flat_remove, HT_bench_flat_destroy },
+    { "robin_hood", HT_bench_robin_create, HT_bench_robin_add, HT_bench_robin_get, HT_bench_robin_remove, HT_bench_robin_destroy },
+    { "compact", HT_bench_compact_create, HT_bench_compact_add, HT_bench_compact_get, HT_bench_compact_remove, HT_bench_compact_destroy },
+#ifdef HT_BENCH_BASELINE
+    { "unordered_map", HT_baseline_create, HT_baseline_add, HT_baseline_get, HT_baseline_remove, HT_baseline_destroy },
+#endif
+};
+
+/**
+ * \brief Access the elements of a key by position, only the chained table keeps duplicates.
+ * \param nb_keys The number of distinct keys.
+ * \param nb_operations The number of lookups.
+ */
+static void HT_bench_duplicates(const size_t nb_keys, const size_t nb_operations){
+    HT_hash_table *ht = HT_bench_generic_create(nb_keys * HT_BENCH_DUPLICATES);
+    HT_bench_run run;
+    size_t i;
+    uint64_t key,
+             sum = 0;
+    void *value;
+    size_t value_size;
+
+    HT_bench_start(&run, nb_keys * HT_BENCH_DUPLICATES);
+    for(i = 0; i < nb_keys * HT_BENCH_DUPLICATES; ++i){
+        key = i % nb_keys;
+        HT_BENCH_TIME(&run, i, HT_add_element_position(ht, &key, sizeof(key), &i, sizeof(i), 0, 1));
+    }
+    HT_bench_report(&run, "chained", "dup insert", 0.0);
+
+    HT_bench_start(&run, nb_operations);
+    for(i = 0; i < nb_operations; ++i){
+        const uint64_t r = HT_bench_random();
+        key = (r >> 8) % nb_keys;
+        HT_BENCH_TIME(&run, i, HT_get_element_position(ht, &key, sizeof(key), &value, &value_size, (unsigned int) (r % HT_BENCH_DUPLICATES), (int) ((r >> 4) & 1)));
+        sum += *(const unsigned char*) value;
+    }
+    HT_bench_report(&run, "chained", "dup position", 0.0);
+    HT_bench_sink = sum;
+    HT_delete_pointer(ht);
+}
+
+/**
+ * \brief Print the usage.
+ * \param program The name of the program.
+ */
+static void HT_bench_usage(const char* program){
+    fprintf(stderr, "Usage: %s [-n keys] [-o operations] [-s seed] [-z zipf exponent]\n", program);
+}
+
+int main(int argc, char** argv){
+    size_t nb_keys = 1000000,
+           nb_operations = 4000000,
+           i;
+    unsigned long long seed = 42;
+    double exponent = 0.99,
+           *cdf;
+    HT_bench_keys binary_keys,
+                  string_keys;
+    struct rusage usage;
+    int option;
+
+    while( (option = getopt(argc, argv, "n:o:s:z:h")) != -1 ){
+        switch(option){
+            case 'n':
+                nb_keys = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                nb_operations = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'z':
+                exponent = strtod(optarg, NULL);
+                break;
+            default:
+                HT_bench_usage(argv[0]);
+                return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if( nb_keys < 2 || nb_operations == 0 ){
+        HT_bench_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    HT_bench_state = seed * UINT64_C(0x9E3779B97F4A7C15) | 1;
+    HT_bench_make_keys(&binary_keys, nb_keys * 2, 0);
+    HT_bench_make_keys(&string_keys, nb_keys * 2, 1);
+    cdf = HT_bench_zipf(nb_keys, exponent);
+
+    printf("# %zu keys, %zu operations, seed %llu, zipf %.2f\n", nb_keys, nb_operations, seed, exponent);
+    printf("%-14s %-20s %10s %8s %8s %8s %10s\n", "table", "workload", "ns/op", "p50", "p99", "p99.9", "bytes/key");
+    for(i = 0; i < sizeof(HT_bench_tables) / sizeof(HT_bench_tables[0]); ++i){
+        HT_bench_table_run(&HT_bench_tables[i], &binary_keys, "u64", nb_operations, cdf);
+        HT_bench_table_run(&HT_bench_tables[i], &string_keys, "string", nb_operations, cdf);
+    }
+    HT_bench_duplicates(nb_keys, nb_operations);
+
+    getrusage(RUSAGE_SELF, &usage);
+    printf("# peak RSS %ld KiB\n", usage.ru_maxrss);
+
+    free(cdf);
+    HT_bench_free_keys(&binary_keys);
+    HT_bench_free_keys(&string_keys);
+    return EXIT_SUCCESS;
+}
@@ -16,7 +16,7 @@
    If not, see <http://www.gnu.org/licenses/>.
    */
 
-#include "base_hash_table.h"
+#include "string_hash.h"
 
 int HT_get_element_string(const HT_hash_table* ht, const char* key, char** value){
     size_t size_key,
@@ -26,12 +26,14 @@
  * \param key The key value represented by a string.
  * \param key_size The size of the string.
  * \return The value representing the hash of the key.
+ * \warning Colliding strings are easy to build, use ::HT_set_seeded_hash with
+ * HT_hash_sip on a table whose keys come from untrusted input.
  */
-static inline unsigned int HT_hash_function_string(const void* const key, const size_t key_size){
+static inline uint64_t HT_hash_function_string(const void* const key, const size_t key_size){
     size_t i;
-    unsigned int hash_value = 5381;        // Some magic prime number (see its binary representation)
+    uint64_t hash_value = 5381;        // Some magic prime number (see its binary representation)
     for(i=0; i < key_size; ++i){
-        hash_value = ((hash_value << 5) + hash_value) + (unsigned int) ((const char*) key)[i];     // hash * 33 + one_char
+        hash_value = ((hash_value << 5) + hash_value) + (uint64_t) ((const char*) key)[i];     // hash * 33 + one_char
     }
     return hash_value;
 }
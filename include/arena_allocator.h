@@ -0,0 +1,109 @@
+/**
+ * \file arena_allocator.h
+ * \brief Arena allocator header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __ARENA_ALLOCATOR_H
+#define __ARENA_ALLOCATOR_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief The default size in bytes of the chunks of an arena.
+ */
+#define HT_ARENA_DEFAULT_CHUNK_SIZE 65536
+
+/**
+ * \brief The alignment of the buffers given by an arena.
+ */
+#define HT_ARENA_ALIGNMENT 16
+
+/**
+ * \brief A memory chunk of an arena.
+ */
+typedef struct HT_arena_chunk{
+    struct HT_arena_chunk *_next;   /**<- The next chunk. */
+    size_t _size;                   /**<- The number of usable bytes. */
+    unsigned char *_data;           /**<- The usable bytes, aligned. */
+} HT_arena_chunk;
+
+/**
+ * \brief An arena giving memory by bumping a pointer inside of chunks.
+ *
+ * Buffers are never released one by one, resetting the arena makes every
+ * chunk available again without giving them back to the system.
+ */
+typedef struct{
+    HT_arena_chunk *_first_chunk,   /**<- The first chunk. */
+                   *_current_chunk; /**<- The chunk used for the next allocations. */
+    size_t _used;                   /**<- The number of bytes used in the current chunk. */
+    size_t _chunk_size;             /**<- The size of the new chunks. */
+} HT_arena;
+
+/**
+ * \brief Initialise an arena.
+ * \see HT_arena_delete
+ * \param arena A pointer to the arena.
+ * \param chunk_size The size of the chunks requested to malloc, 0 for ::HT_ARENA_DEFAULT_CHUNK_SIZE.
+ * \pre arena must not be NULL.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_arena_init(HT_arena* arena, size_t chunk_size);
+
+/**
+ * \brief Get memory from an arena.
+ * \param arena A pointer to the arena.
+ * \param size The size in bytes.
+ * \pre arena must not be NULL.
+ * \return A buffer aligned on ::HT_ARENA_ALIGNMENT.
+ * \retval NULL On failure and errno is set appropriately.
+ */
+void* HT_arena_allocate(HT_arena* arena, size_t size);
+
+/**
+ * \brief Make the whole memory of an arena available again.
+ * \param arena A pointer to the arena.
+ * \pre arena must not be NULL.
+ * \warning Every buffer given by the arena becomes invalid.
+ */
+void HT_arena_reset(HT_arena* arena);
+
+/**
+ * \brief Give back the memory of an arena to the system.
+ * \see HT_arena_init
+ * \param arena A pointer to the arena.
+ * \pre arena must not be NULL.
+ */
+void HT_arena_delete(HT_arena* arena);
+
+/**
+ * \brief Get the callbacks to give to ::HT_init_allocator to use an arena.
+ * \param arena A pointer to the arena, it must be used by one hash table only.
+ * \return The allocator, resetting the hash table resets the arena.
+ */
+HT_allocator HT_arena_allocator(HT_arena* arena);
+
+#endif // ( __ARENA_ALLOCATOR_H )
@@ -0,0 +1,228 @@
+/**
+ * \file cache_hash_table.h
+ * \brief Cache hash table header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __CACHE_HASH_TABLE_H
+#define __CACHE_HASH_TABLE_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief ::HT_evict_function reason: the entry is evicted to stay within the budget.
+ */
+#define HT_CACHE_EVICTED 1u
+
+/**
+ * \brief ::HT_evict_function reason: the time to live of the entry is over.
+ */
+#define HT_CACHE_EXPIRED 2u
+
+/**
+ * \brief The type of the functions told about the entries leaving a cache on their own.
+ * \see HT_cache_set_evict_function
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value.
+ * \param value_size The size of the value in bytes.
+ * \param reason ::HT_CACHE_EVICTED or ::HT_CACHE_EXPIRED.
+ * \param data The data given to ::HT_cache_set_evict_function.
+ * \warning The function must not call the cache.
+ */
+typedef void (*HT_evict_function)(const void* key, const size_t key_size, void* value, const size_t value_size, const unsigned int reason, void* data);
+
+/**
+ * \brief The value of a key of the cache.
+ */
+typedef struct{
+    HT_pair *_pair;             /**<- The pair of the key, its value is a pointer to the entry. */
+    uint64_t _expiry;           /**<- The monotonic time in nanoseconds from which the entry is expired, 0 for never. */
+    size_t _index;              /**<- The place of the entry in the clock ring. */
+    int _referenced;            /**<- Set by a lookup, cleared by the clock hand. */
+    size_t _value_size;         /**<- The size of the value. */
+    uint64_t _value[];          /**<- The value. */
+} HT_cache_entry;
+
+/**
+ * \brief A hash table keeping its content within a number of elements and of bytes.
+ *
+ * The entries are evicted with the CLOCK algorithm: they sit in a ring swept
+ * by a hand, a lookup sets the referenced flag of its entry and the hand
+ * gives a second chance to a referenced entry, clearing its flag, and evicts
+ * the first unreferenced or expired one. A lookup only writes that flag, once,
+ * and never reorders a list as a LRU would.
+ *
+ * An entry can have a time to live. An expired entry is removed by the
+ * lookup that finds it or by the clock hand when it passes.
+ */
+typedef struct{
+    HT_hash_table _table;       /**<- The keys, the value of each pair is a pointer to its ::HT_cache_entry. */
+    HT_cache_entry **_ring;     /**<- The entries, in the order of the clock hand. */
+    size_t _nb_entries,         /**<- The number of entries. */
+           _ring_capacity,      /**<- The number of entries _ring has room for. */
+           _hand;               /**<- The next entry looked at by the clock hand. */
+    size_t _max_elements,       /**<- The largest number of entries, 0 for no limit. */
+           _max_bytes,          /**<- The largest sum of the sizes of the keys and values, 0 for no limit. */
+           _nb_bytes;           /**<- The sum of the sizes of the keys and values. */
+    HT_evict_function evict_function; /**<- The function told about evictions, NULL if none. */
+    void *evict_data;           /**<- The last argument of evict_function. */
+}   HT_cache;
+
+/**
+ * \brief Create a new cache.
+ * \see HT_cache_delete_pointer
+ * \param size The number of slots of the hash table, rounded up to a power of two.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \param max_elements The largest number of elements, 0 for no limit.
+ * \param max_bytes The largest sum of the sizes of the keys and values, 0 for no limit.
+ * \pre size must be a strictly positive number(size > 0).
+ * \pre hash_function should not be NULL.
+ * \return A pointer to an already initialized cache;
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_cache* HT_cache_new_hash(const unsigned int size, HT_hash_function hash_function, const size_t max_elements, const size_t max_bytes);
+
+/**
+ * \brief Use this to initialise an static defined cache.
+ * \see HT_cache_delete
+ * \param cache A pointer to the cache to initialise.
+ * \param size The number of slots of the hash table, rounded up to a power of two.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \param max_elements The largest number of elements, 0 for no limit.
+ * \param max_bytes The largest sum of the sizes of the keys and values, 0 for no limit.
+ * \pre cache and hash_function must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_cache_init(HT_cache* cache, const unsigned int size, HT_hash_function hash_function, const size_t max_elements, const size_t max_bytes);
+
+/**
+ * \brief Set the function told about the entries evicted or expired.
+ * \param cache A pointer to the cache.
+ * \param evict_function The function, NULL for none.
+ * \param data The last argument of evict_function.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note The function is not called by ::HT_cache_remove_element, by a replaced
+ * value, nor by ::HT_cache_reset_table.
+ */
+int HT_cache_set_evict_function(HT_cache* cache, HT_evict_function evict_function, void* data);
+
+/**
+ * \brief Search for an element in the cache.
+ * \param cache A pointer to the cache.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value The value holding the corresponding value if the key is found.
+ * \param value_size A pointer to a variable that will be set to value size in bytes if a match is found.
+ * \pre cache and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success and if not NULL value is set to point to the corresponding value.
+ * \retval 1 If the key is not found or expired.
+ * \retval 2 On failure and errno is set appropriately.
+ * \warning value will point directly to the cache value, until the element leaves the cache.
+ * \note A hit marks the entry as referenced with a relaxed store, so lookups
+ * of keys without time to live can run concurrently, an expired entry is
+ * removed by the lookup.
+ */
+int HT_cache_get_element(HT_cache* cache, const void* key, const size_t key_size, void** value, size_t* value_size);
+
+/**
+ * \brief Add an element to the cache, or replace the value of its key.
+ * \param cache A pointer to the cache.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \param ttl The time to live of the element in milliseconds, 0 for no expiry.
+ * \pre cache, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key was present, its value is replaced.
+ * \retval 2 On error and errno is set appropriately, ENOSPC meaning that the
+ * element alone is above the byte budget.
+ * \note Entries are evicted first until the element fits in the budget.
+ */
+int HT_cache_add_element(HT_cache* cache, const void* key, const size_t key_size, const void* value, const size_t value_size, const uint64_t ttl);
+
+/**
+ * \brief Remove an element from the cache.
+ * \param cache A pointer to the cache.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \pre cache and key must not be NULL.
+ * \pre key_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_cache_remove_element(HT_cache* cache, const void* key, const size_t key_size);
+
+/**
+ * \brief Get the number of elements stored in the cache.
+ * \param cache A pointer to the cache.
+ * \pre cache must not be NULL.
+ * \return The number of keys stored, expired ones not removed yet included.
+ */
+static inline size_t HT_cache_get_nb_elements(const HT_cache* cache){
+    return cache->_nb_entries;
+}
+
+/**
+ * \brief Get the number of bytes counted against the budget of the cache.
+ * \param cache A pointer to the cache.
+ * \pre cache must not be NULL.
+ * \return The sum of the sizes of the keys and values stored.
+ */
+static inline size_t HT_cache_get_nb_bytes(const HT_cache* cache){
+    return cache->_nb_bytes;
+}
+
+/**
+ * \brief Deletes the cache created with ::HT_cache_new_hash.
+ * \see HT_cache_new_hash
+ * \param cache The cache to delete.
+ * \pre cache must not be NULL.
+ */
+void HT_cache_delete_pointer(HT_cache* cache);
+
+/**
+ * \brief Delete a cache initialized with ::HT_cache_init.
+ * \see HT_cache_init
+ * \param cache The cache.
+ * \pre cache must not be NULL.
+ */
+void HT_cache_delete(HT_cache* cache);
+
+/**
+ * \brief Remove every element of the cache.
+ * \param cache A pointer to the cache.
+ * \pre cache must not be NULL.
+ * \post cache is still usable.
+ */
+void HT_cache_reset_table(HT_cache* cache);
+
+#endif // ( __CACHE_HASH_TABLE_H )
@@ -0,0 +1,176 @@
+/**
+ * \file compact_hash_table.h
+ * \brief Compact hash table header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __COMPACT_HASH_TABLE_H
+#define __COMPACT_HASH_TABLE_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief A hash table packing its elements in a single byte heap, for the
+ * tables whose keys and values are small next to the bookkeeping of
+ * ::HT_hash_table.
+ *
+ * Each element is one record appended to the heap: the offset of the next
+ * record of its chain and the folded hash of its key on 32 bits, then the
+ * sizes of the key and of the value as varints, then the key and the value.
+ * A bucket is the 32 bits offset of the first record of its chain, offset 0
+ * ends a chain. An element costs 10 bytes plus its key and value, and 4 to 8
+ * bytes of bucket, instead of a pair, its allocation headers and a slot.
+ *
+ * A removed record stays in the heap until more than half of the heap is
+ * removed records, then the live ones are copied to a new heap.
+ */
+typedef struct{
+    uint32_t *_buckets;         /**<- The offset of the first record of each chain. */
+    unsigned int _bucket_bits;  /**<- The base 2 logarithm of the number of buckets. */
+    unsigned char *_heap;       /**<- The records. */
+    size_t _heap_size,          /**<- The number of bytes of the heap in use, removed records included. */
+           _heap_capacity,      /**<- The number of bytes allocated for the heap. */
+           _garbage;            /**<- The number of bytes of removed records. */
+    size_t _nb_elements;        /**<- The number of elements stored. */
+    HT_hash_function hash_function; /**<- the hash function. */
+}   HT_compact_table;
+
+/**
+ * \brief Create a new compact hash table able to hold size keys without growing its buckets.
+ * \see HT_compact_delete_pointer
+ * \param size The number of keys expected in the hash table.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre size must be a strictly positive number(size > 0).
+ * \pre hash_function should not be NULL.
+ * \return A pointer to an already initialized hash table;
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_compact_table* HT_compact_new_hash(const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Use this to initialise an static defined compact hash table.
+ * \see HT_compact_delete
+ * \param ct A pointer to the hash table to initialise.
+ * \param size The number of keys expected in the hash table.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre ct and hash_function must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_compact_init(HT_compact_table* ct, const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Search for an element in the compact hash table.
+ * \param ct A pointer to the hash table.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value The value holding the corresponding value if the key is found.
+ * \param value_size A pointer to a variable that will be set to value size in bytes if a match is found.
+ * \pre ct and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success and if not NULL value is set to point to the corresponding value.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \warning value points inside of the heap: it is not aligned, so read it
+ * with memcpy, and it is invalidated by the next add or remove.
+ */
+int HT_compact_get_element(const HT_compact_table* ct, const void* key, const size_t key_size, void** value, size_t* value_size);
+
+/**
+ * \brief Add an element to the compact hash table.
+ * \param ct A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \pre ct, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is already present in the hash table.
+ * \retval 2 On error and errno is set appropriately, ENOSPC meaning that the
+ * heap would not be addressable with 32 bits offsets any more.
+ * \note Unlike ::HT_hash_table, a key is stored at most once.
+ */
+int HT_compact_add_element(HT_compact_table* ct, const void* key, const size_t key_size, const void* value, const size_t value_size);
+
+/**
+ * \brief Remove an element from the compact hash table.
+ * \param ct A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \pre ct and key must not be NULL.
+ * \pre key_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On error and errno is set appropriately.
+ * \note The heap is compacted by the removal that makes more than half of it unused.
+ */
+int HT_compact_remove_element(HT_compact_table* ct, const void* key, const size_t key_size);
+
+/**
+ * \brief Get the number of elements stored in the compact hash table.
+ * \param ct A pointer to the hash table.
+ * \pre ct must not be NULL.
+ * \return The number of keys stored.
+ */
+static inline size_t HT_compact_get_nb_elements(const HT_compact_table* ct){
+    return ct->_nb_elements;
+}
+
+/**
+ * \brief Get the memory allocated by the compact hash table.
+ * \param ct A pointer to the hash table.
+ * \pre ct must not be NULL.
+ * \return The size of the heap and of the buckets in bytes.
+ */
+static inline size_t HT_compact_get_allocated_bytes(const HT_compact_table* ct){
+    return ct->_heap_capacity + ((size_t) sizeof(uint32_t) << ct->_bucket_bits);
+}
+
+/**
+ * \brief Deletes the hash table created with ::HT_compact_new_hash.
+ * \see HT_compact_new_hash
+ * \param ct The hash table to delete.
+ * \pre ct must not be NULL.
+ */
+void HT_compact_delete_pointer(HT_compact_table* ct);
+
+/**
+ * \brief Delete a hash table initialized with ::HT_compact_init.
+ * \see HT_compact_init
+ * \param ct The hash table.
+ * \pre ct must not be NULL.
+ */
+void HT_compact_delete(HT_compact_table* ct);
+
+/**
+ * \brief Reset the content of the compact hash table without the need of creating a new one.
+ * \param ct A pointer to the hash table.
+ * \pre ct must not be NULL.
+ * \post ct is still usable, its heap keeps its allocation.
+ */
+void HT_compact_reset_table(HT_compact_table* ct);
+
+#endif // ( __COMPACT_HASH_TABLE_H )
@@ -0,0 +1,277 @@
+/**
+ * \file concurrent_hash_table.h
+ * \brief Thread safe hash table header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __CONCURRENT_HASH_TABLE_H
+#define __CONCURRENT_HASH_TABLE_H
+
+#include <pthread.h>
+
+#include "generic_hash_table.h"
+#include "epoch.h"
+
+/**
+ * \brief The default number of lock stripes.
+ */
+#define HT_CONCURRENT_DEFAULT_STRIPES 64
+
+/**
+ * \brief The size of a cache line, a stripe never shares one with another.
+ */
+#define HT_CACHE_LINE_SIZE 64
+
+/**
+ * \brief The number of slots migrated by each add or remove during a resize.
+ */
+#define HT_CONCURRENT_MIGRATE_SLOTS_PER_STEP 4
+
+/**
+ * \brief A lock protecting a contiguous range of slots.
+ */
+typedef struct{
+    pthread_rwlock_t _lock;     /**<- Taken for reading by lookups, unless they are lock free, and for writing by modifications. */
+    unsigned int _migrated_slots; /**<- During a resize, the number of slots of the range living in the new slots. */
+} __attribute__((aligned(HT_CACHE_LINE_SIZE))) HT_stripe;
+
+/**
+ * \brief A hash table whose operations can be called from several threads.
+ *
+ * The slots are split in 2^stripe_bits contiguous ranges, each protected by
+ * its own reader-writer lock. A key always belongs to the same stripe since
+ * the stripe is given by the top bits of the folded hash, whatever the number
+ * of slots. Operations on keys of different stripes never wait on each other.
+ *
+ * A resize allocates the new slots, then each following modification
+ * migrates ::HT_CONCURRENT_MIGRATE_SLOTS_PER_STEP slots of one stripe,
+ * holding only the lock of that stripe.
+ *
+ * With ::HT_concurrent_set_lockfree_reads the lookups take no lock at all:
+ * the modifications publish the pairs with release stores, copy them instead
+ * of moving them during a resize and retire the unlinked memory with
+ * ::HT_epoch_retire, so a reader never walks freed memory.
+ */
+typedef struct{
+    HT_slot *_slots;            /**<- The slots. */
+    unsigned int _slot_bits;    /**<- The base 2 logarithm of the number of slots. */
+    HT_slot *_new_slots;        /**<- The slots being filled during a resize. */
+    unsigned int _new_slot_bits;/**<- The base 2 logarithm of the number of new slots. */
+    HT_stripe *_stripes;        /**<- The locks. */
+    unsigned int _stripe_bits;  /**<- The base 2 logarithm of the number of stripes. */
+    int _resizing;              /**<- True while a resize is in progress. */
+    unsigned int _resize_cursor;/**<- The next stripe to help, modulo the number of stripes. */
+    unsigned int _pending_stripes; /**<- The number of stripes not migrated yet. */
+    size_t _nb_elements;        /**<- The number of pairs stored. */
+    float _max_load_factor;     /**<- The load factor above which the table grows (0 to disable). */
+    int _lockfree_reads;        /**<- True if the lookups do not lock the stripes. */
+    unsigned int _generation;   /**<- Odd while the slots are swapped at the end of a resize. */
+    HT_hash_function hash_function; /**<- the hash function. */
+}   HT_concurrent_table;
+
+/**
+ * \brief Create a new concurrent hash table.
+ * \see HT_concurrent_delete_pointer
+ * \param size The number of slots, rounded up to a power of two.
+ * \param nb_stripes The number of locks, rounded up to a power of two, 0 for ::HT_CONCURRENT_DEFAULT_STRIPES.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre size must be a strictly positive number (size > 0).
+ * \pre hash_function should not be NULL.
+ * \return A pointer to an already initialized hash table;
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_concurrent_table* HT_concurrent_new_hash(const unsigned int size, const unsigned int nb_stripes, HT_hash_function hash_function);
+
+/**
+ * \brief Initialise an static defined concurrent hash table.
+ * \see HT_concurrent_delete
+ * \param ct A pointer to the hash table to initialise.
+ * \param size The number of slots, rounded up to a power of two and at least the number of stripes.
+ * \param nb_stripes The number of locks, rounded up to a power of two, 0 for ::HT_CONCURRENT_DEFAULT_STRIPES.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre ct and hash_function must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_concurrent_init(HT_concurrent_table* ct, const unsigned int size, const unsigned int nb_stripes, HT_hash_function hash_function);
+
+/**
+ * \brief Set the load factor above which the concurrent hash table doubles its slots.
+ * \param ct A pointer to the hash table.
+ * \param max_load_factor The number of elements per slot, 0 to never grow.
+ * \pre ct must not be NULL and not in use by another thread.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_concurrent_set_load_factor(HT_concurrent_table* ct, float max_load_factor);
+
+/**
+ * \brief Choose whether the lookups walk the slots without taking any lock.
+ * \param ct A pointer to the hash table.
+ * \param enable 0 to lock the stripes for reading and any other integer otherwise.
+ * \pre ct must not be NULL and not in use by another thread.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note A lock free lookup costs no shared write, which is worth the extra
+ * copies done by a resize when the table is mostly read.
+ */
+int HT_concurrent_set_lockfree_reads(HT_concurrent_table* ct, int enable);
+
+/**
+ * \brief Copy the value of an element of the concurrent hash table.
+ * \param ct A pointer to the hash table.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value A buffer receiving a copy of the value, may be NULL.
+ * \param value_size The size of the buffer, set to the size of the value if a match is found.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre ct and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \note The value is copied since another thread may remove it at any time,
+ * it is truncated if the buffer is too small.
+ */
+int HT_concurrent_get_element_position(HT_concurrent_table* ct, const void* key, const size_t key_size, void* value, size_t* value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Get a pointer to the value of an element of a lock free read table.
+ * \param ct A pointer to the hash table.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value found.
+ * \param value_size The size of the value found.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre ct and key must not be NULL and the lookups of ct must be lock free.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \pre The caller must be inside of an ::HT_epoch_enter section which returned 0.
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \note The value stays readable until ::HT_epoch_exit, even if another thread removes it.
+ */
+int HT_concurrent_get_element_reference(HT_concurrent_table* ct, const void* key, const size_t key_size, void** value, size_t* value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Add an element to the concurrent hash table.
+ * \param ct A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre ct, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_concurrent_add_element_position(HT_concurrent_table* ct, const void* key, const size_t key_size, const void* value, const size_t value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Add an element to the concurrent hash table if its key is not present.
+ * \param ct A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \pre ct, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is already present in the hash table.
+ * \retval 2 On error and errno is set appropriately.
+ * \note The membership test and the insertion are atomic.
+ */
+int HT_concurrent_add_element(HT_concurrent_table* ct, const void* key, const size_t key_size, const void* value, const size_t value_size);
+
+/**
+ * \brief Remove an element from the concurrent hash table.
+ * \param ct A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre ct and key must not be NULL.
+ * \pre key_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_concurrent_remove_element_position(HT_concurrent_table* ct, const void* key, const size_t key_size, unsigned int position, int reverse);
+
+/**
+ * \brief Visit a part of the concurrent hash table while other threads keep modifying it.
+ * \param ct A pointer to the hash table.
+ * \param cursor ::HT_SCAN_CURSOR_START for the first call, the returned value for the following ones.
+ * \param count The number of elements after which the call returns.
+ * \param function The function called on each element.
+ * \param data The last argument of function.
+ * \pre ct and function must not be NULL.
+ * \return The cursor to give to the next call, ::HT_SCAN_CURSOR_START once every slot is visited.
+ * \note Works like ::HT_scan, only the stripe of the visited slot is locked
+ * for reading and the table never shrinks, so no element is visited twice.
+ * \warning function runs with the stripe locked and must not call the table.
+ */
+uint64_t HT_concurrent_scan(HT_concurrent_table* ct, uint64_t cursor, const unsigned int count, HT_foreach_function function, void* data);
+
+/**
+ * \brief Get the number of elements stored in the concurrent hash table.
+ * \param ct A pointer to the hash table.
+ * \pre ct must not be NULL.
+ * \return The number of pairs stored, duplicate keys included.
+ */
+static inline size_t HT_concurrent_get_nb_elements(const HT_concurrent_table* ct){
+    return __atomic_load_n(&ct->_nb_elements, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Remove every element of the concurrent hash table.
+ * \param ct A pointer to the hash table.
+ * \pre ct must not be NULL.
+ * \post ct is still usable.
+ * \note Every stripe is locked while the content is released.
+ */
+void HT_concurrent_reset_table(HT_concurrent_table* ct);
+
+/**
+ * \brief Deletes the hash table created with ::HT_concurrent_new_hash.
+ * \see HT_concurrent_new_hash
+ * \param ct The hash table to delete.
+ * \pre ct must not be NULL and not in use by another thread.
+ */
+void HT_concurrent_delete_pointer(HT_concurrent_table* ct);
+
+/**
+ * \brief Delete a hash table initialized with ::HT_concurrent_init.
+ * \see HT_concurrent_init
+ * \param ct The hash table.
+ * \pre ct must not be NULL and not in use by another thread.
+ */
+void HT_concurrent_delete(HT_concurrent_table* ct);
+
+#endif // ( __CONCURRENT_HASH_TABLE_H )
@@ -0,0 +1,91 @@
+/**
+ * \file epoch.h
+ * \brief Epoch based memory reclamation header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __EPOCH_H
+#define __EPOCH_H
+
+/**
+ * \brief The number of buffers a thread retires before trying to reclaim them.
+ */
+#define HT_EPOCH_RECLAIM_THRESHOLD 64
+
+/**
+ * \brief The alignment of the per thread state, a cache line.
+ */
+#define HT_EPOCH_RECORD_ALIGNMENT 64
+
+/**
+ * \brief Enter a read side critical section.
+ *
+ * Every buffer reachable from a shared structure when the section starts
+ * stays valid until the matching ::HT_epoch_exit, even if a writer retires
+ * it in the meantime. Sections can be nested.
+ * \retval 0 On success.
+ * \retval 1 If the state of the thread cannot be allocated, errno is set to
+ * ENOMEM and the section is not entered.
+ * \note The only synchronisation is a sequentially consistent store to a
+ * cache line owned by the calling thread.
+ */
+int HT_epoch_enter(void);
+
+/**
+ * \brief Leave a read side critical section.
+ * \see HT_epoch_enter
+ */
+void HT_epoch_exit(void);
+
+/**
+ * \brief Allocate the bookkeeping of the next retirements of the calling thread.
+ * \param nb_buffers The number of buffers the thread is about to retire.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note The next nb_buffers calls to ::HT_epoch_retire never allocate.
+ */
+int HT_epoch_reserve(const unsigned int nb_buffers);
+
+/**
+ * \brief Destroy a buffer once no reader can access it anymore.
+ * \param buffer The buffer, already unreachable for the new readers.
+ * \param destroy The function destroying the buffer.
+ * \param context The first argument of destroy.
+ * \pre destroy must not be NULL.
+ * \note If the bookkeeping was not reserved and cannot be allocated, the
+ * function waits for the current readers and destroys the buffer
+ * immediately, or leaks it when called inside of a read side critical
+ * section. Use ::HT_epoch_reserve to fail before unlinking the buffer.
+ * \note The buffers of a thread which exits are destroyed by the next
+ * reclamation of any other thread.
+ */
+void HT_epoch_retire(void* buffer, void (*destroy)(void* context, void* buffer), void* context);
+
+/**
+ * \brief Wait until every reader present when called has left and destroy the buffers retired by this thread.
+ * \pre The calling thread must not be inside of a read side critical section.
+ */
+void HT_epoch_synchronize(void);
+
+#endif // ( __EPOCH_H )
@@ -0,0 +1,182 @@
+/**
+ * \file flat_hash_table.h
+ * \brief Open addressing hash table header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __FLAT_HASH_TABLE_H
+#define __FLAT_HASH_TABLE_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief The number of control bytes probed at once.
+ */
+#define HT_FLAT_GROUP_SIZE 16
+
+/**
+ * \brief The offset of an inlined value in the data of a flat entry, after the room of an inlined key.
+ */
+#define HT_FLAT_INLINE_VALUE_OFFSET ((HT_INLINE_KEY_SIZE + HT_INLINE_ALIGNMENT - 1) / HT_INLINE_ALIGNMENT * HT_INLINE_ALIGNMENT)
+
+/**
+ * \brief One entry of the flat hash table.
+ *
+ * A key up to ::HT_INLINE_KEY_SIZE bytes and a value up to
+ * ::HT_INLINE_VALUE_SIZE bytes are stored in the entry itself, so a match
+ * needs no other memory access. Larger ones share a single heap buffer, the
+ * key first and the value aligned after it.
+ */
+typedef struct{
+    HT_container _key,          /**<- The key. */
+                 _value;        /**<- The value associated. */
+    uint64_t _hash;             /**<- The hash of the key. */
+    unsigned char _data[HT_FLAT_INLINE_VALUE_OFFSET + HT_INLINE_VALUE_SIZE] __attribute__((aligned(HT_INLINE_ALIGNMENT))); /**<- The inlined key and value. */
+} HT_flat_entry;
+
+/**
+ * \brief A hash table storing its entries in a flat array (open addressing).
+ *
+ * Each entry has a control byte holding 7 bits of the key hash, or a marker
+ * for empty and deleted entries. A lookup compares a whole group of
+ * ::HT_FLAT_GROUP_SIZE control bytes at once and only touches the entries
+ * whose hash fragment matches.
+ */
+typedef struct{
+    unsigned char *_control;    /**<- The control bytes, one per entry. */
+    HT_flat_entry *_entries;    /**<- The entries. */
+    unsigned int _nb_groups;    /**<- The number of groups of entries (a power of two). */
+    size_t _nb_elements;        /**<- The number of entries in use. */
+    size_t _growth_left;        /**<- The number of insertions before a rehash. */
+    HT_hash_function hash_function; /**<- the hash function. */
+}   HT_flat_table;
+
+/**
+ * \brief Create a new flat hash table able to hold size keys without rehashing.
+ * \see HT_flat_delete_pointer
+ * \param size The number of keys expected in the hash table.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre size must be a strictly positive number(size > 0).
+ * \pre hash_function should not be NULL.
+ * \return A pointer to an already initialized hash table;
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_flat_table* HT_flat_new_hash(const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Use this to initialise an static defined flat hash table.
+ * \see HT_flat_delete
+ * \param ft A pointer to the hash table to initialise.
+ * \param size The number of keys expected in the hash table.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre ft and hash_function must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_flat_init(HT_flat_table* ft, const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Search for an element in the flat hash table.
+ * \param ft A pointer to the hash table.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value The value holding the corresponding value if the key is found.
+ * \param value_size A pointer to a variable that will be set to value size in bytes if a match is found.
+ * \pre ft and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success and if not NULL value is set to point to the corresponding value.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \warning value will point directly to the hash table value. An inlined
+ * value moves when the table is rehashed, the pointer is only valid until the
+ * next insertion.
+ * \note If value is NULL this function acts like a membership test.
+ */
+int HT_flat_get_element(const HT_flat_table* ft, const void* key, const size_t key_size, void** value, size_t* value_size);
+
+/**
+ * \brief Add an element to the flat hash table.
+ * \param ft A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \pre ft, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is already present in the hash table.
+ * \retval 2 On error and errno is set appropriately.
+ * \note Unlike ::HT_hash_table, a key is stored at most once.
+ */
+int HT_flat_add_element(HT_flat_table* ft, const void* key, const size_t key_size, const void* value, const size_t value_size);
+
+/**
+ * \brief Remove an element from the flat hash table.
+ * \param ft A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \pre ft and key must not be NULL.
+ * \pre key_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_flat_remove_element(HT_flat_table* ft, const void* key, const size_t key_size);
+
+/**
+ * \brief Get the number of elements stored in the flat hash table.
+ * \param ft A pointer to the hash table.
+ * \pre ft must not be NULL.
+ * \return The number of keys stored.
+ */
+static inline size_t HT_flat_get_nb_elements(const HT_flat_table* ft){
+    return ft->_nb_elements;
+}
+
+/**
+ * \brief Deletes the hash table created with ::HT_flat_new_hash.
+ * \see HT_flat_new_hash
+ * \param ft The hash table to delete.
+ * \pre ft must not be NULL.
+ */
+void HT_flat_delete_pointer(HT_flat_table* ft);
+
+/**
+ * \brief Delete a hash table initialized with ::HT_flat_init.
+ * \see HT_flat_init
+ * \param ft The hash table.
+ * \pre ft must not be NULL.
+ */
+void HT_flat_delete(HT_flat_table* ft);
+
+/**
+ * \brief Reset the content of the flat hash table without the need of creating a new one.
+ * \param ft A pointer to the hash table.
+ * \pre ft must not be NULL.
+ * \post ft is still usable.
+ */
+void HT_flat_reset_table(HT_flat_table* ft);
+
+#endif // ( __FLAT_HASH_TABLE_H )
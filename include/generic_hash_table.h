@@ -29,6 +29,7 @@
 #define __HASH_TABLE_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 #include <string.h>
 #ifdef HT__DEBUG
@@ -40,6 +41,128 @@
  */
 #define HT_INITIAL_SLOT_SIZE 16
 
+/**
+ * \brief The maximum number of slots of a hash table.
+ *
+ * The cap is deliberate: the slot counts stay unsigned int, as in the
+ * signatures taking a size, and ::HT_hash_fold maps a hash to at most 32
+ * bits. 2^31 is the largest power of two an unsigned int holds, so doubling
+ * a table always stops there and never wraps. The tables keep working past
+ * it, with chains longer than the load factor.
+ */
+#define HT_MAX_SLOTS (1u << 31)
+
+/**
+ * \brief The default load factor above which the slots array grows.
+ */
+#define HT_DEFAULT_MAX_LOAD_FACTOR 1.0f
+
+/**
+ * \brief The default load factor under which the slots array shrinks (0 disables shrinking).
+ */
+#define HT_DEFAULT_MIN_LOAD_FACTOR 0.0f
+
+/**
+ * \brief The number of slots migrated by each add or remove during a resize.
+ */
+#define HT_REHASH_SLOTS_PER_STEP 4
+
+/**
+ * \brief The number of other keys in one slot that makes a seeded table draw a new seed.
+ */
+#ifndef HT_WATCHDOG_CHAIN_LENGTH
+#define HT_WATCHDOG_CHAIN_LENGTH 32
+#endif
+
+/**
+ * \brief The number of keys of a batch whose memory accesses are overlapped.
+ */
+#ifndef HT_BATCH_PIPELINE_DEPTH
+#define HT_BATCH_PIPELINE_DEPTH 16
+#endif
+
+/**
+ * \brief The number of records a streaming bulk build reads before inserting them.
+ */
+#ifndef HT_BULK_CHUNK_SIZE
+#define HT_BULK_CHUNK_SIZE 65536
+#endif
+
+/**
+ * \brief The maximum number of threads of a bulk build or of a parallel operation.
+ */
+#define HT_BULK_MAX_THREADS 64
+
+/**
+ * \brief The minimum number of keys hashed by each thread of a bulk build.
+ */
+#define HT_BULK_RECORDS_PER_THREAD 4096
+
+/**
+ * \brief The minimum number of slots visited by each thread of a parallel operation.
+ */
+#ifndef HT_PARALLEL_SLOTS_PER_THREAD
+#define HT_PARALLEL_SLOTS_PER_THREAD 16384
+#endif
+
+/**
+ * \brief ::HT_merge policy: an element whose key is already present is dropped.
+ */
+#define HT_MERGE_KEEP 0u
+
+/**
+ * \brief ::HT_merge policy: an element whose key is already present replaces the first element of that key.
+ */
+#define HT_MERGE_REPLACE 1u
+
+/**
+ * \brief ::HT_merge policy: every element is added after the elements of the same key.
+ */
+#define HT_MERGE_APPEND 2u
+
+/**
+ * \brief The type of the functions used to hash the keys.
+ * \see hash_functions.h for a set of ready to use functions.
+ */
+typedef uint64_t (*HT_hash_function)(const void* const key, const size_t key_size);
+
+/**
+ * \brief The type of the functions hashing the keys with a secret seed.
+ * \see HT_set_seeded_hash
+ */
+typedef uint64_t (*HT_seeded_hash_function)(const void* const key, const size_t key_size, const uint64_t seed[2]);
+
+/**
+ * \brief The type of the functions releasing the buffers given to a table.
+ * \see HT_set_free_function
+ */
+typedef void (*HT_free_function)(void* buffer);
+
+/**
+ * \brief ::HT_add_element_mode flag: copy the key and the value, like ::HT_add_element_position.
+ */
+#define HT_MODE_COPY 0u
+
+/**
+ * \brief ::HT_add_element_mode flag: the table takes the key buffer and releases it with its free function.
+ */
+#define HT_MODE_TAKE_KEY 1u
+
+/**
+ * \brief ::HT_add_element_mode flag: the table only keeps a pointer to the key, which must outlive the element.
+ */
+#define HT_MODE_BORROW_KEY 2u
+
+/**
+ * \brief ::HT_add_element_mode flag: the table takes the value buffer and releases it with its free function.
+ */
+#define HT_MODE_TAKE_VALUE 4u
+
+/**
+ * \brief ::HT_add_element_mode flag: the table only keeps a pointer to the value, which must outlive the element.
+ */
+#define HT_MODE_BORROW_VALUE 8u
+
 /**
  * \brief A basic container where to store data.
  */
@@ -48,14 +171,39 @@ typedef struct{
     size_t _size_buffer;            /**<- The size of the buffer */
 } HT_container;
 
+/**
+ * \brief The keys up to this size in bytes are stored inside of the pair allocation.
+ */
+#ifndef HT_INLINE_KEY_SIZE
+#define HT_INLINE_KEY_SIZE 24
+#endif
+
+/**
+ * \brief The values up to this size in bytes are stored inside of the pair allocation.
+ */
+#ifndef HT_INLINE_VALUE_SIZE
+#define HT_INLINE_VALUE_SIZE 16
+#endif
+
+/**
+ * \brief The alignment of a value stored inside of the pair allocation.
+ */
+#define HT_INLINE_ALIGNMENT 8
+
 /**
  * \brief A definition of a pair containing the key and its associated value.
+ *
+ * The pair is allocated with enough room after it to hold the key if it is
+ * smaller than ::HT_INLINE_KEY_SIZE, followed by the value if it is smaller
+ * than ::HT_INLINE_VALUE_SIZE. Larger buffers are allocated separately.
  */
 typedef struct HT_pair{
     HT_container _key,          /**<- The key. */
                  _value;        /**<- The value associated. */
     struct HT_pair *_next,      /**<- The next pair */
                    *_previous;  /**<- The previous pair */
+    uint64_t _hash;             /**<- The hash of the key. */
+    unsigned char _data[] __attribute__((aligned(HT_INLINE_ALIGNMENT))); /**<- The inlined key and value. */
 } HT_pair;
 
 /**
@@ -66,40 +214,216 @@ typedef struct{
             *_last_pair;
 } HT_slot;
 
+/**
+ * \brief The callbacks used by a hash table to allocate its pairs.
+ * \see HT_init_allocator
+ */
+typedef struct{
+    void* (*allocate)(void* context, size_t size); /**<- Return size bytes aligned like malloc, NULL on failure. */
+    void (*release)(void* context, void* buffer);  /**<- Give back a buffer, NULL if buffers are only reclaimed by reset. */
+    void (*reset)(void* context);                  /**<- Take back every buffer at once, NULL to release them one by one. */
+    void *context;                                 /**<- The first argument of the callbacks. */
+} HT_allocator;
+
+struct HT_robin_table;
+
 /**
  * \brief A typedef for the hash table.
  */
 typedef struct{
     HT_slot *_slots;            /**<- The slots used for the hash function. */
-    unsigned int _nb_slots;     /**<- The number of slots used for the hash table. */
-    unsigned int (*hash_function)(const void* const key, const size_t key_size); /**<- the hesh function. */
+    unsigned int _nb_slots;     /**<- The number of slots used for the hash table, a power of two. */
+    unsigned int _slot_bits;    /**<- The base 2 logarithm of _nb_slots. */
+    HT_slot *_new_slots;        /**<- The slots being filled during a resize, NULL otherwise. */
+    unsigned int _nb_new_slots; /**<- The number of slots in _new_slots. */
+    unsigned int _new_slot_bits;/**<- The base 2 logarithm of _nb_new_slots. */
+    unsigned int _rehash_index; /**<- The slots of _slots before this one are already migrated. */
+    size_t _nb_elements;        /**<- The number of pairs stored in the hash table. */
+    float _max_load_factor,     /**<- The load factor above which the table grows (0 to disable). */
+          _min_load_factor;     /**<- The load factor under which the table shrinks (0 to disable). */
+    HT_allocator _allocator;    /**<- The allocator of the pairs. */
+    HT_hash_function hash_function; /**<- the hesh function. */
+    HT_seeded_hash_function seeded_hash_function; /**<- The seeded hash function used instead of hash_function, NULL if none. */
+    uint64_t _seed[2];          /**<- The secret seed of seeded_hash_function. */
+    HT_seeded_hash_function _old_seeded_hash_function; /**<- During a reseed, the seeded hash function of the slots not migrated yet. */
+    uint64_t _old_seed[2];      /**<- During a reseed, the seed of the slots not migrated yet. */
+    int _reseeding;             /**<- True while _new_slots are filled with the pairs hashed again. */
+    size_t _reseed_threshold;   /**<- The number of elements under which the watchdog does not reseed. */
+    HT_free_function free_function; /**<- Releases the buffers taken by ::HT_add_element_mode, NULL for free. */
+    int _has_taken;             /**<- True if a buffer was taken since the last reset. */
+    struct HT_robin_table *_robin; /**<- The Robin Hood table holding the elements instead of the slots, NULL if none. */
 }   HT_hash_table;
 
+/**
+ * \brief The number of entries of the chain length histogram of ::HT_stats.
+ */
+#define HT_STATS_HISTOGRAM_SIZE 16
+
+/**
+ * \brief A summary of the layout of a hash table.
+ * \see HT_get_stats
+ */
+typedef struct{
+    size_t nb_elements;         /**<- The number of pairs stored. */
+    size_t nb_slots;            /**<- The number of slots, during a resize the new ones and the old ones not migrated yet. */
+    double load_factor;         /**<- The number of pairs per slot. */
+    size_t nb_empty_slots;      /**<- The number of slots without any pair. */
+    size_t longest_chain;       /**<- The number of pairs of the longest slot. */
+    double average_chain;       /**<- The average number of pairs of the non empty slots. */
+    size_t chain_histogram[HT_STATS_HISTOGRAM_SIZE]; /**<- The number of slots holding i pairs, the last entry counts the longer chains too. */
+    size_t allocated_bytes;     /**<- The memory asked to the allocator for the slots and the pairs. */
+    int resizing;               /**<- True while an incremental resize or reseed is in progress. */
+} HT_stats;
+
+/**
+ * \brief The operations counted by the library when built with HT_STATS defined.
+ * \see HT_get_counters
+ *
+ * Every thread increments its own copy with relaxed atomics, so the counters
+ * cost no shared write. They only grow, a metrics pipeline exports the
+ * difference between two reads.
+ */
+typedef struct{
+    uint64_t hits;              /**<- The lookups that found their key. */
+    uint64_t misses;            /**<- The lookups that did not. */
+    uint64_t searches;          /**<- The walks of a slot, by lookups and modifications. */
+    uint64_t probes;            /**<- The pairs compared by those walks. */
+    uint64_t hashes;            /**<- The keys hashed. */
+    uint64_t hash_cycles;       /**<- The time stamp counter cycles spent hashing, nanoseconds on other than x86, estimated from one hash out of ::HT_STATS_HASH_SAMPLING. */
+} HT_counters;
+
+/**
+ * \brief One hash out of HT_STATS_HASH_SAMPLING is timed.
+ */
+#ifndef HT_STATS_HASH_SAMPLING
+#define HT_STATS_HASH_SAMPLING 16
+#endif
+
+/**
+ * \brief An iterator over the elements of a hash table.
+ * \see HT_iterator_begin
+ */
+typedef struct{
+    const HT_hash_table *_table;/**<- The hash table. */
+    const HT_slot *_slots;      /**<- The slots being walked. */
+    unsigned int _nb_slots;     /**<- The number of slots in _slots. */
+    unsigned int _slot_index;   /**<- The slot of the current element, or its entry with a Robin Hood backend. */
+    HT_pair *_pair;             /**<- The current pair, NULL at the end and with a Robin Hood backend. */
+    HT_container *_key,         /**<- The key of the current element, NULL at the end. */
+                 *_value;       /**<- The value of the current element. */
+} HT_iterator;
+
+/**
+ * \brief A function called on each element of a hash table.
+ * \param key The key.
+ * \param key_size The size of the key in bytes.
+ * \param value The value, it can be modified in place.
+ * \param value_size The size of the value in bytes.
+ * \param data The user data given with the function.
+ * \return 0 to continue and any other integer to stop.
+ */
+typedef int (*HT_foreach_function)(const void* key, const size_t key_size, void* value, const size_t value_size, void* data);
+
+/**
+ * \brief A function folding an element into the accumulator of a thread.
+ * \see HT_parallel_reduce
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value.
+ * \param value_size The size of the value in bytes.
+ * \param accumulator The accumulator of the calling thread.
+ */
+typedef void (*HT_reduce_function)(const void* key, const size_t key_size, const void* value, const size_t value_size, void* accumulator);
+
+/**
+ * \brief A function combining the accumulator of a thread into the result.
+ * \see HT_parallel_reduce
+ * \param result The result.
+ * \param accumulator The accumulator of a thread.
+ */
+typedef void (*HT_combine_function)(void* result, const void* accumulator);
+
+/**
+ * \brief A function modifying the value of an element in place.
+ * \param value The value.
+ * \param value_size The size of the value in bytes.
+ * \param inserted True if the element was just added with its initial value.
+ * \param data The user data given with the function.
+ */
+typedef void (*HT_update_function)(void* value, const size_t value_size, int inserted, void* data);
+
+/**
+ * \brief A function giving the records of a streaming bulk build one by one.
+ * \param context The user data given with the function.
+ * \param key Set to the key of the record.
+ * \param key_size Set to the size of the key in bytes.
+ * \param value Set to the value of the record.
+ * \param value_size Set to the size of the value in bytes.
+ * \retval 0 If a record is given, it only needs to stay valid until the next call.
+ * \retval 1 If there is no more record.
+ * \retval 2 On error and errno is set appropriately.
+ */
+typedef int (*HT_record_reader)(void* context, const void** key, size_t* key_size, const void** value, size_t* value_size);
+
+/**
+ * \brief The cursor value starting and ending a scan.
+ * \see HT_scan
+ */
+#define HT_SCAN_CURSOR_START UINT64_C(0)
+
+/**
+ * \brief Get the slot index of a hash in an array of 2^bits slots.
+ * \param hash The hash of the key.
+ * \param bits The base 2 logarithm of the number of slots.
+ * \return The top bits of a multiplication by the golden ratio.
+ */
+static inline unsigned int HT_hash_fold(const uint64_t hash, const unsigned int bits){
+    return (unsigned int) ((hash * UINT64_C(0x9E3779B97F4A7C15)) >> 32 >> (32 - bits));
+}
+
 /**
  * \brief Create a new hash table already initialized with size number of keys.
  * \see HT_delete_pointer
- * \param size The number of keys present in the hash table.
+ * \param size The number of slots of the hash table, rounded up to a power of two.
  * \param hash_function A pointer to a function to use for hashing the key values.
- * \pre size must be a strictly positive number(size > 0).
+ * \pre size must be a strictly positive number(size > 0) not above ::HT_MAX_SLOTS.
  * \pre hash_function should not be NULL.
  * \return A pointer to an already initialized hash table;
  * \retval NULL On failure and errno is set appropriately.
  * \warning Do not use ::HT_init after this or you will ensure memory leaks.
  */
-HT_hash_table* HT_new_hash(const unsigned int size, unsigned int (*hash_function)(const void* const key, const size_t key_size));
+HT_hash_table* HT_new_hash(const unsigned int size, HT_hash_function hash_function);
 
 /**
  * \brief Use this to initialise an static defined hash table.
  * \see HT_delete
  * \param ht A pointer to the hash table to initialise.
  * \param hash_function A pointer to a function to use for hashing the key values.
- * \param size The number of keys present in the hash table.
+ * \param size The number of slots of the hash table, rounded up to a power of two.
  * \pre ht and hash_function must not be NULL.
  * \pre size must be an strictly positive number (size > 0).
  * \retval 0 On success.
  * \retval 1 On failure and errno is set appropriately.
  */
-int HT_init(HT_hash_table* ht, const unsigned int size, unsigned int (*hash_function)(const void* const key, const size_t key_size));
+int HT_init(HT_hash_table* ht, const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Initialise a static defined hash table whose pairs come from a custom allocator.
+ * \see HT_delete
+ * \param ht A pointer to the hash table to initialise.
+ * \param size The number of slots of the hash table, rounded up to a power of two.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \param allocator The callbacks providing the memory of the pairs, NULL for malloc and free.
+ * \pre ht and hash_function must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \pre allocator->allocate must not be NULL.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note The slots arrays are always allocated with malloc.
+ * \note If allocator->reset is not NULL, ::HT_reset_table and ::HT_delete call it
+ * instead of releasing every pair, the allocator must then be used by this table only.
+ */
+int HT_init_allocator(HT_hash_table* ht, const unsigned int size, HT_hash_function hash_function, const HT_allocator* allocator);
 
 /**
  * \brief Search for an element in the hash table.
@@ -135,7 +459,7 @@ int HT_get_element_position(const HT_hash_table* ht, const void* key, const size
  * \warning value will point directly to the hash table value.
  * \note If value is NULL this function acts like a membership test.
  */
-inline int HT_get_element(const HT_hash_table* ht, const void* key, const size_t key_size, void** value, size_t* value_size){
+static inline int HT_get_element(const HT_hash_table* ht, const void* key, const size_t key_size, void** value, size_t* value_size){
     return HT_get_element_position(ht, key, key_size, value, value_size, 0, 0);
 }
 
@@ -155,6 +479,85 @@ inline int HT_get_element(const HT_hash_table* ht, const void* key, const size_t
  */
 int HT_add_element_position(HT_hash_table* ht, const void* key, const size_t key_size, const void* value, const size_t value_size, unsigned int position, int reverse);
 
+/**
+ * \brief Add an element to the hash table, taking or borrowing the key and value buffers instead of copying them.
+ * \param ht A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \param mode ::HT_MODE_COPY, or HT_MODE_TAKE_KEY or HT_MODE_BORROW_KEY and
+ * HT_MODE_TAKE_VALUE or HT_MODE_BORROW_VALUE combined with a bitwise or.
+ * \pre ht, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately, a taken buffer still belongs to the caller.
+ * \note A taken buffer is released with the function given to
+ * ::HT_set_free_function when its element is removed, and must not be used
+ * by the caller anymore. Taking or borrowing a value never copies it.
+ * \warning A borrowed value is modified in place by ::HT_update_with.
+ */
+int HT_add_element_mode(HT_hash_table* ht, const void* key, const size_t key_size, const void* value, const size_t value_size, unsigned int position, int reverse, unsigned int mode);
+
+/**
+ * \brief Get the first element of a key, adding it if the key is not present.
+ * \param ht A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value to add if the key is not present.
+ * \param value_size The size of the value in bytes.
+ * \param stored_value Set to point to the value stored in the table, may be NULL.
+ * \param stored_value_size Set to the size of the stored value, may be NULL.
+ * \pre ht, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 If the element is added.
+ * \retval 1 If the key is already present in the hash table.
+ * \retval 2 On error and errno is set appropriately.
+ * \warning stored_value will point directly to the hash table value.
+ * \note The key is hashed once and its slot walked once, the element is
+ * added at position 0 like ::HT_add_element_position.
+ */
+int HT_find_or_insert(HT_hash_table* ht, const void* key, const size_t key_size, const void* value, const size_t value_size, void** stored_value, size_t* stored_value_size);
+
+/**
+ * \brief Replace the value of the first element of a key, adding it if the key is not present.
+ * \param ht A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the new value.
+ * \param value_size The size of the value in bytes.
+ * \pre ht, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 If the element is added.
+ * \retval 1 If the value is replaced.
+ * \retval 2 On error and errno is set appropriately.
+ * \note A value of the same size is overwritten in place, otherwise the
+ * element is reallocated at the same position and the old value pointers
+ * become invalid.
+ */
+int HT_upsert(HT_hash_table* ht, const void* key, const size_t key_size, const void* value, const size_t value_size);
+
+/**
+ * \brief Modify in place the value of the first element of a key, adding it first if the key is not present.
+ * \param ht A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param initial_value A pointer to the value to add if the key is not present.
+ * \param initial_value_size The size of the initial value in bytes.
+ * \param update The function modifying the value.
+ * \param data The last argument of update.
+ * \pre ht, key, initial_value and update must not be NULL.
+ * \pre key_size and initial_value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 If the element is added, update is called on the initial value.
+ * \retval 1 If the key is already present in the hash table.
+ * \retval 2 On error and errno is set appropriately, update is not called.
+ * \note A counter is incremented with a single hash and a single walk of the slot.
+ * \warning update must not call the hash table.
+ */
+int HT_update_with(HT_hash_table* ht, const void* key, const size_t key_size, const void* initial_value, const size_t initial_value_size, HT_update_function update, void* data);
+
 /**
  * \brief Add an element to the hash table.
  * \param ht A pointer to the hash table.
@@ -168,12 +571,8 @@ int HT_add_element_position(HT_hash_table* ht, const void* key, const size_t key
  * \retval 1 If the key is already present in the hash table.
  * \retval 2 On error and errno is set appropriately.
  */
-inline int HT_add_element(HT_hash_table* ht, const void* key, const size_t key_size, const void* value, const size_t value_size){
-    int retval = HT_get_element_position(ht, key, key_size, NULL, NULL, 0, 0);
-    if(retval == 1)
-        return HT_add_element_position(ht, key, key_size, value, value_size, 0, 0);
-    else
-        return 1;
+static inline int HT_add_element(HT_hash_table* ht, const void* key, const size_t key_size, const void* value, const size_t value_size){
+    return HT_find_or_insert(ht, key, key_size, value, value_size, NULL, NULL);
 }
 
 /**
@@ -200,6 +599,88 @@ void HT_delete(HT_hash_table* ht);
  */
 void HT_reset_table(HT_hash_table* ht);
 
+/**
+ * \brief Set the load factors that trigger an automatic resize of the hash table.
+ * \param ht A pointer to the hash table.
+ * \param max_load_factor The number of elements per slot above which the slots are doubled, 0 to never grow.
+ * \param min_load_factor The number of elements per slot under which the slots are halved, 0 to never shrink.
+ * \pre ht must not be NULL.
+ * \pre min_load_factor must be lower than half of max_load_factor if both are used.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note The resize is incremental, each following add or remove migrates a few slots.
+ */
+int HT_set_load_factors(HT_hash_table* ht, float max_load_factor, float min_load_factor);
+
+/**
+ * \brief Set the function releasing the buffers taken by ::HT_add_element_mode.
+ * \param ht A pointer to the hash table.
+ * \param free_function The function, NULL for free.
+ * \pre ht must not be NULL.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note The buffers already taken are released with the new function.
+ */
+int HT_set_free_function(HT_hash_table* ht, HT_free_function free_function);
+
+/**
+ * \brief Hash the keys of the hash table with a seeded function and a random secret seed.
+ * \param ht A pointer to the hash table.
+ * \param seeded_hash_function The seeded hash function, NULL to go back to the hash function of the table.
+ * \pre ht must not be NULL.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note Every pair is hashed again, incrementally like a resize: each
+ * following add or remove moves a few slots. Until the end, a lookup in a
+ * slot not moved yet hashes its key with both seeds. A resize or a reseed
+ * already in progress is completed first. Calling it again draws a new seed.
+ * \note While a seeded function is used, an insertion in a slot already
+ * holding ::HT_WATCHDOG_CHAIN_LENGTH other keys starts such a reseed, bulk
+ * builds included. The table has to double its number of elements before
+ * the next one, and no insertion stalls on it.
+ * \see hash_functions.h for HT_hash_sip, meant for keys chosen by an attacker.
+ */
+int HT_set_seeded_hash(HT_hash_table* ht, HT_seeded_hash_function seeded_hash_function);
+
+/**
+ * \brief Store the elements of an empty hash table in a Robin Hood table instead of its slots.
+ * \param ht A pointer to the hash table.
+ * \pre ht must not be NULL.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately, EINVAL if the table is not empty.
+ * \note Keys become unique: ::HT_add_element_position and
+ * ::HT_add_element_u64 return 1 for a key already present, the position of
+ * the lookups and removals is ignored. ::HT_get_element_position,
+ * ::HT_find_or_insert, ::HT_remove_element_position, their u64 variants,
+ * ::HT_set_seeded_hash, ::HT_get_nb_elements, ::HT_reset_table and
+ * ::HT_delete use the Robin Hood table, and so do the iterators,
+ * ::HT_foreach and ::HT_scan. The other functions fail with EINVAL.
+ * \see robin_hood_hash_table.h
+ */
+int HT_set_robin_backend(HT_hash_table* ht);
+
+/**
+ * \brief Start the migration of the hash table to a new number of slots.
+ * \param ht A pointer to the hash table.
+ * \param size The new number of slots, rounded up to a power of two.
+ * \pre ht must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note A resize already in progress is completed first.
+ */
+int HT_resize(HT_hash_table* ht, const unsigned int size);
+
+/**
+ * \brief Get the number of elements stored in the hash table.
+ * \param ht A pointer to the hash table.
+ * \pre ht must not be NULL.
+ * \return The number of pairs stored, duplicate keys included.
+ */
+static inline size_t HT_get_nb_elements(const HT_hash_table* ht){
+    return ht->_nb_elements;
+}
+
 /**
  * \brief Remove the element in the same way that the HT_add_element_position
  * works
@@ -215,4 +696,334 @@ void HT_reset_table(HT_hash_table* ht);
  */
 int HT_remove_element_position(HT_hash_table* ht, const void* key, const size_t key_size, unsigned int position, int reverse);
 
+/**
+ * \brief Search for several elements in the hash table.
+ * \param ht A pointer to the hash table.
+ * \param nb_keys The number of keys.
+ * \param keys The keys to search in the table.
+ * \param key_sizes The sizes of the keys in bytes.
+ * \param values Set to point to the value of each key found, may be NULL.
+ * \param value_sizes Set to the size of the value of each key found, may be NULL.
+ * \param results Set to the ::HT_get_element return value of each key, may be NULL.
+ * \pre ht, keys and key_sizes must not be NULL.
+ * \return The number of keys found.
+ * \note The keys are hashed and their slots and first pairs prefetched
+ * ::HT_BATCH_PIPELINE_DEPTH at a time, so the cache misses of a key overlap
+ * with the ones of the others instead of adding up.
+ * \warning The values point directly to the hash table values.
+ */
+size_t HT_get_elements_batch(const HT_hash_table* ht, const size_t nb_keys, const void* const keys[], const size_t key_sizes[], void* values[], size_t value_sizes[], int results[]);
+
+/**
+ * \brief Add several elements to the hash table.
+ * \param ht A pointer to the hash table.
+ * \param nb_keys The number of elements.
+ * \param keys The keys.
+ * \param key_sizes The sizes of the keys in bytes.
+ * \param values The values.
+ * \param value_sizes The sizes of the values in bytes.
+ * \param unique 0 to add the elements like ::HT_add_element_position at position 0,
+ * any other integer to skip the keys already present like ::HT_add_element.
+ * \param results Set to the return value of each addition, may be NULL.
+ * \pre ht, keys, key_sizes, values and value_sizes must not be NULL.
+ * \return The number of elements added.
+ * \note The elements are added in order, a key repeated in the batch is seen
+ * by the following additions.
+ */
+size_t HT_add_elements_batch(HT_hash_table* ht, const size_t nb_keys, const void* const keys[], const size_t key_sizes[], const void* const values[], const size_t value_sizes[], int unique, int results[]);
+
+/**
+ * \brief Remove several elements from the hash table like ::HT_remove_element_position at position 0.
+ * \param ht A pointer to the hash table.
+ * \param nb_keys The number of keys.
+ * \param keys The keys.
+ * \param key_sizes The sizes of the keys in bytes.
+ * \param results Set to the return value of each removal, may be NULL.
+ * \pre ht, keys and key_sizes must not be NULL.
+ * \return The number of elements removed.
+ */
+size_t HT_remove_elements_batch(HT_hash_table* ht, const size_t nb_keys, const void* const keys[], const size_t key_sizes[], int results[]);
+
+/**
+ * \brief Get the first element of a 64 bits integer key, see ::HT_get_element.
+ * \param ht A pointer to the hash table.
+ * \param key The key, stored as its sizeof(uint64_t) bytes.
+ * \param value A pointer to a variable that will be set to point to the value if a match is found.
+ * \param value_size A pointer to a variable that will be set to value size in bytes if a match is found.
+ * \pre ht must not be NULL.
+ * \retval 0 On success and if not NULL value is set to point to the corresponding value.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \note The keys are compared as integers. With ::HT_hash_u64 as the hash
+ * function of ht, the hash is computed inline instead of by a call.
+ */
+int HT_get_element_u64(const HT_hash_table* ht, const uint64_t key, void** value, size_t* value_size);
+
+/**
+ * \brief Add an element with a 64 bits integer key if the key is not present, see ::HT_add_element.
+ * \param ht A pointer to the hash table.
+ * \param key The key, stored as its sizeof(uint64_t) bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \pre ht and value must not be NULL.
+ * \pre value_size must be a strictly positive number (value_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is already present in the hash table.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_add_element_u64(HT_hash_table* ht, const uint64_t key, const void* value, const size_t value_size);
+
+/**
+ * \brief Remove the first element of a 64 bits integer key.
+ * \param ht A pointer to the hash table.
+ * \param key The key.
+ * \pre ht must not be NULL.
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_remove_element_u64(HT_hash_table* ht, const uint64_t key);
+
+/**
+ * \brief Add many elements at once, after the elements of the same key already present.
+ * \param ht A pointer to the hash table.
+ * \param nb_records The number of elements.
+ * \param keys The keys.
+ * \param key_sizes The sizes of the keys in bytes.
+ * \param values The values.
+ * \param value_sizes The sizes of the values in bytes.
+ * \param nb_threads The number of threads hashing the keys, 0 for one per online processor.
+ * \pre ht must not be NULL, the arrays must not be NULL if nb_records > 0.
+ * \pre Every key and value must be non NULL with a strictly positive size.
+ * \pre The hash function of ht must be thread safe if nb_threads != 1.
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately, the hash table is unchanged.
+ * \note Works like ::HT_add_element_position at position 0 in reverse order for
+ * each record, without the membership tests. The slots are sized once, the
+ * records are partitioned by slot and every pair is copied in a single
+ * allocation, laid out slot by slot, which is released with its last pair.
+ */
+int HT_bulk_build(HT_hash_table* ht, const size_t nb_records, const void* const keys[], const size_t key_sizes[], const void* const values[], const size_t value_sizes[], unsigned int nb_threads);
+
+/**
+ * \brief Add every element given by a reader, see ::HT_bulk_build.
+ * \param ht A pointer to the hash table.
+ * \param reader The function giving the records.
+ * \param context The first argument of reader.
+ * \param nb_threads The number of threads hashing the keys, 0 for one per online processor.
+ * \pre ht and reader must not be NULL.
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately.
+ * \note The records are staged and built by chunks of ::HT_BULK_CHUNK_SIZE,
+ * on error the chunks already built stay in the hash table.
+ */
+int HT_bulk_build_stream(HT_hash_table* ht, HT_record_reader reader, void* context, unsigned int nb_threads);
+
+/**
+ * \brief Move every element of a hash table into another one.
+ * \param destination A pointer to the hash table receiving the elements.
+ * \param source A pointer to the hash table giving the elements, empty on success.
+ * \param policy ::HT_MERGE_KEEP, ::HT_MERGE_REPLACE or ::HT_MERGE_APPEND.
+ * \param nb_threads The number of threads, 0 for one per online processor.
+ * \pre destination and source must not be NULL nor the same table.
+ * \pre The allocators of both tables must be thread safe if nb_threads != 1.
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately, the elements already
+ * moved stay in destination.
+ * \note The slots of destination are sized once. The pairs are relinked
+ * when both tables use the same allocator, copied otherwise. The threads
+ * split the folded hashes in ranges, which cover disjoint slots of both
+ * tables, so they only run in parallel when both tables hash the keys the
+ * same way; otherwise the source is walked by the caller.
+ */
+int HT_merge(HT_hash_table* destination, HT_hash_table* source, const unsigned int policy, unsigned int nb_threads);
+
+/**
+ * \brief Remove every element of the hash table, splitting the slots between threads.
+ * \param ht A pointer to the hash table.
+ * \param nb_threads The number of threads, 0 for one per online processor.
+ * \pre ht must not be NULL.
+ * \pre The allocator and the free function of ht must be thread safe if nb_threads != 1.
+ * \post ht is still usable.
+ * \see HT_reset_table
+ */
+void HT_parallel_reset_table(HT_hash_table* ht, unsigned int nb_threads);
+
+/**
+ * \brief Delete a hash table, splitting the slots between threads.
+ * \param ht The hash table.
+ * \param nb_threads The number of threads, 0 for one per online processor.
+ * \pre ht must not be NULL.
+ * \pre The allocator and the free function of ht must be thread safe if nb_threads != 1.
+ * \see HT_delete
+ */
+void HT_parallel_delete(HT_hash_table* ht, unsigned int nb_threads);
+
+/**
+ * \brief Call a function on every element of the hash table from several threads.
+ * \param ht A pointer to the hash table.
+ * \param function The function to call, from any of the threads at once.
+ * \param data The last argument of function, shared by the threads.
+ * \param nb_threads The number of threads, 0 for one per online processor.
+ * \pre ht and function must not be NULL.
+ * \return 0 once every element is visited, the value returned by function if it stopped the walk.
+ * \retval 2 If ht or function is NULL and errno is set to EINVAL.
+ * \note Each thread visits its own range of slots. Once function stops, the
+ * other threads stop before their next element.
+ * \warning function must not modify the table.
+ */
+int HT_parallel_foreach(const HT_hash_table* ht, HT_foreach_function function, void* data, unsigned int nb_threads);
+
+/**
+ * \brief Fold every element of the hash table into a result, from several threads.
+ * \param ht A pointer to the hash table.
+ * \param reduce The function folding an element into the accumulator of its thread.
+ * \param combine The function combining an accumulator into result.
+ * \param result The identity of combine on entry, the combination of every element on return.
+ * \param result_size The size of result in bytes.
+ * \param nb_threads The number of threads, 0 for one per online processor.
+ * \pre ht, reduce, combine and result must not be NULL.
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately, result is unchanged.
+ * \note Each thread starts from a copy of result and the accumulators are
+ * combined by the caller in the order of the slots.
+ */
+int HT_parallel_reduce(const HT_hash_table* ht, HT_reduce_function reduce, HT_combine_function combine, void* result, const size_t result_size, unsigned int nb_threads);
+
+/**
+ * \brief Measure the layout of the hash table.
+ * \param ht A pointer to the hash table.
+ * \param stats Set to the measures.
+ * \pre ht and stats must not be NULL.
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately.
+ * \note Every slot and pair is visited, the cost is linear in the size of the table.
+ */
+int HT_get_stats(const HT_hash_table* ht, HT_stats* stats);
+
+/**
+ * \brief Sum the counters of every thread.
+ * \param counters Set to the sums, all zero if the library is built without HT_STATS.
+ * \pre counters must not be NULL.
+ * \note The sums are not a snapshot, the other threads keep counting meanwhile.
+ */
+void HT_get_counters(HT_counters* counters);
+
+/**
+ * \brief Position an iterator on the first element of the hash table.
+ * \param ht A pointer to the hash table.
+ * \param it The iterator to initialise.
+ * \pre ht and it must not be NULL.
+ * \warning The iterator is invalidated by any modification of the table,
+ * use ::HT_scan to enumerate a table modified meanwhile.
+ */
+void HT_iterator_begin(const HT_hash_table* ht, HT_iterator* it);
+
+/**
+ * \brief Move an iterator to the following element.
+ * \param it The iterator.
+ * \pre it must not be at the end.
+ */
+void HT_iterator_next(HT_iterator* it);
+
+/**
+ * \brief Test if an iterator went past the last element.
+ * \param it The iterator.
+ * \return 0 if the iterator is on an element and any other integer otherwise.
+ */
+static inline int HT_iterator_end(const HT_iterator* it){
+    return it->_key == NULL;
+}
+
+/**
+ * \brief Get the key of the element of an iterator.
+ * \param it The iterator, not at the end.
+ * \param key_size Set to the size of the key if not NULL.
+ * \return A pointer to the key.
+ */
+static inline const void* HT_iterator_key(const HT_iterator* it, size_t* key_size){
+    if( key_size != NULL )
+        *key_size = it->_key->_size_buffer;
+    return it->_key->_buffer;
+}
+
+/**
+ * \brief Get the value of the element of an iterator.
+ * \param it The iterator, not at the end.
+ * \param value_size Set to the size of the value if not NULL.
+ * \return A pointer to the value, it can be modified in place.
+ */
+static inline void* HT_iterator_value(const HT_iterator* it, size_t* value_size){
+    if( value_size != NULL )
+        *value_size = it->_value->_size_buffer;
+    return it->_value->_buffer;
+}
+
+/**
+ * \brief Call a function on every element of a hash table using a Robin Hood backend.
+ * \see HT_foreach
+ * \param ht A pointer to the hash table.
+ * \param function The function to call.
+ * \param data The last argument of function.
+ * \pre ht and function must not be NULL and ht must use a Robin Hood backend.
+ * \return 0 once every element is visited, the value returned by function if it stopped the walk.
+ */
+int HT_robin_backend_foreach(const HT_hash_table* ht, HT_foreach_function function, void* data);
+
+/**
+ * \brief Call a function on every element of the hash table.
+ * \param ht A pointer to the hash table.
+ * \param function The function to call.
+ * \param data The last argument of function.
+ * \pre ht and function must not be NULL.
+ * \return 0 once every element is visited, the value returned by function if it stopped the walk.
+ * \note Defined in this header so that a constant function can be inlined.
+ * \warning function must not modify the table.
+ */
+static inline int HT_foreach(const HT_hash_table* ht, HT_foreach_function function, void* data){
+    const HT_slot *slots = ht->_slots;
+    unsigned int nb_slots = ht->_nb_slots,
+                 i;
+    HT_pair *pair;
+    int retval;
+
+    if( ht->_robin != NULL )
+        return HT_robin_backend_foreach(ht, function, data);
+    for(;;){
+        for(i = 0; i < nb_slots; ++i){
+            for(pair = slots[i]._first_pair; pair != NULL; pair = pair->_next){
+                retval = function(pair->_key._buffer, pair->_key._size_buffer, pair->_value._buffer, pair->_value._size_buffer, data);
+                if( retval != 0 )
+                    return retval;
+            }
+        }
+        // During a resize the migrated slots are empty, the new ones come next
+        if( slots == ht->_new_slots || ht->_new_slots == NULL )
+            return 0;
+        slots = ht->_new_slots;
+        nb_slots = ht->_nb_new_slots;
+    }
+}
+
+/**
+ * \brief Visit a part of the hash table, the table can be modified between two calls.
+ * \param ht A pointer to the hash table.
+ * \param cursor ::HT_SCAN_CURSOR_START for the first call, the returned value for the following ones.
+ * \param count The number of elements after which the call returns.
+ * \param function The function called on each element.
+ * \param data The last argument of function.
+ * \pre ht and function must not be NULL.
+ * \return The cursor to give to the next call, ::HT_SCAN_CURSOR_START once every slot is visited.
+ * \note The cursor is a position in the space of the folded hashes, which a
+ * slot always covers with a contiguous range whatever the number of slots.
+ * Every element present during the whole scan is visited once, or more
+ * if the table shrinks meanwhile, whatever the resizes in between. A reseed
+ * of a seeded table moves the elements to unrelated slots, a scan across one
+ * may miss or repeat some of them.
+ * \note A slot is always visited entirely, so more than count elements may
+ * be visited, function stopping the walk takes effect at the end of its slot.
+ * \warning function must not modify the table.
+ */
+uint64_t HT_scan(const HT_hash_table* ht, uint64_t cursor, const unsigned int count, HT_foreach_function function, void* data);
+
 #endif // ( __HASH_TABLE_H )
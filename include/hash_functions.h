@@ -0,0 +1,116 @@
+/**
+ * \file hash_functions.h
+ * \brief Ready to use hash functions header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __HASH_FUNCTIONS_H
+#define __HASH_FUNCTIONS_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief Hash a key 8 bytes at a time with 64x64 to 128 bits multiplications (wyhash).
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \return The hash of the key.
+ * \note This is the recommended default, it is fast on short and long keys.
+ */
+uint64_t HT_hash_wy(const void* const key, const size_t key_size);
+
+/**
+ * \brief Mix the bits of a 64 bits integer with two multiply-xorshift rounds.
+ * \param x The integer.
+ * \return The hash of x, a bijection so distinct integers never collide.
+ */
+static inline uint64_t HT_hash_mix64(uint64_t x){
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+/**
+ * \brief Hash a 64 bits integer key with ::HT_hash_mix64.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \return The hash of the key.
+ * \note Keys of another size are hashed with ::HT_hash_wy. The integer entry
+ * points of a table using this function inline the mix instead of calling it.
+ */
+uint64_t HT_hash_u64(const void* const key, const size_t key_size);
+
+/**
+ * \brief Hash a key 32 bytes at a time with four independent lanes (xxHash64).
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \return The hash of the key.
+ */
+uint64_t HT_hash_xxh64(const void* const key, const size_t key_size);
+
+/**
+ * \brief Hash a key with ::HT_hash_wy and a secret seed.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param seed The two words of the seed.
+ * \return The hash of the key.
+ * \note Fast, but only meant for keys that an attacker does not choose.
+ */
+uint64_t HT_hash_wy_seeded(const void* const key, const size_t key_size, const uint64_t seed[2]);
+
+/**
+ * \brief Hash a key with ::HT_hash_xxh64 and a secret seed.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param seed The two words of the seed.
+ * \return The hash of the key.
+ * \note Fast, but only meant for keys that an attacker does not choose.
+ */
+uint64_t HT_hash_xxh64_seeded(const void* const key, const size_t key_size, const uint64_t seed[2]);
+
+/**
+ * \brief Hash a key with SipHash-1-3, a keyed pseudo random function.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param seed The two words of the 128 bits secret key.
+ * \return The hash of the key.
+ * \note Without the seed, colliding keys cannot be computed from the
+ * outputs, use it for keys coming from untrusted input. The number of rounds
+ * is set by HT_SIP_COMPRESSION_ROUNDS and HT_SIP_FINALIZATION_ROUNDS.
+ */
+uint64_t HT_hash_sip(const void* const key, const size_t key_size, const uint64_t seed[2]);
+
+/**
+ * \brief Hash a key with the CRC32C instruction of SSE 4.2 when the processor has it.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \return The CRC of the key spread over 64 bits.
+ * \note Only 32 bits of the result are independent, and a slow bitwise CRC
+ * is used on processors without SSE 4.2 or when the library is built with
+ * HT_HASH_PORTABLE defined. Multiplied by the inverse of 0x9E3779B97F4A7C15,
+ * the result gives back the CRC32C of the key in its low 32 bits and the size
+ * of the key in the high ones.
+ */
+uint64_t HT_hash_crc32c(const void* const key, const size_t key_size);
+
+#endif // ( __HASH_FUNCTIONS_H )
@@ -0,0 +1,219 @@
+/**
+ * \file multimap_hash_table.h
+ * \brief Hash table grouping the values of a key header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#ifndef __MULTIMAP_HASH_TABLE_H
+#define __MULTIMAP_HASH_TABLE_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief The number of values a new key has room for.
+ */
+#define HT_MULTIMAP_INITIAL_VALUES 4
+
+/**
+ * \brief The values of one key, in order.
+ *
+ * The values live in the middle of the array with free room on both sides,
+ * so adding at either end is amortized constant time.
+ */
+typedef struct{
+    size_t _begin,              /**<- The index of the first value. */
+           _nb_values,          /**<- The number of values. */
+           _capacity;           /**<- The number of entries of _values. */
+    HT_container _values[];     /**<- The values, from _begin to _begin + _nb_values. */
+} HT_value_group;
+
+/**
+ * \brief A hash table storing each distinct key once with all its values.
+ *
+ * Works like ::HT_hash_table with duplicate keys, but the duplicates of a
+ * key are not separate pairs of the slot: the key has a single pair pointing
+ * to a ::HT_value_group. Finding the position th value of a key walks the
+ * distinct keys of one slot, then indexes the array.
+ */
+typedef struct{
+    HT_hash_table _keys;        /**<- The distinct keys, the value of each pair is a pointer to its ::HT_value_group. */
+    size_t _nb_values;          /**<- The number of values stored. */
+}   HT_multimap;
+
+/**
+ * \brief Create a new multimap hash table.
+ * \see HT_multimap_delete_pointer
+ * \param size The number of slots of the hash table, rounded up to a power of two.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre size must be a strictly positive number(size > 0).
+ * \pre hash_function should not be NULL.
+ * \return A pointer to an already initialized hash table;
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_multimap* HT_multimap_new_hash(const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Use this to initialise an static defined multimap hash table.
+ * \see HT_multimap_delete
+ * \param mm A pointer to the hash table to initialise.
+ * \param size The number of slots of the hash table, rounded up to a power of two.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre mm and hash_function must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_multimap_init(HT_multimap* mm, const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Search for a value of a key in the multimap hash table.
+ * \param mm A pointer to the hash table.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value The value holding the corresponding value if the key is found.
+ * \param value_size A pointer to a variable that will be set to value size in bytes if a match is found.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre mm and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success and if not NULL value is set to point to the corresponding value.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \warning value will point directly to the hash table value.
+ * \note Like ::HT_get_element_position, the last value is returned if the
+ * key has less than position + 1 values. The cost does not depend on position.
+ */
+int HT_multimap_get_element_position(const HT_multimap* mm, const void* key, const size_t key_size, void** value, size_t* value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Get every value of a key at once.
+ * \param mm A pointer to the hash table.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param values Set to the first of the values of the key, in order.
+ * \param nb_values Set to the number of values of the key.
+ * \pre mm, key, values and nb_values must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \warning The span is valid until the next modification of the key.
+ */
+int HT_multimap_get_all_values(const HT_multimap* mm, const void* key, const size_t key_size, const HT_container** values, size_t* nb_values);
+
+/**
+ * \brief Add a value to a key of the multimap hash table.
+ * \param mm A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre mm, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately.
+ * \note The value takes the place it would take with ::HT_add_element_position.
+ */
+int HT_multimap_add_element_position(HT_multimap* mm, const void* key, const size_t key_size, const void* value, const size_t value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Add a value in front of the values of a key.
+ * \param mm A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \pre mm, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately.
+ */
+static inline int HT_multimap_add_element(HT_multimap* mm, const void* key, const size_t key_size, const void* value, const size_t value_size){
+    return HT_multimap_add_element_position(mm, key, key_size, value, value_size, 0, 0);
+}
+
+/**
+ * \brief Remove a value of a key in the same way as ::HT_multimap_get_element_position finds it.
+ * \param mm A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre mm and key must not be NULL.
+ * \pre key_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On error and errno is set appropriately.
+ * \note The key is removed with its last value.
+ */
+int HT_multimap_remove_element_position(HT_multimap* mm, const void* key, const size_t key_size, unsigned int position, int reverse);
+
+/**
+ * \brief Get the number of values stored in the multimap hash table.
+ * \param mm A pointer to the hash table.
+ * \pre mm must not be NULL.
+ * \return The number of values, duplicate keys included.
+ */
+static inline size_t HT_multimap_get_nb_elements(const HT_multimap* mm){
+    return mm->_nb_values;
+}
+
+/**
+ * \brief Get the number of distinct keys stored in the multimap hash table.
+ * \param mm A pointer to the hash table.
+ * \pre mm must not be NULL.
+ * \return The number of keys.
+ */
+static inline size_t HT_multimap_get_nb_keys(const HT_multimap* mm){
+    return HT_get_nb_elements(&mm->_keys);
+}
+
+/**
+ * \brief Deletes the hash table created with ::HT_multimap_new_hash.
+ * \see HT_multimap_new_hash
+ * \param mm The hash table to delete.
+ * \pre mm must not be NULL.
+ */
+void HT_multimap_delete_pointer(HT_multimap* mm);
+
+/**
+ * \brief Delete a hash table initialized with ::HT_multimap_init.
+ * \see HT_multimap_init
+ * \param mm The hash table.
+ * \pre mm must not be NULL.
+ */
+void HT_multimap_delete(HT_multimap* mm);
+
+/**
+ * \brief Reset the content of the multimap hash table without the need of creating a new one.
+ * \param mm A pointer to the hash table.
+ * \pre mm must not be NULL.
+ * \post mm is still usable.
+ */
+void HT_multimap_reset_table(HT_multimap* mm);
+
+#endif // ( __MULTIMAP_HASH_TABLE_H )
@@ -0,0 +1,236 @@
+/**
+ * \file robin_hood_hash_table.h
+ * \brief Robin Hood hash table header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#ifndef __ROBIN_HOOD_HASH_TABLE_H
+#define __ROBIN_HOOD_HASH_TABLE_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief The longest probe sequence of a lookup, the table grows before an
+ * entry would end further than that from its home entry.
+ */
+#ifndef HT_ROBIN_MAX_PROBES
+#define HT_ROBIN_MAX_PROBES 32
+#endif
+
+/**
+ * \brief The number of new seeds an insertion draws before it gives up on
+ * keys that share their hash bits, see ::HT_robin_set_seeded_hash.
+ */
+#ifndef HT_ROBIN_MAX_RESEEDS
+#define HT_ROBIN_MAX_RESEEDS 4
+#endif
+
+/**
+ * \brief One entry of the Robin Hood hash table.
+ *
+ * The key and the value share a single heap buffer, the key first and the
+ * value aligned after it.
+ */
+typedef struct{
+    HT_container _key,          /**<- The key. */
+                 _value;        /**<- The value associated. */
+    uint64_t _hash;             /**<- The hash of the key. */
+} HT_robin_entry;
+
+/**
+ * \brief A hash table storing its entries in a flat array with Robin Hood
+ * linear probing.
+ *
+ * An insertion takes the place of any entry closer to its home entry than the
+ * inserted one, so the entries of a run are sorted by home and a lookup stops
+ * as soon as it meets an entry closer to its home than the probed key. A
+ * removal shifts the following entries back instead of leaving a marker.
+ *
+ * No entry is ever stored more than ::HT_ROBIN_MAX_PROBES - 1 entries away from
+ * its home: the insertion that would break this bound doubles the table
+ * first, so a lookup reads at most ::HT_ROBIN_MAX_PROBES entries.
+ *
+ * \see HT_set_robin_backend to use it behind the ::HT_hash_table functions.
+ */
+typedef struct HT_robin_table{
+    unsigned char *_distances;  /**<- One plus the distance of each entry to its home, 0 if the entry is empty. */
+    HT_robin_entry *_entries;   /**<- The entries. */
+    unsigned int _entry_bits;   /**<- The base 2 logarithm of the number of entries. */
+    size_t _nb_elements;        /**<- The number of entries in use. */
+    HT_hash_function hash_function; /**<- the hash function. */
+    HT_seeded_hash_function seeded_hash_function; /**<- The seeded hash function used instead of hash_function, NULL if none. */
+    uint64_t _seed[2];          /**<- The secret seed of seeded_hash_function. */
+}   HT_robin_table;
+
+/**
+ * \brief Create a new Robin Hood hash table able to hold size keys without rehashing.
+ * \see HT_robin_delete_pointer
+ * \param size The number of keys expected in the hash table.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre size must be a strictly positive number(size > 0).
+ * \pre hash_function should not be NULL.
+ * \return A pointer to an already initialized hash table;
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_robin_table* HT_robin_new_hash(const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Use this to initialise an static defined Robin Hood hash table.
+ * \see HT_robin_delete
+ * \param rt A pointer to the hash table to initialise.
+ * \param size The number of keys expected in the hash table.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre rt and hash_function must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_robin_init(HT_robin_table* rt, const unsigned int size, HT_hash_function hash_function);
+
+/**
+ * \brief Search for an element in the Robin Hood hash table.
+ * \param rt A pointer to the hash table.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value The value holding the corresponding value if the key is found.
+ * \param value_size A pointer to a variable that will be set to value size in bytes if a match is found.
+ * \pre rt and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success and if not NULL value is set to point to the corresponding value.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \warning value will point directly to the hash table value.
+ * \note At most ::HT_ROBIN_MAX_PROBES entries are read.
+ */
+int HT_robin_get_element(const HT_robin_table* rt, const void* key, const size_t key_size, void** value, size_t* value_size);
+
+/**
+ * \brief Add an element to the Robin Hood hash table.
+ * \param rt A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \pre rt, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is already present in the hash table.
+ * \retval 2 On error and errno is set appropriately, ENOSPC meaning that too
+ * many keys share the same hash bits for the probe length to stay bounded.
+ * With a seeded hash function, up to ::HT_ROBIN_MAX_RESEEDS new seeds are
+ * drawn before giving up.
+ * \note Unlike ::HT_hash_table, a key is stored at most once.
+ */
+int HT_robin_add_element(HT_robin_table* rt, const void* key, const size_t key_size, const void* value, const size_t value_size);
+
+/**
+ * \brief Remove an element from the Robin Hood hash table.
+ * \param rt A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \pre rt and key must not be NULL.
+ * \pre key_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_robin_remove_element(HT_robin_table* rt, const void* key, const size_t key_size);
+
+/**
+ * \brief Hash the keys of the Robin Hood hash table with a seeded function and a random secret seed.
+ * \param rt A pointer to the hash table.
+ * \param seeded_hash_function The seeded hash function, NULL to go back to the hash function of the table.
+ * \pre rt must not be NULL.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately, the table is unchanged.
+ * \note The entries are hashed again at once. An insertion failing to keep
+ * its probe sequence bounded then draws a new seed instead of growing a table
+ * that keys sharing their hash bits would keep crowding.
+ */
+int HT_robin_set_seeded_hash(HT_robin_table* rt, HT_seeded_hash_function seeded_hash_function);
+
+/**
+ * \brief Get the number of elements stored in the Robin Hood hash table.
+ * \param rt A pointer to the hash table.
+ * \pre rt must not be NULL.
+ * \return The number of keys stored.
+ */
+static inline size_t HT_robin_get_nb_elements(const HT_robin_table* rt){
+    return rt->_nb_elements;
+}
+
+/**
+ * \brief Call a function on every element of the Robin Hood hash table.
+ * \param rt A pointer to the hash table.
+ * \param function The function to call.
+ * \param data The last argument of function.
+ * \pre rt and function must not be NULL.
+ * \return 0 once every element is visited, the value returned by function if it stopped the walk.
+ * \warning function must not modify the table.
+ */
+int HT_robin_foreach(const HT_robin_table* rt, HT_foreach_function function, void* data);
+
+/**
+ * \brief Visit a part of the Robin Hood hash table, the table can be modified between two calls.
+ * \param rt A pointer to the hash table.
+ * \param cursor ::HT_SCAN_CURSOR_START for the first call, the returned value for the following ones.
+ * \param count The number of elements after which the call returns.
+ * \param function The function called on each element.
+ * \param data The last argument of function.
+ * \pre rt and function must not be NULL, cursor must not exceed UINT32_MAX.
+ * \return The cursor to give to the next call, ::HT_SCAN_CURSOR_START once every entry is visited.
+ * \note The cursor is the same as the one of ::HT_scan, each step visits the
+ * entries whose home is the next one. A grow splits every home entry in two
+ * consecutive ones, so every element present during the whole scan is visited
+ * once whatever the grows in between.
+ * \warning function must not modify the table.
+ */
+uint64_t HT_robin_scan(const HT_robin_table* rt, uint64_t cursor, const unsigned int count, HT_foreach_function function, void* data);
+
+/**
+ * \brief Deletes the hash table created with ::HT_robin_new_hash.
+ * \see HT_robin_new_hash
+ * \param rt The hash table to delete.
+ * \pre rt must not be NULL.
+ */
+void HT_robin_delete_pointer(HT_robin_table* rt);
+
+/**
+ * \brief Delete a hash table initialized with ::HT_robin_init.
+ * \see HT_robin_init
+ * \param rt The hash table.
+ * \pre rt must not be NULL.
+ */
+void HT_robin_delete(HT_robin_table* rt);
+
+/**
+ * \brief Reset the content of the Robin Hood hash table without the need of creating a new one.
+ * \param rt A pointer to the hash table.
+ * \pre rt must not be NULL.
+ * \post rt is still usable.
+ */
+void HT_robin_reset_table(HT_robin_table* rt);
+
+#endif // ( __ROBIN_HOOD_HASH_TABLE_H )
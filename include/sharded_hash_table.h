@@ -0,0 +1,240 @@
+/**
+ * \file sharded_hash_table.h
+ * \brief Sharded hash table header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#ifndef __SHARDED_HASH_TABLE_H
+#define __SHARDED_HASH_TABLE_H
+
+#include <pthread.h>
+
+#include "generic_hash_table.h"
+#include "concurrent_hash_table.h"
+
+/**
+ * \brief The default number of shards.
+ */
+#define HT_SHARDED_DEFAULT_SHARDS 64
+
+/**
+ * \brief The number of old slots a shard migrates for another one waiting to resize.
+ */
+#define HT_SHARDED_HELP_SLOTS 64
+
+/**
+ * \brief An independent hash table and its lock.
+ */
+typedef struct{
+    HT_hash_table _table;       /**<- The elements of the shard. */
+    pthread_rwlock_t _lock;     /**<- Taken for reading by lookups and for writing by modifications. */
+    int _node;                  /**<- The NUMA node of the slots, -1 if not placed. */
+} __attribute__((aligned(HT_CACHE_LINE_SIZE))) HT_shard;
+
+/**
+ * \brief Where a shard lives.
+ * \see HT_sharded_init_placed
+ */
+typedef struct{
+    int cpu;                    /**<- The processor initialising the shard, its node gets the slots, -1 for the calling thread. */
+    const HT_allocator *allocator; /**<- The allocator of the pairs of the shard, NULL for malloc. */
+} HT_shard_placement;
+
+/**
+ * \brief A hash table split in independent shards for multi-core scaling.
+ *
+ * A key belongs to the shard given by bits of its hash distinct from the
+ * ones picking its slot inside the shard. Each shard is a ::HT_hash_table
+ * with its own slots, allocator and reader-writer lock, so operations on
+ * different shards never contend.
+ *
+ * A shard grows with the incremental resize of ::HT_hash_table, but only one
+ * shard at a time: a shard above the load factor waits until the resizing
+ * one is done, and migrates some of its slots meanwhile if it can lock it.
+ */
+typedef struct{
+    HT_shard *_shards;          /**<- The shards. */
+    unsigned int _shard_bits;   /**<- The base 2 logarithm of the number of shards. */
+    int _resizing_shard;        /**<- The index of the shard being resized, -1 if none. */
+    float _max_load_factor;     /**<- The load factor above which a shard grows (0 to disable). */
+    HT_hash_function hash_function; /**<- the hash function. */
+}   HT_sharded_table;
+
+/**
+ * \brief Create a new sharded hash table.
+ * \see HT_sharded_delete_pointer
+ * \param size The total number of slots, split between the shards.
+ * \param nb_shards The number of shards, rounded up to a power of two, 0 for ::HT_SHARDED_DEFAULT_SHARDS.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre size must be a strictly positive number (size > 0).
+ * \pre hash_function should not be NULL.
+ * \return A pointer to an already initialized hash table;
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_sharded_table* HT_sharded_new_hash(const unsigned int size, const unsigned int nb_shards, HT_hash_function hash_function);
+
+/**
+ * \brief Initialise an static defined sharded hash table.
+ * \see HT_sharded_delete
+ * \param st A pointer to the hash table to initialise.
+ * \param size The total number of slots, split between the shards.
+ * \param nb_shards The number of shards, rounded up to a power of two, 0 for ::HT_SHARDED_DEFAULT_SHARDS.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \pre st and hash_function must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_sharded_init(HT_sharded_table* st, const unsigned int size, const unsigned int nb_shards, HT_hash_function hash_function);
+
+/**
+ * \brief Initialise a sharded hash table, placing each shard on a chosen processor.
+ * \see HT_sharded_delete
+ * \param st A pointer to the hash table to initialise.
+ * \param size The total number of slots, split between the shards.
+ * \param nb_shards The number of shards, a power of two.
+ * \param hash_function A pointer to a function to use for hashing the key values.
+ * \param placements nb_shards placements, one per shard.
+ * \pre st, hash_function and placements must not be NULL.
+ * \pre size must be an strictly positive number (size > 0).
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note The slots of a shard are first touched by a thread bound to the
+ * processor of its placement, so Linux puts them on the node of that
+ * processor, and the slots of its later resizes are bound to the same node.
+ * A node local allocator, such as an ::HT_arena filled by a thread of the
+ * node, does the same for the pairs.
+ */
+int HT_sharded_init_placed(HT_sharded_table* st, const unsigned int size, const unsigned int nb_shards, HT_hash_function hash_function, const HT_shard_placement placements[]);
+
+/**
+ * \brief Set the load factor above which a shard doubles its slots.
+ * \param st A pointer to the hash table.
+ * \param max_load_factor The number of elements per slot, 0 to never grow.
+ * \pre st must not be NULL and not in use by another thread.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+int HT_sharded_set_load_factor(HT_sharded_table* st, float max_load_factor);
+
+/**
+ * \brief Copy the value of an element of the sharded hash table.
+ * \param st A pointer to the hash table.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value A buffer receiving a copy of the value, may be NULL.
+ * \param value_size The size of the buffer, set to the size of the value if a match is found.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre st and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \note Works like ::HT_concurrent_get_element_position.
+ */
+int HT_sharded_get_element_position(HT_sharded_table* st, const void* key, const size_t key_size, void* value, size_t* value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Add an element to the sharded hash table.
+ * \param st A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre st, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_sharded_add_element_position(HT_sharded_table* st, const void* key, const size_t key_size, const void* value, const size_t value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Add an element to the sharded hash table if its key is not present.
+ * \param st A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value corresponding with the key.
+ * \param value_size The size of the value in bytes.
+ * \pre st, key and value must not be NULL.
+ * \pre key_size and value_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is already present in the hash table.
+ * \retval 2 On error and errno is set appropriately.
+ * \note The membership test and the insertion are atomic.
+ */
+int HT_sharded_add_element(HT_sharded_table* st, const void* key, const size_t key_size, const void* value, const size_t value_size);
+
+/**
+ * \brief Remove an element from the sharded hash table.
+ * \param st A pointer to the hash table.
+ * \param key A pointer to the key for the hash.
+ * \param key_size The size of the key in bytes.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre st and key must not be NULL.
+ * \pre key_size must be strictly positive numbers (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_sharded_remove_element_position(HT_sharded_table* st, const void* key, const size_t key_size, unsigned int position, int reverse);
+
+/**
+ * \brief Get the number of elements stored in the sharded hash table.
+ * \param st A pointer to the hash table.
+ * \pre st must not be NULL.
+ * \return The number of pairs stored, duplicate keys included.
+ * \note The shards are locked one after the other, the sum is not a snapshot.
+ */
+size_t HT_sharded_get_nb_elements(HT_sharded_table* st);
+
+/**
+ * \brief Remove every element of the sharded hash table.
+ * \param st A pointer to the hash table.
+ * \pre st must not be NULL.
+ * \post st is still usable.
+ * \note The shards are emptied one after the other.
+ */
+void HT_sharded_reset_table(HT_sharded_table* st);
+
+/**
+ * \brief Deletes the hash table created with ::HT_sharded_new_hash.
+ * \see HT_sharded_new_hash
+ * \param st The hash table to delete.
+ * \pre st must not be NULL and not in use by another thread.
+ */
+void HT_sharded_delete_pointer(HT_sharded_table* st);
+
+/**
+ * \brief Delete a hash table initialized with ::HT_sharded_init or ::HT_sharded_init_placed.
+ * \param st The hash table.
+ * \pre st must not be NULL and not in use by another thread.
+ */
+void HT_sharded_delete(HT_sharded_table* st);
+
+#endif // ( __SHARDED_HASH_TABLE_H )
@@ -0,0 +1,142 @@
+/**
+ * \file snapshot_hash_table.h
+ * \brief Memory mapped read only hash table header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __SNAPSHOT_HASH_TABLE_H
+#define __SNAPSHOT_HASH_TABLE_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief The version of the snapshot file format.
+ */
+#define HT_SNAPSHOT_VERSION 1
+
+/**
+ * \brief A read only hash table whose content lives in a memory mapped file.
+ *
+ * The file starts with a header, followed by the offset of the first entry
+ * of each slot, followed by the entries grouped by slot. An entry holds the
+ * hash of its key, the sizes, the key and the value, each padded to 8 bytes.
+ * Every position is an offset, the image does not depend on its address.
+ */
+typedef struct{
+    void *_map;                 /**<- The mapped file. */
+    size_t _map_size;           /**<- The size of the mapping. */
+    const uint64_t *_offsets;   /**<- The offset of the first entry of each slot, one more for the end. */
+    const unsigned char *_entries; /**<- The entries. */
+    unsigned int _slot_bits;    /**<- The base 2 logarithm of the number of slots. */
+    size_t _nb_elements;        /**<- The number of entries. */
+    HT_hash_function hash_function; /**<- the hash function. */
+}   HT_snapshot;
+
+/**
+ * \brief Write the content of a hash table in a snapshot file.
+ * \see HT_mmap_load
+ * \param ht A pointer to the hash table.
+ * \param path The file to create or replace.
+ * \pre ht and path must not be NULL.
+ * \retval 0 On success.
+ * \retval 2 On failure and errno is set appropriately.
+ * \note The order of the duplicates of a key is kept. The file is built in
+ * place through a mapping, no copy of the table is made in memory.
+ * \note Keys and values bigger than 4GB are refused with EFBIG.
+ * \note A table using a seeded hash function is refused with EINVAL, the
+ * seed is a secret of the process that cannot be given to ::HT_mmap_load. So
+ * is a table still hashing its pairs again after dropping its seeded function.
+ */
+int HT_save(const HT_hash_table* ht, const char* path);
+
+/**
+ * \brief Map a snapshot file as a read only hash table.
+ * \see HT_snapshot_unmap
+ * \param snapshot A pointer to the snapshot to initialise.
+ * \param path The file written by ::HT_save.
+ * \param hash_function The hash function of the saved table.
+ * \pre snapshot, path and hash_function must not be NULL.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately, EINVAL if the file
+ * is not a snapshot or was hashed with another function.
+ * \note Nothing is copied, the pages are read from the file when first used,
+ * except for the slot offsets which are checked at load. A lookup stops at
+ * an entry crossing the end of its slot, so a corrupted file never makes it
+ * read outside of the mapping.
+ */
+int HT_mmap_load(HT_snapshot* snapshot, const char* path, HT_hash_function hash_function);
+
+/**
+ * \brief Search for an element in the snapshot.
+ * \param snapshot A pointer to the snapshot.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value Set to point to the value inside of the mapping if the key is found.
+ * \param value_size A pointer to a variable that will be set to value size in bytes if a match is found.
+ * \param position The number of match before returning the value.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \pre snapshot and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ * \warning The value is read only and valid until ::HT_snapshot_unmap.
+ */
+int HT_snapshot_get_element_position(const HT_snapshot* snapshot, const void* key, const size_t key_size, const void** value, size_t* value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Search for an element in the snapshot.
+ * \param snapshot A pointer to the snapshot.
+ * \param key A pointer to the key to search in the table.
+ * \param key_size The size of the key in bytes.
+ * \param value Set to point to the value inside of the mapping if the key is found.
+ * \param value_size A pointer to a variable that will be set to value size in bytes if a match is found.
+ * \pre snapshot and key must not be NULL.
+ * \pre key_size must be an strictly positive number (key_size > 0).
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ * \retval 2 On failure and errno is set appropriately.
+ */
+static inline int HT_snapshot_get_element(const HT_snapshot* snapshot, const void* key, const size_t key_size, const void** value, size_t* value_size){
+    return HT_snapshot_get_element_position(snapshot, key, key_size, value, value_size, 0, 0);
+}
+
+/**
+ * \brief Get the number of elements stored in the snapshot.
+ * \param snapshot A pointer to the snapshot.
+ * \pre snapshot must not be NULL.
+ * \return The number of entries, duplicate keys included.
+ */
+static inline size_t HT_snapshot_get_nb_elements(const HT_snapshot* snapshot){
+    return snapshot->_nb_elements;
+}
+
+/**
+ * \brief Unmap a snapshot loaded with ::HT_mmap_load.
+ * \param snapshot A pointer to the snapshot.
+ * \pre snapshot must not be NULL.
+ */
+void HT_snapshot_unmap(HT_snapshot* snapshot);
+
+#endif // ( __SNAPSHOT_HASH_TABLE_H )
@@ -0,0 +1,261 @@
+/**
+ * \file typed_hash_table.h
+ * \brief Compile time specialised hash tables header file.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#ifndef __TYPED_HASH_TABLE_H
+#define __TYPED_HASH_TABLE_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief Compare two keys with the == operator, for the scalar key types.
+ */
+#define HT_TYPED_EQUAL(a, b) ((a) == (b))
+
+/**
+ * \brief Define a hash table specialised for a key type and a value type.
+ *
+ * The keys and the values are stored by value in the pairs, and the hash and
+ * comparison are called directly so the compiler can inline them. The
+ * generated functions follow the ::HT_init, ::HT_get_element_position,
+ * ::HT_add_element_position and ::HT_remove_element_position semantics,
+ * duplicate keys and their position and reverse arguments included, and
+ * return the same codes.
+ *
+ * \code
+ * static inline uint64_t hash_id(uint64_t id){ return id * UINT64_C(0x9E3779B97F4A7C15); }
+ * HT_DEFINE_TABLE(id_table, uint64_t, double, hash_id, HT_TYPED_EQUAL)
+ *
+ * id_table t;
+ * double *price;
+ * id_table_init(&t, 1024);
+ * id_table_add_element(&t, 42, 3.5);
+ * if( id_table_get_element(&t, 42, &price) == 0 )
+ *     *price += 1.0;
+ * id_table_delete(&t);
+ * \endcode
+ *
+ * The macro defines the types name, name_pair and name_slot, and the
+ * functions name_init, name_get_element_position, name_get_element,
+ * name_add_element_position, name_add_element, name_remove_element_position,
+ * name_get_nb_elements, name_reset_table and name_delete.
+ *
+ * \param name The name of the table type, the prefix of the functions.
+ * \param key_type The type of the keys.
+ * \param value_type The type of the values.
+ * \param hash A function or macro returning the uint64_t hash of a key.
+ * \param equal A function or macro returning true if two keys are equal.
+ * \note The table doubles its slots, all at once, when the number of elements
+ * goes above ::HT_DEFAULT_MAX_LOAD_FACTOR per slot. It never shrinks.
+ */
+#define HT_DEFINE_TABLE(name, key_type, value_type, hash, equal)                \
+                                                                                \
+typedef struct name##_pair{                                                     \
+    struct name##_pair *_next,                                                  \
+                       *_previous;                                              \
+    uint64_t _hash;                                                             \
+    key_type _key;                                                              \
+    value_type _value;                                                          \
+} name##_pair;                                                                  \
+                                                                                \
+typedef struct{                                                                 \
+    name##_pair *_first_pair,                                                   \
+                *_last_pair;                                                    \
+} name##_slot;                                                                  \
+                                                                                \
+typedef struct{                                                                 \
+    name##_slot *_slots;                                                        \
+    unsigned int _slot_bits;                                                    \
+    size_t _nb_elements;                                                        \
+} name;                                                                         \
+                                                                                \
+static inline int name##_init(name* t, const unsigned int size){                \
+    unsigned int bits = 0;                                                      \
+    if( t == NULL || size == 0 || size > HT_MAX_SLOTS ){                        \
+        errno = EINVAL;                                                         \
+        return 1;                                                               \
+    }                                                                           \
+    while( (1u << bits) < size )                                                \
+        ++bits;                                                                 \
+    t->_slots = calloc((size_t) 1 << bits, sizeof(name##_slot));                \
+    if( t->_slots == NULL )                                                     \
+        return 1;                                                               \
+    t->_slot_bits = bits;                                                       \
+    t->_nb_elements = 0;                                                        \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+static inline name##_pair* name##_get_pair(const name##_slot* slot, const uint64_t h, const key_type key, unsigned int position, int reverse){ \
+    name##_pair *pair = reverse ? slot->_last_pair : slot->_first_pair,        \
+                *last_found = NULL;                                             \
+    for(; pair != NULL; pair = reverse ? pair->_previous : pair->_next){        \
+        if( pair->_hash == h && equal(pair->_key, key) ){                       \
+            last_found = pair;                                                  \
+            if( position-- == 0 )                                               \
+                break;                                                          \
+        }                                                                       \
+    }                                                                           \
+    return last_found;                                                          \
+}                                                                               \
+                                                                                \
+static inline int name##_get_element_position(const name* t, const key_type key, value_type** value, unsigned int position, int reverse){ \
+    const uint64_t h = hash(key);                                               \
+    name##_pair *pair = name##_get_pair(&t->_slots[HT_hash_fold(h, t->_slot_bits)], h, key, position, reverse); \
+    if( pair == NULL )                                                          \
+        return 1;                                                               \
+    if( value != NULL )                                                         \
+        *value = &pair->_value;                                                 \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_get_element(const name* t, const key_type key, value_type** value){ \
+    return name##_get_element_position(t, key, value, 0, 0);                    \
+}                                                                               \
+                                                                                \
+static inline void name##_link_pair(name##_slot* slot, name##_pair* pair, name##_pair* where, int before){ \
+    if( where == NULL ){                                                        \
+        pair->_next = pair->_previous = NULL;                                   \
+    }                                                                           \
+    else if( before ){                                                          \
+        pair->_next = where;                                                    \
+        pair->_previous = where->_previous;                                     \
+        if( where->_previous != NULL )                                          \
+            where->_previous->_next = pair;                                     \
+        where->_previous = pair;                                                \
+    }                                                                           \
+    else{                                                                       \
+        pair->_previous = where;                                                \
+        pair->_next = where->_next;                                             \
+        if( where->_next != NULL )                                              \
+            where->_next->_previous = pair;                                     \
+        where->_next = pair;                                                    \
+    }                                                                           \
+    if( pair->_previous == NULL )                                               \
+        slot->_first_pair = pair;                                               \
+    if( pair->_next == NULL )                                                   \
+        slot->_last_pair = pair;                                                \
+}                                                                               \
+                                                                                \
+static inline void name##_grow(name* t){                                        \
+    const unsigned int bits = t->_slot_bits + 1;                                \
+    name##_slot *slots;                                                         \
+    name##_pair *pair,                                                          \
+                *next;                                                          \
+    size_t i;                                                                   \
+    if( ((size_t) 1 << t->_slot_bits) >= HT_MAX_SLOTS )                         \
+        return;                                                                 \
+    slots = calloc((size_t) 1 << bits, sizeof(name##_slot));                    \
+    if( slots == NULL ) /* Keep the current slots, only slower */              \
+        return;                                                                 \
+    for(i = 0; i < (size_t) 1 << t->_slot_bits; ++i){                           \
+        for(pair = t->_slots[i]._first_pair; pair != NULL; pair = next){        \
+            name##_slot *slot = &slots[HT_hash_fold(pair->_hash, bits)];        \
+            next = pair->_next;                                                 \
+            name##_link_pair(slot, pair, slot->_last_pair, 0);                  \
+        }                                                                       \
+    }                                                                           \
+    free(t->_slots);                                                            \
+    t->_slots = slots;                                                          \
+    t->_slot_bits = bits;                                                       \
+}                                                                               \
+                                                                                \
+static inline int name##_insert(name* t, name##_slot* slot, const uint64_t h, const key_type key, const value_type value, name##_pair* where, int before){ \
+    name##_pair *pair = malloc(sizeof(name##_pair));                            \
+    if( pair == NULL )                                                          \
+        return 2;                                                               \
+    pair->_hash = h;                                                            \
+    pair->_key = key;                                                           \
+    pair->_value = value;                                                       \
+    name##_link_pair(slot, pair, where, before);                                \
+    if( (double) ++t->_nb_elements > (double) HT_DEFAULT_MAX_LOAD_FACTOR * (double) ((size_t) 1 << t->_slot_bits) ) \
+        name##_grow(t);                                                         \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_add_element_position(name* t, const key_type key, const value_type value, unsigned int position, int reverse){ \
+    const uint64_t h = hash(key);                                               \
+    name##_slot *slot = &t->_slots[HT_hash_fold(h, t->_slot_bits)];             \
+    name##_pair *where = NULL;                                                  \
+    if( position != 0 )                                                         \
+        where = name##_get_pair(slot, h, key, position, reverse);               \
+    if( where != NULL )                                                         \
+        return name##_insert(t, slot, h, key, value, where, reverse);           \
+    return name##_insert(t, slot, h, key, value, reverse ? slot->_last_pair : slot->_first_pair, !reverse); \
+}                                                                               \
+                                                                                \
+static inline int name##_add_element(name* t, const key_type key, const value_type value){ \
+    const uint64_t h = hash(key);                                               \
+    name##_slot *slot = &t->_slots[HT_hash_fold(h, t->_slot_bits)];             \
+    /* One walk of the slot, the new pair goes in front of it */                \
+    if( name##_get_pair(slot, h, key, 0, 0) != NULL )                           \
+        return 1;                                                               \
+    return name##_insert(t, slot, h, key, value, slot->_first_pair, 1);         \
+}                                                                               \
+                                                                                \
+static inline int name##_remove_element_position(name* t, const key_type key, unsigned int position, int reverse){ \
+    const uint64_t h = hash(key);                                               \
+    name##_slot *slot = &t->_slots[HT_hash_fold(h, t->_slot_bits)];             \
+    name##_pair *pair = name##_get_pair(slot, h, key, position, reverse);       \
+    if( pair == NULL )                                                          \
+        return 1;                                                               \
+    if( pair->_previous != NULL )                                               \
+        pair->_previous->_next = pair->_next;                                   \
+    else                                                                        \
+        slot->_first_pair = pair->_next;                                        \
+    if( pair->_next != NULL )                                                   \
+        pair->_next->_previous = pair->_previous;                               \
+    else                                                                        \
+        slot->_last_pair = pair->_previous;                                     \
+    free(pair);                                                                 \
+    --t->_nb_elements;                                                          \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+static inline size_t name##_get_nb_elements(const name* t){                     \
+    return t->_nb_elements;                                                     \
+}                                                                               \
+                                                                                \
+static inline void name##_reset_table(name* t){                                 \
+    name##_pair *pair,                                                          \
+                *next;                                                          \
+    size_t i;                                                                   \
+    for(i = 0; i < (size_t) 1 << t->_slot_bits; ++i){                           \
+        for(pair = t->_slots[i]._first_pair; pair != NULL; pair = next){        \
+            next = pair->_next;                                                 \
+            free(pair);                                                         \
+        }                                                                       \
+        t->_slots[i]._first_pair = t->_slots[i]._last_pair = NULL;              \
+    }                                                                           \
+    t->_nb_elements = 0;                                                        \
+}                                                                               \
+                                                                                \
+static inline void name##_delete(name* t){                                      \
+    name##_reset_table(t);                                                      \
+    free(t->_slots);                                                            \
+}
+
+#endif // ( __TYPED_HASH_TABLE_H )
@@ -0,0 +1,144 @@
+/**
+ * \file arena_allocator.c
+ * \brief Arena allocator implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdint.h>
+
+#include "arena_allocator.h"
+
+/**
+ * \brief Round a size up to the arena alignment.
+ * \param size The size in bytes.
+ */
+static inline size_t HT_arena_round(const size_t size){
+    return (size + HT_ARENA_ALIGNMENT - 1) / HT_ARENA_ALIGNMENT * HT_ARENA_ALIGNMENT;
+}
+
+/**
+ * \brief Allocate a new chunk.
+ * \param size The number of usable bytes.
+ * \retval NULL On failure and errno is set appropriately.
+ */
+static HT_arena_chunk* HT_arena_new_chunk(const size_t size){
+    HT_arena_chunk *chunk;
+    uintptr_t data;
+    if( size > SIZE_MAX - sizeof(HT_arena_chunk) - HT_ARENA_ALIGNMENT ){
+        errno = ENOMEM;
+        return NULL;
+    }
+    chunk = malloc(sizeof(HT_arena_chunk) + HT_ARENA_ALIGNMENT + size);
+    if( chunk == NULL )
+        return NULL;
+    data = (uintptr_t) (chunk + 1);
+    data = (data + HT_ARENA_ALIGNMENT - 1) / HT_ARENA_ALIGNMENT * HT_ARENA_ALIGNMENT;
+    chunk->_data = (unsigned char*) data;
+    chunk->_size = size;
+    chunk->_next = NULL;
+    return chunk;
+}
+
+int HT_arena_init(HT_arena* const arena, size_t chunk_size){
+    if( arena == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    if( chunk_size == 0 )
+        chunk_size = HT_ARENA_DEFAULT_CHUNK_SIZE;
+    arena->_chunk_size = HT_arena_round(chunk_size);
+    arena->_first_chunk = HT_arena_new_chunk(arena->_chunk_size);
+    if( arena->_first_chunk == NULL )
+        return 1;
+    arena->_current_chunk = arena->_first_chunk;
+    arena->_used = 0;
+    return 0;
+}
+
+void* HT_arena_allocate(HT_arena* const arena, size_t size){
+    HT_arena_chunk *chunk;
+    void *buffer;
+
+    size = HT_arena_round(size);
+    if( size > arena->_current_chunk->_size - arena->_used ){
+        // Reuse the next chunk left by a reset if it is large enough
+        chunk = arena->_current_chunk->_next;
+        if( chunk == NULL || chunk->_size < size ){
+            chunk = HT_arena_new_chunk(size > arena->_chunk_size ? size : arena->_chunk_size);
+            if( chunk == NULL )
+                return NULL;
+            chunk->_next = arena->_current_chunk->_next;
+            arena->_current_chunk->_next = chunk;
+        }
+        arena->_current_chunk = chunk;
+        arena->_used = 0;
+    }
+    buffer = &arena->_current_chunk->_data[arena->_used];
+    arena->_used += size;
+    return buffer;
+}
+
+void HT_arena_reset(HT_arena* const arena){
+    arena->_current_chunk = arena->_first_chunk;
+    arena->_used = 0;
+}
+
+void HT_arena_delete(HT_arena* const arena){
+    HT_arena_chunk *chunk,
+                   *next;
+    if( arena != NULL ){
+        for(chunk = arena->_first_chunk; chunk != NULL; chunk = next){
+            next = chunk->_next;
+            free(chunk);
+        }
+        arena->_first_chunk = NULL;
+        arena->_current_chunk = NULL;
+    }
+}
+
+/**
+ * \brief Allocator callback of an arena.
+ * \param context The arena.
+ * \param size The size in bytes.
+ */
+static void* HT_arena_allocate_callback(void* context, size_t size){
+    return HT_arena_allocate(context, size);
+}
+
+/**
+ * \brief Reset callback of an arena.
+ * \param context The arena.
+ */
+static void HT_arena_reset_callback(void* context){
+    HT_arena_reset(context);
+}
+
+HT_allocator HT_arena_allocator(HT_arena* const arena){
+    HT_allocator allocator;
+    allocator.allocate = HT_arena_allocate_callback;
+    allocator.release = NULL;
+    allocator.reset = HT_arena_reset_callback;
+    allocator.context = arena;
+    return allocator;
+}
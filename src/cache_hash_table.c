@@ -0,0 +1,336 @@
+/**
+ * \file cache_hash_table.c
+ * \brief Cache hash table implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <time.h>
+
+#include "cache_hash_table.h"
+#include "generic_hash_table_internal.h"
+
+/**
+ * \brief The number of entries the ring of a new cache has room for.
+ */
+#define HT_CACHE_INITIAL_RING 16
+
+/**
+ * \brief A reason for removing an entry that is not told to the evict function.
+ */
+#define HT_CACHE_REMOVED 0u
+
+/**
+ * \brief Get the monotonic time.
+ * \return The time in nanoseconds.
+ */
+static inline uint64_t HT_cache_now(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * UINT64_C(1000000000) + (uint64_t) t.tv_nsec;
+}
+
+/**
+ * \brief Get the entry of a key.
+ * \param pair The pair of the key.
+ */
+static inline HT_cache_entry* HT_cache_entry_of(const HT_pair* const pair){
+    HT_cache_entry *entry;
+    memcpy(&entry, pair->_value._buffer, sizeof(entry));
+    return entry;
+}
+
+/**
+ * \brief Test if an entry is expired.
+ * \param entry The entry.
+ * \param now The current time given by ::HT_cache_now.
+ */
+static inline int HT_cache_expired(const HT_cache_entry* const entry, const uint64_t now){
+    return entry->_expiry != 0 && entry->_expiry <= now;
+}
+
+/**
+ * \brief Take an entry out of the clock ring, the last entry takes its place.
+ * \param cache A pointer to the cache.
+ * \param entry The entry.
+ */
+static void HT_cache_ring_remove(HT_cache* const cache, const HT_cache_entry* const entry){
+    HT_cache_entry *last = cache->_ring[--cache->_nb_entries];
+    cache->_ring[entry->_index] = last;
+    last->_index = entry->_index;
+    cache->_nb_bytes -= entry->_pair->_key._size_buffer + entry->_value_size;
+}
+
+/**
+ * \brief Put an entry in the clock ring, where the hand is, and move the hand past it.
+ * \param cache A pointer to the cache, whose ring has room for the entry.
+ * \param entry The entry.
+ * \note The entry takes the place of the last one evicted, and has a whole
+ * turn of the hand before it can be evicted. The entry that was there goes
+ * to the end of the ring.
+ */
+static void HT_cache_ring_insert(HT_cache* const cache, HT_cache_entry* const entry){
+    size_t hand = cache->_hand < cache->_nb_entries ? cache->_hand : cache->_nb_entries;
+    HT_cache_entry *moved;
+    if( hand != cache->_nb_entries ){
+        moved = cache->_ring[hand];
+        moved->_index = cache->_nb_entries;
+        cache->_ring[cache->_nb_entries] = moved;
+    }
+    entry->_index = hand;
+    cache->_ring[hand] = entry;
+    ++cache->_nb_entries;
+    cache->_hand = hand + 1;
+}
+
+/**
+ * \brief Remove an entry and its key from the cache.
+ * \param cache A pointer to the cache.
+ * \param entry The entry.
+ * \param reason The reason told to the evict function, ::HT_CACHE_REMOVED to keep it silent.
+ */
+static void HT_cache_remove_entry(HT_cache* const cache, HT_cache_entry* const entry, const unsigned int reason){
+    HT_pair *pair = entry->_pair;
+    if( reason != HT_CACHE_REMOVED && cache->evict_function != NULL )
+        cache->evict_function(pair->_key._buffer, pair->_key._size_buffer, entry->_value, entry->_value_size, reason, cache->evict_data);
+    HT_cache_ring_remove(cache, entry);
+    HT_remove_hashed(&cache->_table, pair->_hash, pair->_key._buffer, pair->_key._size_buffer, 0, 0);
+    free(entry);
+}
+
+/**
+ * \brief Evict the entry chosen by the clock hand.
+ * \param cache A pointer to the cache, with at least one entry.
+ * \param now The current time given by ::HT_cache_now.
+ * \note The hand stops at the first expired entry or at the first one not
+ * referenced since it last passed, so it goes around the ring twice at most.
+ */
+static void HT_cache_evict_one(HT_cache* const cache, const uint64_t now){
+    HT_cache_entry *entry;
+    for(;;){
+        if( cache->_hand >= cache->_nb_entries )
+            cache->_hand = 0;
+        entry = cache->_ring[cache->_hand];
+        if( HT_cache_expired(entry, now) ){
+            HT_cache_remove_entry(cache, entry, HT_CACHE_EXPIRED);
+            return;
+        }
+        if( !__atomic_load_n(&entry->_referenced, __ATOMIC_RELAXED) ){
+            HT_cache_remove_entry(cache, entry, HT_CACHE_EVICTED);
+            return;
+        }
+        __atomic_store_n(&entry->_referenced, 0, __ATOMIC_RELAXED);
+        ++cache->_hand;
+    }
+}
+
+/**
+ * \brief Test if an element would go beyond the budget of the cache.
+ * \param cache A pointer to the cache.
+ * \param size The size of the key and the value of the element.
+ */
+static inline int HT_cache_over_budget(const HT_cache* const cache, const size_t size){
+    return ( cache->_max_elements != 0 && cache->_nb_entries >= cache->_max_elements ) ||
+        ( cache->_max_bytes != 0 && cache->_nb_bytes + size > cache->_max_bytes );
+}
+
+HT_cache* HT_cache_new_hash(const unsigned int size, HT_hash_function hash_function, const size_t max_elements, const size_t max_bytes){
+    HT_cache* cache;
+    int retval;
+    if( size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return NULL;
+    }
+    cache = malloc(sizeof(HT_cache));
+    if( cache == NULL )
+        return NULL;
+    retval = HT_cache_init(cache, size, hash_function, max_elements, max_bytes);
+    if( retval != 0 ){
+        int errno_temp = errno;
+        free( cache );
+        errno = errno_temp;
+        return NULL;
+    }
+    return cache;
+}
+
+int HT_cache_init(HT_cache* const cache, const unsigned int size, HT_hash_function hash_function, const size_t max_elements, const size_t max_bytes){
+    if( cache == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    cache->_ring = malloc(HT_CACHE_INITIAL_RING * sizeof(HT_cache_entry*));
+    if( cache->_ring == NULL )
+        return 1;
+    if( HT_init(&cache->_table, size, hash_function) != 0 ){
+        int errno_temp = errno;
+        free(cache->_ring);
+        errno = errno_temp;
+        return 1;
+    }
+    cache->_nb_entries = 0;
+    cache->_ring_capacity = HT_CACHE_INITIAL_RING;
+    cache->_hand = 0;
+    cache->_max_elements = max_elements;
+    cache->_max_bytes = max_bytes;
+    cache->_nb_bytes = 0;
+    cache->evict_function = NULL;
+    cache->evict_data = NULL;
+    return 0;
+}
+
+int HT_cache_set_evict_function(HT_cache* const cache, HT_evict_function evict_function, void* data){
+    if( cache == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    cache->evict_function = evict_function;
+    cache->evict_data = data;
+    return 0;
+}
+
+int HT_cache_get_element(HT_cache* cache, const void* key, const size_t key_size, void** value, size_t* value_size){
+    HT_cache_entry *entry;
+    const HT_pair *pair;
+    if( cache == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    pair = HT_find_pair(&cache->_table, HT_hash_key(&cache->_table, key, key_size), key, key_size, 0, 0);
+    if( pair == NULL )
+        return 1;
+    entry = HT_cache_entry_of(pair);
+    if( entry->_expiry != 0 && HT_cache_expired(entry, HT_cache_now()) ){
+        HT_cache_remove_entry(cache, entry, HT_CACHE_EXPIRED);
+        return 1;
+    }
+    // A hot entry is already referenced, its cache line is not written again
+    if( !__atomic_load_n(&entry->_referenced, __ATOMIC_RELAXED) )
+        __atomic_store_n(&entry->_referenced, 1, __ATOMIC_RELAXED);
+    if( value != NULL && value_size != NULL ){
+        *value = entry->_value;
+        *value_size = entry->_value_size;
+    }
+    return 0;
+}
+
+int HT_cache_add_element(HT_cache* const cache, const void* const key, const size_t key_size, const void* const value, const size_t value_size, const uint64_t ttl){
+    HT_cache_entry *entry;
+    HT_pair *pair;
+    uint64_t hash,
+             now;
+    int inserted = 1;
+    if( cache == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    if( cache->_max_bytes != 0 && key_size + value_size > cache->_max_bytes ){
+        errno = ENOSPC;
+        return 2;
+    }
+    if( cache->_nb_entries == cache->_ring_capacity ){
+        HT_cache_entry **ring = realloc(cache->_ring, 2 * cache->_ring_capacity * sizeof(HT_cache_entry*));
+        if( ring == NULL )
+            return 2;
+        cache->_ring = ring;
+        cache->_ring_capacity *= 2;
+    }
+    entry = malloc(sizeof(HT_cache_entry) + value_size);
+    if( entry == NULL )
+        return 2;
+    now = HT_cache_now();
+    memcpy(entry->_value, value, value_size);
+    entry->_value_size = value_size;
+    entry->_referenced = 0;
+    entry->_expiry = 0;
+    if( ttl != 0 && ttl <= (UINT64_MAX - now) / UINT64_C(1000000) )
+        entry->_expiry = now + ttl * UINT64_C(1000000);
+
+    // A present key keeps its pair, only its entry is replaced, so the
+    // evictions below cannot choose it
+    hash = HT_hash_key(&cache->_table, key, key_size);
+    pair = HT_find_pair(&cache->_table, hash, key, key_size, 0, 0);
+    if( pair != NULL ){
+        HT_cache_entry *old = HT_cache_entry_of(pair);
+        HT_cache_ring_remove(cache, old);
+        free(old);
+        inserted = 0;
+    }
+    while( cache->_nb_entries != 0 && HT_cache_over_budget(cache, key_size + value_size) )
+        HT_cache_evict_one(cache, now);
+
+    if( pair != NULL )
+        memcpy(pair->_value._buffer, &entry, sizeof(entry));
+    else{
+        pair = HT_find_or_insert_hashed(&cache->_table, hash, key, key_size, &entry, sizeof(entry), &inserted);
+        if( pair == NULL ){
+            int errno_temp = errno;
+            free(entry);
+            errno = errno_temp;
+            return 2;
+        }
+    }
+    entry->_pair = pair;
+    HT_cache_ring_insert(cache, entry);
+    cache->_nb_bytes += key_size + value_size;
+    return !inserted;
+}
+
+int HT_cache_remove_element(HT_cache* cache, const void* key, const size_t key_size){
+    const HT_pair *pair;
+    if( cache == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    pair = HT_find_pair(&cache->_table, HT_hash_key(&cache->_table, key, key_size), key, key_size, 0, 0);
+    if( pair == NULL )
+        return 1;
+    HT_cache_remove_entry(cache, HT_cache_entry_of(pair), HT_CACHE_REMOVED);
+    return 0;
+}
+
+void HT_cache_delete_pointer(HT_cache* cache){
+    HT_cache_delete(cache);
+    free(cache);
+}
+
+void HT_cache_delete(HT_cache* const cache){
+    if( cache != NULL && cache->_ring != NULL ){
+        HT_cache_reset_table(cache);
+        HT_delete(&cache->_table);
+        free(cache->_ring);
+        cache->_ring = NULL;
+    }
+}
+
+void HT_cache_reset_table(HT_cache* cache){
+    size_t i;
+    if( cache != NULL && cache->_ring != NULL ){
+        for(i = 0; i < cache->_nb_entries; ++i)
+            free(cache->_ring[i]);
+        HT_reset_table(&cache->_table);
+        cache->_nb_entries = 0;
+        cache->_hand = 0;
+        cache->_nb_bytes = 0;
+    }
+}
@@ -0,0 +1,453 @@
+/**
+ * \file compact_hash_table.c
+ * \brief Compact hash table implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdint.h>
+
+#include "compact_hash_table.h"
+
+/**
+ * \brief The base 2 logarithm of the smallest number of buckets.
+ */
+#define HT_COMPACT_MIN_BITS 3
+
+/**
+ * \brief The base 2 logarithm of the largest number of buckets.
+ */
+#define HT_COMPACT_MAX_BITS 31
+
+/**
+ * \brief The size of the smallest heap, a heap this small is never compacted.
+ */
+#define HT_COMPACT_MIN_HEAP 4096
+
+/**
+ * \brief The size of the start of a record: the offset of the next record and the folded hash.
+ */
+#define HT_COMPACT_HEADER_SIZE (2 * sizeof(uint32_t))
+
+/**
+ * \brief The offset ending a chain, the first byte of the heap is never used by a record.
+ */
+#define HT_COMPACT_END 0
+
+/**
+ * \brief Read a 32 bits word of the heap.
+ * \param at The address of the word, not aligned.
+ */
+static inline uint32_t HT_compact_load(const unsigned char* const at){
+    uint32_t word;
+    memcpy(&word, at, sizeof(word));
+    return word;
+}
+
+/**
+ * \brief Write a 32 bits word of the heap.
+ * \param at The address of the word, not aligned.
+ * \param word The value to write.
+ */
+static inline void HT_compact_store(unsigned char* const at, const uint32_t word){
+    memcpy(at, &word, sizeof(word));
+}
+
+/**
+ * \brief Get the number of bytes of a size written as a varint.
+ * \param value The size.
+ */
+static inline size_t HT_compact_varint_size(size_t value){
+    size_t size = 1;
+    while( value >= 0x80 ){
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+/**
+ * \brief Write a size as a varint, 7 bits per byte starting with the lowest, the top bit telling that more bytes follow.
+ * \param at Where to write.
+ * \param value The size.
+ * \return The address following the varint.
+ */
+static inline unsigned char* HT_compact_write_varint(unsigned char* at, size_t value){
+    while( value >= 0x80 ){
+        *at++ = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    *at++ = (unsigned char) value;
+    return at;
+}
+
+/**
+ * \brief Read a size written by ::HT_compact_write_varint.
+ * \param at Where to read.
+ * \param value Set to the size.
+ * \return The address following the varint.
+ */
+static inline unsigned char* HT_compact_read_varint(unsigned char* at, size_t* const value){
+    unsigned int shift = 0;
+    *value = 0;
+    while( *at & 0x80 ){
+        *value |= (size_t) (*at++ & 0x7f) << shift;
+        shift += 7;
+    }
+    *value |= (size_t) *at++ << shift;
+    return at;
+}
+
+/**
+ * \brief Get the key of a record.
+ * \param ct A pointer to the table.
+ * \param offset The offset of the record.
+ * \param key_size Set to the size of the key.
+ * \param value_size Set to the size of the value, which follows the key.
+ * \return A pointer to the key.
+ */
+static inline unsigned char* HT_compact_record_key(const HT_compact_table* const ct, const uint32_t offset, size_t* const key_size, size_t* const value_size){
+    unsigned char *at = &ct->_heap[offset + HT_COMPACT_HEADER_SIZE];
+    at = HT_compact_read_varint(at, key_size);
+    return HT_compact_read_varint(at, value_size);
+}
+
+/**
+ * \brief Get the size of a record.
+ * \param ct A pointer to the table.
+ * \param offset The offset of the record.
+ */
+static inline size_t HT_compact_record_size(const HT_compact_table* const ct, const uint32_t offset){
+    size_t key_size,
+           value_size;
+    const unsigned char *key = HT_compact_record_key(ct, offset, &key_size, &value_size);
+    return (size_t) (key - &ct->_heap[offset]) + key_size + value_size;
+}
+
+/**
+ * \brief Get the bucket of a folded hash.
+ * \param ct A pointer to the table.
+ * \param fold The hash folded on 32 bits.
+ */
+static inline uint32_t* HT_compact_bucket(const HT_compact_table* const ct, const uint32_t fold){
+    return &ct->_buckets[fold >> (32 - ct->_bucket_bits)];
+}
+
+/**
+ * \brief Search the record of a key.
+ * \param ct A pointer to the table.
+ * \param key The key.
+ * \param key_size The size of the key.
+ * \param fold The hash of the key folded on 32 bits.
+ * \param previous If not NULL, set to the offset of the record before the found one in its chain, ::HT_COMPACT_END if it is the first one.
+ * \return The offset of the record, ::HT_COMPACT_END if the key is absent.
+ */
+static uint32_t HT_compact_find(const HT_compact_table* const ct, const void* const key, const size_t key_size, const uint32_t fold, uint32_t* const previous){
+    uint32_t offset = *HT_compact_bucket(ct, fold),
+             before = HT_COMPACT_END;
+    const unsigned char *stored;
+    size_t stored_key_size,
+           stored_value_size;
+
+    while( offset != HT_COMPACT_END ){
+        // The folded hash spares decoding the records of other keys
+        if( HT_compact_load(&ct->_heap[offset + sizeof(uint32_t)]) == fold ){
+            stored = HT_compact_record_key(ct, offset, &stored_key_size, &stored_value_size);
+            if( stored_key_size == key_size && memcmp(stored, key, key_size) == 0 ){
+                if( previous != NULL )
+                    *previous = before;
+                return offset;
+            }
+        }
+        before = offset;
+        offset = HT_compact_load(&ct->_heap[offset]);
+    }
+    return HT_COMPACT_END;
+}
+
+/**
+ * \brief Relink every record into new buckets.
+ * \param ct A pointer to the table.
+ * \param bucket_bits The new base 2 logarithm of the number of buckets.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately, the table is unchanged.
+ */
+static int HT_compact_rehash(HT_compact_table* const ct, const unsigned int bucket_bits){
+    uint32_t *old_buckets = ct->_buckets,
+             *bucket,
+             offset,
+             next;
+    size_t old_nb_buckets = (size_t) 1 << ct->_bucket_bits,
+           i;
+
+    ct->_buckets = calloc((size_t) 1 << bucket_bits, sizeof(uint32_t));
+    if( ct->_buckets == NULL ){
+        ct->_buckets = old_buckets;
+        return 1;
+    }
+    ct->_bucket_bits = bucket_bits;
+    for(i = 0; i < old_nb_buckets; ++i){
+        for(offset = old_buckets[i]; offset != HT_COMPACT_END; offset = next){
+            next = HT_compact_load(&ct->_heap[offset]);
+            bucket = HT_compact_bucket(ct, HT_compact_load(&ct->_heap[offset + sizeof(uint32_t)]));
+            HT_compact_store(&ct->_heap[offset], *bucket);
+            *bucket = offset;
+        }
+    }
+    free(old_buckets);
+    return 0;
+}
+
+/**
+ * \brief Copy the records in use to a new heap, chain by chain.
+ * \param ct A pointer to the table.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately, the table is unchanged.
+ */
+static int HT_compact_collect(HT_compact_table* const ct){
+    size_t nb_buckets = (size_t) 1 << ct->_bucket_bits,
+           live = ct->_heap_size - ct->_garbage,
+           capacity = live + live / 2,
+           size = 1,
+           record_size,
+           i;
+    unsigned char *heap;
+    uint32_t offset,
+             next;
+
+    if( capacity < HT_COMPACT_MIN_HEAP )
+        capacity = HT_COMPACT_MIN_HEAP;
+    heap = malloc(capacity);
+    if( heap == NULL )
+        return 1;
+    heap[0] = 0;
+    for(i = 0; i < nb_buckets; ++i){
+        offset = ct->_buckets[i];
+        if( offset != HT_COMPACT_END )
+            ct->_buckets[i] = (uint32_t) size;
+        // The records of a chain end up next to each other
+        for(; offset != HT_COMPACT_END; offset = next){
+            next = HT_compact_load(&ct->_heap[offset]);
+            record_size = HT_compact_record_size(ct, offset);
+            memcpy(&heap[size], &ct->_heap[offset], record_size);
+            HT_compact_store(&heap[size], next == HT_COMPACT_END ? HT_COMPACT_END : (uint32_t) (size + record_size));
+            size += record_size;
+        }
+    }
+    free(ct->_heap);
+    ct->_heap = heap;
+    ct->_heap_size = size;
+    ct->_heap_capacity = capacity;
+    ct->_garbage = 0;
+    return 0;
+}
+
+/**
+ * \brief Make room at the end of the heap.
+ * \param ct A pointer to the table.
+ * \param record_size The number of bytes needed.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+static int HT_compact_reserve(HT_compact_table* const ct, const size_t record_size){
+    size_t needed = ct->_heap_size + record_size,
+           capacity;
+    unsigned char *heap;
+
+    if( record_size > UINT32_MAX || needed > UINT32_MAX ){
+        errno = ENOSPC;
+        return 1;
+    }
+    if( needed <= ct->_heap_capacity )
+        return 0;
+    capacity = ct->_heap_capacity + ct->_heap_capacity / 2;
+    if( capacity < needed )
+        capacity = needed;
+    if( capacity > UINT32_MAX )
+        capacity = UINT32_MAX;
+    heap = realloc(ct->_heap, capacity);
+    if( heap == NULL )
+        return 1;
+    ct->_heap = heap;
+    ct->_heap_capacity = capacity;
+    return 0;
+}
+
+HT_compact_table* HT_compact_new_hash(const unsigned int size, HT_hash_function hash_function){
+    HT_compact_table* ctable;
+    int retval;
+    if( size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return NULL;
+    }
+    ctable = malloc(sizeof(HT_compact_table));
+    if( ctable == NULL )
+        return NULL;
+    retval = HT_compact_init(ctable, size, hash_function);
+    if( retval != 0 ){
+        int errno_temp = errno;
+        free( ctable );
+        errno = errno_temp;
+        return NULL;
+    }
+    return ctable;
+}
+
+int HT_compact_init(HT_compact_table* const ct, const unsigned int size, HT_hash_function hash_function){
+    unsigned int bucket_bits = HT_COMPACT_MIN_BITS;
+    if( ct == NULL || size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    while( ((size_t) 1 << bucket_bits) < size ){
+        if( bucket_bits >= HT_COMPACT_MAX_BITS ){
+            errno = EINVAL;
+            return 1;
+        }
+        ++bucket_bits;
+    }
+    ct->_buckets = calloc((size_t) 1 << bucket_bits, sizeof(uint32_t));
+    if( ct->_buckets == NULL )
+        return 1;
+    ct->_heap = malloc(HT_COMPACT_MIN_HEAP);
+    if( ct->_heap == NULL ){
+        int errno_temp = errno;
+        free(ct->_buckets);
+        errno = errno_temp;
+        return 1;
+    }
+    ct->_heap[0] = 0;
+    ct->_heap_size = 1;
+    ct->_heap_capacity = HT_COMPACT_MIN_HEAP;
+    ct->_garbage = 0;
+    ct->_bucket_bits = bucket_bits;
+    ct->_nb_elements = 0;
+    ct->hash_function = hash_function;
+    return 0;
+}
+
+int HT_compact_get_element(const HT_compact_table* ct, const void* key, const size_t key_size, void** value, size_t* value_size){
+    uint32_t offset;
+    unsigned char *stored;
+    size_t stored_key_size,
+           stored_value_size;
+    if( ct == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    offset = HT_compact_find(ct, key, key_size, HT_hash_fold(ct->hash_function(key, key_size), 32), NULL);
+    if( offset == HT_COMPACT_END )
+        return 1;
+    if( value != NULL && value_size != NULL ){
+        stored = HT_compact_record_key(ct, offset, &stored_key_size, &stored_value_size);
+        *value = stored + stored_key_size;
+        *value_size = stored_value_size;
+    }
+    return 0;
+}
+
+int HT_compact_add_element(HT_compact_table* const ct, const void* const key, const size_t key_size, const void* const value, const size_t value_size){
+    uint32_t fold,
+             *bucket;
+    size_t record_size;
+    unsigned char *at;
+    if( ct == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    if( key_size > UINT32_MAX || value_size > UINT32_MAX ){
+        errno = ENOSPC;
+        return 2;
+    }
+
+    fold = HT_hash_fold(ct->hash_function(key, key_size), 32);
+    if( HT_compact_find(ct, key, key_size, fold, NULL) != HT_COMPACT_END )
+        return 1;
+    record_size = HT_COMPACT_HEADER_SIZE + HT_compact_varint_size(key_size) +
+        HT_compact_varint_size(value_size) + key_size + value_size;
+    if( HT_compact_reserve(ct, record_size) != 0 )
+        return 2;
+    // A failed grow is not an error, the chains only get longer
+    if( ct->_nb_elements >= ((size_t) 1 << ct->_bucket_bits) && ct->_bucket_bits < HT_COMPACT_MAX_BITS )
+        HT_compact_rehash(ct, ct->_bucket_bits + 1);
+
+    bucket = HT_compact_bucket(ct, fold);
+    at = &ct->_heap[ct->_heap_size];
+    HT_compact_store(at, *bucket);
+    HT_compact_store(at + sizeof(uint32_t), fold);
+    at = HT_compact_write_varint(at + HT_COMPACT_HEADER_SIZE, key_size);
+    at = HT_compact_write_varint(at, value_size);
+    memcpy(at, key, key_size);
+    memcpy(at + key_size, value, value_size);
+    *bucket = (uint32_t) ct->_heap_size;
+    ct->_heap_size += record_size;
+    ++ct->_nb_elements;
+    return 0;
+}
+
+int HT_compact_remove_element(HT_compact_table* ct, const void* key, const size_t key_size){
+    uint32_t offset,
+             previous,
+             next;
+    if( ct == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    offset = HT_compact_find(ct, key, key_size, HT_hash_fold(ct->hash_function(key, key_size), 32), &previous);
+    if( offset == HT_COMPACT_END )
+        return 1;
+    next = HT_compact_load(&ct->_heap[offset]);
+    if( previous == HT_COMPACT_END )
+        *HT_compact_bucket(ct, HT_compact_load(&ct->_heap[offset + sizeof(uint32_t)])) = next;
+    else
+        HT_compact_store(&ct->_heap[previous], next);
+    ct->_garbage += HT_compact_record_size(ct, offset);
+    --ct->_nb_elements;
+    // A failed collection is not an error, the heap stays as it is
+    if( ct->_heap_size > HT_COMPACT_MIN_HEAP && ct->_garbage > ct->_heap_size / 2 )
+        HT_compact_collect(ct);
+    return 0;
+}
+
+void HT_compact_delete_pointer(HT_compact_table* ct){
+    HT_compact_delete(ct);
+    free(ct);
+}
+
+void HT_compact_delete(HT_compact_table* const ct){
+    if( ct != NULL && ct->_buckets != NULL ){
+        free(ct->_buckets);
+        free(ct->_heap);
+        ct->_buckets = NULL;
+    }
+}
+
+void HT_compact_reset_table(HT_compact_table* ct){
+    if( ct != NULL && ct->_buckets != NULL ){
+        memset(ct->_buckets, 0, ((size_t) 1 << ct->_bucket_bits) * sizeof(uint32_t));
+        ct->_heap_size = 1;
+        ct->_garbage = 0;
+        ct->_nb_elements = 0;
+    }
+}
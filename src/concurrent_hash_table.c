@@ -0,0 +1,652 @@
+/**
+ * \file concurrent_hash_table.c
+ * \brief Thread safe hash table implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include "concurrent_hash_table.h"
+#include "generic_hash_table_internal.h"
+
+/**
+ * \brief Get the base 2 logarithm of the smallest power of two not below size.
+ * \param size The requested size.
+ */
+static inline unsigned int HT_concurrent_bits_for(const unsigned int size){
+    unsigned int bits = 0;
+    while( (1u << bits) < size )
+        ++bits;
+    return bits;
+}
+
+/**
+ * \brief Get the stripe of a key.
+ * \param ct A pointer to the table.
+ * \param hash The hash of the key.
+ */
+static inline HT_stripe* HT_concurrent_stripe(const HT_concurrent_table* const ct, const uint64_t hash){
+    return &ct->_stripes[HT_hash_fold(hash, ct->_stripe_bits)];
+}
+
+/**
+ * \brief Tell if an old slot already lives in the new slots.
+ * \param ct A pointer to the table.
+ * \param migrated_slots The number of migrated slots of the stripe of the slot.
+ * \param slot_bits The base 2 logarithm of the number of old slots.
+ * \param slot_index The index of the old slot.
+ * \note A stripe migrates its slots in order, starting from its first one.
+ */
+static inline int HT_concurrent_is_migrated(const HT_concurrent_table* const ct, const unsigned int migrated_slots, const unsigned int slot_bits, const size_t slot_index){
+    return (slot_index & (((size_t) 1 << (slot_bits - ct->_stripe_bits)) - 1)) < migrated_slots;
+}
+
+/**
+ * \brief Get the slot of a key, the lock of its stripe must be held.
+ * \param ct A pointer to the table.
+ * \param stripe The stripe of the key.
+ * \param hash The hash of the key.
+ */
+static inline HT_slot* HT_concurrent_slot(const HT_concurrent_table* const ct, const HT_stripe* const stripe, const uint64_t hash){
+    const size_t slot_index = HT_hash_fold(hash, ct->_slot_bits);
+    if( HT_concurrent_is_migrated(ct, stripe->_migrated_slots, ct->_slot_bits, slot_index) )
+        return &ct->_new_slots[HT_hash_fold(hash, ct->_new_slot_bits)];
+    return &ct->_slots[slot_index];
+}
+
+/**
+ * \brief Get the slot of a key without any lock, for a lock free lookup.
+ * \param ct A pointer to the table.
+ * \param stripe The stripe of the key.
+ * \param hash The hash of the key.
+ * \note The slots and their size are read again if the end of a resize
+ * swapped them meanwhile, the old ones are retired so they stay readable.
+ */
+static inline HT_slot* HT_concurrent_published_slot(const HT_concurrent_table* const ct, const HT_stripe* const stripe, const uint64_t hash){
+    unsigned int generation,
+                 bits;
+    HT_slot *slots;
+
+    do{
+        generation = __atomic_load_n(&ct->_generation, __ATOMIC_ACQUIRE);
+        bits = __atomic_load_n(&ct->_slot_bits, __ATOMIC_ACQUIRE);
+        if( HT_concurrent_is_migrated(ct, __atomic_load_n(&stripe->_migrated_slots, __ATOMIC_ACQUIRE), bits, HT_hash_fold(hash, bits)) ){
+            slots = __atomic_load_n(&ct->_new_slots, __ATOMIC_ACQUIRE);
+            bits = __atomic_load_n(&ct->_new_slot_bits, __ATOMIC_ACQUIRE);
+        }
+        else
+            slots = __atomic_load_n(&ct->_slots, __ATOMIC_ACQUIRE);
+    }
+    while( (generation & 1u) != 0 || generation != __atomic_load_n(&ct->_generation, __ATOMIC_RELAXED) );
+    return &slots[HT_hash_fold(hash, bits)];
+}
+
+/**
+ * \brief Find a pair like ::HT_get_pair while writers modify the slot.
+ * \param slot The slot to search inside.
+ * \param hash The hash of the key.
+ * \param key The key.
+ * \param key_size The size of the key.
+ * \param position The position wanted.
+ * \param reverse Search first from end or start.
+ * \return The matching pair, the last match if there are less than position
+ * matches, NULL if there is none.
+ * \note Every link is loaded with acquire semantics, pairing with the release
+ * stores of the writers, the caller must be inside of an epoch section.
+ */
+static HT_pair* HT_concurrent_find_published(const HT_slot* const slot, const uint64_t hash, const void* const key, const size_t key_size, unsigned int position, const int reverse){
+    HT_pair *current,
+            *last_found = NULL;
+
+    current = __atomic_load_n(reverse ? &slot->_last_pair : &slot->_first_pair, __ATOMIC_ACQUIRE);
+    while( current != NULL ){
+        if( current->_hash == hash && current->_key._size_buffer == key_size &&
+                memcmp(key, current->_key._buffer, key_size) == 0 ){
+            last_found = current;
+            if( position-- == 0 )
+                break;
+        }
+        current = __atomic_load_n(reverse ? &current->_previous : &current->_next, __ATOMIC_ACQUIRE);
+    }
+    return last_found;
+}
+
+/**
+ * \brief Destroy a retired pair.
+ * \param context Unused.
+ * \param pair The pair.
+ */
+static void HT_concurrent_destroy_retired_pair(void* context, void* pair){
+    (void) context;
+    HT_destroy_pair(&HT_default_allocator, NULL, pair);
+}
+
+/**
+ * \brief Free a retired slot array.
+ * \param context Unused.
+ * \param slots The slots.
+ */
+static void HT_concurrent_free_retired_slots(void* context, void* slots){
+    (void) context;
+    free(slots);
+}
+
+/**
+ * \brief Empty a slot and retire its pairs, the stripe must be locked for writing.
+ * \param slot The slot.
+ */
+static void HT_concurrent_retire_slot_content(HT_slot* const slot){
+    HT_pair *current = slot->_first_pair,
+            *next;
+
+    HT_PUBLISH(slot->_first_pair, (HT_pair*) NULL);
+    HT_PUBLISH(slot->_last_pair, (HT_pair*) NULL);
+    for(; current != NULL; current = next){
+        next = current->_next;
+        HT_epoch_retire(current, HT_concurrent_destroy_retired_pair, NULL);
+    }
+}
+
+/**
+ * \brief Lock every stripe for writing, in order.
+ * \param ct A pointer to the table.
+ */
+static void HT_concurrent_lock_all(HT_concurrent_table* const ct){
+    unsigned int i;
+    for(i = 0; i < (1u << ct->_stripe_bits); ++i)
+        pthread_rwlock_wrlock(&ct->_stripes[i]._lock);
+}
+
+/**
+ * \brief Unlock every stripe.
+ * \param ct A pointer to the table.
+ */
+static void HT_concurrent_unlock_all(HT_concurrent_table* const ct){
+    unsigned int i;
+    for(i = 0; i < (1u << ct->_stripe_bits); ++i)
+        pthread_rwlock_unlock(&ct->_stripes[i]._lock);
+}
+
+/**
+ * \brief Move an old slot to the new slots, its stripe must be locked for writing.
+ * \param ct A pointer to the table.
+ * \param stripe The stripe of the slot.
+ * \param slot_index The index of the slot, the first one not migrated of its stripe.
+ * \return True if the slot was migrated, false if memory is exhausted.
+ * \note The keys of old slot i go to the new slots 2i and 2i+1 which no
+ * other slot fills, and no modification reaches them before the migration.
+ */
+static int HT_concurrent_migrate_slot(HT_concurrent_table* const ct, HT_stripe* const stripe, const size_t slot_index){
+    HT_slot *slot = &ct->_slots[slot_index];
+    HT_pair *current,
+            *next,
+            *copy;
+    unsigned int nb_pairs = 0;
+
+    if( ct->_lockfree_reads ){
+        // A lock free reader may stand on any old pair, so the pairs are
+        // copied and the old ones retired once the new slots are published.
+        // Out of memory the old slot stays in use and is migrated later.
+        for(current = slot->_first_pair; current != NULL; current = current->_next)
+            ++nb_pairs;
+        if( HT_epoch_reserve(nb_pairs) != 0 )
+            return 0;
+        for(current = slot->_first_pair; current != NULL; current = current->_next){
+            copy = HT_new_pair(&HT_default_allocator, current->_key._buffer, current->_key._size_buffer,
+                    current->_value._buffer, current->_value._size_buffer);
+            if( copy == NULL ){
+                HT_destroy_slot_content(&HT_default_allocator, NULL, &ct->_new_slots[slot_index << 1]);
+                HT_destroy_slot_content(&HT_default_allocator, NULL, &ct->_new_slots[(slot_index << 1) + 1]);
+                return 0;
+            }
+            copy->_hash = current->_hash;
+            HT_slot_append_pair(&ct->_new_slots[HT_hash_fold(current->_hash, ct->_new_slot_bits)], copy);
+        }
+        __atomic_store_n(&stripe->_migrated_slots, stripe->_migrated_slots + 1, __ATOMIC_RELEASE);
+        for(current = slot->_first_pair; current != NULL; current = next){
+            next = current->_next;
+            HT_epoch_retire(current, HT_concurrent_destroy_retired_pair, NULL);
+        }
+        return 1;
+    }
+
+    for(current = slot->_first_pair; current != NULL; current = next){
+        next = current->_next;
+        HT_slot_append_pair(&ct->_new_slots[HT_hash_fold(current->_hash, ct->_new_slot_bits)], current);
+    }
+    slot->_first_pair = NULL;
+    slot->_last_pair = NULL;
+    __atomic_store_n(&stripe->_migrated_slots, stripe->_migrated_slots + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/**
+ * \brief Replace the slots by the new ones once every stripe is migrated.
+ * \param ct A pointer to the table.
+ */
+static void HT_concurrent_finish_resize(HT_concurrent_table* const ct){
+    HT_slot *old_slots;
+    unsigned int i;
+
+    HT_concurrent_lock_all(ct);
+    // Lock free readers retry while the generation is odd or has changed,
+    // the release stores keep the odd generation visible before them
+    __atomic_store_n(&ct->_generation, ct->_generation + 1, __ATOMIC_RELAXED);
+    old_slots = ct->_slots;
+    __atomic_store_n(&ct->_slots, ct->_new_slots, __ATOMIC_RELEASE);
+    __atomic_store_n(&ct->_slot_bits, ct->_new_slot_bits, __ATOMIC_RELEASE);
+    __atomic_store_n(&ct->_new_slots, (HT_slot*) NULL, __ATOMIC_RELEASE);
+    for(i = 0; i < (1u << ct->_stripe_bits); ++i)
+        __atomic_store_n(&ct->_stripes[i]._migrated_slots, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&ct->_generation, ct->_generation + 1, __ATOMIC_RELEASE);
+    HT_concurrent_unlock_all(ct);
+    if( ct->_lockfree_reads )
+        HT_epoch_retire(old_slots, HT_concurrent_free_retired_slots, NULL);
+    else
+        free(old_slots);
+    __atomic_store_n(&ct->_resizing, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Migrate a few slots of a resize in progress, no lock must be held.
+ * \param ct A pointer to the table.
+ * \note The stripes are helped in turn, skipping the ones already migrated,
+ * the last migrated slot ends the resize.
+ */
+static void HT_concurrent_help_resize(HT_concurrent_table* const ct){
+    const unsigned int nb_stripes = 1u << ct->_stripe_bits;
+    unsigned int stripe_index,
+                 slots_per_stripe,
+                 i;
+    HT_stripe *stripe;
+    int done = 0;
+
+    if( !__atomic_load_n(&ct->_resizing, __ATOMIC_RELAXED) )
+        return;
+    stripe_index = __atomic_fetch_add(&ct->_resize_cursor, 1, __ATOMIC_RELAXED);
+    slots_per_stripe = 1u << (__atomic_load_n(&ct->_slot_bits, __ATOMIC_RELAXED) - ct->_stripe_bits);
+    for(i = 0; i < nb_stripes; ++i, ++stripe_index){
+        if( __atomic_load_n(&ct->_stripes[stripe_index & (nb_stripes - 1)]._migrated_slots, __ATOMIC_RELAXED) < slots_per_stripe )
+            break;
+    }
+    stripe = &ct->_stripes[stripe_index & (nb_stripes - 1)];
+
+    pthread_rwlock_wrlock(&stripe->_lock);
+    // The resize may have ended, or another one started, before the lock
+    if( __atomic_load_n(&ct->_new_slots, __ATOMIC_ACQUIRE) != NULL ){
+        slots_per_stripe = 1u << (ct->_slot_bits - ct->_stripe_bits);
+        for(i = 0; i < HT_CONCURRENT_MIGRATE_SLOTS_PER_STEP && stripe->_migrated_slots < slots_per_stripe; ++i){
+            if( !HT_concurrent_migrate_slot(ct, stripe, ((size_t) (stripe_index & (nb_stripes - 1)) << (ct->_slot_bits - ct->_stripe_bits)) + stripe->_migrated_slots) )
+                break;
+        }
+        done = i > 0 && stripe->_migrated_slots == slots_per_stripe;
+    }
+    pthread_rwlock_unlock(&stripe->_lock);
+
+    if( done && __atomic_sub_fetch(&ct->_pending_stripes, 1, __ATOMIC_ACQ_REL) == 0 )
+        HT_concurrent_finish_resize(ct);
+}
+
+/**
+ * \brief Start a resize if the load factor is above the threshold, no lock must be held.
+ * \param ct A pointer to the table.
+ * \param nb_elements The number of elements seen by the caller.
+ * \note A failed allocation is not an error, the table keeps its current size.
+ */
+static void HT_concurrent_check_load_factor(HT_concurrent_table* const ct, const size_t nb_elements){
+    unsigned int bits = __atomic_load_n(&ct->_slot_bits, __ATOMIC_RELAXED);
+    size_t nb_new_slots;
+    HT_slot *new_slots;
+
+    if( ct->_max_load_factor <= 0.0f || bits >= 31 ||
+            (double) nb_elements <= (double) ct->_max_load_factor * (double) (1u << bits) )
+        return;
+    if( !__sync_bool_compare_and_swap(&ct->_resizing, 0, 1) )
+        return;
+    if( __atomic_load_n(&ct->_slot_bits, __ATOMIC_RELAXED) != bits ){ // An other thread already resized the table
+        __atomic_store_n(&ct->_resizing, 0, __ATOMIC_RELEASE);
+        return;
+    }
+
+    nb_new_slots = (size_t) 1 << (bits + 1);
+    new_slots = malloc(nb_new_slots * sizeof(HT_slot));
+    if( new_slots == NULL ){
+        __atomic_store_n(&ct->_resizing, 0, __ATOMIC_RELEASE);
+        return;
+    }
+    memset(new_slots, 0, nb_new_slots * sizeof(HT_slot));
+    // The helpers only start once they read the new slots
+    __atomic_store_n(&ct->_new_slot_bits, bits + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&ct->_pending_stripes, 1u << ct->_stripe_bits, __ATOMIC_RELAXED);
+    __atomic_store_n(&ct->_new_slots, new_slots, __ATOMIC_RELEASE);
+}
+
+HT_concurrent_table* HT_concurrent_new_hash(const unsigned int size, const unsigned int nb_stripes, HT_hash_function hash_function){
+    HT_concurrent_table* ctable;
+    int retval;
+    if( size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return NULL;
+    }
+    ctable = malloc(sizeof(HT_concurrent_table));
+    if( ctable == NULL )
+        return NULL;
+    retval = HT_concurrent_init(ctable, size, nb_stripes, hash_function);
+    if( retval != 0 ){
+        int errno_temp = errno;
+        free( ctable );
+        errno = errno_temp;
+        return NULL;
+    }
+    return ctable;
+}
+
+int HT_concurrent_init(HT_concurrent_table* const ct, const unsigned int size, const unsigned int nb_stripes, HT_hash_function hash_function){
+    unsigned int i,
+                 stripe_bits;
+    void *stripes;
+    int retval;
+    if( ct == NULL || size == 0 || size > HT_MAX_SLOTS || nb_stripes > HT_MAX_SLOTS || hash_function == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+
+    stripe_bits = HT_concurrent_bits_for(nb_stripes == 0 ? HT_CONCURRENT_DEFAULT_STRIPES : nb_stripes);
+    ct->_slot_bits = HT_concurrent_bits_for(size);
+    if( ct->_slot_bits < stripe_bits )
+        ct->_slot_bits = stripe_bits;
+    ct->_slots = malloc(((size_t) 1 << ct->_slot_bits) * sizeof(HT_slot));
+    if( ct->_slots == NULL )
+        return 1;
+    memset(ct->_slots, 0, ((size_t) 1 << ct->_slot_bits) * sizeof(HT_slot));
+
+    retval = posix_memalign(&stripes, HT_CACHE_LINE_SIZE, ((size_t) 1 << stripe_bits) * sizeof(HT_stripe));
+    if( retval != 0 ){
+        free(ct->_slots);
+        errno = retval;
+        return 1;
+    }
+    ct->_stripes = stripes;
+    ct->_stripe_bits = stripe_bits;
+    for(i = 0; i < (1u << stripe_bits); ++i){
+        pthread_rwlock_init(&ct->_stripes[i]._lock, NULL);
+        ct->_stripes[i]._migrated_slots = 0;
+    }
+
+    ct->_new_slots = NULL;
+    ct->_new_slot_bits = 0;
+    ct->_resizing = 0;
+    ct->_resize_cursor = 0;
+    ct->_pending_stripes = 0;
+    ct->_nb_elements = 0;
+    ct->_max_load_factor = HT_DEFAULT_MAX_LOAD_FACTOR;
+    ct->_lockfree_reads = 0;
+    ct->_generation = 0;
+    ct->hash_function = hash_function;
+    return 0;
+}
+
+int HT_concurrent_set_load_factor(HT_concurrent_table* const ct, float max_load_factor){
+    if( ct == NULL || max_load_factor < 0.0f ){
+        errno = EINVAL;
+        return 1;
+    }
+    ct->_max_load_factor = max_load_factor;
+    return 0;
+}
+
+int HT_concurrent_set_lockfree_reads(HT_concurrent_table* const ct, int enable){
+    if( ct == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    ct->_lockfree_reads = enable != 0;
+    return 0;
+}
+
+int HT_concurrent_get_element_position(HT_concurrent_table* ct, const void* key, const size_t key_size, void* value, size_t* value_size, unsigned int position, int reverse){
+    HT_stripe *stripe;
+    HT_pair *pair;
+    uint64_t hash;
+    int locked;
+    if( ct == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = ct->hash_function(key, key_size);
+    stripe = HT_concurrent_stripe(ct, hash);
+    // Without an epoch record the stripe lock keeps the pairs alive instead
+    locked = !ct->_lockfree_reads || HT_epoch_enter() != 0;
+    if( !locked )
+        pair = HT_concurrent_find_published(HT_concurrent_published_slot(ct, stripe, hash), hash, key, key_size, position, reverse);
+    else{
+        pthread_rwlock_rdlock(&stripe->_lock);
+        pair = HT_get_pair(HT_concurrent_slot(ct, stripe, hash), hash, key, key_size, position, reverse);
+    }
+    if( pair != NULL && value_size != NULL ){
+        if( value != NULL )
+            memcpy(value, pair->_value._buffer,
+                    *value_size < pair->_value._size_buffer ? *value_size : pair->_value._size_buffer);
+        *value_size = pair->_value._size_buffer;
+    }
+    if( locked )
+        pthread_rwlock_unlock(&stripe->_lock);
+    else
+        HT_epoch_exit();
+    return pair == NULL ? 1 : 0;
+}
+
+int HT_concurrent_get_element_reference(HT_concurrent_table* ct, const void* key, const size_t key_size, void** value, size_t* value_size, unsigned int position, int reverse){
+    HT_pair *pair;
+    uint64_t hash;
+    if( ct == NULL || key == NULL || key_size == 0 || !ct->_lockfree_reads ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = ct->hash_function(key, key_size);
+    pair = HT_concurrent_find_published(HT_concurrent_published_slot(ct, HT_concurrent_stripe(ct, hash), hash),
+            hash, key, key_size, position, reverse);
+    if( pair == NULL )
+        return 1;
+    if( value != NULL && value_size != NULL ){
+        *value = pair->_value._buffer;
+        *value_size = pair->_value._size_buffer;
+    }
+    return 0;
+}
+
+/**
+ * \brief Add an element, optionally only if its key is absent.
+ * \param ct A pointer to the table.
+ * \param key The key.
+ * \param key_size The size of the key.
+ * \param value The value.
+ * \param value_size The size of the value.
+ * \param position The number of match before the new pair.
+ * \param reverse Count the matches from the end.
+ * \param unique Fail if the key is already present.
+ * \retval 0 On success.
+ * \retval 1 If unique and the key is present.
+ * \retval 2 On failure and errno is set appropriately.
+ */
+static int HT_concurrent_add(HT_concurrent_table* const ct, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse, int unique){
+    HT_stripe *stripe;
+    HT_slot *slot;
+    uint64_t hash;
+    int retval;
+    if( ct == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = ct->hash_function(key, key_size);
+    stripe = HT_concurrent_stripe(ct, hash);
+    pthread_rwlock_wrlock(&stripe->_lock);
+    slot = HT_concurrent_slot(ct, stripe, hash);
+    if( unique && HT_get_pair(slot, hash, key, key_size, 0, 0) != NULL )
+        retval = 1;
+    else
+        retval = HT_slot_insert(&HT_default_allocator, slot, hash, key, key_size, value, value_size, position, reverse, HT_MODE_COPY);
+    pthread_rwlock_unlock(&stripe->_lock);
+
+    if( retval == 0 )
+        HT_concurrent_check_load_factor(ct, __atomic_add_fetch(&ct->_nb_elements, 1, __ATOMIC_RELAXED));
+    HT_concurrent_help_resize(ct);
+    return retval;
+}
+
+int HT_concurrent_add_element_position(HT_concurrent_table* const ct, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse){
+    return HT_concurrent_add(ct, key, key_size, value, value_size, position, reverse, 0);
+}
+
+int HT_concurrent_add_element(HT_concurrent_table* const ct, const void* const key, const size_t key_size, const void* const value, const size_t value_size){
+    return HT_concurrent_add(ct, key, key_size, value, value_size, 0, 0, 1);
+}
+
+int HT_concurrent_remove_element_position(HT_concurrent_table* ct, const void* key, const size_t key_size, unsigned int position, int reverse){
+    HT_stripe *stripe;
+    HT_pair *pair;
+    uint64_t hash;
+    int retval;
+    if( ct == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    // The removed pair is retired, its bookkeeping must exist before the unlink
+    if( ct->_lockfree_reads && HT_epoch_reserve(1) != 0 )
+        return 2;
+
+    hash = ct->hash_function(key, key_size);
+    stripe = HT_concurrent_stripe(ct, hash);
+    pthread_rwlock_wrlock(&stripe->_lock);
+    if( ct->_lockfree_reads ){
+        pair = HT_slot_unlink(HT_concurrent_slot(ct, stripe, hash), hash, key, key_size, position, reverse);
+        if( pair != NULL )
+            HT_epoch_retire(pair, HT_concurrent_destroy_retired_pair, NULL);
+        retval = pair == NULL ? 1 : 0;
+    }
+    else
+        retval = HT_slot_remove(&HT_default_allocator, NULL, HT_concurrent_slot(ct, stripe, hash), hash, key, key_size, position, reverse);
+    pthread_rwlock_unlock(&stripe->_lock);
+
+    if( retval == 0 )
+        __atomic_sub_fetch(&ct->_nb_elements, 1, __ATOMIC_RELAXED);
+    HT_concurrent_help_resize(ct);
+    return retval;
+}
+
+uint64_t HT_concurrent_scan(HT_concurrent_table* ct, uint64_t cursor, const unsigned int count, HT_foreach_function function, void* data){
+    unsigned int visited = 0,
+                 bits;
+    uint64_t end;
+    HT_stripe *stripe;
+    HT_slot *slot;
+    HT_pair *pair;
+    int stop = 0;
+    if( ct == NULL || function == NULL || cursor > UINT32_MAX ){
+        errno = EINVAL;
+        return HT_SCAN_CURSOR_START;
+    }
+
+    do{
+        // The stripe of a cursor is given by its top bits, like for a key
+        stripe = &ct->_stripes[cursor >> (32 - ct->_stripe_bits)];
+        pthread_rwlock_rdlock(&stripe->_lock);
+        if( HT_concurrent_is_migrated(ct, stripe->_migrated_slots, ct->_slot_bits, cursor >> (32 - ct->_slot_bits)) ){
+            bits = ct->_new_slot_bits;
+            slot = &ct->_new_slots[cursor >> (32 - bits)];
+        }
+        else{
+            bits = ct->_slot_bits;
+            slot = &ct->_slots[cursor >> (32 - bits)];
+        }
+        for(pair = slot->_first_pair; pair != NULL; pair = pair->_next){
+            if( function(pair->_key._buffer, pair->_key._size_buffer, pair->_value._buffer, pair->_value._size_buffer, data) != 0 )
+                stop = 1;
+            ++visited;
+        }
+        pthread_rwlock_unlock(&stripe->_lock);
+        end = ((cursor >> (32 - bits)) + 1) << (32 - bits);
+        cursor = end > UINT32_MAX ? HT_SCAN_CURSOR_START : end;
+    }
+    while( cursor != HT_SCAN_CURSOR_START && visited < count && !stop );
+    return cursor;
+}
+
+/**
+ * \brief Release every pair, the stripes must be locked or unused.
+ * \param ct A pointer to the table.
+ * \param retire Retire the pairs instead of destroying them, for the lock free readers.
+ * \note The migrated old slots are skipped, their pairs moved or were already
+ * retired.
+ */
+static void HT_concurrent_destroy_content(HT_concurrent_table* const ct, const int retire){
+    const unsigned int shift = ct->_slot_bits - ct->_stripe_bits;
+    unsigned int stripe_index;
+    size_t i;
+    for(stripe_index = 0; stripe_index < (1u << ct->_stripe_bits); ++stripe_index){
+        for(i = ((size_t) stripe_index << shift) + ct->_stripes[stripe_index]._migrated_slots; i < ((size_t) stripe_index + 1) << shift; ++i){
+            if( retire )
+                HT_concurrent_retire_slot_content(&ct->_slots[i]);
+            else
+                HT_destroy_slot_content(&HT_default_allocator, NULL, &ct->_slots[i]);
+        }
+    }
+    if( ct->_new_slots != NULL ){
+        for(i = 0; i < (size_t) 1 << ct->_new_slot_bits; ++i){
+            if( retire )
+                HT_concurrent_retire_slot_content(&ct->_new_slots[i]);
+            else
+                HT_destroy_slot_content(&HT_default_allocator, NULL, &ct->_new_slots[i]);
+        }
+    }
+    __atomic_store_n(&ct->_nb_elements, 0, __ATOMIC_RELAXED);
+}
+
+void HT_concurrent_reset_table(HT_concurrent_table* ct){
+    if( ct != NULL && ct->_stripes != NULL ){
+        HT_concurrent_lock_all(ct);
+        HT_concurrent_destroy_content(ct, ct->_lockfree_reads);
+        HT_concurrent_unlock_all(ct);
+    }
+}
+
+void HT_concurrent_delete_pointer(HT_concurrent_table* ct){
+    HT_concurrent_delete(ct);
+    free(ct);
+}
+
+void HT_concurrent_delete(HT_concurrent_table* const ct){
+    unsigned int i;
+    if( ct != NULL && ct->_stripes != NULL ){
+        HT_concurrent_destroy_content(ct, 0);
+        for(i = 0; i < (1u << ct->_stripe_bits); ++i)
+            pthread_rwlock_destroy(&ct->_stripes[i]._lock);
+        free(ct->_stripes);
+        free(ct->_slots);
+        free(ct->_new_slots);
+        ct->_stripes = NULL;
+    }
+}
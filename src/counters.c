@@ -0,0 +1,126 @@
+/**
+ * \file counters.c
+ * \brief Per thread operation counters implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "generic_hash_table.h"
+#include "generic_hash_table_internal.h"
+
+#ifdef HT_STATS
+
+/**
+ * \brief The counters of a thread, records are never freed but reused after the thread exits.
+ * \note A record fills its own cache line so that counting never writes to a shared one.
+ */
+typedef struct HT_counters_record{
+    HT_counters _counters;      /**<- The counters, kept by the next owner. */
+    int _in_use;                /**<- True while a thread owns the record. */
+    struct HT_counters_record *_next; /**<- The next record. */
+} __attribute__((aligned(64))) HT_counters_record;
+
+__thread HT_counters *HT_counters_self = NULL;
+
+/**
+ * \brief Every record ever created.
+ */
+static HT_counters_record *HT_counters_records = NULL;
+
+/**
+ * \brief The key used to release the record when a thread exits.
+ */
+static pthread_key_t HT_counters_key;
+
+/**
+ * \brief Ensure HT_counters_key is created once.
+ */
+static pthread_once_t HT_counters_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * \brief Give the record of an exiting thread back.
+ * \param record The record.
+ */
+static void HT_counters_release_record(void* record){
+    HT_counters_record *r = record;
+    __atomic_store_n(&r->_in_use, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Create the thread exit key.
+ */
+static void HT_counters_create_key(void){
+    pthread_key_create(&HT_counters_key, HT_counters_release_record);
+}
+
+HT_counters* HT_counters_register(void){
+    HT_counters_record *record;
+    int expected;
+
+    pthread_once(&HT_counters_key_once, HT_counters_create_key);
+    for(record = __atomic_load_n(&HT_counters_records, __ATOMIC_ACQUIRE); record != NULL; record = record->_next){
+        expected = 0;
+        if( __atomic_compare_exchange_n(&record->_in_use, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) )
+            break;
+    }
+    if( record == NULL ){
+        void *buffer;
+        if( posix_memalign(&buffer, sizeof(HT_counters_record), sizeof(HT_counters_record)) != 0 )
+            return NULL;
+        record = buffer;
+        memset(record, 0, sizeof(HT_counters_record));
+        record->_in_use = 1;
+        record->_next = __atomic_load_n(&HT_counters_records, __ATOMIC_RELAXED);
+        while( !__atomic_compare_exchange_n(&HT_counters_records, &record->_next, record, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED) )
+            ;
+    }
+    pthread_setspecific(HT_counters_key, record);
+    HT_counters_self = &record->_counters;
+    return HT_counters_self;
+}
+
+void HT_get_counters(HT_counters* counters){
+    HT_counters_record *record;
+    memset(counters, 0, sizeof(HT_counters));
+    for(record = __atomic_load_n(&HT_counters_records, __ATOMIC_ACQUIRE); record != NULL; record = record->_next){
+        counters->hits += __atomic_load_n(&record->_counters.hits, __ATOMIC_RELAXED);
+        counters->misses += __atomic_load_n(&record->_counters.misses, __ATOMIC_RELAXED);
+        counters->searches += __atomic_load_n(&record->_counters.searches, __ATOMIC_RELAXED);
+        counters->probes += __atomic_load_n(&record->_counters.probes, __ATOMIC_RELAXED);
+        counters->hashes += __atomic_load_n(&record->_counters.hashes, __ATOMIC_RELAXED);
+        counters->hash_cycles += __atomic_load_n(&record->_counters.hash_cycles, __ATOMIC_RELAXED);
+    }
+}
+
+#else
+
+void HT_get_counters(HT_counters* counters){
+    memset(counters, 0, sizeof(HT_counters));
+}
+
+#endif // ( HT_STATS )
@@ -0,0 +1,332 @@
+/**
+ * \file epoch.c
+ * \brief Epoch based memory reclamation implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "epoch.h"
+
+/**
+ * \brief A buffer waiting for the end of the grace period.
+ */
+typedef struct HT_retired{
+    struct HT_retired *_next;   /**<- The next retired buffer. */
+    void *_buffer;              /**<- The buffer. */
+    void (*_destroy)(void* context, void* buffer); /**<- The destruction function. */
+    void *_context;             /**<- The first argument of _destroy. */
+    unsigned long _epoch;       /**<- The global epoch when the buffer was retired. */
+} HT_retired;
+
+/**
+ * \brief The state of a thread, records are never freed but reused after the thread exits.
+ * \note A record fills its own cache line so that readers never write to a shared one.
+ */
+typedef struct HT_epoch_record{
+    unsigned long _epoch;       /**<- The epoch observed by a reader, 0 outside of any section. */
+    unsigned int _nesting;      /**<- The depth of nested sections. */
+    int _in_use;                /**<- True while a thread owns the record. */
+    HT_retired *_retired;       /**<- The buffers retired by the owner. */
+    unsigned int _nb_retired;   /**<- The length of _retired. */
+    HT_retired *_spare;         /**<- The bookkeeping reserved by ::HT_epoch_reserve. */
+    unsigned int _nb_spare;     /**<- The length of _spare. */
+    struct HT_epoch_record *_next; /**<- The next record. */
+} __attribute__((aligned(HT_EPOCH_RECORD_ALIGNMENT))) HT_epoch_record;
+
+/**
+ * \brief The global epoch, starts at 1 since 0 marks a quiescent reader.
+ */
+static unsigned long HT_epoch_global = 1;
+
+/**
+ * \brief Every record ever created.
+ */
+static HT_epoch_record *HT_epoch_records = NULL;
+
+/**
+ * \brief The buffers left by the threads which exited before their grace period ended.
+ */
+static HT_retired *HT_epoch_orphans = NULL;
+
+/**
+ * \brief The record of the current thread.
+ */
+static __thread HT_epoch_record *HT_epoch_self = NULL;
+
+/**
+ * \brief The key used to release the record when a thread exits.
+ */
+static pthread_key_t HT_epoch_key;
+
+/**
+ * \brief Ensure HT_epoch_key is created once.
+ */
+static pthread_once_t HT_epoch_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * \brief Increment the global epoch if every active reader observed the current one.
+ * \return The global epoch.
+ */
+static unsigned long HT_epoch_try_advance(void){
+    unsigned long epoch = __atomic_load_n(&HT_epoch_global, __ATOMIC_SEQ_CST),
+                  observed;
+    HT_epoch_record *record;
+
+    for(record = __atomic_load_n(&HT_epoch_records, __ATOMIC_ACQUIRE); record != NULL; record = record->_next){
+        observed = __atomic_load_n(&record->_epoch, __ATOMIC_SEQ_CST);
+        if( observed != 0 && observed != epoch )
+            return epoch;
+    }
+    if( __atomic_compare_exchange_n(&HT_epoch_global, &epoch, epoch + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) )
+        return epoch + 1;
+    return epoch;
+}
+
+/**
+ * \brief Push a list of retired buffers on the orphan list.
+ * \param first The first buffer of the list.
+ * \param last The last buffer of the list.
+ */
+static void HT_epoch_push_orphans(HT_retired* const first, HT_retired* const last){
+    last->_next = __atomic_load_n(&HT_epoch_orphans, __ATOMIC_RELAXED);
+    while( !__atomic_compare_exchange_n(&HT_epoch_orphans, &last->_next, first, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED) )
+        ;
+}
+
+/**
+ * \brief Destroy the buffers of a list retired two epochs ago or more.
+ * \param link The head of the list.
+ * \param epoch The global epoch.
+ * \param spare The record keeping the freed bookkeeping for later, NULL to free it.
+ * \return The number of buffers destroyed.
+ */
+static unsigned int HT_epoch_reclaim_list(HT_retired** link, const unsigned long epoch, HT_epoch_record* const spare){
+    HT_retired *retired;
+    unsigned int nb_reclaimed = 0;
+    while( (retired = *link) != NULL ){
+        if( retired->_epoch + 2 <= epoch ){
+            *link = retired->_next;
+            retired->_destroy(retired->_context, retired->_buffer);
+            if( spare != NULL && spare->_nb_spare < HT_EPOCH_RECLAIM_THRESHOLD ){
+                retired->_next = spare->_spare;
+                spare->_spare = retired;
+                ++spare->_nb_spare;
+            }
+            else
+                free(retired);
+            ++nb_reclaimed;
+        }
+        else
+            link = &retired->_next;
+    }
+    return nb_reclaimed;
+}
+
+/**
+ * \brief Destroy the orphaned buffers retired two epochs ago or more.
+ * \param epoch The global epoch.
+ * \note The list is taken as a whole, the buffers still in their grace
+ * period are pushed back.
+ */
+static void HT_epoch_reclaim_orphans(const unsigned long epoch){
+    HT_retired *orphans,
+               *last;
+
+    if( __atomic_load_n(&HT_epoch_orphans, __ATOMIC_RELAXED) == NULL )
+        return;
+    orphans = __atomic_exchange_n(&HT_epoch_orphans, (HT_retired*) NULL, __ATOMIC_ACQUIRE);
+    HT_epoch_reclaim_list(&orphans, epoch, NULL);
+    if( orphans != NULL ){
+        for(last = orphans; last->_next != NULL; last = last->_next)
+            ;
+        HT_epoch_push_orphans(orphans, last);
+    }
+}
+
+/**
+ * \brief Destroy the buffers of a record retired two epochs ago or more.
+ * \param record The record of the current thread.
+ * \param epoch The global epoch.
+ */
+static void HT_epoch_reclaim(HT_epoch_record* const record, const unsigned long epoch){
+    record->_nb_retired -= HT_epoch_reclaim_list(&record->_retired, epoch, record);
+    HT_epoch_reclaim_orphans(epoch);
+}
+
+/**
+ * \brief Give the record of an exiting thread back.
+ * \param record The record.
+ * \note The buffers still in their grace period are orphaned, the next
+ * reclamation of any thread destroys them.
+ */
+static void HT_epoch_release_record(void* record){
+    HT_epoch_record *r = record;
+    HT_retired *retired,
+               *next;
+
+    __atomic_store_n(&r->_epoch, 0, __ATOMIC_RELEASE);
+    r->_nesting = 0;
+    if( r->_retired != NULL )
+        HT_epoch_reclaim(r, HT_epoch_try_advance());
+    if( r->_retired != NULL ){
+        for(retired = r->_retired; retired->_next != NULL; retired = retired->_next)
+            ;
+        HT_epoch_push_orphans(r->_retired, retired);
+        r->_retired = NULL;
+        r->_nb_retired = 0;
+    }
+    for(retired = r->_spare; retired != NULL; retired = next){
+        next = retired->_next;
+        free(retired);
+    }
+    r->_spare = NULL;
+    r->_nb_spare = 0;
+    __atomic_store_n(&r->_in_use, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Create the thread exit key.
+ */
+static void HT_epoch_create_key(void){
+    pthread_key_create(&HT_epoch_key, HT_epoch_release_record);
+}
+
+/**
+ * \brief Get the record of the current thread, creating it if needed.
+ * \return The record, NULL on allocation failure.
+ */
+static HT_epoch_record* HT_epoch_get_record(void){
+    HT_epoch_record *record;
+    int expected;
+
+    if( HT_epoch_self != NULL )
+        return HT_epoch_self;
+
+    pthread_once(&HT_epoch_key_once, HT_epoch_create_key);
+    for(record = __atomic_load_n(&HT_epoch_records, __ATOMIC_ACQUIRE); record != NULL; record = record->_next){
+        expected = 0;
+        if( __atomic_compare_exchange_n(&record->_in_use, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) )
+            break;
+    }
+    if( record == NULL ){
+        void *buffer;
+        if( posix_memalign(&buffer, HT_EPOCH_RECORD_ALIGNMENT, sizeof(HT_epoch_record)) != 0 )
+            return NULL;
+        record = buffer;
+        memset(record, 0, sizeof(HT_epoch_record));
+        record->_in_use = 1;
+        record->_next = __atomic_load_n(&HT_epoch_records, __ATOMIC_RELAXED);
+        while( !__atomic_compare_exchange_n(&HT_epoch_records, &record->_next, record, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED) )
+            ;
+    }
+    pthread_setspecific(HT_epoch_key, record);
+    HT_epoch_self = record;
+    return record;
+}
+
+int HT_epoch_reserve(const unsigned int nb_buffers){
+    HT_epoch_record *record = HT_epoch_get_record();
+    HT_retired *retired;
+
+    if( record == NULL ){
+        errno = ENOMEM;
+        return 1;
+    }
+    while( record->_nb_spare < nb_buffers ){
+        retired = malloc(sizeof(HT_retired));
+        if( retired == NULL )
+            return 1;
+        retired->_next = record->_spare;
+        record->_spare = retired;
+        ++record->_nb_spare;
+    }
+    return 0;
+}
+
+int HT_epoch_enter(void){
+    HT_epoch_record *record = HT_epoch_get_record();
+    if( record == NULL ){
+        errno = ENOMEM;
+        return 1;
+    }
+    // The announcement must be visible before any shared pointer is read
+    if( record->_nesting++ == 0 )
+        __atomic_store_n(&record->_epoch, __atomic_load_n(&HT_epoch_global, __ATOMIC_RELAXED), __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+void HT_epoch_exit(void){
+    HT_epoch_record *record = HT_epoch_self;
+    if( --record->_nesting == 0 )
+        __atomic_store_n(&record->_epoch, 0, __ATOMIC_RELEASE);
+}
+
+void HT_epoch_retire(void* buffer, void (*destroy)(void* context, void* buffer), void* context){
+    HT_epoch_record *record = HT_epoch_get_record();
+    HT_retired *retired = NULL;
+
+    if( record != NULL ){
+        if( record->_spare != NULL ){
+            retired = record->_spare;
+            record->_spare = retired->_next;
+            --record->_nb_spare;
+        }
+        else
+            retired = malloc(sizeof(HT_retired));
+    }
+    if( retired == NULL ){
+        // Inside of a section the wait would never end, the buffer is then
+        // leaked rather than destroyed under a reader
+        if( record == NULL || record->_nesting == 0 ){
+            HT_epoch_synchronize();
+            destroy(context, buffer);
+        }
+        return;
+    }
+    retired->_buffer = buffer;
+    retired->_destroy = destroy;
+    retired->_context = context;
+    // The unlinking of the buffer must be visible before the epoch is read,
+    // a fence keeps the cache line of the global epoch shared with the readers
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    retired->_epoch = __atomic_load_n(&HT_epoch_global, __ATOMIC_SEQ_CST);
+    retired->_next = record->_retired;
+    record->_retired = retired;
+    if( ++record->_nb_retired >= HT_EPOCH_RECLAIM_THRESHOLD )
+        HT_epoch_reclaim(record, HT_epoch_try_advance());
+}
+
+void HT_epoch_synchronize(void){
+    HT_epoch_record *record = HT_epoch_get_record();
+    unsigned long target = __atomic_load_n(&HT_epoch_global, __ATOMIC_SEQ_CST) + 2;
+    while( HT_epoch_try_advance() < target )
+        sched_yield();
+    if( record != NULL )
+        HT_epoch_reclaim(record, target);
+}
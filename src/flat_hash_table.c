@@ -0,0 +1,439 @@
+/**
+ * \file flat_hash_table.c
+ * \brief Open addressing hash table implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <limits.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "flat_hash_table.h"
+
+/**
+ * \brief Control byte of an entry that was never used.
+ */
+#define HT_FLAT_EMPTY ((unsigned char) 0x80)
+
+/**
+ * \brief Control byte of an entry that was removed.
+ */
+#define HT_FLAT_DELETED ((unsigned char) 0xFE)
+
+/**
+ * \brief The alignment of a value, stored after its key in the same buffer.
+ */
+#define HT_FLAT_VALUE_ALIGNMENT 8
+
+/**
+ * \brief Point the containers of an entry to its inlined key and value.
+ * \param entry The entry, once filled or moved.
+ */
+static inline void HT_flat_link_inline(HT_flat_entry* const entry){
+    if( entry->_key._size_buffer <= HT_INLINE_KEY_SIZE )
+        entry->_key._buffer = entry->_data;
+    if( entry->_value._size_buffer <= HT_INLINE_VALUE_SIZE )
+        entry->_value._buffer = &entry->_data[HT_FLAT_INLINE_VALUE_OFFSET];
+}
+
+/**
+ * \brief Get the heap buffer of an entry.
+ * \param entry The entry.
+ * \return The buffer holding the key or the value that is not inlined, NULL if both are.
+ */
+static inline void* HT_flat_heap_buffer(const HT_flat_entry* const entry){
+    if( entry->_key._size_buffer > HT_INLINE_KEY_SIZE )
+        return entry->_key._buffer;
+    if( entry->_value._size_buffer > HT_INLINE_VALUE_SIZE )
+        return entry->_value._buffer;
+    return NULL;
+}
+
+/**
+ * \brief Get the 7 bits of the hash stored in the control byte.
+ * \param hash The hash of the key.
+ * \note The bits come from the same multiplication as ::HT_hash_fold, below
+ * the 32 bits the group is taken from, so a weak hash function still spreads
+ * them.
+ */
+static inline unsigned char HT_flat_h2(const uint64_t hash){
+    return (unsigned char) ((hash * UINT64_C(0x9E3779B97F4A7C15)) >> 25) & 0x7F;
+}
+
+/**
+ * \brief Get the first group of the probe sequence of a hash.
+ * \param ft A pointer to the table.
+ * \param hash The hash of the key.
+ */
+static inline unsigned int HT_flat_group(const HT_flat_table* const ft, const uint64_t hash){
+    return HT_hash_fold(hash, (unsigned int) __builtin_ctz(ft->_nb_groups));
+}
+
+/**
+ * \brief Get a bit mask of the bytes of the group equal to byte.
+ * \param group The first control byte of the group.
+ * \param byte The control byte to look for.
+ * \return The bit i is set if the control byte i of the group matches.
+ */
+static inline unsigned int HT_flat_match(const unsigned char* const group, const unsigned char byte){
+#ifdef __SSE2__
+    __m128i control = _mm_loadu_si128((const __m128i*) group);
+    return (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(control, _mm_set1_epi8((char) byte)));
+#else
+    unsigned int i,
+                 mask = 0;
+    for(i = 0; i < HT_FLAT_GROUP_SIZE; ++i)
+        mask |= (unsigned int) (group[i] == byte) << i;
+    return mask;
+#endif
+}
+
+/**
+ * \brief Get a bit mask of the empty or deleted bytes of the group.
+ * \param group The first control byte of the group.
+ * \return The bit i is set if the entry i of the group is free.
+ */
+static inline unsigned int HT_flat_match_free(const unsigned char* const group){
+#ifdef __SSE2__
+    return (unsigned int) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+#else
+    unsigned int i,
+                 mask = 0;
+    for(i = 0; i < HT_FLAT_GROUP_SIZE; ++i)
+        mask |= (unsigned int) (group[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+/**
+ * \brief Get the number of entries that can be used before a rehash.
+ * \param nb_groups The number of groups of the table.
+ */
+static inline size_t HT_flat_capacity(const unsigned int nb_groups){
+    return (size_t) nb_groups * HT_FLAT_GROUP_SIZE / 8 * 7;
+}
+
+/**
+ * \brief Allocate empty control bytes and entries.
+ * \param ft A pointer to the table.
+ * \param nb_groups The number of groups, a power of two.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+static int HT_flat_allocate(HT_flat_table* const ft, const unsigned int nb_groups){
+    size_t nb_entries = (size_t) nb_groups * HT_FLAT_GROUP_SIZE;
+    ft->_control = malloc(nb_entries);
+    if( ft->_control == NULL )
+        return 1;
+    ft->_entries = malloc(nb_entries * sizeof(HT_flat_entry));
+    if( ft->_entries == NULL ){
+        int errno_temp = errno;
+        free(ft->_control);
+        errno = errno_temp;
+        return 1;
+    }
+    memset(ft->_control, HT_FLAT_EMPTY, nb_entries);
+    ft->_nb_groups = nb_groups;
+    ft->_growth_left = HT_flat_capacity(nb_groups) - ft->_nb_elements;
+    return 0;
+}
+
+/**
+ * \brief Get the number of groups needed to hold size entries.
+ * \param size The number of entries.
+ * \return A power of two, or 0 if it cannot be represented.
+ */
+static unsigned int HT_flat_nb_groups_for(const size_t size){
+    unsigned int nb_groups = 1;
+    while( HT_flat_capacity(nb_groups) < size ){
+        if( nb_groups > UINT_MAX / 2 )
+            return 0;
+        nb_groups *= 2;
+    }
+    return nb_groups;
+}
+
+/**
+ * \brief Find the first free entry on the probe sequence of a hash.
+ * \param ft A pointer to the table.
+ * \param hash The hash of the key.
+ * \return The index of the entry.
+ */
+static size_t HT_flat_find_free(const HT_flat_table* const ft, const uint64_t hash){
+    unsigned int group = HT_flat_group(ft, hash),
+                 step = 0,
+                 mask;
+    for(;;){
+        mask = HT_flat_match_free(&ft->_control[(size_t) group * HT_FLAT_GROUP_SIZE]);
+        if( mask != 0 )
+            return (size_t) group * HT_FLAT_GROUP_SIZE + (size_t) __builtin_ctz(mask);
+        group = (group + ++step) & (ft->_nb_groups - 1);
+    }
+}
+
+/**
+ * \brief Move every entry to new arrays, dropping the deleted markers.
+ * \param ft A pointer to the table.
+ * \param nb_groups The new number of groups.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+static int HT_flat_rehash(HT_flat_table* const ft, const unsigned int nb_groups){
+    unsigned char *old_control = ft->_control;
+    HT_flat_entry *old_entries = ft->_entries;
+    size_t old_nb_entries = (size_t) ft->_nb_groups * HT_FLAT_GROUP_SIZE,
+           i,
+           index;
+
+    if( HT_flat_allocate(ft, nb_groups) != 0 ){
+        ft->_control = old_control;
+        ft->_entries = old_entries;
+        return 1;
+    }
+    for(i = 0; i < old_nb_entries; ++i){
+        if( old_control[i] < HT_FLAT_EMPTY ){
+            index = HT_flat_find_free(ft, old_entries[i]._hash);
+            ft->_control[index] = old_control[i];
+            ft->_entries[index] = old_entries[i];
+            HT_flat_link_inline(&ft->_entries[index]);
+        }
+    }
+    free(old_control);
+    free(old_entries);
+    return 0;
+}
+
+/**
+ * \brief Search the entry holding a key.
+ * \param ft A pointer to the table.
+ * \param key The key.
+ * \param key_size The size of the key.
+ * \param hash The hash of the key.
+ * \param first_free If not NULL, set to the first free entry of the probe sequence.
+ * \return The index of the entry or SIZE_MAX if the key is absent.
+ */
+static size_t HT_flat_find(const HT_flat_table* const ft, const void* const key, const size_t key_size, const uint64_t hash, size_t* const first_free){
+    const unsigned char h2 = HT_flat_h2(hash);
+    const unsigned char *control;
+    const HT_flat_entry *entry;
+    unsigned int group = HT_flat_group(ft, hash),
+                 step = 0,
+                 mask;
+    size_t index;
+
+    if( first_free != NULL )
+        *first_free = SIZE_MAX;
+    for(;;){
+        control = &ft->_control[(size_t) group * HT_FLAT_GROUP_SIZE];
+        for(mask = HT_flat_match(control, h2); mask != 0; mask &= mask - 1){
+            index = (size_t) group * HT_FLAT_GROUP_SIZE + (size_t) __builtin_ctz(mask);
+            entry = &ft->_entries[index];
+            if( entry->_hash == hash && entry->_key._size_buffer == key_size &&
+                    memcmp(entry->_key._buffer, key, key_size) == 0 )
+                return index;
+        }
+        mask = HT_flat_match_free(control);
+        if( first_free != NULL && *first_free == SIZE_MAX && mask != 0 )
+            *first_free = (size_t) group * HT_FLAT_GROUP_SIZE + (size_t) __builtin_ctz(mask);
+        if( HT_flat_match(control, HT_FLAT_EMPTY) != 0 )
+            return SIZE_MAX;
+        group = (group + ++step) & (ft->_nb_groups - 1);
+    }
+}
+
+HT_flat_table* HT_flat_new_hash(const unsigned int size, HT_hash_function hash_function){
+    HT_flat_table* ftable;
+    int retval;
+    if( size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return NULL;
+    }
+    ftable = malloc(sizeof(HT_flat_table));
+    if( ftable == NULL )
+        return NULL;
+    retval = HT_flat_init(ftable, size, hash_function);
+    if( retval != 0 ){
+        int errno_temp = errno;
+        free( ftable );
+        errno = errno_temp;
+        return NULL;
+    }
+    return ftable;
+}
+
+int HT_flat_init(HT_flat_table* const ft, const unsigned int size, HT_hash_function hash_function){
+    unsigned int nb_groups;
+    if( ft == NULL || size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    nb_groups = HT_flat_nb_groups_for(size);
+    if( nb_groups == 0 ){
+        errno = EINVAL;
+        return 1;
+    }
+    ft->_nb_elements = 0;
+    if( HT_flat_allocate(ft, nb_groups) != 0 )
+        return 1;
+    ft->hash_function = hash_function;
+    return 0;
+}
+
+int HT_flat_get_element(const HT_flat_table* ft, const void* key, const size_t key_size, void** value, size_t* value_size){
+    size_t index;
+    if( ft == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    index = HT_flat_find(ft, key, key_size, ft->hash_function(key, key_size), NULL);
+    if( index == SIZE_MAX )
+        return 1;
+    if( value != NULL && value_size != NULL ){
+        *value = ft->_entries[index]._value._buffer;
+        *value_size = ft->_entries[index]._value._size_buffer;
+    }
+    return 0;
+}
+
+int HT_flat_add_element(HT_flat_table* const ft, const void* const key, const size_t key_size, const void* const value, const size_t value_size){
+    HT_flat_entry *entry;
+    unsigned char *buffer = NULL;
+    uint64_t hash;
+    unsigned int nb_groups;
+    size_t index,
+           key_room = 0,
+           value_room = 0;
+    if( ft == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = ft->hash_function(key, key_size);
+    if( HT_flat_find(ft, key, key_size, hash, &index) != SIZE_MAX )
+        return 1;
+    if( ft->_growth_left == 0 && ft->_control[index] == HT_FLAT_EMPTY ){
+        // Rehash in place when most of the used entries are deleted markers
+        if( ft->_nb_elements < HT_flat_capacity(ft->_nb_groups) / 2 )
+            nb_groups = ft->_nb_groups;
+        else if( ft->_nb_groups <= UINT_MAX / 2 )
+            nb_groups = ft->_nb_groups * 2;
+        else{
+            errno = ENOMEM;
+            return 2;
+        }
+        if( HT_flat_rehash(ft, nb_groups) != 0 )
+            return 2;
+        index = HT_flat_find_free(ft, hash);
+    }
+
+    // A key or a value too large to be inlined goes to one shared buffer, the value stays aligned
+    if( key_size > HT_INLINE_KEY_SIZE )
+        key_room = (key_size + HT_FLAT_VALUE_ALIGNMENT - 1) & ~(size_t) (HT_FLAT_VALUE_ALIGNMENT - 1);
+    if( value_size > HT_INLINE_VALUE_SIZE )
+        value_room = value_size;
+    if( (key_room != 0 && key_room < key_size) || value_room > SIZE_MAX - key_room ){
+        errno = ENOMEM;
+        return 2;
+    }
+    if( key_room + value_room != 0 ){
+        buffer = malloc(key_room + value_room);
+        if( buffer == NULL )
+            return 2;
+    }
+    entry = &ft->_entries[index];
+    entry->_key._buffer = buffer;
+    entry->_key._size_buffer = key_size;
+    entry->_value._buffer = value_room != 0 ? buffer + key_room : NULL;
+    entry->_value._size_buffer = value_size;
+    HT_flat_link_inline(entry);
+    memcpy(entry->_key._buffer, key, key_size);
+    memcpy(entry->_value._buffer, value, value_size);
+    entry->_hash = hash;
+
+    if( ft->_control[index] == HT_FLAT_EMPTY )
+        --ft->_growth_left;
+    ft->_control[index] = HT_flat_h2(hash);
+    ++ft->_nb_elements;
+    return 0;
+}
+
+int HT_flat_remove_element(HT_flat_table* ft, const void* key, const size_t key_size){
+    HT_flat_entry *entry;
+    size_t index,
+           group_start;
+    if( ft == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    index = HT_flat_find(ft, key, key_size, ft->hash_function(key, key_size), NULL);
+    if( index == SIZE_MAX )
+        return 1;
+
+    entry = &ft->_entries[index];
+    free(HT_flat_heap_buffer(entry));
+
+    // A probe sequence stops at a group holding an empty entry, so the entry
+    // can be marked empty again if its group already stops every probe.
+    group_start = index - index % HT_FLAT_GROUP_SIZE;
+    if( HT_flat_match(&ft->_control[group_start], HT_FLAT_EMPTY) != 0 ){
+        ft->_control[index] = HT_FLAT_EMPTY;
+        ++ft->_growth_left;
+    }
+    else
+        ft->_control[index] = HT_FLAT_DELETED;
+    --ft->_nb_elements;
+    return 0;
+}
+
+void HT_flat_delete_pointer(HT_flat_table* ft){
+    HT_flat_delete(ft);
+    free(ft);
+}
+
+void HT_flat_delete(HT_flat_table* const ft){
+    if( ft != NULL && ft->_nb_groups != 0 ){
+        HT_flat_reset_table(ft);
+        free(ft->_control);
+        free(ft->_entries);
+        ft->_nb_groups = 0;
+    }
+}
+
+void HT_flat_reset_table(HT_flat_table* ft){
+    size_t i,
+           nb_entries;
+    if( ft != NULL && ft->_nb_groups != 0 ){
+        nb_entries = (size_t) ft->_nb_groups * HT_FLAT_GROUP_SIZE;
+        for(i = 0; i < nb_entries; ++i){
+            if( ft->_control[i] < HT_FLAT_EMPTY )
+                free(HT_flat_heap_buffer(&ft->_entries[i]));
+        }
+        memset(ft->_control, HT_FLAT_EMPTY, nb_entries);
+        ft->_nb_elements = 0;
+        ft->_growth_left = HT_flat_capacity(ft->_nb_groups);
+    }
+}
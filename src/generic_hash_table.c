@@ -25,17 +25,64 @@
    If not, see <http://www.gnu.org/licenses/>.
    */
 
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#if defined(__linux__) && defined(__GLIBC__) && \
+    ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 25 ) )
+#include <sys/random.h>
+#define HT_HAVE_GETRANDOM
+#endif
+
 #include "generic_hash_table.h"
+#include "generic_hash_table_internal.h"
+#include "robin_hood_hash_table.h"
+#include "arena_allocator.h"
+#include "hash_functions.h"
+
+/**
+ * \brief Allocate memory with the standard allocator.
+ * \param context Unused.
+ * \param size The size in bytes.
+ */
+static void* HT_malloc(void* context, size_t size){
+    (void) context;
+    return malloc(size);
+}
+
+/**
+ * \brief Release memory with the standard allocator.
+ * \param context Unused.
+ * \param buffer The memory to release.
+ */
+static void HT_free(void* context, void* buffer){
+    (void) context;
+    free(buffer);
+}
+
+const HT_allocator HT_default_allocator = { HT_malloc, HT_free, NULL, NULL };
+
+/**
+ * \brief Release memory given by an allocator.
+ * \param allocator The allocator.
+ * \param buffer The memory to release.
+ */
+static inline void HT_release(const HT_allocator* const allocator, void* buffer){
+    if( allocator->release != NULL )
+        allocator->release(allocator->context, buffer);
+}
 
 /**
  * \brief Add a value into a container.
+ * \param allocator The allocator providing the memory.
  * \param container A pointer to an already allocated container where to copy the buffer.
  * \param buf A pointer to the buffer to copy into the container.
  * \param buff_size The size of the buffer in bytes.
  * \retval 0 On success.
  * \retval 1 On failure and errno is set appropriately.
  */
-static inline int HT_add_to_container(HT_container* const container, const void* const buf, const size_t buff_size){
+static inline int HT_add_to_container(const HT_allocator* const allocator, HT_container* const container, const void* const buf, const size_t buff_size){
 
 #ifdef HT__DEBUG    // Since this is internal to the API, error like this is not likely to happened.
     if( buff_size == 0 ){
@@ -48,7 +95,7 @@ static inline int HT_add_to_container(HT_container* const container, const void*
     }
 #endif
 
-    container->_buffer = malloc(buff_size);
+    container->_buffer = allocator->allocate(allocator->context, buff_size);
     if( container->_buffer == NULL )
         return 1;
     container->_size_buffer = buff_size;
@@ -58,30 +105,129 @@ static inline int HT_add_to_container(HT_container* const container, const void*
 
 /**
  * \brief Destroys the content of a container and set it's size to zero.
+ * \param allocator The allocator that provided the memory.
  * \param container A pointer to a container.
  */
-static inline void HT_destroy_container(HT_container* container){
+static inline void HT_destroy_container(const HT_allocator* const allocator, HT_container* container){
     if( container->_size_buffer != 0){
-        free(container->_buffer);
+        HT_release(allocator, container->_buffer);
         container->_size_buffer = 0;
     }
 }
 
 /**
- * \brief Destroy a pair
- * \param p The pair to destroy.
+ * \brief Get the room used by an inlined key in a pair.
+ * \param key_size The size of the key in bytes.
+ * \return The key size rounded up to keep the value aligned, 0 if the key is not inlined.
+ */
+static inline size_t HT_inline_key_room(const size_t key_size){
+    if( key_size > HT_INLINE_KEY_SIZE )
+        return 0;
+    return (key_size + HT_INLINE_ALIGNMENT - 1) / HT_INLINE_ALIGNMENT * HT_INLINE_ALIGNMENT;
+}
+
+/**
+ * \brief The header of a block of pairs created by a bulk build.
+ */
+typedef struct{
+    size_t _nb_pairs;           /**<- The number of pairs of the block not destroyed yet. */
+} HT_pair_block;
+
+/**
+ * \brief The offset of the key of a pair living in a block, the block address comes first.
+ */
+#define HT_BLOCK_KEY_OFFSET HT_INLINE_ALIGNMENT
+
+/**
+ * \brief Test if a pair was allocated inside of a block by a bulk build.
+ * \param p The pair.
+ * \note The key of any other pair is either at the start of _data or outside of the pair.
+ */
+static inline int HT_pair_in_block(const HT_pair* p){
+    return p->_key._buffer == (const void*) &p->_data[HT_BLOCK_KEY_OFFSET];
+}
+
+/**
+ * \brief Test if the key of a pair is stored inside of the pair.
+ * \param p The pair.
+ */
+static inline int HT_pair_key_is_inline(const HT_pair* p){
+    return p->_key._buffer == (const void*) p->_data;
+}
+
+/**
+ * \brief The size of the word holding the ::HT_add_element_mode flags of a pair.
+ *
+ * A pair whose key or value is not inlined has the word in _data, right
+ * after the inlined key, or first if the key is not inlined either. The
+ * inlined value of such a pair comes after the word.
+ */
+#define HT_MODE_WORD_SIZE HT_INLINE_ALIGNMENT
+
+/**
+ * \brief Test if the value of a pair is stored inside of the pair.
+ * \param p The pair.
+ */
+static inline int HT_pair_value_is_inline(const HT_pair* p){
+    size_t offset = HT_pair_key_is_inline(p) ? HT_inline_key_room(p->_key._size_buffer) : HT_MODE_WORD_SIZE;
+    return p->_value._buffer == (const void*) &p->_data[offset];
+}
+
+/**
+ * \brief Get the ::HT_add_element_mode flags of a pair.
+ * \param p The pair.
  */
-static inline void HT_destroy_pair(HT_pair* p){
-    HT_destroy_container(&p->_key);
-    HT_destroy_container(&p->_value);
-    free(p);
+static inline unsigned int HT_pair_mode(const HT_pair* p){
+    uint64_t mode;
+    size_t offset = 0;
+    if( HT_pair_in_block(p) )
+        return HT_MODE_COPY;
+    if( HT_pair_key_is_inline(p) ){
+        if( HT_pair_value_is_inline(p) )
+            return HT_MODE_COPY;
+        offset = HT_inline_key_room(p->_key._size_buffer);
+    }
+    memcpy(&mode, &p->_data[offset], sizeof(mode));
+    return (unsigned int) mode;
 }
 
 /**
- * \brief Delete the content of a slot.
- * \param slot A pointer to the slot to reset.
+ * \brief Release a container of a pair that is not inlined.
+ * \param allocator The allocator that provided the memory.
+ * \param free_function The function releasing the taken buffers, NULL for free.
+ * \param container The container.
+ * \param mode The flags of the pair.
+ * \param take The flag telling that the buffer is taken.
+ * \param borrow The flag telling that the buffer is borrowed.
  */
-static inline void HT_destroy_slot_content(HT_slot* slot){
+static inline void HT_release_container(const HT_allocator* const allocator, HT_free_function free_function, HT_container* const container, const unsigned int mode, const unsigned int take, const unsigned int borrow){
+    if( mode & borrow )
+        return;
+    if( mode & take )
+        (free_function != NULL ? free_function : free)(container->_buffer);
+    else
+        HT_destroy_container(allocator, container);
+}
+
+void HT_destroy_pair(const HT_allocator* const allocator, HT_free_function free_function, HT_pair* p){
+    unsigned int mode;
+    if( HT_pair_in_block(p) ){ // The block goes away with its last pair
+        HT_pair_block *block;
+        memcpy(&block, p->_data, sizeof(block));
+        // Atomic since the pairs of a block span the slot ranges of a parallel reset
+        if( __atomic_sub_fetch(&block->_nb_pairs, 1, __ATOMIC_ACQ_REL) == 0 )
+            HT_release(allocator, block);
+        return;
+    }
+    mode = HT_pair_mode(p);
+    if( !HT_pair_value_is_inline(p) )
+        HT_release_container(allocator, free_function, &p->_value, mode, HT_MODE_TAKE_VALUE, HT_MODE_BORROW_VALUE);
+    if( !HT_pair_key_is_inline(p) )
+        HT_release_container(allocator, free_function, &p->_key, mode, HT_MODE_TAKE_KEY, HT_MODE_BORROW_KEY);
+    HT_release(allocator, p);
+}
+
+void HT_destroy_slot_content(const HT_allocator* const allocator, HT_free_function free_function, HT_slot* slot){
     if(slot->_first_pair != NULL){
         HT_pair *next,
                 *current;
@@ -89,35 +235,152 @@ static inline void HT_destroy_slot_content(HT_slot* slot){
 
         do{
             next = current->_next;
-            HT_destroy_pair(current);
+            HT_destroy_pair(allocator, free_function, current);
             current = next;
         }
         while(current != NULL);
+        slot->_first_pair = NULL;
+        slot->_last_pair = NULL;
     }
 }
 
 /**
- * \brief Return the slot corresponding to the hash function applied to key.
+ * \brief Return the slot corresponding to the hash of a key.
  * \param ht A pointer to the hash table.
- * \param key A pointer to the key to process.
- * \param key_size The size of the key in bytes.
+ * \param hash The value returned by the hash function for the key.
  * \return A pointer to the slot related to the key.
  */
-static inline HT_slot* HT_get_slot_from_key(const HT_hash_table* const ht, const void* const key, const size_t key_size){
+static inline HT_slot* HT_get_slot_from_hash(const HT_hash_table* const ht, const uint64_t hash){
 #ifdef HT__DEBUG
-    if( ht == NULL || key == NULL ){
-        fprintf(stderr, "Null pointer inside of HT_get_slot_from_key\n");
+    if( ht == NULL ){
+        fprintf(stderr, "Null pointer inside of HT_get_slot_from_hash\n");
         exit(1);
     }
 #endif
-    unsigned int key_val;
-    HT_slot *slot;
-    key_val = ht->hash_function(key, key_size);
-    slot = &ht->_slots[key_val % ht->_nb_slots];
-    return slot;
+    unsigned int index;
+    index = HT_hash_fold(hash, ht->_slot_bits);
+    if( ht->_new_slots != NULL && index < ht->_rehash_index )
+        return &ht->_new_slots[HT_hash_fold(hash, ht->_new_slot_bits)];
+    return &ht->_slots[index];
+}
+
+/**
+ * \brief Hash a key like the pairs of the slots not migrated yet by a reseed.
+ * \param ht A pointer to the hash table being reseeded.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ */
+static inline uint64_t HT_old_hash(const HT_hash_table* const ht, const void* const key, const size_t key_size){
+    HT_COUNT(hashes, 1);
+    if( ht->_old_seeded_hash_function != NULL )
+        return ht->_old_seeded_hash_function(key, key_size, ht->_old_seed);
+    return ht->hash_function(key, key_size);
+}
+
+/**
+ * \brief Return the slot of a key, during a reseed too.
+ * \param ht A pointer to the hash table.
+ * \param hash A pointer to the hash of the key, set to the hash the pairs of the slot are compared with.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \return A pointer to the slot related to the key.
+ * \note During a reseed the hash is given by the new seed. The slots not
+ * migrated yet are found, and their pairs compared, with the old one.
+ */
+static inline HT_slot* HT_get_slot_from_key(const HT_hash_table* const ht, uint64_t* const hash, const void* const key, const size_t key_size){
+    uint64_t old_hash;
+    unsigned int index;
+    if( !ht->_reseeding )
+        return HT_get_slot_from_hash(ht, *hash);
+    old_hash = HT_old_hash(ht, key, key_size);
+    index = HT_hash_fold(old_hash, ht->_slot_bits);
+    if( index < ht->_rehash_index )
+        return &ht->_new_slots[HT_hash_fold(*hash, ht->_new_slot_bits)];
+    *hash = old_hash;
+    return &ht->_slots[index];
+}
+
+/**
+ * \brief Move the content of an old slot at the end of the new slots.
+ * \param ht A pointer to the hash table being resized or reseeded.
+ * \param slot The slot of _slots to empty.
+ * \note Pairs are appended in chain order, duplicate keys keep their ordering.
+ */
+static void HT_migrate_slot(HT_hash_table* const ht, HT_slot* const slot){
+    HT_pair *current,
+            *next;
+
+    for(current = slot->_first_pair; current != NULL; current = next){
+        next = current->_next;
+        if( ht->_reseeding )
+            current->_hash = HT_hash_key(ht, current->_key._buffer, current->_key._size_buffer);
+        HT_slot_append_pair(&ht->_new_slots[HT_hash_fold(current->_hash, ht->_new_slot_bits)], current);
+    }
+    slot->_first_pair = NULL;
+    slot->_last_pair = NULL;
+}
+
+/**
+ * \brief Migrate some slots of a resize in progress.
+ * \param ht A pointer to the hash table.
+ * \param nb_slots The maximum number of slots to migrate.
+ */
+static void HT_rehash_step(HT_hash_table* const ht, unsigned int nb_slots){
+    if( ht->_new_slots == NULL )
+        return;
+    while( nb_slots-- != 0 && ht->_rehash_index < ht->_nb_slots ){
+        HT_migrate_slot(ht, &ht->_slots[ht->_rehash_index]);
+        ++ht->_rehash_index;
+    }
+    if( ht->_rehash_index == ht->_nb_slots ){
+        free(ht->_slots);
+        ht->_slots = ht->_new_slots;
+        ht->_nb_slots = ht->_nb_new_slots;
+        ht->_slot_bits = ht->_new_slot_bits;
+        ht->_new_slots = NULL;
+        ht->_nb_new_slots = 0;
+        ht->_rehash_index = 0;
+        ht->_reseeding = 0;
+    }
+}
+
+/**
+ * \brief Start a resize if the load factor crossed one of the thresholds.
+ * \param ht A pointer to the hash table.
+ * \note A failed allocation is not an error, the table keeps its current size.
+ */
+static void HT_check_load_factor(HT_hash_table* const ht){
+    double load;
+    if( ht->_new_slots != NULL )
+        return;
+    load = (double) ht->_nb_elements / (double) ht->_nb_slots;
+    if( ht->_max_load_factor > 0.0f && load > (double) ht->_max_load_factor ){
+        if( ht->_nb_slots < HT_MAX_SLOTS )
+            HT_resize(ht, ht->_nb_slots * 2);
+    }
+    else if( ht->_min_load_factor > 0.0f && load < (double) ht->_min_load_factor ){
+        if( ht->_nb_slots > 1 )
+            HT_resize(ht, ht->_nb_slots / 2);
+    }
+}
+
+void HT_rehash_slots(HT_hash_table* const ht, const unsigned int nb_slots){
+    HT_rehash_step(ht, nb_slots);
+}
+
+/**
+ * \brief Get the base 2 logarithm of the number of slots to use for a requested size.
+ * \param size The requested number of slots.
+ * \return The logarithm of the smallest power of two not below size.
+ */
+static inline unsigned int HT_slot_bits_for(const unsigned int size){
+    unsigned int bits = 0;
+    while( (1u << bits) < size )
+        ++bits;
+    return bits;
 }
 
-HT_hash_table* HT_new_hash(const unsigned int size, unsigned int (*hash_function)(const void* const key, const size_t key_size)){
+HT_hash_table* HT_new_hash(const unsigned int size, HT_hash_function hash_function){
     HT_hash_table* htable;
     int retval;
     if( size == 0 || hash_function == NULL ){
@@ -137,17 +400,200 @@ HT_hash_table* HT_new_hash(const unsigned int size, unsigned int (*hash_function
     return htable;
 }
 
-int HT_init(HT_hash_table* const ht, const unsigned int size, unsigned int (*hash_function)(const void* const key, const size_t key_size)){
-    if( ht == NULL || size == 0 || hash_function == NULL ){
+int HT_init(HT_hash_table* const ht, const unsigned int size, HT_hash_function hash_function){
+    return HT_init_allocator(ht, size, hash_function, NULL);
+}
+
+int HT_init_allocator(HT_hash_table* const ht, const unsigned int size, HT_hash_function hash_function, const HT_allocator* const allocator){
+    if( ht == NULL || size == 0 || size > HT_MAX_SLOTS || hash_function == NULL ||
+            ( allocator != NULL && allocator->allocate == NULL ) ){
         errno = EINVAL;
         return 1;
     }
-    ht->_slots = malloc( size * sizeof(HT_slot) );
+    ht->_slot_bits = HT_slot_bits_for(size);
+    ht->_nb_slots = 1u << ht->_slot_bits;
+    ht->_slots = malloc( ht->_nb_slots * sizeof(HT_slot) );
     if( ht->_slots == NULL )
         return 1;
-    ht->_nb_slots = size;
-    memset(ht->_slots, 0, size * sizeof(HT_slot));
+    memset(ht->_slots, 0, ht->_nb_slots * sizeof(HT_slot));
+    ht->_new_slots = NULL;
+    ht->_nb_new_slots = 0;
+    ht->_new_slot_bits = 0;
+    ht->_rehash_index = 0;
+    ht->_nb_elements = 0;
+    ht->_max_load_factor = HT_DEFAULT_MAX_LOAD_FACTOR;
+    ht->_min_load_factor = HT_DEFAULT_MIN_LOAD_FACTOR;
+    ht->_allocator = allocator != NULL ? *allocator : HT_default_allocator;
     ht->hash_function = hash_function;
+    ht->seeded_hash_function = NULL;
+    ht->_seed[0] = 0;
+    ht->_seed[1] = 0;
+    ht->_old_seeded_hash_function = NULL;
+    ht->_old_seed[0] = 0;
+    ht->_old_seed[1] = 0;
+    ht->_reseeding = 0;
+    ht->_reseed_threshold = 0;
+    ht->free_function = NULL;
+    ht->_has_taken = 0;
+    ht->_robin = NULL;
+    return 0;
+}
+
+int HT_set_free_function(HT_hash_table* const ht, HT_free_function free_function){
+    if( ht == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    ht->free_function = free_function;
+    return 0;
+}
+
+int HT_set_load_factors(HT_hash_table* const ht, float max_load_factor, float min_load_factor){
+    if( ht == NULL || max_load_factor < 0.0f || min_load_factor < 0.0f ||
+            ( max_load_factor > 0.0f && min_load_factor * 2.0f >= max_load_factor ) ){
+        errno = EINVAL;
+        return 1;
+    }
+    ht->_max_load_factor = max_load_factor;
+    ht->_min_load_factor = min_load_factor;
+    return 0;
+}
+
+int HT_resize(HT_hash_table* const ht, const unsigned int size){
+    HT_slot *new_slots;
+    unsigned int bits;
+    if( ht == NULL || size == 0 || size > HT_MAX_SLOTS || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    HT_rehash_step(ht, UINT_MAX);
+    bits = HT_slot_bits_for(size);
+    if( bits == ht->_slot_bits )
+        return 0;
+    new_slots = malloc( ((size_t) 1 << bits) * sizeof(HT_slot) );
+    if( new_slots == NULL )
+        return 1;
+    memset(new_slots, 0, ((size_t) 1 << bits) * sizeof(HT_slot));
+    ht->_new_slots = new_slots;
+    ht->_nb_new_slots = 1u << bits;
+    ht->_new_slot_bits = bits;
+    ht->_rehash_index = 0;
+    return 0;
+}
+
+int HT_random_seed(uint64_t seed[2]){
+    size_t done = 0;
+    ssize_t retval;
+    int fd;
+
+#ifdef HT_HAVE_GETRANDOM
+    while( done < 2 * sizeof(uint64_t) ){
+        retval = getrandom((unsigned char*) seed + done, 2 * sizeof(uint64_t) - done, 0);
+        if( retval < 0 ){
+            if( errno == EINTR )
+                continue;
+            if( errno != ENOSYS )
+                return 1;
+            break;
+        }
+        done += (size_t) retval;
+    }
+    if( done == 2 * sizeof(uint64_t) )
+        return 0;
+#endif
+    // Without getrandom, or with a kernel lacking it
+    fd = open("/dev/urandom", O_RDONLY);
+    if( fd < 0 )
+        return 1;
+    while( done < 2 * sizeof(uint64_t) ){
+        retval = read(fd, (unsigned char*) seed + done, 2 * sizeof(uint64_t) - done);
+        if( retval < 0 && errno == EINTR )
+            continue;
+        if( retval <= 0 ){
+            int errno_temp = retval == 0 ? EIO : errno;
+            close(fd);
+            errno = errno_temp;
+            return 1;
+        }
+        done += (size_t) retval;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * \brief Draw a new seed and start hashing every pair again.
+ * \param ht A pointer to the hash table.
+ * \param seeded_hash_function The seeded hash function to use from now on, NULL for the hash function of the table.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately, the table is unchanged.
+ * \pre No resize or reseed is in progress.
+ * \note Like a resize the pairs are moved to new slots incrementally, hashed
+ * with the new seed. Until then the old seed still finds the slots not
+ * migrated yet.
+ */
+static int HT_reseed(HT_hash_table* const ht, HT_seeded_hash_function seeded_hash_function){
+    HT_slot *new_slots = NULL;
+    uint64_t seed[2] = {0, 0};
+
+    if( seeded_hash_function != NULL && HT_random_seed(seed) != 0 )
+        return 1;
+    if( ht->_nb_elements != 0 ){
+        new_slots = malloc( ht->_nb_slots * sizeof(HT_slot) );
+        if( new_slots == NULL )
+            return 1;
+        memset(new_slots, 0, ht->_nb_slots * sizeof(HT_slot));
+    }
+
+    ht->_old_seeded_hash_function = ht->seeded_hash_function;
+    ht->_old_seed[0] = ht->_seed[0];
+    ht->_old_seed[1] = ht->_seed[1];
+    ht->seeded_hash_function = seeded_hash_function;
+    ht->_seed[0] = seed[0];
+    ht->_seed[1] = seed[1];
+    if( new_slots != NULL ){ // An empty table has nothing to migrate
+        ht->_new_slots = new_slots;
+        ht->_nb_new_slots = ht->_nb_slots;
+        ht->_new_slot_bits = ht->_slot_bits;
+        ht->_rehash_index = 0;
+        ht->_reseeding = 1;
+    }
+    return 0;
+}
+
+int HT_set_seeded_hash(HT_hash_table* const ht, HT_seeded_hash_function seeded_hash_function){
+    if( ht == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    if( ht->_robin != NULL ){
+        if( HT_robin_set_seeded_hash(ht->_robin, seeded_hash_function) != 0 )
+            return 1;
+        ht->seeded_hash_function = seeded_hash_function;
+        return 0;
+    }
+    HT_rehash_step(ht, UINT_MAX);
+    if( HT_reseed(ht, seeded_hash_function) != 0 )
+        return 1;
+    ht->_reseed_threshold = 0;
+    return 0;
+}
+
+int HT_set_robin_backend(HT_hash_table* const ht){
+    if( ht == NULL || ht->_nb_elements != 0 || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    ht->_robin = HT_robin_new_hash(ht->_nb_slots, ht->hash_function);
+    if( ht->_robin == NULL )
+        return 1;
+    if( ht->seeded_hash_function != NULL && HT_robin_set_seeded_hash(ht->_robin, ht->seeded_hash_function) != 0 ){
+        int errno_temp = errno;
+        HT_robin_delete_pointer(ht->_robin);
+        ht->_robin = NULL;
+        errno = errno_temp;
+        return 1;
+    }
     return 0;
 }
 
@@ -170,33 +616,23 @@ static inline HT_pair *ht_previous(HT_pair* pair){
 /**
  * \brief Test if a pair has the same key value than the given one
  * \param pair The pair to test
+ * \param hash The hash of the key
  * \param key The key to test
  * \param key_size The size of key
  */
-static inline int has_same_key(const HT_pair* pair, const void *key, const size_t key_size){
-    int retval;
-    if(pair->_key._size_buffer == key_size){
-        retval = strncmp((const char*) key, (const char*) pair->_key._buffer, key_size);
-    }
-    else{
-        retval = 1;
-    }
-    return !retval; // strncmp return 0 on match
+static inline int has_same_key(const HT_pair* pair, const uint64_t hash, const void *key, const size_t key_size){
+    return pair->_hash == hash && pair->_key._size_buffer == key_size &&
+        memcmp(key, pair->_key._buffer, key_size) == 0;
 }
 
-/**
- * \brief Get the pair matching the key that is the position th one in the list.
- * \param slot The slot to search inside
- * \param key The key
- * \param key_size The size of the key
- * \param position The position wanted
- * \param reverse Search first from end or start
- */
-static HT_pair * HT_get_pair(const HT_slot *slot, const void *key, const size_t key_size, unsigned int position, int reverse){
+HT_pair * HT_get_pair(const HT_slot *slot, const uint64_t hash, const void *key, const size_t key_size, unsigned int position, int reverse){
     HT_pair* (*next_one)(HT_pair* pair) = NULL;
     HT_pair* first = NULL;
     HT_pair* last_found = NULL;
     int found = 0;
+#ifdef HT_STATS
+    uint64_t probes = 0;
+#endif
 
     if(reverse){
         next_one = ht_previous;
@@ -208,7 +644,10 @@ static HT_pair * HT_get_pair(const HT_slot *slot, const void *key, const size_t
     }
 
     while(first != NULL && !found){
-        if(has_same_key(first, key, key_size)){
+#ifdef HT_STATS
+        ++probes;
+#endif
+        if(has_same_key(first, hash, key, key_size)){
             last_found = first;
             if(position == 0){
                 found = 1;
@@ -220,18 +659,31 @@ static HT_pair * HT_get_pair(const HT_slot *slot, const void *key, const size_t
         first = next_one(first);
     }
 
+    HT_COUNT(searches, 1);
+    HT_COUNT(probes, probes);
     return last_found;
 }
 
+HT_pair* HT_find_pair(const HT_hash_table* const ht, const uint64_t hash, const void* const key, const size_t key_size, unsigned int position, int reverse){
+    uint64_t slot_hash = hash;
+    const HT_slot *slot = HT_get_slot_from_key(ht, &slot_hash, key, key_size);
+    HT_pair *pair = HT_get_pair(slot, slot_hash, key, key_size, position, reverse);
+    if( pair == NULL )
+        HT_COUNT(misses, 1);
+    else
+        HT_COUNT(hits, 1);
+    return pair;
+}
+
 int HT_get_element_position(const HT_hash_table* ht, const void* key, const size_t key_size, void** value, size_t* value_size, unsigned int position, int reverse){
-    HT_slot *slot;
     HT_pair *pair;
     if( ht == NULL || key == NULL || key_size == 0 ){
         errno = EINVAL;
         return 2;
     }
-    slot = HT_get_slot_from_key(ht, key, key_size);
-    pair = HT_get_pair(slot, key, key_size, position, reverse);
+    if( ht->_robin != NULL )
+        return HT_robin_get_element(ht->_robin, key, key_size, value, value_size);
+    pair = HT_find_pair(ht, HT_hash_key(ht, key, key_size), key, key_size, position, reverse);
     if( pair == NULL )
         return 1;
     if( value != NULL && value_size != NULL){
@@ -257,64 +709,116 @@ static void add_pair_in_pair_chain(HT_pair* pair_to_add, HT_pair* where, int pre
             pair_to_add->_next = where;
             pair_to_add->_previous = where->_previous;
             if(where->_previous != NULL)
-                where->_previous->_next = pair_to_add;
-            where->_previous = pair_to_add;
+                HT_PUBLISH(where->_previous->_next, pair_to_add);
+            HT_PUBLISH(where->_previous, pair_to_add);
         }
         else{
             pair_to_add->_previous = where;
             pair_to_add->_next = where->_next;
             if(where->_next != NULL)
-                where->_next->_previous = pair_to_add;
-            where->_next = pair_to_add;
+                HT_PUBLISH(where->_next->_previous, pair_to_add);
+            HT_PUBLISH(where->_next, pair_to_add);
         }
     }
 }
 
 /**
- * \brief Remove the pair
+ * \brief Remove the pair from its chain
  * \param pair The pair to remove from the chain
+ * \note The links of the pair are kept so a concurrent reader standing on
+ * it can still walk to the rest of the chain.
  */
 static void remove_pair_in_pair_chain(HT_pair* pair){
     if(pair != NULL){
         if(pair->_previous != NULL)
-            pair->_previous->_next = pair->_next;
+            HT_PUBLISH(pair->_previous->_next, pair->_next);
         if(pair->_next != NULL)
-            pair->_next->_previous = pair->_previous;
-        HT_destroy_pair(pair);
+            HT_PUBLISH(pair->_next->_previous, pair->_previous);
     }
 }
 
-/** \brief Creates a pair
- * \param key The key to add to the pair
- * \param key_size The size of the key
- * \param value The value to add to the pair
- * \param value_size The size of the value
- */
-static inline HT_pair* new_pair(const void* const key, const size_t key_size, const void* const value, const size_t value_size){
-    HT_pair* new_one = malloc(sizeof(HT_pair));
+HT_pair* HT_new_pair(const HT_allocator* const allocator, const void* const key, const size_t key_size, const void* const value, const size_t value_size){
+    return HT_new_pair_mode(allocator, key, key_size, value, value_size, HT_MODE_COPY);
+}
+
+HT_pair* HT_new_pair_mode(const HT_allocator* const allocator, const void* const key, const size_t key_size, const void* const value, const size_t value_size, const unsigned int mode){
+    const int key_copied = !(mode & (HT_MODE_TAKE_KEY | HT_MODE_BORROW_KEY)),
+              value_copied = !(mode & (HT_MODE_TAKE_VALUE | HT_MODE_BORROW_VALUE));
+    size_t key_room = key_copied ? HT_inline_key_room(key_size) : 0,
+           value_room = value_copied && value_size <= HT_INLINE_VALUE_SIZE ? value_size : 0,
+           word_room = key_room != 0 && value_room != 0 ? 0 : HT_MODE_WORD_SIZE,
+           padding = 0;
+    uint64_t word = mode;
+    HT_pair* new_one;
+    // Keep &_data[HT_BLOCK_KEY_OFFSET] inside of the pair, an outer buffer
+    // allocated right after it must not be taken for a block key or an inlined value
+    if(key_room == 0 && value_room == 0)
+        padding = HT_INLINE_ALIGNMENT;
+    new_one = allocator->allocate(allocator->context, sizeof(HT_pair) + key_room + word_room + value_room + padding);
     if(new_one == NULL)
         return new_one;
-    HT_add_to_container(&new_one->_key, key, key_size);
-    HT_add_to_container(&new_one->_value, value, value_size);
+
+    if(key_room != 0){
+        new_one->_key._buffer = new_one->_data;
+        new_one->_key._size_buffer = key_size;
+        memcpy(new_one->_data, key, key_size);
+    }
+    else if(!key_copied){
+        new_one->_key._buffer = (void*) key;
+        new_one->_key._size_buffer = key_size;
+    }
+    else if(HT_add_to_container(allocator, &new_one->_key, key, key_size) != 0){
+        int errno_temp = errno;
+        HT_release(allocator, new_one);
+        errno = errno_temp;
+        return NULL;
+    }
+
+    if(value_room != 0){
+        new_one->_value._buffer = &new_one->_data[key_room + word_room];
+        new_one->_value._size_buffer = value_size;
+        memcpy(new_one->_value._buffer, value, value_size);
+    }
+    else if(!value_copied){
+        new_one->_value._buffer = (void*) value;
+        new_one->_value._size_buffer = value_size;
+    }
+    else if(HT_add_to_container(allocator, &new_one->_value, value, value_size) != 0){
+        int errno_temp = errno;
+        if(key_room == 0 && key_copied)
+            HT_destroy_container(allocator, &new_one->_key);
+        HT_release(allocator, new_one);
+        errno = errno_temp;
+        return NULL;
+    }
+
+    if(word_room != 0)
+        memcpy(&new_one->_data[key_room], &word, sizeof(word));
     new_one->_next = NULL;
     new_one->_previous = NULL;
     return new_one;
 }
 
-int HT_add_element_position(HT_hash_table* const ht, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse){
-    HT_slot *slot;
-    HT_pair *where;
-    if( ht == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0){
-        errno = EINVAL;
-        return 2;
-    }
-
-    slot = HT_get_slot_from_key(ht, key, key_size);
+void HT_slot_append_pair(HT_slot* const slot, HT_pair* const pair){
+    pair->_next = NULL;
+    pair->_previous = slot->_last_pair;
+    if(slot->_last_pair != NULL)
+        HT_PUBLISH(slot->_last_pair->_next, pair);
+    else
+        HT_PUBLISH(slot->_first_pair, pair);
+    HT_PUBLISH(slot->_last_pair, pair);
+}
 
-    HT_pair* new_one = new_pair(key, key_size, value, value_size);
+int HT_slot_insert(const HT_allocator* const allocator, HT_slot* const slot, const uint64_t hash, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse, const unsigned int mode){
+    HT_pair *where = NULL;
+    HT_pair* new_one = HT_new_pair_mode(allocator, key, key_size, value, value_size, mode);
+    if(new_one == NULL)
+        return 2;
+    new_one->_hash = hash;
 
-    if(position != 0){ // search for the pair if asked
-        where = HT_get_pair(slot, key, key_size, position, reverse);
+    if(position != 0) // search for the pair if asked
+        where = HT_get_pair(slot, hash, key, key_size, position, reverse);
+    if(where != NULL){
         add_pair_in_pair_chain(new_one, where, reverse);
     }
     else{ // otherwise add in first or last
@@ -326,53 +830,1469 @@ int HT_add_element_position(HT_hash_table* const ht, const void* const key, cons
     }
 
     if(new_one->_previous == NULL)
-        slot->_first_pair = new_one;
+        HT_PUBLISH(slot->_first_pair, new_one);
     if(new_one->_next == NULL)
-        slot->_last_pair = new_one;
-
+        HT_PUBLISH(slot->_last_pair, new_one);
     return 0;
 }
 
-void HT_delete_pointer(HT_hash_table* ht){
-    HT_delete(ht);
-    free(ht);
+HT_pair* HT_slot_unlink(HT_slot* const slot, const uint64_t hash, const void* const key, const size_t key_size, unsigned int position, int reverse){
+    HT_pair *where = HT_get_pair(slot, hash, key, key_size, position, reverse);
+
+    if( where == NULL )
+        return NULL;
+
+    if(where == slot->_first_pair)
+        HT_PUBLISH(slot->_first_pair, where->_next);
+    if(where == slot->_last_pair)
+        HT_PUBLISH(slot->_last_pair, where->_previous);
+
+    remove_pair_in_pair_chain(where);
+    return where;
 }
 
-void HT_delete(HT_hash_table* const ht){
-    if( ht != NULL && ht->_nb_slots != 0 ){
-        HT_reset_table(ht);
-        free(ht->_slots);
-    }
+int HT_slot_remove(const HT_allocator* const allocator, HT_free_function free_function, HT_slot* const slot, const uint64_t hash, const void* const key, const size_t key_size, unsigned int position, int reverse){
+    HT_pair *where = HT_slot_unlink(slot, hash, key, key_size, position, reverse);
+
+    if( where == NULL )
+        return 1;
+    HT_destroy_pair(allocator, free_function, where);
+    return 0;
 }
 
-void HT_reset_table(HT_hash_table* ht){
-    unsigned int i;
-    if( ht != NULL && ht->_nb_slots != 0 ){
-        for(i=0; i < ht->_nb_slots; ++i)
-            HT_destroy_slot_content(&ht->_slots[i]);
+/**
+ * \brief Reseed a seeded table after an insertion in a slot holding too many other keys.
+ * \param ht A pointer to the hash table.
+ * \param hash The hash of the inserted key.
+ * \param key The inserted key.
+ * \param key_size The size of the key in bytes.
+ * \return True if a reseed starts, the hashes computed before are stale.
+ * \note A failed reseed is not an error, the table keeps its seed. During a
+ * resize or a reseed the check waits for the migration to end.
+ */
+static int HT_watchdog(HT_hash_table* const ht, const uint64_t hash, const void* const key, const size_t key_size){
+    const HT_pair *pair;
+    unsigned int length = 0;
+
+    if( ht->seeded_hash_function == NULL || ht->_nb_elements < ht->_reseed_threshold || ht->_new_slots != NULL )
+        return 0;
+    // The duplicates of the inserted key would still share a slot after a reseed
+    for(pair = HT_get_slot_from_hash(ht, hash)->_first_pair; pair != NULL; pair = pair->_next){
+        if( !has_same_key(pair, hash, key, key_size) && ++length >= HT_WATCHDOG_CHAIN_LENGTH ){
+            if( HT_reseed(ht, ht->seeded_hash_function) != 0 )
+                return 0;
+            ht->_reseed_threshold = 2 * ht->_nb_elements;
+            return 1;
+        }
     }
+    return 0;
 }
 
-int HT_remove_element_position(HT_hash_table* ht, const void* key, const size_t key_size, unsigned int position, int reverse){
-    HT_slot *slot;
-    HT_pair *where;
-    if( ht == NULL || key == NULL || key_size == 0 ){
+/**
+ * \brief Add an element to the Robin Hood table of a hash table, see ::HT_set_robin_backend.
+ * \param ht A pointer to the hash table.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param value A pointer to the value.
+ * \param value_size The size of the value in bytes.
+ * \param stored_value If not NULL, set to the value stored for the key.
+ * \param stored_value_size If not NULL, set to the size of the value stored for the key.
+ * \retval 0 On success.
+ * \retval 1 If the key is already present.
+ * \retval 2 On error and errno is set appropriately.
+ */
+static int HT_robin_backend_add(HT_hash_table* const ht, const void* const key, const size_t key_size, const void* const value, const size_t value_size, void** stored_value, size_t* stored_value_size){
+    int retval = HT_robin_add_element(ht->_robin, key, key_size, value, value_size);
+    ht->_nb_elements = HT_robin_get_nb_elements(ht->_robin);
+    if( retval != 2 && stored_value != NULL && stored_value_size != NULL )
+        HT_robin_get_element(ht->_robin, key, key_size, stored_value, stored_value_size);
+    return retval;
+}
+
+/**
+ * \brief Remove an element from the Robin Hood table of a hash table, see ::HT_set_robin_backend.
+ * \param ht A pointer to the hash table.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ */
+static int HT_robin_backend_remove(HT_hash_table* const ht, const void* const key, const size_t key_size){
+    int retval = HT_robin_remove_element(ht->_robin, key, key_size);
+    ht->_nb_elements = HT_robin_get_nb_elements(ht->_robin);
+    return retval;
+}
+
+int HT_add_element_position(HT_hash_table* const ht, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse){
+    if( ht == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0){
         errno = EINVAL;
         return 2;
     }
+    if( ht->_robin != NULL )
+        return HT_robin_backend_add(ht, key, key_size, value, value_size, NULL, NULL);
+    return HT_insert_hashed(ht, HT_hash_key(ht, key, key_size), key, key_size, value, value_size, position, reverse);
+}
 
-    slot = HT_get_slot_from_key(ht, key, key_size);
-    where = HT_get_pair(slot, key, key_size, position, reverse);
+int HT_insert_hashed(HT_hash_table* const ht, const uint64_t hash, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse){
+    uint64_t slot_hash = hash;
+    HT_slot *slot;
 
-    if( where == NULL )
-        return 1;
+    HT_rehash_step(ht, HT_REHASH_SLOTS_PER_STEP);
+    slot = HT_get_slot_from_key(ht, &slot_hash, key, key_size);
+    if( HT_slot_insert(&ht->_allocator, slot, slot_hash, key, key_size, value, value_size, position, reverse, HT_MODE_COPY) != 0 )
+        return 2;
 
-    if(where == slot->_first_pair)
-        slot->_first_pair = where->_next;
-    if(where == slot->_last_pair)
-        slot->_last_pair = where->_previous;
+    ++ht->_nb_elements;
+    HT_watchdog(ht, slot_hash, key, key_size);
+    HT_check_load_factor(ht);
+    return 0;
+}
 
-    remove_pair_in_pair_chain(where);
+int HT_add_element_mode(HT_hash_table* const ht, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse, unsigned int mode){
+    HT_slot *slot;
+    uint64_t hash;
+    if( ht == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ||
+            (mode & ~(HT_MODE_TAKE_KEY | HT_MODE_BORROW_KEY | HT_MODE_TAKE_VALUE | HT_MODE_BORROW_VALUE)) != 0 ||
+            (mode & (HT_MODE_TAKE_KEY | HT_MODE_BORROW_KEY)) == (HT_MODE_TAKE_KEY | HT_MODE_BORROW_KEY) ||
+            (mode & (HT_MODE_TAKE_VALUE | HT_MODE_BORROW_VALUE)) == (HT_MODE_TAKE_VALUE | HT_MODE_BORROW_VALUE) ||
+            ht->_robin != NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = HT_hash_key(ht, key, key_size);
+    HT_rehash_step(ht, HT_REHASH_SLOTS_PER_STEP);
+    slot = HT_get_slot_from_key(ht, &hash, key, key_size);
+    if( HT_slot_insert(&ht->_allocator, slot, hash, key, key_size, value, value_size, position, reverse, mode) != 0 )
+        return 2;
+    if( mode & (HT_MODE_TAKE_KEY | HT_MODE_TAKE_VALUE) )
+        ht->_has_taken = 1;
 
+    ++ht->_nb_elements;
+    HT_watchdog(ht, hash, key, key_size);
+    HT_check_load_factor(ht);
+    return 0;
+}
+
+/**
+ * \brief Get the first element of a key or add it in front of its slot, hashing the key and walking the slot once.
+ * \param ht A pointer to the hash table.
+ * \param hash The hash of the key.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param value The value of the element to add.
+ * \param value_size The size of the value in bytes.
+ * \param slot Set to the slot of the key.
+ * \param inserted Set to true if the element is added.
+ * \return The pair of the key, NULL on error and errno is set appropriately.
+ */
+static HT_pair* HT_find_or_insert_pair(HT_hash_table* const ht, const uint64_t hash, const void* const key, const size_t key_size, const void* const value, const size_t value_size, HT_slot** slot, int* inserted){
+    uint64_t slot_hash = hash;
+    HT_pair *pair;
+
+    HT_rehash_step(ht, HT_REHASH_SLOTS_PER_STEP);
+    *slot = HT_get_slot_from_key(ht, &slot_hash, key, key_size);
+    pair = HT_get_pair(*slot, slot_hash, key, key_size, 0, 0);
+    if( pair != NULL ){
+        *inserted = 0;
+        return pair;
+    }
+
+    pair = HT_new_pair(&ht->_allocator, key, key_size, value, value_size);
+    if( pair == NULL )
+        return NULL;
+    pair->_hash = slot_hash;
+    add_pair_in_pair_chain(pair, (*slot)->_first_pair, 1);
+    HT_PUBLISH((*slot)->_first_pair, pair);
+    if( pair->_next == NULL )
+        HT_PUBLISH((*slot)->_last_pair, pair);
+    ++ht->_nb_elements;
+    // A resize or a reseed only starts here, the pair stays in its slot until
+    // the next operation migrates it
+    HT_watchdog(ht, slot_hash, key, key_size);
+    HT_check_load_factor(ht);
+    *inserted = 1;
+    return pair;
+}
+
+HT_pair* HT_find_or_insert_hashed(HT_hash_table* const ht, const uint64_t hash, const void* const key, const size_t key_size, const void* const value, const size_t value_size, int* inserted){
+    HT_slot *slot;
+    return HT_find_or_insert_pair(ht, hash, key, key_size, value, value_size, &slot, inserted);
+}
+
+int HT_find_or_insert(HT_hash_table* const ht, const void* const key, const size_t key_size, const void* const value, const size_t value_size, void** stored_value, size_t* stored_value_size){
+    HT_slot *slot;
+    HT_pair *pair;
+    int inserted;
+    if( ht == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    if( ht->_robin != NULL )
+        return HT_robin_backend_add(ht, key, key_size, value, value_size, stored_value, stored_value_size);
+
+    pair = HT_find_or_insert_pair(ht, HT_hash_key(ht, key, key_size), key, key_size, value, value_size, &slot, &inserted);
+    if( pair == NULL )
+        return 2;
+    if( stored_value != NULL && stored_value_size != NULL ){
+        *stored_value = pair->_value._buffer;
+        *stored_value_size = pair->_value._size_buffer;
+    }
+    return !inserted;
+}
+
+int HT_upsert(HT_hash_table* const ht, const void* const key, const size_t key_size, const void* const value, const size_t value_size){
+    HT_slot *slot;
+    HT_pair *pair,
+            *new_one;
+    int inserted;
+    if( ht == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    pair = HT_find_or_insert_pair(ht, HT_hash_key(ht, key, key_size), key, key_size, value, value_size, &slot, &inserted);
+    if( pair == NULL )
+        return 2;
+    if( inserted )
+        return 0;
+    if( pair->_value._size_buffer == value_size && !(HT_pair_mode(pair) & HT_MODE_BORROW_VALUE) ){
+        memcpy(pair->_value._buffer, value, value_size);
+        return 1;
+    }
+
+    // The size changes or the value is borrowed, a new pair takes the place of the old one
+    new_one = HT_new_pair(&ht->_allocator, key, key_size, value, value_size);
+    if( new_one == NULL )
+        return 2;
+    new_one->_hash = pair->_hash;
+    add_pair_in_pair_chain(new_one, pair, 0);
+    if( new_one->_next == NULL )
+        HT_PUBLISH(slot->_last_pair, new_one);
+    if( pair == slot->_first_pair )
+        HT_PUBLISH(slot->_first_pair, new_one);
+    remove_pair_in_pair_chain(pair);
+    HT_destroy_pair(&ht->_allocator, ht->free_function, pair);
+    return 1;
+}
+
+int HT_update_with(HT_hash_table* const ht, const void* const key, const size_t key_size, const void* const initial_value, const size_t initial_value_size, HT_update_function update, void* data){
+    HT_slot *slot;
+    HT_pair *pair;
+    int inserted;
+    if( ht == NULL || key == NULL || initial_value == NULL || key_size == 0 || initial_value_size == 0 || update == NULL ||
+            ht->_robin != NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    pair = HT_find_or_insert_pair(ht, HT_hash_key(ht, key, key_size), key, key_size, initial_value, initial_value_size, &slot, &inserted);
+    if( pair == NULL )
+        return 2;
+    update(pair->_value._buffer, pair->_value._size_buffer, inserted, data);
+    return !inserted;
+}
+
+void HT_delete_pointer(HT_hash_table* ht){
+    HT_delete(ht);
+    free(ht);
+}
+
+void HT_delete(HT_hash_table* const ht){
+    HT_parallel_delete(ht, 1);
+}
+
+/**
+ * \brief Release the buffers taken by the pairs of a slot, leaving the pairs to the allocator.
+ * \param ht A pointer to the hash table.
+ * \param slot The slot.
+ */
+static void HT_release_taken(const HT_hash_table* const ht, const HT_slot* const slot){
+    HT_pair *current;
+    unsigned int mode;
+    for(current = slot->_first_pair; current != NULL; current = current->_next){
+        mode = HT_pair_mode(current);
+        if( mode & HT_MODE_TAKE_KEY )
+            HT_release_container(&ht->_allocator, ht->free_function, &current->_key, mode, HT_MODE_TAKE_KEY, HT_MODE_BORROW_KEY);
+        if( mode & HT_MODE_TAKE_VALUE )
+            HT_release_container(&ht->_allocator, ht->free_function, &current->_value, mode, HT_MODE_TAKE_VALUE, HT_MODE_BORROW_VALUE);
+    }
+}
+
+void HT_reset_table(HT_hash_table* ht){
+    HT_parallel_reset_table(ht, 1);
+}
+
+int HT_remove_element_position(HT_hash_table* ht, const void* key, const size_t key_size, unsigned int position, int reverse){
+    if( ht == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    if( ht->_robin != NULL )
+        return HT_robin_backend_remove(ht, key, key_size);
+    return HT_remove_hashed(ht, HT_hash_key(ht, key, key_size), key, key_size, position, reverse);
+}
+
+int HT_remove_hashed(HT_hash_table* const ht, const uint64_t hash, const void* const key, const size_t key_size, unsigned int position, int reverse){
+    uint64_t slot_hash = hash;
+    HT_slot *slot;
+
+    HT_rehash_step(ht, HT_REHASH_SLOTS_PER_STEP);
+    slot = HT_get_slot_from_key(ht, &slot_hash, key, key_size);
+    if( HT_slot_remove(&ht->_allocator, ht->free_function, slot, slot_hash, key, key_size, position, reverse) != 0 )
+        return 1;
+
+    --ht->_nb_elements;
+    HT_check_load_factor(ht);
+    return 0;
+}
+
+/**
+ * \brief Hash an integer key, inlining ::HT_hash_u64.
+ * \param ht A pointer to the hash table.
+ * \param key The key.
+ */
+static inline uint64_t HT_hash_key_u64(const HT_hash_table* const ht, const uint64_t key){
+    if( ht->hash_function == HT_hash_u64 && ht->seeded_hash_function == NULL ){
+        HT_COUNT(hashes, 1);
+        return HT_hash_mix64(key);
+    }
+    return HT_hash_key(ht, &key, sizeof(key));
+}
+
+int HT_get_element_u64(const HT_hash_table* ht, const uint64_t key, void** value, size_t* value_size){
+    const HT_pair *pair;
+    uint64_t hash,
+             pair_key,
+             probes = 0;
+    if( ht == NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+    if( ht->_robin != NULL )
+        return HT_robin_get_element(ht->_robin, &key, sizeof(key), value, value_size);
+
+    hash = HT_hash_key_u64(ht, key);
+    for(pair = HT_get_slot_from_key(ht, &hash, &key, sizeof(key))->_first_pair; pair != NULL; pair = pair->_next){
+        ++probes;
+        if( pair->_hash != hash || pair->_key._size_buffer != sizeof(key) )
+            continue;
+        memcpy(&pair_key, pair->_key._buffer, sizeof(key));
+        if( pair_key == key )
+            break;
+    }
+    HT_COUNT(searches, 1);
+    HT_COUNT(probes, probes);
+    if( pair == NULL ){
+        HT_COUNT(misses, 1);
+        return 1;
+    }
+    HT_COUNT(hits, 1);
+    if( value != NULL && value_size != NULL ){
+        *value = pair->_value._buffer;
+        *value_size = pair->_value._size_buffer;
+    }
+    return 0;
+}
+
+int HT_add_element_u64(HT_hash_table* ht, const uint64_t key, const void* value, const size_t value_size){
+    HT_slot *slot;
+    int inserted;
+    if( ht == NULL || value == NULL || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    if( ht->_robin != NULL )
+        return HT_robin_backend_add(ht, &key, sizeof(key), value, value_size, NULL, NULL);
+
+    if( HT_find_or_insert_pair(ht, HT_hash_key_u64(ht, key), &key, sizeof(key), value, value_size, &slot, &inserted) == NULL )
+        return 2;
+    return !inserted;
+}
+
+int HT_remove_element_u64(HT_hash_table* ht, const uint64_t key){
+    HT_slot *slot;
+    uint64_t hash;
+    if( ht == NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+    if( ht->_robin != NULL )
+        return HT_robin_backend_remove(ht, &key, sizeof(key));
+
+    HT_rehash_step(ht, HT_REHASH_SLOTS_PER_STEP);
+    hash = HT_hash_key_u64(ht, key);
+    slot = HT_get_slot_from_key(ht, &hash, &key, sizeof(key));
+    if( HT_slot_remove(&ht->_allocator, ht->free_function, slot, hash, &key, sizeof(key), 0, 0) != 0 )
+        return 1;
+
+    --ht->_nb_elements;
+    HT_check_load_factor(ht);
+    return 0;
+}
+
+/**
+ * \brief Hash a group of keys and prefetch their slots, then their first pairs.
+ * \param ht A pointer to the hash table.
+ * \param nb_keys The number of keys, at most ::HT_BATCH_PIPELINE_DEPTH.
+ * \param keys The keys.
+ * \param key_sizes The sizes of the keys.
+ * \param hashes Set to the hash of each key, 0 for an invalid key.
+ * \return 0 if every key is valid.
+ */
+static int HT_batch_prefetch(const HT_hash_table* const ht, const size_t nb_keys, const void* const keys[], const size_t key_sizes[], uint64_t hashes[]){
+    HT_slot *slots[HT_BATCH_PIPELINE_DEPTH];
+    HT_pair *first;
+    uint64_t slot_hash;
+    size_t i;
+    int invalid = 0;
+
+    for(i = 0; i < nb_keys; ++i){
+        if( keys[i] == NULL || key_sizes[i] == 0 ){
+            hashes[i] = 0;
+            slots[i] = NULL;
+            invalid = 1;
+            continue;
+        }
+        hashes[i] = HT_hash_key(ht, keys[i], key_sizes[i]);
+        slot_hash = hashes[i];
+        slots[i] = HT_get_slot_from_key(ht, &slot_hash, keys[i], key_sizes[i]);
+        __builtin_prefetch(slots[i]);
+    }
+    for(i = 0; i < nb_keys; ++i){
+        if( slots[i] != NULL && (first = slots[i]->_first_pair) != NULL ){
+            __builtin_prefetch(first);
+            __builtin_prefetch(first->_data);
+        }
+    }
+    return invalid;
+}
+
+size_t HT_get_elements_batch(const HT_hash_table* ht, const size_t nb_keys, const void* const keys[], const size_t key_sizes[], void* values[], size_t value_sizes[], int results[]){
+    uint64_t hashes[HT_BATCH_PIPELINE_DEPTH],
+             slot_hash;
+    size_t done,
+           i,
+           length,
+           nb_found = 0;
+    const HT_slot *slot;
+    HT_pair *pair;
+    int invalid,
+        retval;
+    if( ht == NULL || keys == NULL || key_sizes == NULL || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 0;
+    }
+
+    for(done = 0; done < nb_keys; done += length){
+        length = nb_keys - done < HT_BATCH_PIPELINE_DEPTH ? nb_keys - done : HT_BATCH_PIPELINE_DEPTH;
+        invalid = HT_batch_prefetch(ht, length, &keys[done], &key_sizes[done], hashes);
+        for(i = 0; i < length; ++i){
+            if( invalid && (keys[done + i] == NULL || key_sizes[done + i] == 0) ){
+                errno = EINVAL;
+                retval = 2;
+            }
+            else{
+                slot_hash = hashes[i];
+                slot = HT_get_slot_from_key(ht, &slot_hash, keys[done + i], key_sizes[done + i]);
+                pair = HT_get_pair(slot, slot_hash, keys[done + i], key_sizes[done + i], 0, 0);
+                retval = pair == NULL ? 1 : 0;
+                if( pair == NULL )
+                    HT_COUNT(misses, 1);
+                else{
+                    HT_COUNT(hits, 1);
+                    if( values != NULL )
+                        values[done + i] = pair->_value._buffer;
+                    if( value_sizes != NULL )
+                        value_sizes[done + i] = pair->_value._size_buffer;
+                    ++nb_found;
+                }
+            }
+            if( results != NULL )
+                results[done + i] = retval;
+        }
+    }
+    return nb_found;
+}
+
+size_t HT_add_elements_batch(HT_hash_table* ht, const size_t nb_keys, const void* const keys[], const size_t key_sizes[], const void* const values[], const size_t value_sizes[], int unique, int results[]){
+    uint64_t hashes[HT_BATCH_PIPELINE_DEPTH],
+             slot_hash;
+    size_t done,
+           i,
+           j,
+           length,
+           nb_added = 0;
+    HT_slot *slot;
+    int invalid,
+        retval;
+    if( ht == NULL || keys == NULL || key_sizes == NULL || values == NULL || value_sizes == NULL || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 0;
+    }
+
+    for(done = 0; done < nb_keys; done += length){
+        length = nb_keys - done < HT_BATCH_PIPELINE_DEPTH ? nb_keys - done : HT_BATCH_PIPELINE_DEPTH;
+        // Migrate before prefetching so the slots of the group stay in place
+        HT_rehash_step(ht, (unsigned int) length * HT_REHASH_SLOTS_PER_STEP);
+        invalid = HT_batch_prefetch(ht, length, &keys[done], &key_sizes[done], hashes);
+        for(i = 0; i < length; ++i){
+            if( (invalid && (keys[done + i] == NULL || key_sizes[done + i] == 0)) ||
+                    values[done + i] == NULL || value_sizes[done + i] == 0 ){
+                errno = EINVAL;
+                retval = 2;
+            }
+            else{
+                slot_hash = hashes[i];
+                slot = HT_get_slot_from_key(ht, &slot_hash, keys[done + i], key_sizes[done + i]);
+                if( unique && HT_get_pair(slot, slot_hash, keys[done + i], key_sizes[done + i], 0, 0) != NULL )
+                    retval = 1;
+                else
+                    retval = HT_slot_insert(&ht->_allocator, slot, slot_hash, keys[done + i], key_sizes[done + i],
+                            values[done + i], value_sizes[done + i], 0, 0, HT_MODE_COPY);
+                if( retval == 0 ){
+                    ++ht->_nb_elements;
+                    ++nb_added;
+                    if( HT_watchdog(ht, slot_hash, keys[done + i], key_sizes[done + i]) ){
+                        for(j = i + 1; j < length; ++j){
+                            if( keys[done + j] != NULL && key_sizes[done + j] != 0 )
+                                hashes[j] = HT_hash_key(ht, keys[done + j], key_sizes[done + j]);
+                        }
+                    }
+                    HT_check_load_factor(ht);
+                }
+            }
+            if( results != NULL )
+                results[done + i] = retval;
+        }
+    }
+    return nb_added;
+}
+
+size_t HT_remove_elements_batch(HT_hash_table* ht, const size_t nb_keys, const void* const keys[], const size_t key_sizes[], int results[]){
+    uint64_t hashes[HT_BATCH_PIPELINE_DEPTH],
+             slot_hash;
+    size_t done,
+           i,
+           length,
+           nb_removed = 0;
+    HT_slot *slot;
+    int invalid,
+        retval;
+    if( ht == NULL || keys == NULL || key_sizes == NULL || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 0;
+    }
+
+    for(done = 0; done < nb_keys; done += length){
+        length = nb_keys - done < HT_BATCH_PIPELINE_DEPTH ? nb_keys - done : HT_BATCH_PIPELINE_DEPTH;
+        HT_rehash_step(ht, (unsigned int) length * HT_REHASH_SLOTS_PER_STEP);
+        invalid = HT_batch_prefetch(ht, length, &keys[done], &key_sizes[done], hashes);
+        for(i = 0; i < length; ++i){
+            if( invalid && (keys[done + i] == NULL || key_sizes[done + i] == 0) ){
+                errno = EINVAL;
+                retval = 2;
+            }
+            else{
+                slot_hash = hashes[i];
+                slot = HT_get_slot_from_key(ht, &slot_hash, keys[done + i], key_sizes[done + i]);
+                retval = HT_slot_remove(&ht->_allocator, ht->free_function, slot, slot_hash,
+                        keys[done + i], key_sizes[done + i], 0, 0);
+                if( retval == 0 ){
+                    --ht->_nb_elements;
+                    ++nb_removed;
+                    HT_check_load_factor(ht);
+                }
+            }
+            if( results != NULL )
+                results[done + i] = retval;
+        }
+    }
+    return nb_removed;
+}
+
+/**
+ * \brief Move an iterator over a Robin Hood backend to the next entry in use.
+ * \param it The iterator, its entry index set to the first entry to look at.
+ */
+static void HT_iterator_robin_seek(HT_iterator* const it){
+    const HT_robin_table *rt = it->_table->_robin;
+    for(; it->_slot_index < it->_nb_slots; ++it->_slot_index){
+        if( rt->_distances[it->_slot_index] != 0 ){
+            it->_key = &rt->_entries[it->_slot_index]._key;
+            it->_value = &rt->_entries[it->_slot_index]._value;
+            return;
+        }
+    }
+    it->_key = NULL;
+    it->_value = NULL;
+}
+
+/**
+ * \brief Point an iterator at a pair.
+ * \param it The iterator.
+ * \param pair The pair, NULL at the end.
+ */
+static inline void HT_iterator_set_pair(HT_iterator* const it, HT_pair* const pair){
+    it->_pair = pair;
+    it->_key = pair != NULL ? &pair->_key : NULL;
+    it->_value = pair != NULL ? &pair->_value : NULL;
+}
+
+void HT_iterator_begin(const HT_hash_table* const ht, HT_iterator* const it){
+    it->_table = ht;
+    it->_slots = ht->_slots;
+    it->_nb_slots = ht->_nb_slots;
+    it->_slot_index = 0;
+    if( ht->_robin != NULL ){
+        it->_pair = NULL;
+        it->_nb_slots = 1U << ht->_robin->_entry_bits;
+        HT_iterator_robin_seek(it);
+        return;
+    }
+    HT_iterator_set_pair(it, ht->_nb_slots != 0 ? ht->_slots[0]._first_pair : NULL);
+    if( it->_pair == NULL && ht->_nb_slots != 0 )
+        HT_iterator_next(it);
+}
+
+void HT_iterator_next(HT_iterator* const it){
+    if( it->_table->_robin != NULL ){
+        ++it->_slot_index;
+        HT_iterator_robin_seek(it);
+        return;
+    }
+    if( it->_pair != NULL && it->_pair->_next != NULL ){
+        HT_iterator_set_pair(it, it->_pair->_next);
+        return;
+    }
+    HT_iterator_set_pair(it, NULL);
+    for(;;){
+        while( ++it->_slot_index < it->_nb_slots ){
+            if( it->_slots[it->_slot_index]._first_pair != NULL ){
+                HT_iterator_set_pair(it, it->_slots[it->_slot_index]._first_pair);
+                return;
+            }
+        }
+        // During a resize the migrated slots are empty, the new ones come next
+        if( it->_slots == it->_table->_new_slots || it->_table->_new_slots == NULL )
+            return;
+        it->_slots = it->_table->_new_slots;
+        it->_nb_slots = it->_table->_nb_new_slots;
+        it->_slot_index = 0;
+        if( it->_slots[0]._first_pair != NULL ){
+            HT_iterator_set_pair(it, it->_slots[0]._first_pair);
+            return;
+        }
+    }
+}
+
+int HT_robin_backend_foreach(const HT_hash_table* ht, HT_foreach_function function, void* data){
+    return HT_robin_foreach(ht->_robin, function, data);
+}
+
+/**
+ * \brief Call a function on every pair of a slot.
+ * \param slot The slot.
+ * \param function The function.
+ * \param data The last argument of function.
+ * \param visited Incremented for each pair.
+ * \param stop Set to true if function asks to stop.
+ */
+static void HT_scan_slot(const HT_slot* const slot, HT_foreach_function function, void* data, unsigned int* const visited, int* const stop){
+    HT_pair *pair;
+    for(pair = slot->_first_pair; pair != NULL; pair = pair->_next){
+        if( function(pair->_key._buffer, pair->_key._size_buffer, pair->_value._buffer, pair->_value._size_buffer, data) != 0 )
+            *stop = 1;
+        ++*visited;
+    }
+}
+
+uint64_t HT_scan(const HT_hash_table* ht, uint64_t cursor, const unsigned int count, HT_foreach_function function, void* data){
+    unsigned int visited = 0,
+                 index,
+                 new_index,
+                 last_new_index;
+    uint64_t end;
+    int stop = 0;
+    if( ht == NULL || function == NULL || cursor > UINT32_MAX ){
+        errno = EINVAL;
+        return HT_SCAN_CURSOR_START;
+    }
+    if( ht->_robin != NULL )
+        return HT_robin_scan(ht->_robin, cursor, count, function, data);
+
+    do{
+        // The cursor holds the top 32 bits of a folded hash, a slot of an
+        // array of 2^bits slots covers the cursors sharing their top bits
+        index = (unsigned int) (cursor >> (32 - ht->_slot_bits));
+        end = ((uint64_t) index + 1) << (32 - ht->_slot_bits);
+        if( ht->_new_slots == NULL || index >= ht->_rehash_index )
+            HT_scan_slot(&ht->_slots[index], function, data, &visited, &stop);
+        else{ // Already migrated, visit the new slots covering the same range
+            last_new_index = (unsigned int) ((end - 1) >> (32 - ht->_new_slot_bits));
+            for(new_index = (unsigned int) (cursor >> (32 - ht->_new_slot_bits)); new_index <= last_new_index; ++new_index)
+                HT_scan_slot(&ht->_new_slots[new_index], function, data, &visited, &stop);
+        }
+        cursor = end > UINT32_MAX ? HT_SCAN_CURSOR_START : end;
+    }
+    while( cursor != HT_SCAN_CURSOR_START && visited < count && !stop );
+    return cursor;
+}
+
+/**
+ * \brief Get the number of threads sharing some work.
+ * \param nb_threads The number of threads asked, 0 for one per online processor.
+ * \param nb_items The number of items to share.
+ * \param items_per_thread The minimum number of items given to each thread.
+ * \return The number of threads, between 1 and ::HT_BULK_MAX_THREADS.
+ */
+static unsigned int HT_nb_threads(unsigned int nb_threads, const size_t nb_items, const size_t items_per_thread){
+    if( nb_threads == 0 ){
+        long nb_processors = sysconf(_SC_NPROCESSORS_ONLN);
+        nb_threads = nb_processors > 0 ? (unsigned int) nb_processors : 1;
+    }
+    if( nb_threads > HT_BULK_MAX_THREADS )
+        nb_threads = HT_BULK_MAX_THREADS;
+    if( nb_threads > nb_items / items_per_thread )
+        nb_threads = (unsigned int) (nb_items / items_per_thread);
+    if( nb_threads == 0 )
+        nb_threads = 1;
+    return nb_threads;
+}
+
+/**
+ * \brief Run jobs in parallel, the caller running the first one.
+ * \param jobs The array of jobs.
+ * \param job_size The size of a job in bytes.
+ * \param nb_jobs The number of jobs, at most ::HT_BULK_MAX_THREADS.
+ * \param run The function running the job given as argument.
+ * \note A job whose thread cannot be created is run by the caller.
+ */
+static void HT_run_jobs(void* const jobs, const size_t job_size, const unsigned int nb_jobs, void* (*run)(void*)){
+    pthread_t threads[HT_BULK_MAX_THREADS];
+    int started[HT_BULK_MAX_THREADS];
+    unsigned int i;
+
+    for(i = 0; i < nb_jobs; ++i)
+        started[i] = i != 0 && pthread_create(&threads[i], NULL, run, (char*) jobs + job_size * i) == 0;
+    for(i = 0; i < nb_jobs; ++i){
+        if( !started[i] )
+            run((char*) jobs + job_size * i);
+    }
+    for(i = 1; i < nb_jobs; ++i){
+        if( started[i] )
+            pthread_join(threads[i], NULL);
+    }
+}
+
+/**
+ * \brief A range of keys hashed by one thread of a bulk build.
+ */
+typedef struct{
+    const HT_hash_table *_table;/**<- The hash table giving the hash function. */
+    const void* const *_keys;   /**<- The keys. */
+    const size_t *_key_sizes;   /**<- The sizes of the keys. */
+    uint64_t *_hashes;          /**<- The hashes to compute. */
+    size_t _begin,              /**<- The first key of the range. */
+           _end;                /**<- The key after the range. */
+} HT_bulk_hash_job;
+
+/**
+ * \brief Hash a range of keys.
+ * \param job_pointer A pointer to the HT_bulk_hash_job.
+ * \return NULL.
+ */
+static void* HT_bulk_hash_range(void* job_pointer){
+    HT_bulk_hash_job *job = job_pointer;
+    size_t i;
+    for(i = job->_begin; i < job->_end; ++i)
+        job->_hashes[i] = HT_hash_key(job->_table, job->_keys[i], job->_key_sizes[i]);
+    return NULL;
+}
+
+/**
+ * \brief Hash every key, splitting the work between threads.
+ * \param ht A pointer to the hash table.
+ * \param nb_records The number of keys.
+ * \param keys The keys.
+ * \param key_sizes The sizes of the keys.
+ * \param hashes Set to the hash of each key.
+ * \param nb_threads The number of threads, 0 for one per online processor.
+ */
+static void HT_bulk_hash(const HT_hash_table* const ht, const size_t nb_records, const void* const keys[], const size_t key_sizes[], uint64_t hashes[], unsigned int nb_threads){
+    HT_bulk_hash_job jobs[HT_BULK_MAX_THREADS];
+    unsigned int i;
+
+    nb_threads = HT_nb_threads(nb_threads, nb_records, HT_BULK_RECORDS_PER_THREAD);
+    for(i = 0; i < nb_threads; ++i){
+        jobs[i]._table = ht;
+        jobs[i]._keys = keys;
+        jobs[i]._key_sizes = key_sizes;
+        jobs[i]._hashes = hashes;
+        jobs[i]._begin = nb_records / nb_threads * i;
+        jobs[i]._end = i + 1 == nb_threads ? nb_records : nb_records / nb_threads * (i + 1);
+    }
+    HT_run_jobs(jobs, sizeof(jobs[0]), nb_threads, HT_bulk_hash_range);
+}
+
+/**
+ * \brief Give the hash table enough slots for a number of elements and finish any resize.
+ * \param ht A pointer to the hash table.
+ * \param nb_elements The number of elements the table will hold.
+ * \note The slots are at least doubled so that successive builds resize a logarithmic number of times.
+ */
+static void HT_bulk_reserve(HT_hash_table* const ht, const size_t nb_elements){
+    double needed;
+
+    HT_rehash_step(ht, UINT_MAX);
+    if( ht->_max_load_factor <= 0.0f )
+        return;
+    needed = (double) nb_elements / (double) ht->_max_load_factor;
+    if( needed <= (double) ht->_nb_slots || ht->_nb_slots >= HT_MAX_SLOTS )
+        return;
+    if( needed < 2.0 * (double) ht->_nb_slots )
+        needed = 2.0 * (double) ht->_nb_slots;
+    if( HT_resize(ht, needed >= (double) HT_MAX_SLOTS ? HT_MAX_SLOTS : (unsigned int) needed) == 0 )
+        HT_rehash_step(ht, UINT_MAX);
+}
+
+/**
+ * \brief Get the room taken by a pair in a block.
+ * \param key_size The size of the key.
+ * \param value_size The size of the value.
+ */
+static inline size_t HT_block_pair_size(const size_t key_size, const size_t value_size){
+    return sizeof(HT_pair) + HT_BLOCK_KEY_OFFSET +
+        (key_size + HT_INLINE_ALIGNMENT - 1) / HT_INLINE_ALIGNMENT * HT_INLINE_ALIGNMENT +
+        (value_size + HT_INLINE_ALIGNMENT - 1) / HT_INLINE_ALIGNMENT * HT_INLINE_ALIGNMENT;
+}
+
+int HT_bulk_build(HT_hash_table* const ht, const size_t nb_records, const void* const keys[], const size_t key_sizes[], const void* const values[], const size_t value_sizes[], unsigned int nb_threads){
+    HT_pair_block *block;
+    HT_pair *pair;
+    unsigned char *pairs;
+    uint64_t *hashes;
+    size_t *offsets,
+           begin,
+           i,
+           key_room;
+    unsigned int slot;
+    if( ht == NULL || ht->_robin != NULL ||
+            (nb_records != 0 && (keys == NULL || key_sizes == NULL || values == NULL || value_sizes == NULL)) ){
+        errno = EINVAL;
+        return 2;
+    }
+    for(i = 0; i < nb_records; ++i){
+        if( keys[i] == NULL || key_sizes[i] == 0 || values[i] == NULL || value_sizes[i] == 0 ){
+            errno = EINVAL;
+            return 2;
+        }
+    }
+    if( nb_records == 0 )
+        return 0;
+
+    hashes = malloc(nb_records * sizeof(uint64_t));
+    if( hashes == NULL )
+        return 2;
+    HT_bulk_hash(ht, nb_records, keys, key_sizes, hashes, nb_threads);
+    HT_bulk_reserve(ht, ht->_nb_elements + nb_records);
+
+    // Partition by slot: the pairs of a slot are contiguous in the block
+    offsets = calloc((size_t) ht->_nb_slots + 1, sizeof(size_t));
+    if( offsets == NULL ){
+        free(hashes);
+        return 2;
+    }
+    for(i = 0; i < nb_records; ++i)
+        offsets[HT_hash_fold(hashes[i], ht->_slot_bits) + 1] += HT_block_pair_size(key_sizes[i], value_sizes[i]);
+    for(i = 1; i <= ht->_nb_slots; ++i)
+        offsets[i] += offsets[i - 1];
+    block = ht->_allocator.allocate(ht->_allocator.context, sizeof(HT_pair_block) + offsets[ht->_nb_slots]);
+    if( block == NULL ){
+        int errno_temp = errno;
+        free(offsets);
+        free(hashes);
+        errno = errno_temp;
+        return 2;
+    }
+    block->_nb_pairs = nb_records;
+    pairs = (unsigned char*) (block + 1);
+
+    for(i = 0; i < nb_records; ++i){
+        slot = HT_hash_fold(hashes[i], ht->_slot_bits);
+        pair = (HT_pair*) (void*) &pairs[offsets[slot]];
+        offsets[slot] += HT_block_pair_size(key_sizes[i], value_sizes[i]);
+        key_room = HT_block_pair_size(key_sizes[i], 0) - sizeof(HT_pair);
+        memcpy(pair->_data, &block, sizeof(block));
+        pair->_key._buffer = &pair->_data[HT_BLOCK_KEY_OFFSET];
+        pair->_key._size_buffer = key_sizes[i];
+        memcpy(pair->_key._buffer, keys[i], key_sizes[i]);
+        pair->_value._buffer = &pair->_data[key_room];
+        pair->_value._size_buffer = value_sizes[i];
+        memcpy(pair->_value._buffer, values[i], value_sizes[i]);
+        pair->_hash = hashes[i];
+    }
+    // Each offset now ends its slot, walk the block and the slots in order
+    ht->_nb_elements += nb_records;
+    for(begin = 0, i = 0; i < ht->_nb_slots; begin = offsets[i], ++i){
+        if( begin == offsets[i] )
+            continue;
+        while( begin < offsets[i] ){
+            pair = (HT_pair*) (void*) &pairs[begin];
+            begin += HT_block_pair_size(pair->_key._size_buffer, pair->_value._size_buffer);
+            HT_slot_append_pair(&ht->_slots[i], pair);
+        }
+        // Check the slot as the insertion of its last pair would, once a
+        // reseed starts the remaining pairs still go to the old slots
+        HT_watchdog(ht, pair->_hash, pair->_key._buffer, pair->_key._size_buffer);
+    }
+    free(offsets);
+    free(hashes);
+
+    HT_check_load_factor(ht);
+    return 0;
+}
+
+int HT_bulk_build_stream(HT_hash_table* const ht, HT_record_reader reader, void* context, unsigned int nb_threads){
+    const void **keys = NULL,
+               **values = NULL,
+               *key,
+               *value;
+    size_t *key_sizes = NULL,
+           *value_sizes = NULL,
+           key_size,
+           value_size,
+           nb_records;
+    void *key_copy,
+         *value_copy;
+    HT_arena staging;
+    int retval = 0,
+        read_retval = 0;
+    if( ht == NULL || reader == NULL || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    keys = malloc(HT_BULK_CHUNK_SIZE * sizeof(void*));
+    values = malloc(HT_BULK_CHUNK_SIZE * sizeof(void*));
+    key_sizes = malloc(HT_BULK_CHUNK_SIZE * sizeof(size_t));
+    value_sizes = malloc(HT_BULK_CHUNK_SIZE * sizeof(size_t));
+    if( keys == NULL || values == NULL || key_sizes == NULL || value_sizes == NULL || HT_arena_init(&staging, 0) != 0 ){
+        int errno_temp = errno;
+        free(keys);
+        free(values);
+        free(key_sizes);
+        free(value_sizes);
+        errno = errno_temp;
+        return 2;
+    }
+
+    // The records are copied in a staging arena, the reader may reuse its buffers
+    while( read_retval == 0 && retval == 0 ){
+        HT_arena_reset(&staging);
+        for(nb_records = 0; nb_records < HT_BULK_CHUNK_SIZE; ++nb_records){
+            read_retval = reader(context, &key, &key_size, &value, &value_size);
+            if( read_retval != 0 )
+                break;
+            if( key == NULL || key_size == 0 || value == NULL || value_size == 0 ){
+                errno = EINVAL;
+                read_retval = 2;
+                break;
+            }
+            key_copy = HT_arena_allocate(&staging, key_size);
+            value_copy = key_copy == NULL ? NULL : HT_arena_allocate(&staging, value_size);
+            if( value_copy == NULL ){
+                read_retval = 2;
+                break;
+            }
+            keys[nb_records] = memcpy(key_copy, key, key_size);
+            key_sizes[nb_records] = key_size;
+            values[nb_records] = memcpy(value_copy, value, value_size);
+            value_sizes[nb_records] = value_size;
+        }
+        if( read_retval != 0 && read_retval != 1 )
+            retval = 2;
+        else
+            retval = HT_bulk_build(ht, nb_records, keys, key_sizes, values, value_sizes, nb_threads);
+    }
+
+    {
+        int errno_temp = errno;
+        HT_arena_delete(&staging);
+        free(keys);
+        free(values);
+        free(key_sizes);
+        free(value_sizes);
+        errno = errno_temp;
+    }
+    return retval;
+}
+
+/**
+ * \brief The slots visited by one thread of a parallel operation.
+ */
+typedef struct{
+    const HT_hash_table *_table;/**<- The hash table. */
+    unsigned int _begin,        /**<- The first slot of the range in _slots. */
+                 _end,          /**<- The slot after the range in _slots. */
+                 _new_begin,    /**<- The first slot of the range in _new_slots. */
+                 _new_end;      /**<- The slot after the range in _new_slots. */
+    HT_foreach_function _foreach;/**<- The function of a foreach. */
+    HT_reduce_function _reduce; /**<- The function of a reduce. */
+    void *_data;                /**<- The data of a foreach, the accumulator of a reduce. */
+    int *_stop;                 /**<- Shared by the threads of a foreach, the value that stopped it. */
+} HT_slot_job;
+
+/**
+ * \brief Split the slots of a hash table in ranges, one per thread.
+ * \param ht A pointer to the hash table.
+ * \param nb_threads The number of threads asked, 0 for one per online processor.
+ * \param jobs Set to the ranges, ::HT_BULK_MAX_THREADS at most.
+ * \return The number of ranges.
+ * \note During a resize both slot arrays are split, the migrated slots are empty.
+ */
+static unsigned int HT_split_slots(const HT_hash_table* const ht, unsigned int nb_threads, HT_slot_job jobs[]){
+    unsigned int i;
+    nb_threads = HT_nb_threads(nb_threads, (size_t) ht->_nb_slots + ht->_nb_new_slots, HT_PARALLEL_SLOTS_PER_THREAD);
+    memset(jobs, 0, nb_threads * sizeof(jobs[0]));
+    for(i = 0; i < nb_threads; ++i){
+        jobs[i]._table = ht;
+        jobs[i]._begin = (unsigned int) ((uint64_t) ht->_nb_slots * i / nb_threads);
+        jobs[i]._end = (unsigned int) ((uint64_t) ht->_nb_slots * (i + 1) / nb_threads);
+        jobs[i]._new_begin = (unsigned int) ((uint64_t) ht->_nb_new_slots * i / nb_threads);
+        jobs[i]._new_end = (unsigned int) ((uint64_t) ht->_nb_new_slots * (i + 1) / nb_threads);
+    }
+    return nb_threads;
+}
+
+/**
+ * \brief Empty a range of slots.
+ * \param ht A pointer to the hash table.
+ * \param slots The slot array.
+ * \param begin The first slot of the range.
+ * \param end The slot after the range.
+ */
+static void HT_reset_slots(const HT_hash_table* const ht, HT_slot* const slots, const unsigned int begin, const unsigned int end){
+    unsigned int i;
+    if( ht->_allocator.reset != NULL ){ // The allocator takes back every pair at once
+        if( ht->_has_taken ){
+            for(i = begin; i < end; ++i)
+                HT_release_taken(ht, &slots[i]);
+        }
+        memset(&slots[begin], 0, (end - begin) * sizeof(HT_slot));
+    }
+    else{
+        for(i = begin; i < end; ++i)
+            HT_destroy_slot_content(&ht->_allocator, ht->free_function, &slots[i]);
+    }
+}
+
+/**
+ * \brief Empty the slots of a job.
+ * \param job_pointer A pointer to the HT_slot_job.
+ * \return NULL.
+ */
+static void* HT_reset_range(void* job_pointer){
+    HT_slot_job *job = job_pointer;
+    HT_reset_slots(job->_table, job->_table->_slots, job->_begin, job->_end);
+    if( job->_table->_new_slots != NULL )
+        HT_reset_slots(job->_table, job->_table->_new_slots, job->_new_begin, job->_new_end);
+    return NULL;
+}
+
+void HT_parallel_reset_table(HT_hash_table* const ht, unsigned int nb_threads){
+    HT_slot_job jobs[HT_BULK_MAX_THREADS];
+    if( ht != NULL && ht->_nb_slots != 0 ){
+        if( ht->_robin != NULL )
+            HT_robin_reset_table(ht->_robin);
+        nb_threads = HT_split_slots(ht, nb_threads, jobs);
+        HT_run_jobs(jobs, sizeof(jobs[0]), nb_threads, HT_reset_range);
+        if( ht->_allocator.reset != NULL )
+            ht->_allocator.reset(ht->_allocator.context);
+        if( ht->_new_slots != NULL ){
+            ht->_rehash_index = ht->_nb_slots;
+            HT_rehash_step(ht, 0);
+        }
+        ht->_nb_elements = 0;
+        ht->_reseed_threshold = 0;
+        ht->_has_taken = 0;
+    }
+}
+
+void HT_parallel_delete(HT_hash_table* const ht, const unsigned int nb_threads){
+    if( ht != NULL && ht->_nb_slots != 0 ){
+        HT_parallel_reset_table(ht, nb_threads);
+        free(ht->_slots);
+        if( ht->_robin != NULL ){
+            HT_robin_delete_pointer(ht->_robin);
+            ht->_robin = NULL;
+        }
+    }
+}
+
+/**
+ * \brief Call the function of a foreach on the elements of a range of slots.
+ * \param job The job.
+ * \param slots The slot array.
+ * \param begin The first slot of the range.
+ * \param end The slot after the range.
+ * \retval 0 If the whole range was visited.
+ * \retval 1 If the foreach is stopped.
+ */
+static int HT_foreach_slots(HT_slot_job* const job, const HT_slot* const slots, const unsigned int begin, const unsigned int end){
+    HT_pair *pair;
+    unsigned int i;
+    int retval,
+        expected;
+    for(i = begin; i < end; ++i){
+        for(pair = slots[i]._first_pair; pair != NULL; pair = pair->_next){
+            if( __atomic_load_n(job->_stop, __ATOMIC_RELAXED) != 0 )
+                return 1;
+            retval = job->_foreach(pair->_key._buffer, pair->_key._size_buffer, pair->_value._buffer, pair->_value._size_buffer, job->_data);
+            if( retval != 0 ){ // The first thread to stop gives the return value
+                expected = 0;
+                __atomic_compare_exchange_n(job->_stop, &expected, retval, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Run a foreach on the slots of a job.
+ * \param job_pointer A pointer to the HT_slot_job.
+ * \return NULL.
+ */
+static void* HT_foreach_range(void* job_pointer){
+    HT_slot_job *job = job_pointer;
+    if( HT_foreach_slots(job, job->_table->_slots, job->_begin, job->_end) == 0 && job->_table->_new_slots != NULL )
+        HT_foreach_slots(job, job->_table->_new_slots, job->_new_begin, job->_new_end);
+    return NULL;
+}
+
+int HT_parallel_foreach(const HT_hash_table* const ht, HT_foreach_function function, void* data, unsigned int nb_threads){
+    HT_slot_job jobs[HT_BULK_MAX_THREADS];
+    unsigned int i;
+    int stop = 0;
+
+    if( ht == NULL || function == NULL || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+    nb_threads = HT_split_slots(ht, nb_threads, jobs);
+    for(i = 0; i < nb_threads; ++i){
+        jobs[i]._foreach = function;
+        jobs[i]._data = data;
+        jobs[i]._stop = &stop;
+    }
+    HT_run_jobs(jobs, sizeof(jobs[0]), nb_threads, HT_foreach_range);
+    return stop;
+}
+
+/**
+ * \brief Fold the elements of a range of slots into the accumulator of a job.
+ * \param job The job.
+ * \param slots The slot array.
+ * \param begin The first slot of the range.
+ * \param end The slot after the range.
+ */
+static void HT_reduce_slots(HT_slot_job* const job, const HT_slot* const slots, const unsigned int begin, const unsigned int end){
+    const HT_pair *pair;
+    unsigned int i;
+    for(i = begin; i < end; ++i){
+        for(pair = slots[i]._first_pair; pair != NULL; pair = pair->_next)
+            job->_reduce(pair->_key._buffer, pair->_key._size_buffer, pair->_value._buffer, pair->_value._size_buffer, job->_data);
+    }
+}
+
+/**
+ * \brief Run a reduce on the slots of a job.
+ * \param job_pointer A pointer to the HT_slot_job.
+ * \return NULL.
+ */
+static void* HT_reduce_range(void* job_pointer){
+    HT_slot_job *job = job_pointer;
+    HT_reduce_slots(job, job->_table->_slots, job->_begin, job->_end);
+    if( job->_table->_new_slots != NULL )
+        HT_reduce_slots(job, job->_table->_new_slots, job->_new_begin, job->_new_end);
+    return NULL;
+}
+
+/**
+ * \brief The alignment of the accumulators of a reduce, the size of a cache line.
+ */
+#define HT_REDUCE_ACCUMULATOR_ALIGNMENT 64
+
+int HT_parallel_reduce(const HT_hash_table* const ht, HT_reduce_function reduce, HT_combine_function combine, void* result, const size_t result_size, unsigned int nb_threads){
+    HT_slot_job jobs[HT_BULK_MAX_THREADS];
+    void *buffer;
+    char *accumulators;
+    size_t stride;
+    unsigned int i;
+
+    if( ht == NULL || reduce == NULL || combine == NULL || result == NULL || result_size == 0 || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+    // Each accumulator on its own cache lines, the threads never write to a shared one
+    stride = (result_size + HT_REDUCE_ACCUMULATOR_ALIGNMENT - 1) / HT_REDUCE_ACCUMULATOR_ALIGNMENT * HT_REDUCE_ACCUMULATOR_ALIGNMENT;
+    nb_threads = HT_split_slots(ht, nb_threads, jobs);
+    if( posix_memalign(&buffer, HT_REDUCE_ACCUMULATOR_ALIGNMENT, stride * nb_threads) != 0 ){
+        errno = ENOMEM;
+        return 2;
+    }
+    accumulators = buffer;
+    for(i = 0; i < nb_threads; ++i){
+        jobs[i]._reduce = reduce;
+        jobs[i]._data = &accumulators[stride * i];
+        memcpy(jobs[i]._data, result, result_size);
+    }
+    HT_run_jobs(jobs, sizeof(jobs[0]), nb_threads, HT_reduce_range);
+    for(i = 0; i < nb_threads; ++i)
+        combine(result, jobs[i]._data);
+    free(accumulators);
+    return 0;
+}
+
+/**
+ * \brief A range of source slots merged by one thread.
+ */
+typedef struct{
+    HT_hash_table *_destination;/**<- The hash table receiving the elements. */
+    HT_hash_table *_source;     /**<- The hash table giving the elements. */
+    unsigned int _policy;       /**<- The merge policy. */
+    int _move,                  /**<- True if the pairs are relinked, false if they are copied. */
+        _same_hash;             /**<- True if the hashes of the source are valid in destination. */
+    unsigned int _begin,        /**<- The first source slot of the range. */
+                 _end;          /**<- The source slot after the range. */
+    size_t _added,              /**<- The number of elements added to destination. */
+           _removed;            /**<- The number of elements removed from source. */
+    int _errno;                 /**<- The error stopping the range, 0 if none. */
+} HT_merge_job;
+
+/**
+ * \brief A free function keeping the buffer, for the pairs whose taken buffers are given to a copy.
+ * \param buffer Unused.
+ */
+static void HT_keep_buffer(void* buffer){
+    (void) buffer;
+}
+
+/**
+ * \brief Move the pairs of a range of source slots into the destination.
+ * \param job_pointer A pointer to the HT_merge_job.
+ * \return NULL.
+ */
+static void* HT_merge_range(void* job_pointer){
+    HT_merge_job *job = job_pointer;
+    HT_hash_table *destination = job->_destination,
+                  *source = job->_source;
+    HT_slot *slot,
+            *destination_slot;
+    HT_pair *pair,
+            *next,
+            *match,
+            *moved;
+    uint64_t hash;
+    unsigned int i;
+
+    for(i = job->_begin; i < job->_end && job->_errno == 0; ++i){
+        slot = &source->_slots[i];
+        for(pair = slot->_first_pair; pair != NULL; pair = next){
+            next = pair->_next;
+            hash = job->_same_hash ? pair->_hash : HT_hash_key(destination, pair->_key._buffer, pair->_key._size_buffer);
+            destination_slot = &destination->_slots[HT_hash_fold(hash, destination->_slot_bits)];
+            match = NULL;
+            if( job->_policy != HT_MERGE_APPEND ){
+                for(match = destination_slot->_first_pair; match != NULL; match = match->_next){
+                    if( has_same_key(match, hash, pair->_key._buffer, pair->_key._size_buffer) )
+                        break;
+                }
+            }
+
+            if( match != NULL && job->_policy == HT_MERGE_KEEP )
+                HT_destroy_pair(&source->_allocator, source->free_function, pair);
+            else{
+                if( job->_move )
+                    moved = pair;
+                else{
+                    moved = HT_new_pair_mode(&destination->_allocator, pair->_key._buffer, pair->_key._size_buffer,
+                            pair->_value._buffer, pair->_value._size_buffer, HT_pair_mode(pair));
+                    if( moved == NULL ){ // The rest of the chain stays in the source
+                        job->_errno = errno;
+                        pair->_previous = NULL;
+                        slot->_first_pair = pair;
+                        break;
+                    }
+                    // The copy took over the taken buffers
+                    HT_destroy_pair(&source->_allocator, HT_keep_buffer, pair);
+                }
+                moved->_hash = hash;
+                if( match != NULL ){
+                    add_pair_in_pair_chain(moved, match, 0);
+                    if( moved->_next == NULL )
+                        destination_slot->_last_pair = moved;
+                    if( match == destination_slot->_first_pair )
+                        destination_slot->_first_pair = moved;
+                    remove_pair_in_pair_chain(match);
+                    HT_destroy_pair(&destination->_allocator, destination->free_function, match);
+                }
+                else{
+                    HT_slot_append_pair(destination_slot, moved);
+                    ++job->_added;
+                }
+            }
+            ++job->_removed;
+        }
+        if( job->_errno == 0 ){
+            slot->_first_pair = NULL;
+            slot->_last_pair = NULL;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * \brief Test if two allocators are the same.
+ * \param a The first allocator.
+ * \param b The second allocator.
+ */
+static inline int HT_same_allocator(const HT_allocator* const a, const HT_allocator* const b){
+    return a->allocate == b->allocate && a->release == b->release &&
+        a->reset == b->reset && a->context == b->context;
+}
+
+int HT_merge(HT_hash_table* const destination, HT_hash_table* const source, const unsigned int policy, unsigned int nb_threads){
+    HT_merge_job jobs[HT_BULK_MAX_THREADS];
+    unsigned int i,
+                 max_threads;
+    int same_hash,
+        retval = 0;
+
+    if( destination == NULL || source == NULL || destination == source || policy > HT_MERGE_APPEND ||
+            destination->_robin != NULL || source->_robin != NULL ||
+            ( source->_has_taken && source->free_function != destination->free_function ) ){
+        errno = EINVAL;
+        return 2;
+    }
+    if( source->_nb_elements == 0 )
+        return 0;
+
+    HT_rehash_step(source, UINT_MAX);
+    HT_bulk_reserve(destination, destination->_nb_elements + source->_nb_elements);
+    same_hash = destination->hash_function == source->hash_function &&
+        destination->seeded_hash_function == source->seeded_hash_function &&
+        ( source->seeded_hash_function == NULL ||
+          ( destination->_seed[0] == source->_seed[0] && destination->_seed[1] == source->_seed[1] ) );
+
+    // A power of two number of ranges of the folded hashes, each covering
+    // whole slots of both tables
+    max_threads = 1;
+    if( same_hash ){
+        nb_threads = HT_nb_threads(nb_threads,
+                source->_nb_slots < destination->_nb_slots ? source->_nb_slots : destination->_nb_slots,
+                HT_PARALLEL_SLOTS_PER_THREAD);
+        while( max_threads * 2 <= nb_threads )
+            max_threads *= 2;
+    }
+    for(i = 0; i < max_threads; ++i){
+        jobs[i]._destination = destination;
+        jobs[i]._source = source;
+        jobs[i]._policy = policy;
+        jobs[i]._move = HT_same_allocator(&destination->_allocator, &source->_allocator);
+        jobs[i]._same_hash = same_hash;
+        jobs[i]._begin = source->_nb_slots / max_threads * i;
+        jobs[i]._end = source->_nb_slots / max_threads * (i + 1);
+        jobs[i]._added = 0;
+        jobs[i]._removed = 0;
+        jobs[i]._errno = 0;
+    }
+    HT_run_jobs(jobs, sizeof(jobs[0]), max_threads, HT_merge_range);
+
+    for(i = 0; i < max_threads; ++i){
+        destination->_nb_elements += jobs[i]._added;
+        source->_nb_elements -= jobs[i]._removed;
+        if( jobs[i]._errno != 0 ){
+            errno = jobs[i]._errno;
+            retval = 2;
+        }
+    }
+    destination->_has_taken |= source->_has_taken;
+    return retval;
+}
+
+/**
+ * \brief Get the memory asked to the allocator by a pair.
+ * \param p The pair.
+ * \note A pair of a bulk build accounts for its share of the block.
+ */
+static size_t HT_pair_footprint(const HT_pair* const p){
+    unsigned int mode;
+    size_t size = sizeof(HT_pair);
+    if( HT_pair_in_block(p) )
+        return HT_block_pair_size(p->_key._size_buffer, p->_value._size_buffer);
+    mode = HT_pair_mode(p);
+    if( HT_pair_key_is_inline(p) )
+        size += HT_inline_key_room(p->_key._size_buffer);
+    else if( !(mode & HT_MODE_BORROW_KEY) )
+        size += p->_key._size_buffer;
+    if( !(mode & HT_MODE_BORROW_VALUE) )
+        size += p->_value._size_buffer;
+    if( !HT_pair_key_is_inline(p) || !HT_pair_value_is_inline(p) )
+        size += HT_MODE_WORD_SIZE;
+    if( !HT_pair_key_is_inline(p) && !HT_pair_value_is_inline(p) )
+        size += HT_INLINE_ALIGNMENT;
+    return size;
+}
+
+/**
+ * \brief Add the slots of an array to the stats.
+ * \param slots The slots.
+ * \param nb_slots The number of slots.
+ * \param stats The stats.
+ */
+static void HT_stats_add_slots(const HT_slot* const slots, const unsigned int nb_slots, HT_stats* const stats){
+    const HT_pair *pair;
+    size_t length;
+    unsigned int i;
+
+    stats->nb_slots += nb_slots;
+    stats->allocated_bytes += nb_slots * sizeof(HT_slot);
+    for(i = 0; i < nb_slots; ++i){
+        length = 0;
+        for(pair = slots[i]._first_pair; pair != NULL; pair = pair->_next){
+            ++length;
+            stats->allocated_bytes += HT_pair_footprint(pair);
+        }
+        if( length == 0 )
+            ++stats->nb_empty_slots;
+        if( length > stats->longest_chain )
+            stats->longest_chain = length;
+        ++stats->chain_histogram[length < HT_STATS_HISTOGRAM_SIZE ? length : HT_STATS_HISTOGRAM_SIZE - 1];
+    }
+}
+
+int HT_get_stats(const HT_hash_table* const ht, HT_stats* const stats){
+    if( ht == NULL || stats == NULL || ht->_robin != NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    memset(stats, 0, sizeof(HT_stats));
+    stats->nb_elements = ht->_nb_elements;
+    stats->resizing = ht->_new_slots != NULL;
+    HT_stats_add_slots(ht->_slots, ht->_nb_slots, stats);
+    if( ht->_new_slots != NULL ){
+        // The empty old slots were migrated, they do not count
+        stats->nb_empty_slots -= ht->_rehash_index;
+        stats->chain_histogram[0] -= ht->_rehash_index;
+        stats->nb_slots -= ht->_rehash_index;
+        HT_stats_add_slots(ht->_new_slots, ht->_nb_new_slots, stats);
+    }
+    if( stats->nb_slots != 0 )
+        stats->load_factor = (double) stats->nb_elements / (double) stats->nb_slots;
+    if( stats->nb_slots != stats->nb_empty_slots )
+        stats->average_chain = (double) stats->nb_elements / (double) (stats->nb_slots - stats->nb_empty_slots);
     return 0;
 }
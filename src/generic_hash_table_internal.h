@@ -0,0 +1,287 @@
+/**
+ * \file generic_hash_table_internal.h
+ * \brief Slot level functions shared by the hash table implementations.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __GENERIC_HASH_TABLE_INTERNAL_H
+#define __GENERIC_HASH_TABLE_INTERNAL_H
+
+#include "generic_hash_table.h"
+
+/**
+ * \brief The allocator used when none is given to the table.
+ */
+extern const HT_allocator HT_default_allocator;
+
+/**
+ * \brief Store a link of a chain so that a concurrent reader loading it with
+ * acquire semantics sees the pointed pair fully initialised.
+ */
+#define HT_PUBLISH(link, pair) __atomic_store_n(&(link), (pair), __ATOMIC_RELEASE)
+
+#ifdef HT_STATS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+/**
+ * \brief Read the clock timing the hash function, the time stamp counter.
+ */
+#define HT_STATS_TICKS() ((uint64_t) __rdtsc())
+#else
+#include <time.h>
+
+/**
+ * \brief Read the clock timing the hash function, in nanoseconds without a time stamp counter.
+ */
+static inline uint64_t HT_stats_ticks(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * UINT64_C(1000000000) + (uint64_t) t.tv_nsec;
+}
+
+#define HT_STATS_TICKS() HT_stats_ticks()
+#endif
+
+/**
+ * \brief The counters of the current thread, NULL until its first count.
+ */
+extern __thread HT_counters *HT_counters_self;
+
+/**
+ * \brief Give the current thread its counters.
+ * \return The counters, NULL on allocation failure.
+ */
+HT_counters* HT_counters_register(void);
+
+/**
+ * \brief Add to a counter of the current thread.
+ * \param field The name of the ::HT_counters field.
+ * \param n The amount.
+ * \note Only the owner writes a counter, a relaxed load and store is enough.
+ */
+#define HT_COUNT(field, n) do{                                                  \
+    HT_counters *HT_self = HT_counters_self != NULL ? HT_counters_self : HT_counters_register(); \
+    if( HT_self != NULL )                                                       \
+        __atomic_store_n(&HT_self->field, __atomic_load_n(&HT_self->field, __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED); \
+}while(0)
+
+#else
+
+#define HT_COUNT(field, n) ((void) 0)
+
+#endif // ( HT_STATS )
+
+/**
+ * \brief Draw a random seed for a seeded hash function.
+ * \param seed Set to the seed.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ * \note getrandom is used where the C library has it, /dev/urandom otherwise.
+ */
+int HT_random_seed(uint64_t seed[2]);
+
+/**
+ * \brief Hash a key with the seeded hash function of a table if it has one.
+ * \param ht A pointer to the hash table.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ */
+static inline uint64_t HT_call_hash(const HT_hash_table* const ht, const void* const key, const size_t key_size){
+    if( ht->seeded_hash_function != NULL )
+        return ht->seeded_hash_function(key, key_size, ht->_seed);
+    return ht->hash_function(key, key_size);
+}
+
+/**
+ * \brief Hash a key with the hash function of a table, counting and timing it with HT_STATS.
+ * \param ht A pointer to the hash table.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ */
+static inline uint64_t HT_hash_key(const HT_hash_table* const ht, const void* const key, const size_t key_size){
+#ifdef HT_STATS
+    if( HT_counters_self != NULL && HT_counters_self->hashes % HT_STATS_HASH_SAMPLING == 0 ){
+        const uint64_t begin = HT_STATS_TICKS(),
+                       hash = HT_call_hash(ht, key, key_size);
+        HT_COUNT(hash_cycles, (HT_STATS_TICKS() - begin) * HT_STATS_HASH_SAMPLING);
+        HT_COUNT(hashes, 1);
+        return hash;
+    }
+    HT_COUNT(hashes, 1);
+#endif
+    return HT_call_hash(ht, key, key_size);
+}
+
+/**
+ * \brief Creates a pair, not linked to any slot.
+ * \param allocator The allocator providing the memory
+ * \param key The key to add to the pair
+ * \param key_size The size of the key
+ * \param value The value to add to the pair
+ * \param value_size The size of the value
+ * \return The pair, its hash is not set.
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_pair* HT_new_pair(const HT_allocator* allocator, const void* key, const size_t key_size, const void* value, const size_t value_size);
+
+/**
+ * \brief Creates a pair taking or borrowing its buffers, not linked to any slot.
+ * \param allocator The allocator providing the memory
+ * \param key The key to add to the pair
+ * \param key_size The size of the key
+ * \param value The value to add to the pair
+ * \param value_size The size of the value
+ * \param mode The flags of ::HT_add_element_mode.
+ * \return The pair, its hash is not set.
+ * \retval NULL On failure and errno is set appropriately.
+ */
+HT_pair* HT_new_pair_mode(const HT_allocator* allocator, const void* key, const size_t key_size, const void* value, const size_t value_size, const unsigned int mode);
+
+/**
+ * \brief Destroy a pair
+ * \param allocator The allocator that provided the memory.
+ * \param free_function The function releasing the taken buffers, NULL for free.
+ * \param p The pair to destroy.
+ */
+void HT_destroy_pair(const HT_allocator* allocator, HT_free_function free_function, HT_pair* p);
+
+/**
+ * \brief Get the pair matching the key that is the position th one in the list.
+ * \param slot The slot to search inside
+ * \param hash The hash of the key
+ * \param key The key
+ * \param key_size The size of the key
+ * \param position The position wanted
+ * \param reverse Search first from end or start
+ * \return The matching pair, the last match if there are less than position
+ * matches, NULL if there is none.
+ */
+HT_pair * HT_get_pair(const HT_slot *slot, const uint64_t hash, const void *key, const size_t key_size, unsigned int position, int reverse);
+
+/**
+ * \brief Create a pair and link it in a slot like ::HT_add_element_position.
+ * \param allocator The allocator providing the memory
+ * \param slot The slot of the key
+ * \param hash The hash of the key
+ * \param key The key
+ * \param key_size The size of the key
+ * \param value The value
+ * \param value_size The size of the value
+ * \param position The number of match before the new pair
+ * \param reverse Count the matches from the end
+ * \param mode The flags of ::HT_add_element_mode.
+ * \retval 0 On success.
+ * \retval 2 On failure and errno is set appropriately.
+ */
+int HT_slot_insert(const HT_allocator* allocator, HT_slot* slot, const uint64_t hash, const void* key, const size_t key_size, const void* value, const size_t value_size, unsigned int position, int reverse, const unsigned int mode);
+
+/**
+ * \brief Unlink a pair from a slot without destroying it.
+ * \param slot The slot of the key
+ * \param hash The hash of the key
+ * \param key The key
+ * \param key_size The size of the key
+ * \param position The number of match before the pair
+ * \param reverse Count the matches from the end
+ * \return The unlinked pair, its own links still point inside of the chain.
+ * \retval NULL If the key is not found.
+ */
+HT_pair* HT_slot_unlink(HT_slot* slot, const uint64_t hash, const void* key, const size_t key_size, unsigned int position, int reverse);
+
+/**
+ * \brief Unlink a pair from a slot and destroy it like ::HT_remove_element_position.
+ * \param allocator The allocator that provided the pair
+ * \param free_function The function releasing the taken buffers, NULL for free.
+ * \param slot The slot of the key
+ * \param hash The hash of the key
+ * \param key The key
+ * \param key_size The size of the key
+ * \param position The number of match before the pair
+ * \param reverse Count the matches from the end
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ */
+int HT_slot_remove(const HT_allocator* allocator, HT_free_function free_function, HT_slot* slot, const uint64_t hash, const void* key, const size_t key_size, unsigned int position, int reverse);
+
+/**
+ * \brief Link an existing pair at the end of a slot.
+ * \param slot The slot.
+ * \param pair The pair, unlinked from its previous slot.
+ */
+void HT_slot_append_pair(HT_slot* slot, HT_pair* pair);
+
+/**
+ * \brief Find an element of a key already hashed, see ::HT_get_element_position.
+ * \param ht A pointer to the hash table.
+ * \param hash The hash of the key given by the hash function of ht.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param position The number of match before returning the pair.
+ * \param reverse 0 to search from begin to end and any other integer otherwise.
+ * \return The pair, NULL if the key is not found.
+ */
+HT_pair* HT_find_pair(const HT_hash_table* ht, const uint64_t hash, const void* key, const size_t key_size, unsigned int position, int reverse);
+
+/**
+ * \brief Add an element of a key already hashed, see ::HT_add_element_position.
+ * \pre The arguments are valid.
+ * \retval 0 On success.
+ * \retval 2 On error and errno is set appropriately.
+ */
+int HT_insert_hashed(HT_hash_table* ht, const uint64_t hash, const void* key, const size_t key_size, const void* value, const size_t value_size, unsigned int position, int reverse);
+
+/**
+ * \brief Get the first element of a key already hashed or add it, see ::HT_find_or_insert.
+ * \param inserted Set to true if the element is added.
+ * \pre The arguments are valid.
+ * \return The pair of the key, NULL on error and errno is set appropriately.
+ */
+HT_pair* HT_find_or_insert_hashed(HT_hash_table* ht, const uint64_t hash, const void* key, const size_t key_size, const void* value, const size_t value_size, int* inserted);
+
+/**
+ * \brief Remove an element of a key already hashed, see ::HT_remove_element_position.
+ * \pre The arguments are valid.
+ * \retval 0 On success.
+ * \retval 1 If the key is not found.
+ */
+int HT_remove_hashed(HT_hash_table* ht, const uint64_t hash, const void* key, const size_t key_size, unsigned int position, int reverse);
+
+/**
+ * \brief Migrate slots of a resize in progress.
+ * \param ht A pointer to the hash table.
+ * \param nb_slots The number of old slots to migrate.
+ */
+void HT_rehash_slots(HT_hash_table* ht, const unsigned int nb_slots);
+
+/**
+ * \brief Delete the content of a slot.
+ * \param allocator The allocator that provided the memory.
+ * \param free_function The function releasing the taken buffers, NULL for free.
+ * \param slot A pointer to the slot to reset.
+ */
+void HT_destroy_slot_content(const HT_allocator* allocator, HT_free_function free_function, HT_slot* slot);
+
+#endif // ( __GENERIC_HASH_TABLE_INTERNAL_H )
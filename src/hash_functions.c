@@ -0,0 +1,371 @@
+/**
+ * \file hash_functions.c
+ * \brief Ready to use hash functions implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+// HT_HASH_PORTABLE keeps to the portable code, whatever the processor
+#if ( defined(__x86_64__) || defined(__i386__) ) && !defined(HT_HASH_PORTABLE)
+#include <nmmintrin.h>
+#define HT_HAS_CRC32C_INSTRUCTION
+#endif
+
+#include "hash_functions.h"
+
+/**
+ * \brief Read 8 bytes without alignment requirement.
+ * \param p The bytes.
+ */
+static inline uint64_t HT_read64(const unsigned char* p){
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * \brief Read 4 bytes without alignment requirement.
+ * \param p The bytes.
+ */
+static inline uint64_t HT_read32(const unsigned char* p){
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * \brief Rotate the bits of a word to the left.
+ * \param x The word.
+ * \param r The rotation, between 1 and 63.
+ */
+static inline uint64_t HT_rotl64(const uint64_t x, const unsigned int r){
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * \brief Multiply two words and give back the low and high part of the product.
+ * \param a The first word, set to the low part.
+ * \param b The second word, set to the high part.
+ */
+static inline void HT_mum(uint64_t* a, uint64_t* b){
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 HT_uint128;
+    HT_uint128 r = (HT_uint128) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b,
+             rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb,
+             t = rl + (rm0 << 32),
+             c = t < rl,
+             lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/**
+ * \brief Multiply two words and fold the 128 bits product.
+ * \param a The first word.
+ * \param b The second word.
+ */
+static inline uint64_t HT_mix(uint64_t a, uint64_t b){
+    HT_mum(&a, &b);
+    return a ^ b;
+}
+
+/**
+ * \brief The constants of wyhash.
+ */
+static const uint64_t HT_wy_secret[4] = {
+    UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47)
+};
+
+/**
+ * \brief wyhash of a key.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param seed The seed of the hash.
+ */
+static uint64_t HT_wyhash(const void* const key, const size_t key_size, uint64_t seed){
+    const unsigned char *p = key;
+    const uint64_t *s = HT_wy_secret;
+    size_t i = key_size;
+    uint64_t a, b;
+
+    seed ^= HT_mix(seed ^ s[0], s[1]);
+    if( key_size <= 16 ){
+        if( key_size >= 4 ){
+            a = (HT_read32(p) << 32) | HT_read32(p + ((key_size >> 3) << 2));
+            b = (HT_read32(p + key_size - 4) << 32) | HT_read32(p + key_size - 4 - ((key_size >> 3) << 2));
+        }
+        else if( key_size > 0 ){
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[key_size >> 1] << 8) | p[key_size - 1];
+            b = 0;
+        }
+        else
+            a = b = 0;
+    }
+    else{
+        if( i > 48 ){
+            uint64_t see1 = seed,
+                     see2 = seed;
+            do{
+                seed = HT_mix(HT_read64(p) ^ s[1], HT_read64(p + 8) ^ seed);
+                see1 = HT_mix(HT_read64(p + 16) ^ s[2], HT_read64(p + 24) ^ see1);
+                see2 = HT_mix(HT_read64(p + 32) ^ s[3], HT_read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            }
+            while( i > 48 );
+            seed ^= see1 ^ see2;
+        }
+        while( i > 16 ){
+            seed = HT_mix(HT_read64(p) ^ s[1], HT_read64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = HT_read64(p + i - 16);
+        b = HT_read64(p + i - 8);
+    }
+    a ^= s[1];
+    b ^= seed;
+    HT_mum(&a, &b);
+    return HT_mix(a ^ s[0] ^ key_size, b ^ s[1]);
+}
+
+uint64_t HT_hash_wy(const void* const key, const size_t key_size){
+    return HT_wyhash(key, key_size, 0);
+}
+
+uint64_t HT_hash_u64(const void* const key, const size_t key_size){
+    if( key_size != sizeof(uint64_t) )
+        return HT_wyhash(key, key_size, 0);
+    return HT_hash_mix64(HT_read64(key));
+}
+
+#define HT_XXH_P1 UINT64_C(11400714785074694791)
+#define HT_XXH_P2 UINT64_C(14029467366897019727)
+#define HT_XXH_P3 UINT64_C(1609587929392839161)
+#define HT_XXH_P4 UINT64_C(9650029242287828579)
+#define HT_XXH_P5 UINT64_C(2870177450012600261)
+
+/**
+ * \brief Accumulate 8 bytes in a lane of xxHash64.
+ * \param acc The lane.
+ * \param input The bytes.
+ */
+static inline uint64_t HT_xxh_round(uint64_t acc, const uint64_t input){
+    acc += input * HT_XXH_P2;
+    acc = HT_rotl64(acc, 31);
+    return acc * HT_XXH_P1;
+}
+
+/**
+ * \brief Merge a lane in the xxHash64 result.
+ * \param acc The result.
+ * \param lane The lane.
+ */
+static inline uint64_t HT_xxh_merge(uint64_t acc, const uint64_t lane){
+    acc ^= HT_xxh_round(0, lane);
+    return acc * HT_XXH_P1 + HT_XXH_P4;
+}
+
+/**
+ * \brief xxHash64 of a key.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ * \param seed The seed of the hash.
+ */
+static uint64_t HT_xxh64(const void* const key, const size_t key_size, const uint64_t seed){
+    const unsigned char *p = key,
+                        *end = p + key_size;
+    uint64_t h;
+
+    if( key_size >= 32 ){
+        const unsigned char *limit = end - 32;
+        uint64_t v1 = seed + HT_XXH_P1 + HT_XXH_P2,
+                 v2 = seed + HT_XXH_P2,
+                 v3 = seed,
+                 v4 = seed - HT_XXH_P1;
+        do{
+            v1 = HT_xxh_round(v1, HT_read64(p));
+            v2 = HT_xxh_round(v2, HT_read64(p + 8));
+            v3 = HT_xxh_round(v3, HT_read64(p + 16));
+            v4 = HT_xxh_round(v4, HT_read64(p + 24));
+            p += 32;
+        }
+        while( p <= limit );
+        h = HT_rotl64(v1, 1) + HT_rotl64(v2, 7) + HT_rotl64(v3, 12) + HT_rotl64(v4, 18);
+        h = HT_xxh_merge(h, v1);
+        h = HT_xxh_merge(h, v2);
+        h = HT_xxh_merge(h, v3);
+        h = HT_xxh_merge(h, v4);
+    }
+    else
+        h = seed + HT_XXH_P5;
+
+    h += key_size;
+    for(; p + 8 <= end; p += 8){
+        h ^= HT_xxh_round(0, HT_read64(p));
+        h = HT_rotl64(h, 27) * HT_XXH_P1 + HT_XXH_P4;
+    }
+    if( p + 4 <= end ){
+        h ^= HT_read32(p) * HT_XXH_P1;
+        h = HT_rotl64(h, 23) * HT_XXH_P2 + HT_XXH_P3;
+        p += 4;
+    }
+    for(; p < end; ++p){
+        h ^= *p * HT_XXH_P5;
+        h = HT_rotl64(h, 11) * HT_XXH_P1;
+    }
+
+    h ^= h >> 33;
+    h *= HT_XXH_P2;
+    h ^= h >> 29;
+    h *= HT_XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t HT_hash_xxh64(const void* const key, const size_t key_size){
+    return HT_xxh64(key, key_size, 0);
+}
+
+uint64_t HT_hash_wy_seeded(const void* const key, const size_t key_size, const uint64_t seed[2]){
+    return HT_wyhash(key, key_size, seed[0] ^ HT_rotl64(seed[1], 32));
+}
+
+uint64_t HT_hash_xxh64_seeded(const void* const key, const size_t key_size, const uint64_t seed[2]){
+    return HT_xxh64(key, key_size, seed[0] ^ HT_rotl64(seed[1], 32));
+}
+
+/**
+ * \brief The number of rounds of SipHash per 8 bytes of key.
+ */
+#ifndef HT_SIP_COMPRESSION_ROUNDS
+#define HT_SIP_COMPRESSION_ROUNDS 1
+#endif
+
+/**
+ * \brief The number of rounds of SipHash after the last bytes of key.
+ */
+#ifndef HT_SIP_FINALIZATION_ROUNDS
+#define HT_SIP_FINALIZATION_ROUNDS 3
+#endif
+
+/**
+ * \brief Run rounds of SipHash on its state.
+ * \param v The four words of the state.
+ * \param nb_rounds The number of rounds.
+ */
+static inline void HT_sip_rounds(uint64_t v[4], unsigned int nb_rounds){
+    for(; nb_rounds != 0; --nb_rounds){
+        v[0] += v[1]; v[1] = HT_rotl64(v[1], 13); v[1] ^= v[0]; v[0] = HT_rotl64(v[0], 32);
+        v[2] += v[3]; v[3] = HT_rotl64(v[3], 16); v[3] ^= v[2];
+        v[0] += v[3]; v[3] = HT_rotl64(v[3], 21); v[3] ^= v[0];
+        v[2] += v[1]; v[1] = HT_rotl64(v[1], 17); v[1] ^= v[2]; v[2] = HT_rotl64(v[2], 32);
+    }
+}
+
+uint64_t HT_hash_sip(const void* const key, const size_t key_size, const uint64_t seed[2]){
+    const unsigned char *p = key;
+    uint64_t v[4] = {
+        seed[0] ^ UINT64_C(0x736f6d6570736575),
+        seed[1] ^ UINT64_C(0x646f72616e646f6d),
+        seed[0] ^ UINT64_C(0x6c7967656e657261),
+        seed[1] ^ UINT64_C(0x7465646279746573),
+    };
+    uint64_t m;
+    size_t left,
+           i;
+
+    for(left = key_size; left >= 8; left -= 8, p += 8){
+        m = HT_read64(p);
+        v[3] ^= m;
+        HT_sip_rounds(v, HT_SIP_COMPRESSION_ROUNDS);
+        v[0] ^= m;
+    }
+    m = (uint64_t) key_size << 56;
+    for(i = 0; i < left; ++i)
+        m |= (uint64_t) p[i] << (8 * i);
+    v[3] ^= m;
+    HT_sip_rounds(v, HT_SIP_COMPRESSION_ROUNDS);
+    v[0] ^= m;
+    v[2] ^= 0xff;
+    HT_sip_rounds(v, HT_SIP_FINALIZATION_ROUNDS);
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+/**
+ * \brief CRC32C of a buffer, one bit at a time.
+ * \param crc The initial CRC.
+ * \param p The bytes.
+ * \param size The number of bytes.
+ */
+static uint32_t HT_crc32c_software(uint32_t crc, const unsigned char* p, size_t size){
+    unsigned int bit;
+    for(; size != 0; --size, ++p){
+        crc ^= *p;
+        for(bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (UINT32_C(0x82F63B78) & (0u - (crc & 1u)));
+    }
+    return crc;
+}
+
+#ifdef HT_HAS_CRC32C_INSTRUCTION
+/**
+ * \brief CRC32C of a buffer, 8 bytes at a time with the SSE 4.2 instruction.
+ * \param crc The initial CRC.
+ * \param p The bytes.
+ * \param size The number of bytes.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t HT_crc32c_sse42(uint32_t crc, const unsigned char* p, size_t size){
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for(; size >= 8; size -= 8, p += 8)
+        crc64 = _mm_crc32_u64(crc64, HT_read64(p));
+    crc = (uint32_t) crc64;
+#endif
+    for(; size >= 4; size -= 4, p += 4)
+        crc = _mm_crc32_u32(crc, (uint32_t) HT_read32(p));
+    for(; size != 0; --size, ++p)
+        crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+#endif
+
+uint64_t HT_hash_crc32c(const void* const key, const size_t key_size){
+    uint32_t crc;
+#ifdef HT_HAS_CRC32C_INSTRUCTION
+    if( __builtin_cpu_supports("sse4.2") )
+        crc = HT_crc32c_sse42(UINT32_MAX, key, key_size);
+    else
+#endif
+        crc = HT_crc32c_software(UINT32_MAX, key, key_size);
+    // Spread the 32 bits over the whole word for the table fold
+    return ((uint64_t) ~crc ^ ((uint64_t) key_size << 32)) * UINT64_C(0x9E3779B97F4A7C15);
+}
@@ -0,0 +1,315 @@
+/**
+ * \file multimap_hash_table.c
+ * \brief Hash table grouping the values of a key implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#include "multimap_hash_table.h"
+#include "generic_hash_table_internal.h"
+
+/**
+ * \brief Get the group of values of a key.
+ * \param pair The pair of the key.
+ */
+static inline HT_value_group* HT_multimap_group(const HT_pair* const pair){
+    HT_value_group *group;
+    memcpy(&group, pair->_value._buffer, sizeof(group));
+    return group;
+}
+
+/**
+ * \brief Allocate a group of values, the values centered in the array.
+ * \param capacity The number of entries of the array.
+ * \param nb_values The number of values the group will hold.
+ * \return The group, its values are not set.
+ * \retval NULL On failure and errno is set appropriately.
+ */
+static HT_value_group* HT_multimap_new_group(const size_t capacity, const size_t nb_values){
+    HT_value_group *group = malloc(sizeof(HT_value_group) + capacity * sizeof(HT_container));
+    if( group == NULL )
+        return NULL;
+    group->_begin = (capacity - nb_values) / 2;
+    group->_nb_values = nb_values;
+    group->_capacity = capacity;
+    return group;
+}
+
+/**
+ * \brief Get the index in a group of the position th value.
+ * \param nb_values The number of values of the group, not 0.
+ * \param position The number of match before the value.
+ * \param reverse Count from the end.
+ * \return The index of the value, the last one if there are less values.
+ */
+static inline size_t HT_multimap_index(const size_t nb_values, const unsigned int position, const int reverse){
+    size_t index = position < nb_values ? position : nb_values - 1;
+    return reverse ? nb_values - 1 - index : index;
+}
+
+/**
+ * \brief Make room for a value in a group.
+ * \param group The group.
+ * \param index The index of the new value, between 0 and the number of values.
+ * \return The group, moved if it had to grow.
+ * \retval NULL On failure and errno is set appropriately, the group is unchanged.
+ * \note The side with the less values to move is shifted. Without room on
+ * that side, the values are copied centered in a new array, twice as big if
+ * the current one is more than half full.
+ */
+static HT_value_group* HT_multimap_open(HT_value_group* group, const size_t index){
+    HT_container *values = &group->_values[group->_begin];
+    const size_t nb_values = group->_nb_values;
+    const int front = index <= nb_values / 2;
+    HT_value_group *moved;
+
+    if( front && group->_begin > 0 ){
+        memmove(values - 1, values, index * sizeof(HT_container));
+        --group->_begin;
+    }
+    else if( !front && group->_begin + nb_values < group->_capacity )
+        memmove(values + index + 1, values + index, (nb_values - index) * sizeof(HT_container));
+    else{
+        moved = HT_multimap_new_group(group->_capacity >= 2 * (nb_values + 1) ? group->_capacity : 2 * nb_values + 2, nb_values + 1);
+        if( moved == NULL )
+            return NULL;
+        memcpy(&moved->_values[moved->_begin], values, index * sizeof(HT_container));
+        memcpy(&moved->_values[moved->_begin + index + 1], values + index, (nb_values - index) * sizeof(HT_container));
+        free(group);
+        return moved;
+    }
+    ++group->_nb_values;
+    return group;
+}
+
+/**
+ * \brief Copy a value in a container.
+ * \param container The container.
+ * \param value The value.
+ * \param value_size The size of the value in bytes.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+static inline int HT_multimap_copy_value(HT_container* const container, const void* const value, const size_t value_size){
+    container->_buffer = malloc(value_size);
+    if( container->_buffer == NULL )
+        return 1;
+    memcpy(container->_buffer, value, value_size);
+    container->_size_buffer = value_size;
+    return 0;
+}
+
+/**
+ * \brief Release a group and its values.
+ * \param group The group.
+ */
+static void HT_multimap_destroy_group(HT_value_group* group){
+    size_t i;
+    for(i = 0; i < group->_nb_values; ++i)
+        free(group->_values[group->_begin + i]._buffer);
+    free(group);
+}
+
+HT_multimap* HT_multimap_new_hash(const unsigned int size, HT_hash_function hash_function){
+    HT_multimap* mmap;
+    int retval;
+    if( size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return NULL;
+    }
+    mmap = malloc(sizeof(HT_multimap));
+    if( mmap == NULL )
+        return NULL;
+    retval = HT_multimap_init(mmap, size, hash_function);
+    if( retval != 0 ){
+        int errno_temp = errno;
+        free( mmap );
+        errno = errno_temp;
+        return NULL;
+    }
+    return mmap;
+}
+
+int HT_multimap_init(HT_multimap* const mm, const unsigned int size, HT_hash_function hash_function){
+    if( mm == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    if( HT_init(&mm->_keys, size, hash_function) != 0 )
+        return 1;
+    mm->_nb_values = 0;
+    return 0;
+}
+
+int HT_multimap_get_element_position(const HT_multimap* mm, const void* key, const size_t key_size, void** value, size_t* value_size, unsigned int position, int reverse){
+    const HT_value_group *group;
+    const HT_container *found;
+    const HT_pair *pair;
+    if( mm == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    pair = HT_find_pair(&mm->_keys, HT_hash_key(&mm->_keys, key, key_size), key, key_size, 0, 0);
+    if( pair == NULL )
+        return 1;
+    if( value != NULL && value_size != NULL ){
+        group = HT_multimap_group(pair);
+        found = &group->_values[group->_begin + HT_multimap_index(group->_nb_values, position, reverse)];
+        *value = found->_buffer;
+        *value_size = found->_size_buffer;
+    }
+    return 0;
+}
+
+int HT_multimap_get_all_values(const HT_multimap* mm, const void* key, const size_t key_size, const HT_container** values, size_t* nb_values){
+    const HT_value_group *group;
+    const HT_pair *pair;
+    if( mm == NULL || key == NULL || key_size == 0 || values == NULL || nb_values == NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+    pair = HT_find_pair(&mm->_keys, HT_hash_key(&mm->_keys, key, key_size), key, key_size, 0, 0);
+    if( pair == NULL )
+        return 1;
+    group = HT_multimap_group(pair);
+    *values = &group->_values[group->_begin];
+    *nb_values = group->_nb_values;
+    return 0;
+}
+
+int HT_multimap_add_element_position(HT_multimap* const mm, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse){
+    HT_value_group *group,
+                   *opened;
+    HT_pair *pair;
+    uint64_t hash;
+    size_t index;
+    if( mm == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = HT_hash_key(&mm->_keys, key, key_size);
+    pair = HT_find_pair(&mm->_keys, hash, key, key_size, 0, 0);
+    if( pair == NULL ){
+        group = HT_multimap_new_group(HT_MULTIMAP_INITIAL_VALUES, 1);
+        if( group == NULL )
+            return 2;
+        if( HT_multimap_copy_value(&group->_values[group->_begin], value, value_size) != 0 ||
+                HT_insert_hashed(&mm->_keys, hash, key, key_size, &group, sizeof(group), 0, 0) != 0 ){
+            int errno_temp = errno;
+            group->_nb_values = group->_values[group->_begin]._buffer == NULL ? 0 : 1;
+            HT_multimap_destroy_group(group);
+            errno = errno_temp;
+            return 2;
+        }
+        ++mm->_nb_values;
+        return 0;
+    }
+
+    // Same place as a new pair of the chained table: the first or last one,
+    // or after the position th match counting from the chosen end
+    group = HT_multimap_group(pair);
+    if( position == 0 )
+        index = reverse ? group->_nb_values : 0;
+    else if( reverse )
+        index = HT_multimap_index(group->_nb_values, position, 1);
+    else
+        index = HT_multimap_index(group->_nb_values, position, 0) + 1;
+
+    opened = HT_multimap_open(group, index);
+    if( opened == NULL )
+        return 2;
+    if( HT_multimap_copy_value(&opened->_values[opened->_begin + index], value, value_size) != 0 ){
+        int errno_temp = errno;
+        // Close the room again, the group keeps its values
+        memmove(&opened->_values[opened->_begin + index], &opened->_values[opened->_begin + index + 1],
+                (opened->_nb_values - index - 1) * sizeof(HT_container));
+        --opened->_nb_values;
+        memcpy(pair->_value._buffer, &opened, sizeof(opened));
+        errno = errno_temp;
+        return 2;
+    }
+    memcpy(pair->_value._buffer, &opened, sizeof(opened));
+    ++mm->_nb_values;
+    return 0;
+}
+
+int HT_multimap_remove_element_position(HT_multimap* mm, const void* key, const size_t key_size, unsigned int position, int reverse){
+    HT_value_group *group;
+    HT_container *values;
+    HT_pair *pair;
+    uint64_t hash;
+    size_t index;
+    if( mm == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = HT_hash_key(&mm->_keys, key, key_size);
+    pair = HT_find_pair(&mm->_keys, hash, key, key_size, 0, 0);
+    if( pair == NULL )
+        return 1;
+    group = HT_multimap_group(pair);
+    --mm->_nb_values;
+    if( group->_nb_values == 1 ){
+        HT_multimap_destroy_group(group);
+        HT_remove_hashed(&mm->_keys, hash, key, key_size, 0, 0);
+        return 0;
+    }
+
+    index = HT_multimap_index(group->_nb_values, position, reverse);
+    values = &group->_values[group->_begin];
+    free(values[index]._buffer);
+    // Shift the side with the less values to move
+    if( index < group->_nb_values / 2 ){
+        memmove(values + 1, values, index * sizeof(HT_container));
+        ++group->_begin;
+    }
+    else
+        memmove(values + index, values + index + 1, (group->_nb_values - index - 1) * sizeof(HT_container));
+    --group->_nb_values;
+    return 0;
+}
+
+void HT_multimap_delete_pointer(HT_multimap* mm){
+    HT_multimap_delete(mm);
+    free(mm);
+}
+
+void HT_multimap_delete(HT_multimap* const mm){
+    if( mm != NULL ){
+        HT_multimap_reset_table(mm);
+        HT_delete(&mm->_keys);
+    }
+}
+
+void HT_multimap_reset_table(HT_multimap* mm){
+    HT_iterator it;
+    if( mm != NULL ){
+        for(HT_iterator_begin(&mm->_keys, &it); !HT_iterator_end(&it); HT_iterator_next(&it))
+            HT_multimap_destroy_group(HT_multimap_group(it._pair));
+        HT_reset_table(&mm->_keys);
+        mm->_nb_values = 0;
+    }
+}
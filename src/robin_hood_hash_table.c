@@ -0,0 +1,512 @@
+/**
+ * \file robin_hood_hash_table.c
+ * \brief Robin Hood hash table implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#include <limits.h>
+#include <stdint.h>
+
+#include "robin_hood_hash_table.h"
+#include "generic_hash_table_internal.h"
+
+#if HT_ROBIN_MAX_PROBES < 1 || HT_ROBIN_MAX_PROBES > UCHAR_MAX
+#error "HT_ROBIN_MAX_PROBES must fit in the distance bytes"
+#endif
+
+/**
+ * \brief The base 2 logarithm of the smallest number of entries.
+ */
+#define HT_ROBIN_MIN_BITS 3
+
+/**
+ * \brief A table is never grown below one entry in use out of this number,
+ * beyond that the keys share too many hash bits for a bigger table to help.
+ */
+#define HT_ROBIN_MIN_FILL 16
+
+/**
+ * \brief The alignment of a value, stored after its key in the same buffer.
+ */
+#define HT_ROBIN_VALUE_ALIGNMENT 8
+
+/**
+ * \brief Hash a key with the seeded hash function of a table if it has one.
+ * \param rt A pointer to the table.
+ * \param key A pointer to the key.
+ * \param key_size The size of the key in bytes.
+ */
+static inline uint64_t HT_robin_hash(const HT_robin_table* const rt, const void* const key, const size_t key_size){
+    if( rt->seeded_hash_function != NULL )
+        return rt->seeded_hash_function(key, key_size, rt->_seed);
+    return rt->hash_function(key, key_size);
+}
+
+/**
+ * \brief Get the number of entries that can be used before a rehash.
+ * \param entry_bits The base 2 logarithm of the number of entries.
+ */
+static inline size_t HT_robin_capacity(const unsigned int entry_bits){
+    return ((size_t) 1 << entry_bits) / 8 * 7;
+}
+
+/**
+ * \brief Allocate empty entries.
+ * \param rt A pointer to the table.
+ * \param entry_bits The base 2 logarithm of the number of entries.
+ * \retval 0 On success.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+static int HT_robin_allocate(HT_robin_table* const rt, const unsigned int entry_bits){
+    size_t nb_entries = (size_t) 1 << entry_bits;
+    rt->_distances = calloc(nb_entries, 1);
+    if( rt->_distances == NULL )
+        return 1;
+    rt->_entries = malloc(nb_entries * sizeof(HT_robin_entry));
+    if( rt->_entries == NULL ){
+        int errno_temp = errno;
+        free(rt->_distances);
+        errno = errno_temp;
+        return 1;
+    }
+    rt->_entry_bits = entry_bits;
+    return 0;
+}
+
+/**
+ * \brief Search the entry holding a key.
+ * \param rt A pointer to the table.
+ * \param key The key, NULL to only look for the place of a new entry.
+ * \param key_size The size of the key.
+ * \param hash The hash of the key.
+ * \param place If not NULL, set to the entry where the key belongs if it is absent.
+ * \param distance If not NULL, set to the distance of place to the home of the
+ * key, ::HT_ROBIN_MAX_PROBES if the key cannot be stored without a grow.
+ * \return The index of the entry or SIZE_MAX if the key is absent.
+ */
+static size_t HT_robin_find(const HT_robin_table* const rt, const void* const key, const size_t key_size, const uint64_t hash, size_t* const place, unsigned int* const distance){
+    const size_t mask = ((size_t) 1 << rt->_entry_bits) - 1;
+    const HT_robin_entry *entry;
+    size_t index = HT_hash_fold(hash, rt->_entry_bits);
+    unsigned int probe;
+
+    for(probe = 0; probe < HT_ROBIN_MAX_PROBES; ++probe){
+        // The entry is empty or closer to its home, the key would be here
+        if( rt->_distances[index] <= probe )
+            break;
+        entry = &rt->_entries[index];
+        if( key != NULL && entry->_hash == hash && entry->_key._size_buffer == key_size &&
+                memcmp(entry->_key._buffer, key, key_size) == 0 )
+            return index;
+        index = (index + 1) & mask;
+    }
+    if( place != NULL ){
+        *place = index;
+        *distance = probe;
+    }
+    return SIZE_MAX;
+}
+
+/**
+ * \brief Store an entry, shifting the rest of its run by one entry.
+ * \param rt A pointer to the table.
+ * \param entry The entry to store.
+ * \param index The place given by ::HT_robin_find.
+ * \param distance The distance given by ::HT_robin_find.
+ * \retval 0 On success.
+ * \retval 1 If an entry would end too far from its home, the table is unchanged.
+ * \pre The table has at least one empty entry.
+ */
+static int HT_robin_place(HT_robin_table* const rt, const HT_robin_entry* const entry, const size_t index, const unsigned int distance){
+    const size_t mask = ((size_t) 1 << rt->_entry_bits) - 1;
+    size_t end = index,
+           previous;
+
+    if( distance >= HT_ROBIN_MAX_PROBES )
+        return 1;
+    while( rt->_distances[end] != 0 ){
+        if( rt->_distances[end] >= HT_ROBIN_MAX_PROBES )
+            return 1;
+        end = (end + 1) & mask;
+    }
+    while( end != index ){
+        previous = (end - 1) & mask;
+        rt->_entries[end] = rt->_entries[previous];
+        rt->_distances[end] = (unsigned char) (rt->_distances[previous] + 1);
+        end = previous;
+    }
+    rt->_entries[index] = *entry;
+    rt->_distances[index] = (unsigned char) (distance + 1);
+    return 0;
+}
+
+/**
+ * \brief Move every entry to new arrays.
+ * \param rt A pointer to the table.
+ * \param entry_bits The new base 2 logarithm of the number of entries.
+ * \param rehash_keys If true, hash the keys again with the hash function and
+ * seed of the table instead of keeping their hash.
+ * \retval 0 On success.
+ * \retval 1 If an entry would end too far from its home, the table is unchanged.
+ * \retval 2 On failure and errno is set appropriately.
+ */
+static int HT_robin_rehash(HT_robin_table* const rt, const unsigned int entry_bits, const int rehash_keys){
+    unsigned char *old_distances = rt->_distances;
+    HT_robin_entry *old_entries = rt->_entries,
+                   entry;
+    unsigned int old_entry_bits = rt->_entry_bits,
+                 distance;
+    size_t old_nb_entries = (size_t) 1 << old_entry_bits,
+           i,
+           index;
+
+    if( HT_robin_allocate(rt, entry_bits) != 0 ){
+        rt->_distances = old_distances;
+        rt->_entries = old_entries;
+        return 2;
+    }
+    for(i = 0; i < old_nb_entries; ++i){
+        if( old_distances[i] != 0 ){
+            entry = old_entries[i];
+            if( rehash_keys )
+                entry._hash = HT_robin_hash(rt, entry._key._buffer, entry._key._size_buffer);
+            HT_robin_find(rt, NULL, 0, entry._hash, &index, &distance);
+            if( HT_robin_place(rt, &entry, index, distance) != 0 ){
+                free(rt->_distances);
+                free(rt->_entries);
+                rt->_distances = old_distances;
+                rt->_entries = old_entries;
+                rt->_entry_bits = old_entry_bits;
+                return 1;
+            }
+        }
+    }
+    free(old_distances);
+    free(old_entries);
+    return 0;
+}
+
+/**
+ * \brief Hash every key again with a new random seed, keeping the number of entries.
+ * \param rt A pointer to the table, with a seeded hash function.
+ * \retval 0 On success.
+ * \retval 1 If an entry would end too far from its home, the table is unchanged.
+ * \retval 2 On failure and errno is set appropriately.
+ */
+static int HT_robin_reseed(HT_robin_table* const rt){
+    uint64_t old_seed[2] = { rt->_seed[0], rt->_seed[1] };
+    int retval;
+    if( HT_random_seed(rt->_seed) != 0 )
+        return 2;
+    retval = HT_robin_rehash(rt, rt->_entry_bits, 1);
+    if( retval != 0 ){
+        rt->_seed[0] = old_seed[0];
+        rt->_seed[1] = old_seed[1];
+    }
+    return retval;
+}
+
+/**
+ * \brief Double the number of entries until every entry is close enough to its home.
+ * \param rt A pointer to the table.
+ * \param reseeds The number of seeds already drawn by the insertion, updated.
+ * \retval 0 On success, the hashes changed if a new seed was drawn.
+ * \retval 1 On failure and errno is set appropriately.
+ */
+static int HT_robin_grow(HT_robin_table* const rt, unsigned int* const reseeds){
+    unsigned int entry_bits = rt->_entry_bits;
+    int retval;
+    do{
+        // HT_hash_fold gives at most 32 bits
+        if( entry_bits >= 32 ){
+            errno = ENOMEM;
+            return 1;
+        }
+        ++entry_bits;
+        if( rt->_nb_elements + 1 < ((size_t) 1 << entry_bits) / HT_ROBIN_MIN_FILL ){
+            // The keys share too many hash bits for a bigger table to help,
+            // only another seed can spread them
+            if( rt->seeded_hash_function == NULL || *reseeds >= HT_ROBIN_MAX_RESEEDS ){
+                errno = ENOSPC;
+                return 1;
+            }
+            ++*reseeds;
+            retval = HT_robin_reseed(rt);
+            entry_bits = rt->_entry_bits;
+        }
+        else
+            retval = HT_robin_rehash(rt, entry_bits, 0);
+    } while( retval == 1 );
+    return retval == 0 ? 0 : 1;
+}
+
+HT_robin_table* HT_robin_new_hash(const unsigned int size, HT_hash_function hash_function){
+    HT_robin_table* rtable;
+    int retval;
+    if( size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return NULL;
+    }
+    rtable = malloc(sizeof(HT_robin_table));
+    if( rtable == NULL )
+        return NULL;
+    retval = HT_robin_init(rtable, size, hash_function);
+    if( retval != 0 ){
+        int errno_temp = errno;
+        free( rtable );
+        errno = errno_temp;
+        return NULL;
+    }
+    return rtable;
+}
+
+int HT_robin_init(HT_robin_table* const rt, const unsigned int size, HT_hash_function hash_function){
+    unsigned int entry_bits = HT_ROBIN_MIN_BITS;
+    if( rt == NULL || size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    while( HT_robin_capacity(entry_bits) < size ){
+        if( entry_bits >= 32 ){
+            errno = EINVAL;
+            return 1;
+        }
+        ++entry_bits;
+    }
+    if( HT_robin_allocate(rt, entry_bits) != 0 )
+        return 1;
+    rt->_nb_elements = 0;
+    rt->hash_function = hash_function;
+    rt->seeded_hash_function = NULL;
+    rt->_seed[0] = 0;
+    rt->_seed[1] = 0;
+    return 0;
+}
+
+int HT_robin_get_element(const HT_robin_table* rt, const void* key, const size_t key_size, void** value, size_t* value_size){
+    size_t index;
+    if( rt == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+    index = HT_robin_find(rt, key, key_size, HT_robin_hash(rt, key, key_size), NULL, NULL);
+    if( index == SIZE_MAX )
+        return 1;
+    if( value != NULL && value_size != NULL ){
+        *value = rt->_entries[index]._value._buffer;
+        *value_size = rt->_entries[index]._value._size_buffer;
+    }
+    return 0;
+}
+
+int HT_robin_add_element(HT_robin_table* const rt, const void* const key, const size_t key_size, const void* const value, const size_t value_size){
+    HT_robin_entry entry;
+    unsigned char *buffer;
+    unsigned int distance,
+                 reseeds = 0;
+    size_t index,
+           key_room;
+    if( rt == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    entry._hash = HT_robin_hash(rt, key, key_size);
+    if( HT_robin_find(rt, key, key_size, entry._hash, &index, &distance) != SIZE_MAX )
+        return 1;
+    if( rt->_nb_elements >= HT_robin_capacity(rt->_entry_bits) ){
+        if( HT_robin_grow(rt, &reseeds) != 0 )
+            return 2;
+        entry._hash = HT_robin_hash(rt, key, key_size);
+        HT_robin_find(rt, NULL, 0, entry._hash, &index, &distance);
+    }
+
+    // The key and the value share one buffer, the value stays aligned
+    key_room = (key_size + HT_ROBIN_VALUE_ALIGNMENT - 1) & ~(size_t) (HT_ROBIN_VALUE_ALIGNMENT - 1);
+    if( key_room < key_size || value_size > SIZE_MAX - key_room ){
+        errno = ENOMEM;
+        return 2;
+    }
+    buffer = malloc(key_room + value_size);
+    if( buffer == NULL )
+        return 2;
+    memcpy(buffer, key, key_size);
+    memcpy(buffer + key_room, value, value_size);
+    entry._key._buffer = buffer;
+    entry._key._size_buffer = key_size;
+    entry._value._buffer = buffer + key_room;
+    entry._value._size_buffer = value_size;
+
+    // Grow, or draw a new seed, rather than let a probe sequence get longer than the bound
+    while( HT_robin_place(rt, &entry, index, distance) != 0 ){
+        if( HT_robin_grow(rt, &reseeds) != 0 ){
+            int errno_temp = errno;
+            free(buffer);
+            errno = errno_temp;
+            return 2;
+        }
+        entry._hash = HT_robin_hash(rt, key, key_size);
+        HT_robin_find(rt, NULL, 0, entry._hash, &index, &distance);
+    }
+    ++rt->_nb_elements;
+    return 0;
+}
+
+int HT_robin_remove_element(HT_robin_table* rt, const void* key, const size_t key_size){
+    size_t mask,
+           index,
+           next;
+    if( rt == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    index = HT_robin_find(rt, key, key_size, HT_robin_hash(rt, key, key_size), NULL, NULL);
+    if( index == SIZE_MAX )
+        return 1;
+    free(rt->_entries[index]._key._buffer);
+
+    // Shift back the rest of the run, up to an empty entry or one at its home
+    mask = ((size_t) 1 << rt->_entry_bits) - 1;
+    next = (index + 1) & mask;
+    while( rt->_distances[next] > 1 ){
+        rt->_entries[index] = rt->_entries[next];
+        rt->_distances[index] = (unsigned char) (rt->_distances[next] - 1);
+        index = next;
+        next = (next + 1) & mask;
+    }
+    rt->_distances[index] = 0;
+    --rt->_nb_elements;
+    return 0;
+}
+
+int HT_robin_set_seeded_hash(HT_robin_table* const rt, HT_seeded_hash_function seeded_hash_function){
+    HT_seeded_hash_function old_function;
+    uint64_t old_seed[2];
+    unsigned int entry_bits;
+    int retval;
+    if( rt == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+    old_function = rt->seeded_hash_function;
+    old_seed[0] = rt->_seed[0];
+    old_seed[1] = rt->_seed[1];
+    if( seeded_hash_function != NULL && HT_random_seed(rt->_seed) != 0 )
+        return 1;
+    rt->seeded_hash_function = seeded_hash_function;
+
+    // Grow like an insertion would if the entries do not fit with the new hashes
+    entry_bits = rt->_entry_bits;
+    retval = HT_robin_rehash(rt, entry_bits, 1);
+    while( retval == 1 && entry_bits < 32 &&
+            rt->_nb_elements >= ((size_t) 1 << (entry_bits + 1)) / HT_ROBIN_MIN_FILL )
+        retval = HT_robin_rehash(rt, ++entry_bits, 1);
+    if( retval != 0 ){
+        if( retval == 1 )
+            errno = ENOSPC;
+        rt->seeded_hash_function = old_function;
+        rt->_seed[0] = old_seed[0];
+        rt->_seed[1] = old_seed[1];
+        return 1;
+    }
+    return 0;
+}
+
+int HT_robin_foreach(const HT_robin_table* rt, HT_foreach_function function, void* data){
+    const size_t nb_entries = (size_t) 1 << rt->_entry_bits;
+    const HT_robin_entry *entry;
+    size_t i;
+    int retval;
+
+    for(i = 0; i < nb_entries; ++i){
+        if( rt->_distances[i] == 0 )
+            continue;
+        entry = &rt->_entries[i];
+        retval = function(entry->_key._buffer, entry->_key._size_buffer, entry->_value._buffer, entry->_value._size_buffer, data);
+        if( retval != 0 )
+            return retval;
+    }
+    return 0;
+}
+
+uint64_t HT_robin_scan(const HT_robin_table* rt, uint64_t cursor, const unsigned int count, HT_foreach_function function, void* data){
+    const size_t mask = ((size_t) 1 << rt->_entry_bits) - 1;
+    const HT_robin_entry *entry;
+    unsigned int visited = 0,
+                 probe;
+    size_t home,
+           index;
+    uint64_t end;
+    int stop = 0;
+
+    do{
+        // The run sorts its entries by home, the ones of this home are the
+        // entries as far from it as from their own home
+        home = (size_t) (cursor >> (32 - rt->_entry_bits));
+        end = ((uint64_t) home + 1) << (32 - rt->_entry_bits);
+        index = home;
+        for(probe = 0; probe < HT_ROBIN_MAX_PROBES && rt->_distances[index] > probe; ++probe){
+            if( rt->_distances[index] == probe + 1 ){
+                entry = &rt->_entries[index];
+                if( function(entry->_key._buffer, entry->_key._size_buffer, entry->_value._buffer, entry->_value._size_buffer, data) != 0 )
+                    stop = 1;
+                ++visited;
+            }
+            index = (index + 1) & mask;
+        }
+        cursor = end > UINT32_MAX ? HT_SCAN_CURSOR_START : end;
+    }
+    while( cursor != HT_SCAN_CURSOR_START && visited < count && !stop );
+    return cursor;
+}
+
+void HT_robin_delete_pointer(HT_robin_table* rt){
+    HT_robin_delete(rt);
+    free(rt);
+}
+
+void HT_robin_delete(HT_robin_table* const rt){
+    if( rt != NULL && rt->_distances != NULL ){
+        HT_robin_reset_table(rt);
+        free(rt->_distances);
+        free(rt->_entries);
+        rt->_distances = NULL;
+    }
+}
+
+void HT_robin_reset_table(HT_robin_table* rt){
+    size_t i,
+           nb_entries;
+    if( rt != NULL && rt->_distances != NULL ){
+        nb_entries = (size_t) 1 << rt->_entry_bits;
+        for(i = 0; i < nb_entries; ++i){
+            if( rt->_distances[i] != 0 )
+                free(rt->_entries[i]._key._buffer);
+        }
+        memset(rt->_distances, 0, nb_entries);
+        rt->_nb_elements = 0;
+    }
+}
@@ -0,0 +1,381 @@
+/**
+ * \file sharded_hash_table.c
+ * \brief Sharded hash table implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "sharded_hash_table.h"
+#include "generic_hash_table_internal.h"
+
+/**
+ * \brief The mbind policy preferring a node, from linux/mempolicy.h.
+ */
+#define HT_MPOL_PREFERRED 1
+
+/**
+ * \brief The mbind flag moving the pages already touched, from linux/mempolicy.h.
+ */
+#define HT_MPOL_MF_MOVE 2
+
+/**
+ * \brief Get the base 2 logarithm of a number of shards.
+ * \param size The requested number.
+ * \return The logarithm of the smallest power of two not below size.
+ */
+static inline unsigned int HT_sharded_bits_for(const unsigned int size){
+    unsigned int bits = 0;
+    while( (1u << bits) < size )
+        ++bits;
+    return bits;
+}
+
+/**
+ * \brief Get the shard of a hash.
+ * \param st A pointer to the hash table.
+ * \param hash The hash of the key.
+ * \note The slot inside of the shard comes from the top bits of the folded
+ * hash, the shard from the folded hash with its halves swapped.
+ */
+static inline unsigned int HT_sharded_index(const HT_sharded_table* const st, const uint64_t hash){
+    return HT_hash_fold(hash >> 32 | hash << 32, st->_shard_bits);
+}
+
+/**
+ * \brief Ask the kernel to keep a memory range on a node.
+ * \param buffer The start of the range.
+ * \param size The size of the range in bytes.
+ * \param node The node.
+ * \note Only the pages fully inside of the range are moved, failures are ignored.
+ */
+static void HT_sharded_bind(void* buffer, const size_t size, const int node){
+    const uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE),
+                    begin = ((uintptr_t) buffer + page - 1) & ~(page - 1),
+                    end = ((uintptr_t) buffer + size) & ~(page - 1);
+    unsigned long mask;
+    if( node < 0 || (size_t) node >= sizeof(mask) * 8 || end <= begin )
+        return;
+    mask = 1ul << node;
+    syscall(SYS_mbind, begin, end - begin, HT_MPOL_PREFERRED, &mask, sizeof(mask) * 8, HT_MPOL_MF_MOVE);
+}
+
+/**
+ * \brief The initialisation of a shard, run by a thread of its node.
+ */
+typedef struct{
+    HT_shard *_shard;           /**<- The shard. */
+    unsigned int _size;         /**<- The number of slots. */
+    HT_hash_function _hash_function; /**<- The hash function. */
+    const HT_allocator *_allocator; /**<- The allocator of the pairs, may be NULL. */
+    int _placed;                /**<- True if the thread is bound to the processor of the shard. */
+    int _retval;                /**<- The value returned by HT_init_allocator. */
+    int _errno;                 /**<- The errno set by HT_init_allocator. */
+} HT_shard_init_job;
+
+/**
+ * \brief Initialise a shard, its slots are touched first by the calling thread.
+ * \param job_pointer A pointer to the HT_shard_init_job.
+ * \return NULL.
+ */
+static void* HT_sharded_init_shard(void* job_pointer){
+    HT_shard_init_job *job = job_pointer;
+    HT_shard *shard = job->_shard;
+    unsigned int cpu,
+                 node;
+
+    job->_retval = HT_init_allocator(&shard->_table, job->_size, job->_hash_function, job->_allocator);
+    job->_errno = errno;
+    if( job->_retval != 0 )
+        return NULL;
+    // Each shard grows when the table allows it, see HT_sharded_grow
+    HT_set_load_factors(&shard->_table, 0.0f, 0.0f);
+    pthread_rwlock_init(&shard->_lock, NULL);
+    shard->_node = job->_placed && getcpu(&cpu, &node) == 0 ? (int) node : -1;
+    return NULL;
+}
+
+int HT_sharded_init_placed(HT_sharded_table* const st, const unsigned int size, const unsigned int nb_shards, HT_hash_function hash_function, const HT_shard_placement placements[]){
+    HT_shard_init_job job;
+    pthread_attr_t attributes;
+    pthread_t thread;
+    cpu_set_t cpus;
+    unsigned int i,
+                 shard_bits;
+    void *shards;
+    int retval;
+    if( st == NULL || size == 0 || size > HT_MAX_SLOTS || nb_shards == 0 || nb_shards > HT_MAX_SLOTS || hash_function == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+
+    shard_bits = HT_sharded_bits_for(nb_shards);
+    retval = posix_memalign(&shards, HT_CACHE_LINE_SIZE, ((size_t) 1 << shard_bits) * sizeof(HT_shard));
+    if( retval != 0 ){
+        errno = retval;
+        return 1;
+    }
+    st->_shards = shards;
+    st->_shard_bits = shard_bits;
+
+    for(i = 0; i < (1u << shard_bits); ++i){
+        job._shard = &st->_shards[i];
+        job._size = size >> shard_bits != 0 ? size >> shard_bits : 1;
+        job._hash_function = hash_function;
+        job._allocator = placements != NULL && i < nb_shards ? placements[i].allocator : NULL;
+        job._placed = 0;
+        if( placements != NULL && i < nb_shards && placements[i].cpu >= 0 && placements[i].cpu < CPU_SETSIZE &&
+                pthread_attr_init(&attributes) == 0 ){
+            CPU_ZERO(&cpus);
+            CPU_SET((size_t) placements[i].cpu, &cpus);
+            job._placed = 1;
+            if( pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus) != 0 ||
+                    pthread_create(&thread, &attributes, HT_sharded_init_shard, &job) != 0 )
+                job._placed = 0;
+            else
+                pthread_join(thread, NULL);
+            pthread_attr_destroy(&attributes);
+        }
+        if( !job._placed )
+            HT_sharded_init_shard(&job);
+        if( job._retval != 0 ){
+            while( i-- != 0 ){
+                HT_delete(&st->_shards[i]._table);
+                pthread_rwlock_destroy(&st->_shards[i]._lock);
+            }
+            free(st->_shards);
+            errno = job._errno;
+            return 1;
+        }
+    }
+
+    st->_resizing_shard = -1;
+    st->_max_load_factor = HT_DEFAULT_MAX_LOAD_FACTOR;
+    st->hash_function = hash_function;
+    return 0;
+}
+
+int HT_sharded_init(HT_sharded_table* const st, const unsigned int size, const unsigned int nb_shards, HT_hash_function hash_function){
+    return HT_sharded_init_placed(st, size, nb_shards == 0 ? HT_SHARDED_DEFAULT_SHARDS : nb_shards, hash_function, NULL);
+}
+
+HT_sharded_table* HT_sharded_new_hash(const unsigned int size, const unsigned int nb_shards, HT_hash_function hash_function){
+    HT_sharded_table* stable;
+    int retval;
+    if( size == 0 || hash_function == NULL ){
+        errno = EINVAL;
+        return NULL;
+    }
+    stable = malloc(sizeof(HT_sharded_table));
+    if( stable == NULL )
+        return NULL;
+    retval = HT_sharded_init(stable, size, nb_shards, hash_function);
+    if( retval != 0 ){
+        int errno_temp = errno;
+        free( stable );
+        errno = errno_temp;
+        return NULL;
+    }
+    return stable;
+}
+
+int HT_sharded_set_load_factor(HT_sharded_table* const st, float max_load_factor){
+    if( st == NULL || max_load_factor < 0.0f ){
+        errno = EINVAL;
+        return 1;
+    }
+    st->_max_load_factor = max_load_factor;
+    return 0;
+}
+
+/**
+ * \brief Give the resize turn back once the shard holding it is fully migrated.
+ * \param st A pointer to the hash table.
+ * \param index The shard, locked for writing.
+ */
+static inline void HT_sharded_end_resize(HT_sharded_table* const st, const unsigned int index){
+    if( __atomic_load_n(&st->_resizing_shard, __ATOMIC_RELAXED) == (int) index &&
+            st->_shards[index]._table._new_slots == NULL )
+        __atomic_store_n(&st->_resizing_shard, -1, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Start the resize of a shard above the load factor if no other shard is resizing.
+ * \param st A pointer to the hash table.
+ * \param index The shard, locked for writing.
+ * \note A shard waiting for its turn migrates some slots of the resizing shard
+ * when it can lock it, so the resize ends even if its shard is never modified.
+ */
+static void HT_sharded_grow(HT_sharded_table* const st, const unsigned int index){
+    HT_shard *shard = &st->_shards[index];
+    HT_hash_table *ht = &shard->_table;
+    int resizing = -1;
+
+    HT_sharded_end_resize(st, index);
+    if( ht->_new_slots != NULL || st->_max_load_factor <= 0.0f || ht->_nb_slots >= HT_MAX_SLOTS ||
+            (double) ht->_nb_elements <= (double) st->_max_load_factor * (double) ht->_nb_slots )
+        return;
+
+    if( __atomic_compare_exchange_n(&st->_resizing_shard, &resizing, (int) index, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ){
+        if( HT_resize(ht, ht->_nb_slots * 2) != 0 ){
+            __atomic_store_n(&st->_resizing_shard, -1, __ATOMIC_RELEASE);
+            return;
+        }
+        if( shard->_node >= 0 )
+            HT_sharded_bind(ht->_new_slots, ht->_nb_new_slots * sizeof(HT_slot), shard->_node);
+        HT_sharded_end_resize(st, index);
+    }
+    else if( resizing != (int) index && pthread_rwlock_trywrlock(&st->_shards[resizing]._lock) == 0 ){
+        HT_rehash_slots(&st->_shards[resizing]._table, HT_SHARDED_HELP_SLOTS);
+        HT_sharded_end_resize(st, (unsigned int) resizing);
+        pthread_rwlock_unlock(&st->_shards[resizing]._lock);
+    }
+}
+
+int HT_sharded_get_element_position(HT_sharded_table* const st, const void* const key, const size_t key_size, void* value, size_t* value_size, unsigned int position, int reverse){
+    HT_shard *shard;
+    HT_pair *pair;
+    uint64_t hash;
+    if( st == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = HT_hash_key(&st->_shards[0]._table, key, key_size);
+    shard = &st->_shards[HT_sharded_index(st, hash)];
+    pthread_rwlock_rdlock(&shard->_lock);
+    pair = HT_find_pair(&shard->_table, hash, key, key_size, position, reverse);
+    if( pair != NULL && value_size != NULL ){
+        if( value != NULL )
+            memcpy(value, pair->_value._buffer,
+                    *value_size < pair->_value._size_buffer ? *value_size : pair->_value._size_buffer);
+        *value_size = pair->_value._size_buffer;
+    }
+    pthread_rwlock_unlock(&shard->_lock);
+    return pair == NULL ? 1 : 0;
+}
+
+int HT_sharded_add_element_position(HT_sharded_table* const st, const void* const key, const size_t key_size, const void* const value, const size_t value_size, unsigned int position, int reverse){
+    HT_shard *shard;
+    unsigned int index;
+    uint64_t hash;
+    int retval;
+    if( st == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = HT_hash_key(&st->_shards[0]._table, key, key_size);
+    index = HT_sharded_index(st, hash);
+    shard = &st->_shards[index];
+    pthread_rwlock_wrlock(&shard->_lock);
+    retval = HT_insert_hashed(&shard->_table, hash, key, key_size, value, value_size, position, reverse);
+    HT_sharded_grow(st, index);
+    pthread_rwlock_unlock(&shard->_lock);
+    return retval;
+}
+
+int HT_sharded_add_element(HT_sharded_table* const st, const void* const key, const size_t key_size, const void* const value, const size_t value_size){
+    HT_shard *shard;
+    unsigned int index;
+    uint64_t hash;
+    int inserted = 0,
+        retval;
+    if( st == NULL || key == NULL || value == NULL || key_size == 0 || value_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = HT_hash_key(&st->_shards[0]._table, key, key_size);
+    index = HT_sharded_index(st, hash);
+    shard = &st->_shards[index];
+    pthread_rwlock_wrlock(&shard->_lock);
+    retval = HT_find_or_insert_hashed(&shard->_table, hash, key, key_size, value, value_size, &inserted) == NULL ? 2 : !inserted;
+    HT_sharded_grow(st, index);
+    pthread_rwlock_unlock(&shard->_lock);
+    return retval;
+}
+
+int HT_sharded_remove_element_position(HT_sharded_table* const st, const void* const key, const size_t key_size, unsigned int position, int reverse){
+    HT_shard *shard;
+    unsigned int index;
+    uint64_t hash;
+    int retval;
+    if( st == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = HT_hash_key(&st->_shards[0]._table, key, key_size);
+    index = HT_sharded_index(st, hash);
+    shard = &st->_shards[index];
+    pthread_rwlock_wrlock(&shard->_lock);
+    retval = HT_remove_hashed(&shard->_table, hash, key, key_size, position, reverse);
+    HT_sharded_end_resize(st, index);
+    pthread_rwlock_unlock(&shard->_lock);
+    return retval;
+}
+
+size_t HT_sharded_get_nb_elements(HT_sharded_table* const st){
+    size_t nb_elements = 0;
+    unsigned int i;
+    for(i = 0; i < (1u << st->_shard_bits); ++i){
+        pthread_rwlock_rdlock(&st->_shards[i]._lock);
+        nb_elements += st->_shards[i]._table._nb_elements;
+        pthread_rwlock_unlock(&st->_shards[i]._lock);
+    }
+    return nb_elements;
+}
+
+void HT_sharded_reset_table(HT_sharded_table* const st){
+    unsigned int i;
+    if( st != NULL ){
+        for(i = 0; i < (1u << st->_shard_bits); ++i){
+            pthread_rwlock_wrlock(&st->_shards[i]._lock);
+            HT_reset_table(&st->_shards[i]._table);
+            HT_sharded_end_resize(st, i);
+            pthread_rwlock_unlock(&st->_shards[i]._lock);
+        }
+    }
+}
+
+void HT_sharded_delete_pointer(HT_sharded_table* st){
+    HT_sharded_delete(st);
+    free(st);
+}
+
+void HT_sharded_delete(HT_sharded_table* const st){
+    unsigned int i;
+    if( st != NULL ){
+        for(i = 0; i < (1u << st->_shard_bits); ++i){
+            HT_delete(&st->_shards[i]._table);
+            pthread_rwlock_destroy(&st->_shards[i]._lock);
+        }
+        free(st->_shards);
+    }
+}
@@ -0,0 +1,354 @@
+/**
+ * \file snapshot_hash_table.c
+ * \brief Memory mapped read only hash table implementation.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot_hash_table.h"
+
+/**
+ * \brief The first bytes of a snapshot file.
+ */
+static const char HT_snapshot_magic[8] = {'H', 'a', 's', 'h', 'T', 'S', 'n', 'p'};
+
+/**
+ * \brief The key hashed to check that a snapshot is loaded with the function it was saved with.
+ */
+static const char HT_snapshot_probe[] = "HashT snapshot probe";
+
+/**
+ * \brief The header of a snapshot file.
+ */
+typedef struct{
+    char _magic[8];             /**<- ::HT_snapshot_magic. */
+    uint32_t _byte_order;       /**<- 0x01020304 written in the byte order of the machine. */
+    uint32_t _version;          /**<- ::HT_SNAPSHOT_VERSION. */
+    uint32_t _slot_bits;        /**<- The base 2 logarithm of the number of slots. */
+    uint32_t _reserved;         /**<- Always 0. */
+    uint64_t _nb_elements;      /**<- The number of entries. */
+    uint64_t _probe_hash;       /**<- The hash of ::HT_snapshot_probe. */
+    uint64_t _entries_size;     /**<- The size in bytes of the entries. */
+} HT_snapshot_header;
+
+/**
+ * \brief An entry of a snapshot, followed by the key and the value padded to 8 bytes.
+ */
+typedef struct{
+    uint64_t _hash;             /**<- The hash of the key. */
+    uint32_t _key_size;         /**<- The size of the key. */
+    uint32_t _value_size;       /**<- The size of the value. */
+    unsigned char _data[];      /**<- The key then the value. */
+} HT_snapshot_entry;
+
+/**
+ * \brief Round a size up to a multiple of 8.
+ * \param size The size.
+ */
+static inline uint64_t HT_snapshot_pad(const uint64_t size){
+    return (size + 7) & ~(uint64_t) 7;
+}
+
+/**
+ * \brief Get the size of an entry.
+ * \param key_size The size of the key.
+ * \param value_size The size of the value.
+ */
+static inline uint64_t HT_snapshot_entry_size(const size_t key_size, const size_t value_size){
+    return sizeof(HT_snapshot_entry) + HT_snapshot_pad(key_size) + HT_snapshot_pad(value_size);
+}
+
+/**
+ * \brief Get the entry starting at an offset, if it fits before the end of its slot.
+ * \param snapshot A pointer to the snapshot.
+ * \param current The offset of the entry.
+ * \param end The offset of the end of the slot.
+ * \return The entry, NULL if its header, key or value crosses end.
+ */
+static inline const HT_snapshot_entry* HT_snapshot_entry_at(const HT_snapshot* const snapshot, const uint64_t current, const uint64_t end){
+    const HT_snapshot_entry *entry;
+    if( end - current < sizeof(HT_snapshot_entry) )
+        return NULL;
+    entry = (const HT_snapshot_entry*) (const void*) &snapshot->_entries[current];
+    if( end - current < HT_snapshot_entry_size(entry->_key_size, entry->_value_size) )
+        return NULL;
+    return entry;
+}
+
+/**
+ * \brief Check that the slot offsets are 8 bytes aligned, sorted and inside of the entries.
+ * \param offsets The slot offsets.
+ * \param nb_slots The number of slots, there is one more offset.
+ * \param entries_size The size in bytes of the entries.
+ * \return True if the offsets are valid.
+ */
+static int HT_snapshot_check_offsets(const uint64_t* const offsets, const size_t nb_slots, const uint64_t entries_size){
+    size_t i;
+    for(i = 0; i <= nb_slots; ++i){
+        if( (offsets[i] & 7) != 0 || offsets[i] > entries_size || (i > 0 && offsets[i] < offsets[i - 1]) )
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * \brief Get the offset of the slot offsets in the file.
+ */
+static inline size_t HT_snapshot_offsets_position(void){
+    return (size_t) HT_snapshot_pad(sizeof(HT_snapshot_header));
+}
+
+/**
+ * \brief Get the number of slot bits of a snapshot, about one slot per element.
+ * \param nb_elements The number of elements.
+ */
+static inline unsigned int HT_snapshot_bits_for(const size_t nb_elements){
+    unsigned int bits = 0;
+    while( bits < 31 && ((size_t) 1 << bits) < nb_elements )
+        ++bits;
+    return bits;
+}
+
+int HT_save(const HT_hash_table* ht, const char* path){
+    HT_snapshot_header header;
+    HT_snapshot_entry *entry;
+    HT_iterator it;
+    unsigned char *map = NULL;
+    uint64_t *offsets = NULL,
+             *cursors = NULL,
+             total;
+    size_t nb_slots,
+           map_size = 0,
+           key_size,
+           value_size,
+           i;
+    const void *key;
+    void *value;
+    unsigned int slot;
+    int fd = -1,
+        errno_temp;
+    if( ht == NULL || path == NULL || ht->seeded_hash_function != NULL || ht->_reseeding ||
+            ht->_robin != NULL ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header._magic, HT_snapshot_magic, sizeof(header._magic));
+    header._byte_order = UINT32_C(0x01020304);
+    header._version = HT_SNAPSHOT_VERSION;
+    header._slot_bits = HT_snapshot_bits_for(HT_get_nb_elements(ht));
+    header._nb_elements = HT_get_nb_elements(ht);
+    header._probe_hash = ht->hash_function(HT_snapshot_probe, sizeof(HT_snapshot_probe) - 1);
+    nb_slots = (size_t) 1 << header._slot_bits;
+
+    // Count the bytes of each slot, then turn the counts in offsets
+    cursors = calloc(nb_slots + 1, sizeof(uint64_t));
+    if( cursors == NULL )
+        return 2;
+    for(HT_iterator_begin(ht, &it); !HT_iterator_end(&it); HT_iterator_next(&it)){
+        HT_iterator_key(&it, &key_size);
+        HT_iterator_value(&it, &value_size);
+        if( key_size > UINT32_MAX || value_size > UINT32_MAX ){
+            free(cursors);
+            errno = EFBIG;
+            return 2;
+        }
+        cursors[HT_hash_fold(it._pair->_hash, header._slot_bits) + 1] += HT_snapshot_entry_size(key_size, value_size);
+    }
+    for(total = 0, i = 0; i <= nb_slots; ++i){
+        total += cursors[i];
+        cursors[i] = total;
+    }
+    header._entries_size = total;
+
+    map_size = HT_snapshot_offsets_position() + (nb_slots + 1) * sizeof(uint64_t) + (size_t) total;
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if( fd == -1 )
+        goto error;
+    if( ftruncate(fd, (off_t) map_size) != 0 )
+        goto error;
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if( map == MAP_FAILED ){
+        map = NULL;
+        goto error;
+    }
+
+    memcpy(map, &header, sizeof(header));
+    offsets = (uint64_t*) (void*) &map[HT_snapshot_offsets_position()];
+    memcpy(offsets, cursors, (nb_slots + 1) * sizeof(uint64_t));
+    map += HT_snapshot_offsets_position() + (nb_slots + 1) * sizeof(uint64_t);
+    // The iteration order is the chain order, the duplicates keep their order
+    for(HT_iterator_begin(ht, &it); !HT_iterator_end(&it); HT_iterator_next(&it)){
+        key = HT_iterator_key(&it, &key_size);
+        value = HT_iterator_value(&it, &value_size);
+        slot = HT_hash_fold(it._pair->_hash, header._slot_bits);
+        entry = (HT_snapshot_entry*) (void*) &map[cursors[slot]];
+        entry->_hash = it._pair->_hash;
+        entry->_key_size = (uint32_t) key_size;
+        entry->_value_size = (uint32_t) value_size;
+        memcpy(entry->_data, key, key_size);
+        memcpy(&entry->_data[HT_snapshot_pad(key_size)], value, value_size);
+        cursors[slot] += HT_snapshot_entry_size(key_size, value_size);
+    }
+    map -= HT_snapshot_offsets_position() + (nb_slots + 1) * sizeof(uint64_t);
+    free(cursors);
+    cursors = NULL;
+
+    if( munmap(map, map_size) != 0 ){
+        map = NULL;
+        goto error;
+    }
+    map = NULL;
+    if( fsync(fd) != 0 )
+        goto error;
+    if( close(fd) != 0 ){
+        fd = -1;
+        goto error;
+    }
+    return 0;
+
+error:
+    errno_temp = errno;
+    free(cursors);
+    if( map != NULL )
+        munmap(map, map_size);
+    if( fd != -1 )
+        close(fd);
+    errno = errno_temp;
+    return 2;
+}
+
+int HT_mmap_load(HT_snapshot* const snapshot, const char* path, HT_hash_function hash_function){
+    HT_snapshot_header header;
+    struct stat status;
+    size_t nb_slots,
+           entries_position;
+    void *map;
+    int fd;
+    if( snapshot == NULL || path == NULL || hash_function == NULL ){
+        errno = EINVAL;
+        return 1;
+    }
+
+    fd = open(path, O_RDONLY);
+    if( fd == -1 )
+        return 1;
+    if( fstat(fd, &status) != 0 ){
+        int errno_temp = errno;
+        close(fd);
+        errno = errno_temp;
+        return 1;
+    }
+    if( (size_t) status.st_size < HT_snapshot_offsets_position() ){
+        close(fd);
+        errno = EINVAL;
+        return 1;
+    }
+    map = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if( map == MAP_FAILED )
+        return 1;
+
+    memcpy(&header, map, sizeof(header));
+    nb_slots = (size_t) 1 << (header._slot_bits & 31);
+    entries_position = HT_snapshot_offsets_position() + (nb_slots + 1) * sizeof(uint64_t);
+    if( memcmp(header._magic, HT_snapshot_magic, sizeof(header._magic)) != 0 ||
+            header._byte_order != UINT32_C(0x01020304) || header._version != HT_SNAPSHOT_VERSION ||
+            header._slot_bits > 31 || entries_position > (size_t) status.st_size ||
+            header._entries_size != (uint64_t) status.st_size - entries_position ||
+            header._probe_hash != hash_function(HT_snapshot_probe, sizeof(HT_snapshot_probe) - 1) ||
+            !HT_snapshot_check_offsets((const uint64_t*) (const void*) ((const unsigned char*) map + HT_snapshot_offsets_position()),
+                nb_slots, header._entries_size) ){
+        munmap(map, (size_t) status.st_size);
+        errno = EINVAL;
+        return 1;
+    }
+    madvise(map, (size_t) status.st_size, MADV_RANDOM);
+
+    snapshot->_map = map;
+    snapshot->_map_size = (size_t) status.st_size;
+    snapshot->_offsets = (const uint64_t*) (const void*) ((const unsigned char*) map + HT_snapshot_offsets_position());
+    snapshot->_entries = (const unsigned char*) map + entries_position;
+    snapshot->_slot_bits = header._slot_bits;
+    snapshot->_nb_elements = (size_t) header._nb_elements;
+    snapshot->hash_function = hash_function;
+    return 0;
+}
+
+int HT_snapshot_get_element_position(const HT_snapshot* snapshot, const void* key, const size_t key_size, const void** value, size_t* value_size, unsigned int position, int reverse){
+    const HT_snapshot_entry *entry,
+                            *found = NULL;
+    uint64_t hash,
+             current,
+             end;
+    unsigned int slot,
+                 nb_matches = 0;
+    if( snapshot == NULL || key == NULL || key_size == 0 ){
+        errno = EINVAL;
+        return 2;
+    }
+
+    hash = snapshot->hash_function(key, key_size);
+    slot = HT_hash_fold(hash, snapshot->_slot_bits);
+    end = snapshot->_offsets[slot + 1];
+    if( reverse ){ // The entries only link forward, count the matches first
+        for(current = snapshot->_offsets[slot];
+                (entry = HT_snapshot_entry_at(snapshot, current, end)) != NULL;
+                current += HT_snapshot_entry_size(entry->_key_size, entry->_value_size)){
+            if( entry->_hash == hash && entry->_key_size == key_size && memcmp(key, entry->_data, key_size) == 0 )
+                ++nb_matches;
+        }
+        if( nb_matches == 0 )
+            return 1;
+        position = position < nb_matches ? nb_matches - 1 - position : 0;
+    }
+    for(current = snapshot->_offsets[slot];
+            (entry = HT_snapshot_entry_at(snapshot, current, end)) != NULL;
+            current += HT_snapshot_entry_size(entry->_key_size, entry->_value_size)){
+        if( entry->_hash == hash && entry->_key_size == key_size && memcmp(key, entry->_data, key_size) == 0 ){
+            found = entry;
+            if( position-- == 0 )
+                break;
+        }
+    }
+    if( found == NULL )
+        return 1;
+    if( value != NULL && value_size != NULL ){
+        *value = &found->_data[HT_snapshot_pad(found->_key_size)];
+        *value_size = found->_value_size;
+    }
+    return 0;
+}
+
+void HT_snapshot_unmap(HT_snapshot* const snapshot){
+    if( snapshot != NULL && snapshot->_map != NULL ){
+        munmap(snapshot->_map, snapshot->_map_size);
+        snapshot->_map = NULL;
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * \file test.h
+ * \brief Minimal checks shared by the tests.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#ifndef __TEST_H
+#define __TEST_H
+
+#include <stdio.h>
+
+/**
+ * \brief Fail the calling test function, returning 1, if condition is false.
+ */
+#define CHECK(condition) do{                                                    \
+    if( !(condition) ){                                                         \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        return 1;                                                               \
+    }                                                                           \
+}while(0)
+
+/**
+ * \brief Run a test function and count its failure.
+ */
+#define RUN(test, failures) do{                                                 \
+    if( (test) != 0 ){                                                          \
+        fprintf(stderr, "FAIL %s\n", #test);                                    \
+        ++(failures);                                                           \
+    }                                                                           \
+}while(0)
+
+#endif // ( __TEST_H )
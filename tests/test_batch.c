@@ -0,0 +1,232 @@
+/**
+ * \file test_batch.c
+ * \brief Check the batched lookups, additions and removals of the chained table.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of elements of a batch, many times ::HT_BATCH_PIPELINE_DEPTH.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The entry of the batch with a NULL key.
+ */
+#define TEST_NULL_KEY 100
+
+/**
+ * \brief The entry of the batch with a key of size 0.
+ */
+#define TEST_EMPTY_KEY 101
+
+/**
+ * \brief The entry of the batch with a NULL value.
+ */
+#define TEST_NULL_VALUE 102
+
+/**
+ * \brief The entry of the batch repeating the key of ::TEST_REPEATED_KEY.
+ */
+#define TEST_REPEAT 200
+
+/**
+ * \brief The key added a second time by the batch.
+ */
+#define TEST_REPEATED_KEY 50
+
+/**
+ * \brief The elements of a batch, entry i holding the key i and the value 3 * i.
+ */
+typedef struct{
+    int key_storage[TEST_NB_KEYS],
+        value_storage[TEST_NB_KEYS];
+    const void *keys[TEST_NB_KEYS],
+               *values[TEST_NB_KEYS];
+    size_t key_sizes[TEST_NB_KEYS],
+           value_sizes[TEST_NB_KEYS];
+    void *found[TEST_NB_KEYS];
+    size_t found_sizes[TEST_NB_KEYS];
+    int results[TEST_NB_KEYS];
+} test_batch;
+
+/**
+ * \brief Fill a batch with the keys [0, nb_keys[.
+ */
+static void test_fill(test_batch* const b, const size_t nb_keys){
+    size_t i;
+    for(i = 0; i < nb_keys; ++i){
+        b->key_storage[i] = (int) i;
+        b->value_storage[i] = 3 * (int) i;
+        b->keys[i] = &b->key_storage[i];
+        b->values[i] = &b->value_storage[i];
+        b->key_sizes[i] = sizeof(int);
+        b->value_sizes[i] = sizeof(int);
+        b->results[i] = -1;
+    }
+}
+
+/**
+ * \brief Check that the result of an entry is expected, and its value if it is found.
+ */
+static int test_check_found(const test_batch* const b, const size_t i, const int expected, const int expected_value){
+    CHECK(b->results[i] == expected);
+    if( expected == 0 ){
+        CHECK(b->found_sizes[i] == sizeof(int));
+        CHECK(memcmp(b->found[i], &expected_value, sizeof(int)) == 0);
+    }
+    return 0;
+}
+
+/**
+ * \brief Add a batch with bad and repeated entries to a table growing in the
+ * middle of the groups, then look every entry up.
+ */
+static int test_add_get(void){
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    test_batch *b = malloc(sizeof(*b));
+    size_t i;
+    int expected;
+    CHECK(ht != NULL && b != NULL);
+
+    test_fill(b, TEST_NB_KEYS);
+    b->keys[TEST_NULL_KEY] = NULL;
+    b->key_sizes[TEST_EMPTY_KEY] = 0;
+    b->values[TEST_NULL_VALUE] = NULL;
+    b->key_storage[TEST_REPEAT] = TEST_REPEATED_KEY;
+    CHECK(HT_add_elements_batch(ht, TEST_NB_KEYS, b->keys, b->key_sizes, b->values, b->value_sizes, 1, b->results) == TEST_NB_KEYS - 4);
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        if( i == TEST_NULL_KEY || i == TEST_EMPTY_KEY || i == TEST_NULL_VALUE )
+            expected = 2;
+        else
+            expected = i == TEST_REPEAT ? 1 : 0;
+        CHECK(b->results[i] == expected);
+    }
+    CHECK(HT_get_nb_elements(ht) == TEST_NB_KEYS - 4);
+    // The table grew during the batch
+    CHECK(ht->_nb_slots >= 1024);
+
+    CHECK(HT_get_elements_batch(ht, TEST_NB_KEYS, b->keys, b->key_sizes, b->found, b->found_sizes, b->results) == TEST_NB_KEYS - 3);
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        if( i == TEST_NULL_KEY || i == TEST_EMPTY_KEY )
+            CHECK(test_check_found(b, i, 2, 0) == 0);
+        else if( i == TEST_NULL_VALUE )
+            CHECK(test_check_found(b, i, 1, 0) == 0);
+        else if( i == TEST_REPEAT )
+            CHECK(test_check_found(b, i, 0, 3 * TEST_REPEATED_KEY) == 0);
+        else
+            CHECK(test_check_found(b, i, 0, 3 * (int) i) == 0);
+    }
+    // Without results nor values, only counted
+    CHECK(HT_get_elements_batch(ht, TEST_NB_KEYS, b->keys, b->key_sizes, NULL, NULL, NULL) == TEST_NB_KEYS - 3);
+
+    // Duplicates are added in front when the keys do not have to be unique
+    test_fill(b, 2 * HT_BATCH_PIPELINE_DEPTH + 3);
+    for(i = 0; i < 2 * HT_BATCH_PIPELINE_DEPTH + 3; ++i)
+        b->value_storage[i] = -(int) i;
+    CHECK(HT_add_elements_batch(ht, 2 * HT_BATCH_PIPELINE_DEPTH + 3, b->keys, b->key_sizes, b->values, b->value_sizes, 0, b->results) == 2 * HT_BATCH_PIPELINE_DEPTH + 3);
+    CHECK(HT_get_elements_batch(ht, 2 * HT_BATCH_PIPELINE_DEPTH + 3, b->keys, b->key_sizes, b->found, b->found_sizes, b->results) == 2 * HT_BATCH_PIPELINE_DEPTH + 3);
+    for(i = 0; i < 2 * HT_BATCH_PIPELINE_DEPTH + 3; ++i)
+        CHECK(test_check_found(b, i, 0, -(int) i) == 0);
+    CHECK(HT_get_nb_elements(ht) == TEST_NB_KEYS - 4 + 2 * HT_BATCH_PIPELINE_DEPTH + 3);
+
+    CHECK(HT_add_elements_batch(NULL, 1, b->keys, b->key_sizes, b->values, b->value_sizes, 1, NULL) == 0 && errno == EINVAL);
+    HT_delete_pointer(ht);
+    free(b);
+    return 0;
+}
+
+/**
+ * \brief Look up and remove batches while a resize moves the slots, then
+ * remove enough elements for the table to shrink in the middle of a group.
+ */
+static int test_resizing(void){
+    HT_hash_table *ht = HT_new_hash(1024, HT_hash_wy);
+    test_batch *b = malloc(sizeof(*b));
+    size_t i,
+           done;
+    CHECK(ht != NULL && b != NULL);
+    CHECK(HT_set_load_factors(ht, 0.0f, 0.0f) == 0);
+
+    test_fill(b, TEST_NB_KEYS);
+    CHECK(HT_add_elements_batch(ht, TEST_NB_KEYS, b->keys, b->key_sizes, b->values, b->value_sizes, 1, NULL) == TEST_NB_KEYS);
+    CHECK(ht->_nb_slots == 1024 && ht->_new_slots == NULL);
+    CHECK(HT_resize(ht, 8192) == 0);
+
+    // Lookups find the keys in both slot arrays
+    CHECK(HT_get_elements_batch(ht, TEST_NB_KEYS, b->keys, b->key_sizes, b->found, b->found_sizes, b->results) == TEST_NB_KEYS);
+    for(i = 0; i < TEST_NB_KEYS; ++i)
+        CHECK(test_check_found(b, i, 0, 3 * (int) i) == 0);
+
+    // Each group of a removal migrates some slots, the first ones leave the resize unfinished
+    for(done = 0; done < TEST_NB_KEYS; done += 40){
+        CHECK(HT_remove_elements_batch(ht, 20, &b->keys[done], &b->key_sizes[done], b->results) == 20);
+        for(i = 0; i < 20; ++i)
+            CHECK(b->results[i] == 0);
+        if( done == 0 )
+            CHECK(ht->_new_slots != NULL && ht->_rehash_index != 0);
+        CHECK(HT_get_elements_batch(ht, 20, &b->keys[done + 20], &b->key_sizes[done + 20], NULL, NULL, b->results) == 20);
+    }
+    CHECK(ht->_new_slots == NULL && ht->_nb_slots == 8192);
+    CHECK(HT_get_nb_elements(ht) == TEST_NB_KEYS / 2);
+
+    // A key removed twice in a batch and bad keys
+    CHECK(HT_remove_elements_batch(ht, 5, &b->keys[21], &b->key_sizes[21], NULL) == 5);
+    b->key_storage[1] = 20;
+    b->keys[2] = NULL;
+    b->key_sizes[3] = 0;
+    b->key_storage[0] = 20;
+    CHECK(HT_remove_elements_batch(ht, 4, b->keys, b->key_sizes, b->results) == 1);
+    CHECK(b->results[0] == 0 && b->results[1] == 1 && b->results[2] == 2 && b->results[3] == 2);
+
+    // The removals shrink the table in the middle of their groups
+    CHECK(HT_set_load_factors(ht, 1.0f, 0.25f) == 0);
+    test_fill(b, TEST_NB_KEYS);
+    CHECK(HT_remove_elements_batch(ht, TEST_NB_KEYS - 200, &b->keys[200], &b->key_sizes[200], b->results) == TEST_NB_KEYS / 2 - 100);
+    CHECK(ht->_nb_slots < 8192 || ht->_new_slots != NULL);
+    CHECK(HT_get_elements_batch(ht, 200, b->keys, b->key_sizes, b->found, b->found_sizes, b->results) == 94);
+    for(i = 0; i < 200; ++i){
+        if( i % 40 >= 20 && (i < 20 || i > 25) )
+            CHECK(test_check_found(b, i, 0, 3 * (int) i) == 0);
+        else
+            CHECK(b->results[i] == 1);
+    }
+    HT_delete_pointer(ht);
+    free(b);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_add_get(), failures);
+    RUN(test_resizing(), failures);
+    return failures != 0;
+}
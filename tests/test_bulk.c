@@ -0,0 +1,363 @@
+/**
+ * \file test_bulk.c
+ * \brief Check the bulk builds, from arrays and from a reader, and the blocks of pairs they allocate.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of records of the large builds.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The key holding the duplicates.
+ */
+#define TEST_KEY 7
+
+/**
+ * \brief The buffers of a ::test_allocate allocator.
+ */
+typedef struct{
+    size_t nb_live;             /**<- The buffers allocated and not released yet. */
+    void *last;                 /**<- The last buffer allocated. */
+    void *watched;              /**<- The buffer whose release is reported. */
+    int watched_released;       /**<- True once watched is released. */
+    int fail;                   /**<- True to fail every allocation. */
+} test_buffers;
+
+static void* test_allocate(void* context, size_t size){
+    test_buffers *buffers = context;
+    void *buffer;
+    if( buffers->fail ){
+        errno = ENOMEM;
+        return NULL;
+    }
+    buffer = malloc(size);
+    if( buffer != NULL ){
+        __atomic_add_fetch(&buffers->nb_live, 1, __ATOMIC_RELAXED);
+        buffers->last = buffer;
+    }
+    return buffer;
+}
+
+static void test_release(void* context, void* buffer){
+    test_buffers *buffers = context;
+    if( buffer == buffers->watched )
+        buffers->watched_released = 1;
+    __atomic_sub_fetch(&buffers->nb_live, 1, __ATOMIC_RELAXED);
+    free(buffer);
+}
+
+/**
+ * \brief The records given by ::test_read_record.
+ */
+typedef struct{
+    const int *keys,            /**<- The keys. */
+              *values;          /**<- The values. */
+    size_t nb_records,          /**<- The number of records. */
+           next,                /**<- The next record given. */
+           fail_at;             /**<- The record replaced by an error, nb_records for none. */
+    int key;                    /**<- The copy of the key given last, overwritten by the next call. */
+} test_records;
+
+/**
+ * \brief Give the next record of a ::test_records, from a buffer reused by every call.
+ */
+static int test_read_record(void* context, const void** key, size_t* key_size, const void** value, size_t* value_size){
+    test_records *records = context;
+    if( records->next == records->nb_records )
+        return 1;
+    if( records->next == records->fail_at ){
+        errno = EIO;
+        return 2;
+    }
+    records->key = records->keys[records->next];
+    *key = &records->key;
+    *key_size = sizeof(records->key);
+    *value = &records->values[records->next];
+    *value_size = sizeof(int);
+    ++records->next;
+    return 0;
+}
+
+/**
+ * \brief Point the arrays of a bulk build at integer keys and values.
+ */
+static void test_arrays(const int* const keys, const int* const values, const size_t nb_records, const void** key_pointers, size_t* key_sizes, const void** value_pointers, size_t* value_sizes){
+    size_t i;
+    for(i = 0; i < nb_records; ++i){
+        key_pointers[i] = &keys[i];
+        key_sizes[i] = sizeof(int);
+        value_pointers[i] = &values[i];
+        value_sizes[i] = sizeof(int);
+    }
+}
+
+/**
+ * \brief Check the values of the duplicates of a key in order, and that there is no other.
+ */
+static int test_check_values(const HT_hash_table* const ht, const int key, const int* const expected, const unsigned int nb_expected){
+    size_t found_size;
+    void *found;
+    unsigned int i;
+    for(i = 0; i < nb_expected; ++i){
+        CHECK(HT_get_element_position(ht, &key, sizeof(key), &found, &found_size, i, 0) == 0);
+        CHECK(found_size == sizeof(int) && *(int*) found == expected[i]);
+    }
+    // Past the last match, the last match is returned
+    CHECK(HT_get_element_position(ht, &key, sizeof(key), &found, &found_size, nb_expected, 0) == 0);
+    CHECK(*(int*) found == expected[nb_expected - 1]);
+    return 0;
+}
+
+/**
+ * \brief The records of a key go after its elements already present, in the order given.
+ * \param nb_threads The number of threads hashing the keys.
+ */
+static int test_append_order(const unsigned int nb_threads){
+    static const int keys[] = {TEST_KEY, TEST_KEY + 1, TEST_KEY, TEST_KEY},
+                     values[] = {3, 9, 4, 5},
+                     stream_keys[] = {TEST_KEY, TEST_KEY + 1},
+                     stream_values[] = {6, 10},
+                     after_build[] = {1, 2, 3, 4, 5},
+                     after_stream[] = {1, 2, 3, 4, 5, 6},
+                     other_after_stream[] = {9, 10};
+    test_records records = {stream_keys, stream_values, 2, 0, 2, 0};
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    const void *key_pointers[4],
+               *value_pointers[4];
+    size_t key_sizes[4],
+           value_sizes[4];
+    const int key = TEST_KEY;
+    int value;
+    CHECK(ht != NULL);
+
+    for(value = 1; value <= 2; ++value)
+        CHECK(HT_add_element_position(ht, &key, sizeof(key), &value, sizeof(value), 0, 1) == 0);
+    test_arrays(keys, values, 4, key_pointers, key_sizes, value_pointers, value_sizes);
+    CHECK(HT_bulk_build(ht, 4, key_pointers, key_sizes, value_pointers, value_sizes, nb_threads) == 0);
+    CHECK(HT_get_nb_elements(ht) == 6);
+    CHECK(test_check_values(ht, TEST_KEY, after_build, 5) == 0);
+
+    CHECK(HT_bulk_build_stream(ht, test_read_record, &records, nb_threads) == 0);
+    CHECK(HT_get_nb_elements(ht) == 8);
+    CHECK(test_check_values(ht, TEST_KEY, after_stream, 6) == 0);
+    CHECK(test_check_values(ht, TEST_KEY + 1, other_after_stream, 2) == 0);
+
+    // Nothing to build is not an error, even without arrays
+    CHECK(HT_bulk_build(ht, 0, NULL, NULL, NULL, NULL, nb_threads) == 0);
+    records.next = 2;
+    CHECK(HT_bulk_build_stream(ht, test_read_record, &records, nb_threads) == 0);
+    CHECK(HT_get_nb_elements(ht) == 8);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief A failed build leaves the table as it was.
+ */
+static int test_errors(void){
+    static int keys[TEST_NB_KEYS],
+               values[TEST_NB_KEYS];
+    static const void *key_pointers[TEST_NB_KEYS],
+                      *value_pointers[TEST_NB_KEYS];
+    static size_t key_sizes[TEST_NB_KEYS],
+                  value_sizes[TEST_NB_KEYS];
+    int existing = TEST_NB_KEYS,
+        key;
+    test_buffers buffers = {0, NULL, NULL, 0, 0};
+    HT_allocator allocator = {test_allocate, test_release, NULL, &buffers};
+    test_records records;
+    HT_hash_table ht;
+    unsigned int nb_slots;
+
+    CHECK(HT_init_allocator(&ht, 8192, HT_hash_wy, &allocator) == 0);
+    CHECK(HT_add_element(&ht, &existing, sizeof(existing), &existing, sizeof(existing)) == 0);
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        keys[key] = key;
+        values[key] = key * 3;
+    }
+    test_arrays(keys, values, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes);
+    nb_slots = ht._nb_slots;
+
+    key_pointers[TEST_NB_KEYS / 2] = NULL;
+    CHECK(HT_bulk_build(&ht, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes, 2) == 2 && errno == EINVAL);
+    key_pointers[TEST_NB_KEYS / 2] = &keys[TEST_NB_KEYS / 2];
+    value_sizes[TEST_NB_KEYS - 1] = 0;
+    CHECK(HT_bulk_build(&ht, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes, 2) == 2 && errno == EINVAL);
+    value_sizes[TEST_NB_KEYS - 1] = sizeof(int);
+    CHECK(HT_bulk_build(&ht, TEST_NB_KEYS, key_pointers, key_sizes, NULL, value_sizes, 2) == 2 && errno == EINVAL);
+    CHECK(HT_bulk_build(NULL, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes, 2) == 2 && errno == EINVAL);
+
+    // The block of pairs cannot be allocated
+    buffers.fail = 1;
+    CHECK(HT_bulk_build(&ht, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes, 2) == 2 && errno == ENOMEM);
+    buffers.fail = 0;
+
+    // The reader fails, or gives a bad record, before the end of the first chunk
+    records.keys = keys;
+    records.values = values;
+    records.nb_records = TEST_NB_KEYS;
+    records.next = 0;
+    records.fail_at = TEST_NB_KEYS - 1;
+    CHECK(HT_bulk_build_stream(&ht, test_read_record, &records, 2) == 2 && errno == EIO);
+    CHECK(HT_bulk_build_stream(&ht, NULL, &records, 2) == 2 && errno == EINVAL);
+
+    CHECK(HT_get_nb_elements(&ht) == 1 && ht._nb_slots == nb_slots && ht._new_slots == NULL);
+    CHECK(buffers.nb_live == 1);
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(HT_get_element(&ht, &key, sizeof(key), NULL, NULL) == 1);
+    CHECK(HT_get_element(&ht, &existing, sizeof(existing), NULL, NULL) == 0);
+
+    // The table is still usable
+    CHECK(HT_bulk_build(&ht, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes, 2) == 0);
+    CHECK(HT_get_nb_elements(&ht) == TEST_NB_KEYS + 1);
+    HT_reset_table(&ht);
+    CHECK(HT_set_robin_backend(&ht) == 0);
+    CHECK(HT_bulk_build(&ht, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes, 2) == 2 && errno == EINVAL);
+    CHECK(HT_bulk_build_stream(&ht, test_read_record, &records, 2) == 2 && errno == EINVAL);
+    HT_delete(&ht);
+    CHECK(buffers.nb_live == 0);
+    return 0;
+}
+
+/**
+ * \brief The block of a build is released with its last pair, whether the
+ * pairs are removed or moved out of the block by an upsert.
+ */
+static int test_block_release(void){
+    int keys[8],
+        values[8],
+        larger[2] = {1, 2},
+        key;
+    const void *key_pointers[8],
+               *value_pointers[8];
+    size_t key_sizes[8],
+           value_sizes[8],
+           found_size;
+    void *found;
+    test_buffers buffers = {0, NULL, NULL, 0, 0};
+    HT_allocator allocator = {test_allocate, test_release, NULL, &buffers};
+    HT_hash_table ht;
+    int value;
+
+    CHECK(HT_init_allocator(&ht, 64, HT_hash_wy, &allocator) == 0);
+    for(key = 0; key < 8; ++key){
+        keys[key] = key;
+        values[key] = key * 3;
+    }
+    test_arrays(keys, values, 8, key_pointers, key_sizes, value_pointers, value_sizes);
+    CHECK(HT_bulk_build(&ht, 8, key_pointers, key_sizes, value_pointers, value_sizes, 1) == 0);
+    CHECK(buffers.nb_live == 1);
+    buffers.watched = buffers.last;
+
+    for(key = 0; key < 4; ++key)
+        CHECK(HT_remove_element_position(&ht, &key, sizeof(key), 0, 0) == 0);
+    CHECK(!buffers.watched_released);
+
+    // An upsert of the same size stays in the block, another size leaves it
+    key = 4;
+    value = 40;
+    CHECK(HT_upsert(&ht, &key, sizeof(key), &value, sizeof(value)) == 1);
+    CHECK(buffers.nb_live == 1);
+    for(key = 4; key < 7; ++key)
+        CHECK(HT_upsert(&ht, &key, sizeof(key), larger, sizeof(larger)) == 1);
+    CHECK(buffers.nb_live == 4 && !buffers.watched_released);
+    key = 7;
+    CHECK(HT_upsert(&ht, &key, sizeof(key), larger, sizeof(larger)) == 1);
+    CHECK(buffers.watched_released && buffers.nb_live == 4);
+    for(key = 4; key < 8; ++key){
+        CHECK(HT_get_element(&ht, &key, sizeof(key), &found, &found_size) == 0);
+        CHECK(found_size == sizeof(larger) && memcmp(found, larger, sizeof(larger)) == 0);
+    }
+    CHECK(HT_get_nb_elements(&ht) == 4);
+    HT_delete(&ht);
+    CHECK(buffers.nb_live == 0);
+    return 0;
+}
+
+/**
+ * \brief Several threads destroy the pairs of the same blocks, the last one releasing each block.
+ */
+static int test_parallel_delete(void){
+    static int keys[TEST_NB_KEYS],
+               values[TEST_NB_KEYS];
+    static const void *key_pointers[TEST_NB_KEYS],
+                      *value_pointers[TEST_NB_KEYS];
+    static size_t key_sizes[TEST_NB_KEYS],
+                  value_sizes[TEST_NB_KEYS];
+    test_buffers buffers = {0, NULL, NULL, 0, 0};
+    HT_allocator allocator = {test_allocate, test_release, NULL, &buffers};
+    test_records records;
+    HT_hash_table ht;
+    int key;
+
+    CHECK(HT_init_allocator(&ht, 64, HT_hash_wy, &allocator) == 0);
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        keys[key] = key;
+        values[key] = key * 3;
+    }
+    test_arrays(keys, values, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes);
+    records.keys = keys;
+    records.values = values;
+    records.nb_records = TEST_NB_KEYS;
+    records.next = 0;
+    records.fail_at = TEST_NB_KEYS;
+
+    // Two blocks and single pairs mixed in the same slots
+    CHECK(HT_bulk_build(&ht, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes, 4) == 0);
+    CHECK(HT_bulk_build_stream(&ht, test_read_record, &records, 4) == 0);
+    for(key = 0; key < TEST_NB_KEYS; key += 7)
+        CHECK(HT_add_element_position(&ht, &key, sizeof(key), &key, sizeof(key), 0, 0) == 0);
+    CHECK(HT_get_nb_elements(&ht) == 2 * TEST_NB_KEYS + (TEST_NB_KEYS + 6) / 7);
+    CHECK(HT_get_element(&ht, &keys[TEST_NB_KEYS - 1], sizeof(int), NULL, NULL) == 0);
+
+    HT_parallel_reset_table(&ht, 4);
+    CHECK(HT_get_nb_elements(&ht) == 0 && buffers.nb_live == 0);
+    CHECK(HT_bulk_build(&ht, TEST_NB_KEYS, key_pointers, key_sizes, value_pointers, value_sizes, 4) == 0);
+    records.next = 0;
+    CHECK(HT_bulk_build_stream(&ht, test_read_record, &records, 4) == 0);
+    CHECK(buffers.nb_live == 2);
+    HT_parallel_delete(&ht, 4);
+    CHECK(buffers.nb_live == 0);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_append_order(1), failures);
+    RUN(test_append_order(4), failures);
+    RUN(test_errors(), failures);
+    RUN(test_block_release(), failures);
+    RUN(test_parallel_delete(), failures);
+    return failures != 0;
+}
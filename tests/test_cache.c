@@ -0,0 +1,219 @@
+/**
+ * \file test_cache.c
+ * \brief Check the cache, its CLOCK eviction, its time to live and its evict function.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "test.h"
+#include "cache_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys inserted, enough for many turns of the clock hand.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The largest number of evictions recorded.
+ */
+#define TEST_MAX_EVICTIONS 16
+
+/**
+ * \brief The evictions told to ::test_evict.
+ */
+typedef struct{
+    int keys[TEST_MAX_EVICTIONS];
+    unsigned int reasons[TEST_MAX_EVICTIONS];
+    unsigned int nb_evictions;
+} test_evictions;
+
+/**
+ * \brief Record an eviction in the ::test_evictions given as data.
+ */
+static void test_evict(const void* key, const size_t key_size, void* value, const size_t value_size, const unsigned int reason, void* data){
+    test_evictions *evictions = data;
+    (void) value;
+    (void) value_size;
+    if( key_size == sizeof(int) && evictions->nb_evictions < TEST_MAX_EVICTIONS ){
+        memcpy(&evictions->keys[evictions->nb_evictions], key, sizeof(int));
+        evictions->reasons[evictions->nb_evictions] = reason;
+    }
+    ++evictions->nb_evictions;
+}
+
+/**
+ * \brief Wait for the time to live of the entries added before to be over.
+ * \param ms The number of milliseconds to wait.
+ */
+static void test_sleep(const long ms){
+    struct timespec t = { 0, ms * 1000000L };
+    while( nanosleep(&t, &t) != 0 && errno == EINTR );
+}
+
+/**
+ * \brief Add an int element without time to live.
+ */
+static int test_add(HT_cache* const cache, const int key, const int value){
+    return HT_cache_add_element(cache, &key, sizeof(key), &value, sizeof(value), 0);
+}
+
+/**
+ * \brief Test if a key is in the cache, marking it referenced if it is.
+ */
+static int test_present(HT_cache* const cache, const int key){
+    return HT_cache_get_element(cache, &key, sizeof(key), NULL, NULL) == 0;
+}
+
+/**
+ * \brief A referenced entry gets a second chance from the clock hand, the
+ * unreferenced ones are evicted in ring order.
+ */
+static int test_second_chance(void){
+    test_evictions evictions = { {0}, {0}, 0 };
+    HT_cache cache;
+    int key;
+    CHECK(HT_cache_init(&cache, 16, HT_hash_wy, 4, 0) == 0);
+    CHECK(HT_cache_set_evict_function(&cache, test_evict, &evictions) == 0);
+
+    for(key = 0; key < 4; ++key)
+        CHECK(test_add(&cache, key, key * 3) == 0);
+    CHECK(test_present(&cache, 0) && test_present(&cache, 2));
+    CHECK(evictions.nb_evictions == 0);
+
+    // The hand clears 0 and evicts 1, then clears 2 and evicts 3
+    CHECK(test_add(&cache, 4, 12) == 0);
+    CHECK(test_add(&cache, 5, 15) == 0);
+    CHECK(evictions.nb_evictions == 2);
+    CHECK(evictions.keys[0] == 1 && evictions.reasons[0] == HT_CACHE_EVICTED);
+    CHECK(evictions.keys[1] == 3 && evictions.reasons[1] == HT_CACHE_EVICTED);
+    CHECK(HT_cache_get_nb_elements(&cache) == 4);
+    CHECK(!test_present(&cache, 1) && !test_present(&cache, 3));
+
+    // 0 spent its second chance and was not used since
+    CHECK(test_add(&cache, 6, 18) == 0);
+    CHECK(evictions.nb_evictions == 3 && evictions.keys[2] == 0);
+    CHECK(test_present(&cache, 2) && test_present(&cache, 4) && test_present(&cache, 5) && test_present(&cache, 6));
+
+    // A hot key survives any number of insertions
+    for(key = 100; key < 100 + TEST_NB_KEYS; ++key){
+        CHECK(test_present(&cache, 2));
+        CHECK(test_add(&cache, key, key * 3) == 0);
+        CHECK(HT_cache_get_nb_elements(&cache) == 4);
+    }
+    CHECK(evictions.nb_evictions == 3 + TEST_NB_KEYS);
+    HT_cache_delete(&cache);
+    return 0;
+}
+
+/**
+ * \brief Expired entries are removed by the lookup finding them or by the
+ * clock hand, even when referenced.
+ */
+static int test_ttl(void){
+    test_evictions evictions = { {0}, {0}, 0 };
+    HT_cache *cache = HT_cache_new_hash(16, HT_hash_wy, 2, 0);
+    int key = 1,
+        value = 3;
+    CHECK(cache != NULL);
+    CHECK(HT_cache_set_evict_function(cache, test_evict, &evictions) == 0);
+
+    CHECK(HT_cache_add_element(cache, &key, sizeof(key), &value, sizeof(value), 1) == 0);
+    key = 2;
+    CHECK(HT_cache_add_element(cache, &key, sizeof(key), &value, sizeof(value), 60000) == 0);
+    CHECK(test_present(cache, 1) && test_present(cache, 2));
+    test_sleep(5);
+    CHECK(!test_present(cache, 1) && test_present(cache, 2));
+    CHECK(evictions.nb_evictions == 1 && evictions.keys[0] == 1 && evictions.reasons[0] == HT_CACHE_EXPIRED);
+    CHECK(HT_cache_get_nb_elements(cache) == 1);
+
+    // The hand takes the expired referenced entry before the unreferenced one
+    key = 3;
+    CHECK(HT_cache_add_element(cache, &key, sizeof(key), &value, sizeof(value), 1) == 0);
+    CHECK(test_present(cache, 3));
+    CHECK(HT_cache_get_nb_elements(cache) == 2);
+    test_sleep(5);
+    CHECK(test_add(cache, 4, 12) == 0);
+    CHECK(evictions.nb_evictions == 2 && evictions.keys[1] == 3 && evictions.reasons[1] == HT_CACHE_EXPIRED);
+    CHECK(test_present(cache, 2) && test_present(cache, 4));
+    HT_cache_delete_pointer(cache);
+    return 0;
+}
+
+/**
+ * \brief Stay within a byte budget, replace values in place and keep the
+ * evict function silent for explicit removals.
+ */
+static int test_budget(void){
+    test_evictions evictions = { {0}, {0}, 0 };
+    HT_cache *cache = HT_cache_new_hash(16, HT_hash_wy, 0, 8 * 2 * sizeof(int));
+    char big[8 * 2 * sizeof(int)];
+    size_t found_size;
+    void *found;
+    int key;
+    CHECK(cache != NULL);
+    CHECK(HT_cache_set_evict_function(cache, test_evict, &evictions) == 0);
+
+    for(key = 0; key < 8; ++key)
+        CHECK(test_add(cache, key, key * 3) == 0);
+    CHECK(HT_cache_get_nb_bytes(cache) == 8 * 2 * sizeof(int) && evictions.nb_evictions == 0);
+    CHECK(test_add(cache, 8, 24) == 0);
+    CHECK(HT_cache_get_nb_elements(cache) == 8 && evictions.nb_evictions == 1);
+
+    // A replaced value is not an eviction
+    CHECK(test_add(cache, 8, 25) == 1);
+    key = 8;
+    CHECK(HT_cache_get_element(cache, &key, sizeof(key), &found, &found_size) == 0);
+    CHECK(found_size == sizeof(int) && *(int*) found == 25);
+    CHECK(HT_cache_remove_element(cache, &key, sizeof(key)) == 0);
+    CHECK(HT_cache_remove_element(cache, &key, sizeof(key)) == 1);
+    CHECK(evictions.nb_evictions == 1);
+    CHECK(HT_cache_get_nb_bytes(cache) == 7 * 2 * sizeof(int));
+
+    // Alone above the budget
+    memset(big, 0, sizeof(big));
+    CHECK(HT_cache_add_element(cache, &key, sizeof(key), big, sizeof(big), 0) == 2 && errno == ENOSPC);
+    // Fits once every other entry is evicted
+    CHECK(HT_cache_add_element(cache, &key, sizeof(key), big, sizeof(big) - sizeof(key), 0) == 0);
+    CHECK(HT_cache_get_nb_elements(cache) == 1 && evictions.nb_evictions == 8);
+
+    HT_cache_reset_table(cache);
+    CHECK(HT_cache_get_nb_elements(cache) == 0 && HT_cache_get_nb_bytes(cache) == 0);
+    CHECK(evictions.nb_evictions == 8);
+    HT_cache_delete_pointer(cache);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_second_chance(), failures);
+    RUN(test_ttl(), failures);
+    RUN(test_budget(), failures);
+    return failures != 0;
+}
@@ -0,0 +1,177 @@
+/**
+ * \file test_compact.c
+ * \brief Check the compact table, the compaction of its heap and its 32 bits offset limit.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "compact_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys inserted, enough for several grows of the buckets and of the heap.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The size of the record of an int key and an int value: the two
+ * offsets, one byte per varint, the key and the value.
+ */
+#define TEST_RECORD_SIZE (2 * sizeof(uint32_t) + 2 + 2 * sizeof(int))
+
+/**
+ * \brief Check every key below nb_keys, the removed ones being absent.
+ * \param step Only the multiples of step are present.
+ */
+static int test_check_keys(const HT_compact_table* const ct, const int nb_keys, const int step){
+    size_t found_size;
+    void *found;
+    int key,
+        value;
+    for(key = 0; key < nb_keys; ++key){
+        if( key % step != 0 ){
+            CHECK(HT_compact_get_element(ct, &key, sizeof(key), &found, &found_size) == 1);
+            continue;
+        }
+        CHECK(HT_compact_get_element(ct, &key, sizeof(key), &found, &found_size) == 0);
+        // Not aligned inside of the heap
+        memcpy(&value, found, sizeof(value));
+        CHECK(found_size == sizeof(value) && value == key * 3);
+    }
+    return 0;
+}
+
+/**
+ * \brief Pack the keys in the heap, then remove most of them: the heap is
+ * compacted once more than half of it is removed records.
+ */
+static int test_compaction(void){
+    HT_compact_table *ct = HT_compact_new_hash(16, HT_hash_wy);
+    unsigned int nb_collections = 0;
+    size_t heap_size;
+    int key,
+        value;
+    CHECK(ct != NULL);
+
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        value = key * 3;
+        CHECK(HT_compact_add_element(ct, &key, sizeof(key), &value, sizeof(value)) == 0);
+    }
+    CHECK(HT_compact_add_element(ct, &key, sizeof(key), &value, sizeof(value)) == 0);
+    CHECK(HT_compact_add_element(ct, &key, sizeof(key), &value, sizeof(value)) == 1);
+    CHECK(HT_compact_remove_element(ct, &key, sizeof(key)) == 0);
+    // One byte before the first record, the records end to end
+    CHECK(HT_compact_get_nb_elements(ct) == TEST_NB_KEYS);
+    CHECK(ct->_heap_size == 1 + (TEST_NB_KEYS + 1) * TEST_RECORD_SIZE);
+    CHECK(ct->_garbage == TEST_RECORD_SIZE);
+    CHECK(((size_t) 1 << ct->_bucket_bits) >= TEST_NB_KEYS);
+    CHECK(test_check_keys(ct, TEST_NB_KEYS, 1) == 0);
+
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        if( key % 8 == 0 )
+            continue;
+        heap_size = ct->_heap_size;
+        CHECK(HT_compact_remove_element(ct, &key, sizeof(key)) == 0);
+        CHECK(HT_compact_remove_element(ct, &key, sizeof(key)) == 1);
+        if( ct->_heap_size < heap_size ){
+            ++nb_collections;
+            CHECK(ct->_garbage == 0);
+            CHECK(ct->_heap_size == 1 + HT_compact_get_nb_elements(ct) * TEST_RECORD_SIZE);
+        }
+        CHECK(ct->_garbage <= ct->_heap_size / 2 || ct->_heap_size <= 4096);
+    }
+    CHECK(nb_collections >= 1);
+    CHECK(HT_compact_get_nb_elements(ct) == TEST_NB_KEYS / 8);
+    CHECK(test_check_keys(ct, TEST_NB_KEYS, 8) == 0);
+
+    // The keys added after a compaction are chained with the moved ones
+    for(key = 1; key < TEST_NB_KEYS; key += 8){
+        value = key * 3;
+        CHECK(HT_compact_add_element(ct, &key, sizeof(key), &value, sizeof(value)) == 0);
+    }
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        if( key % 8 == 0 || key % 8 == 1 )
+            CHECK(HT_compact_get_element(ct, &key, sizeof(key), NULL, NULL) == 0);
+        else
+            CHECK(HT_compact_get_element(ct, &key, sizeof(key), NULL, NULL) == 1);
+    }
+
+    heap_size = ct->_heap_capacity;
+    HT_compact_reset_table(ct);
+    CHECK(HT_compact_get_nb_elements(ct) == 0 && ct->_heap_capacity == heap_size);
+    key = 0;
+    CHECK(HT_compact_get_element(ct, &key, sizeof(key), NULL, NULL) == 1);
+    HT_compact_delete_pointer(ct);
+    return 0;
+}
+
+/**
+ * \brief Refuse the elements whose record would not be addressable with 32
+ * bits offsets, the table staying usable.
+ */
+static int test_offset_limit(void){
+    HT_compact_table ct;
+    size_t heap_size,
+           heap_capacity;
+    int key = 1,
+        value = 3;
+    CHECK(HT_compact_init(&ct, 16, HT_hash_wy) == 0);
+    CHECK(HT_compact_add_element(&ct, &key, sizeof(key), &value, sizeof(value)) == 0);
+
+    // Sizes too large for a record are refused before the key is read
+    CHECK(HT_compact_add_element(&ct, &key, (size_t) UINT32_MAX + 1, &value, sizeof(value)) == 2 && errno == ENOSPC);
+    CHECK(HT_compact_add_element(&ct, &key, sizeof(key), &value, (size_t) UINT32_MAX + 1) == 2 && errno == ENOSPC);
+
+    // A heap about to pass 4 GiB, faked instead of allocated
+    heap_size = ct._heap_size;
+    heap_capacity = ct._heap_capacity;
+    ct._heap_size = UINT32_MAX - TEST_RECORD_SIZE / 2;
+    ct._heap_capacity = ct._heap_size;
+    key = 2;
+    CHECK(HT_compact_add_element(&ct, &key, sizeof(key), &value, sizeof(value)) == 2 && errno == ENOSPC);
+    CHECK(HT_compact_get_nb_elements(&ct) == 1);
+    ct._heap_size = heap_size;
+    ct._heap_capacity = heap_capacity;
+
+    CHECK(HT_compact_add_element(&ct, &key, sizeof(key), &value, sizeof(value)) == 0);
+    CHECK(HT_compact_get_nb_elements(&ct) == 2);
+    key = 1;
+    CHECK(HT_compact_get_element(&ct, &key, sizeof(key), NULL, NULL) == 0);
+    HT_compact_delete(&ct);
+
+    CHECK(HT_compact_init(&ct, 0, HT_hash_wy) == 1 && errno == EINVAL);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_compaction(), failures);
+    RUN(test_offset_limit(), failures);
+    return failures != 0;
+}
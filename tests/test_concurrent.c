@@ -0,0 +1,417 @@
+/**
+ * \file test_concurrent.c
+ * \brief Stress the concurrent hash table with readers and writers.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "test.h"
+#include "concurrent_hash_table.h"
+#include "epoch.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys never removed.
+ */
+#define TEST_NB_STABLE_KEYS 2000
+
+/**
+ * \brief The number of keys added and removed by each writer.
+ */
+#define TEST_NB_CHURN_KEYS 4000
+
+/**
+ * \brief The number of times each writer adds and removes its keys.
+ */
+#define TEST_NB_ROUNDS 4
+
+/**
+ * \brief The number of threads looking up keys.
+ */
+#define TEST_NB_READERS 4
+
+/**
+ * \brief The number of threads adding and removing keys.
+ */
+#define TEST_NB_WRITERS 3
+
+/**
+ * \brief The number of keys of the single threaded round trips, enough for several resizes.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The key holding the duplicates.
+ */
+#define TEST_KEY 7u
+
+/**
+ * \brief A value made of copies of its key, a torn read breaks the pattern.
+ */
+typedef struct{
+    unsigned int words[8];
+} test_value;
+
+static void test_make_value(const unsigned int key, test_value* const value){
+    unsigned int i;
+    for(i = 0; i < sizeof(value->words) / sizeof(*value->words); ++i)
+        value->words[i] = key ^ i;
+}
+
+static int test_is_value(const unsigned int key, const void* const found, const size_t found_size){
+    test_value expected;
+    test_make_value(key, &expected);
+    return found_size == sizeof(expected) && memcmp(found, &expected, sizeof(expected)) == 0;
+}
+
+/**
+ * \brief Copy the value at a position of ::TEST_KEY.
+ * \return The value, UINT_MAX if not found.
+ */
+static unsigned int test_duplicate_at(HT_concurrent_table* const ct, const unsigned int position, const int reverse){
+    const unsigned int key = TEST_KEY;
+    unsigned int value;
+    size_t value_size = sizeof(value);
+    if( HT_concurrent_get_element_position(ct, &key, sizeof(key), &value, &value_size, position, reverse) != 0 ||
+            value_size != sizeof(value) )
+        return UINT_MAX;
+    return value;
+}
+
+/**
+ * \brief Add and remove keys from a single thread through several resizes,
+ * the lookups locking the stripes.
+ */
+static int test_locked_round_trip(void){
+    static const unsigned int adds[][2] = { {0, 0}, {0, 0}, {0, 1}, {1, 0}, {1, 1}, {9, 0} };
+    HT_concurrent_table *ct = HT_concurrent_new_hash(8, 4, HT_hash_wy);
+    HT_hash_table ht;
+    const unsigned int key = TEST_KEY;
+    void *expected;
+    unsigned int i,
+                 value,
+                 nb_resizes = 0,
+                 slot_bits;
+    unsigned char truncated[4];
+    test_value found;
+    size_t found_size;
+    CHECK(ct != NULL);
+    slot_bits = ct->_slot_bits;
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        test_make_value(i, &found);
+        CHECK(HT_concurrent_add_element(ct, &i, sizeof(i), &found, sizeof(found)) == 0);
+        CHECK(HT_concurrent_add_element(ct, &i, sizeof(i), &found, sizeof(found)) == 1);
+        if( ct->_resizing && ct->_pending_stripes == 4u )
+            ++nb_resizes;
+    }
+    CHECK(nb_resizes > 0 && ct->_slot_bits > slot_bits);
+    CHECK(HT_concurrent_get_nb_elements(ct) == TEST_NB_KEYS);
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        found_size = sizeof(found);
+        CHECK(HT_concurrent_get_element_position(ct, &i, sizeof(i), &found, &found_size, 0, 0) == 0);
+        CHECK(test_is_value(i, &found, found_size));
+    }
+
+    // A buffer too small receives the beginning of the value and its real size
+    i = 1;
+    found_size = sizeof(truncated);
+    CHECK(HT_concurrent_get_element_position(ct, &i, sizeof(i), truncated, &found_size, 0, 0) == 0);
+    test_make_value(i, &found);
+    CHECK(found_size == sizeof(found) && memcmp(truncated, &found, sizeof(truncated)) == 0);
+    found_size = 0;
+    CHECK(HT_concurrent_get_element_position(ct, &i, sizeof(i), NULL, &found_size, 0, 0) == 0 && found_size == sizeof(found));
+
+    // The duplicates of a key are ordered like in the generic table
+    CHECK(HT_concurrent_remove_element_position(ct, &key, sizeof(key), 0, 0) == 0);
+    CHECK(HT_init(&ht, 16, HT_hash_wy) == 0);
+    for(value = 0; value < sizeof(adds) / sizeof(adds[0]); ++value){
+        CHECK(HT_concurrent_add_element_position(ct, &key, sizeof(key), &value, sizeof(value), adds[value][0], (int) adds[value][1]) == 0);
+        CHECK(HT_add_element_position(&ht, &key, sizeof(key), &value, sizeof(value), adds[value][0], (int) adds[value][1]) == 0);
+    }
+    CHECK(HT_concurrent_remove_element_position(ct, &key, sizeof(key), 1, 1) == 0);
+    CHECK(HT_remove_element_position(&ht, &key, sizeof(key), 1, 1) == 0);
+    for(i = 0; i < sizeof(adds) / sizeof(adds[0]); ++i){
+        CHECK(HT_get_element_position(&ht, &key, sizeof(key), &expected, &found_size, i, 0) == 0);
+        CHECK(test_duplicate_at(ct, i, 0) == *(unsigned int*) expected);
+        CHECK(HT_get_element_position(&ht, &key, sizeof(key), &expected, &found_size, i, 1) == 0);
+        CHECK(test_duplicate_at(ct, i, 1) == *(unsigned int*) expected);
+    }
+    HT_delete(&ht);
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        if( i != TEST_KEY ){
+            CHECK(HT_concurrent_remove_element_position(ct, &i, sizeof(i), 0, 0) == 0);
+            CHECK(HT_concurrent_remove_element_position(ct, &i, sizeof(i), 0, 0) == 1);
+        }
+    }
+    CHECK(HT_concurrent_get_nb_elements(ct) == sizeof(adds) / sizeof(adds[0]) - 1);
+    HT_concurrent_reset_table(ct);
+    CHECK(HT_concurrent_get_nb_elements(ct) == 0);
+    CHECK(test_duplicate_at(ct, 0, 0) == UINT_MAX);
+    HT_concurrent_delete_pointer(ct);
+    return 0;
+}
+
+/**
+ * \brief Count the buffers destroyed by the epochs.
+ */
+static void test_count_destroy(void* context, void* buffer){
+    ++*(unsigned int*) context;
+    free(buffer);
+}
+
+/**
+ * \brief Check that a retired buffer outlives the read side sections, nested ones included.
+ */
+static int test_epoch_retire(void){
+    unsigned int nb_destroyed = 0;
+    void *buffer = malloc(16);
+    CHECK(buffer != NULL);
+    CHECK(HT_epoch_reserve(1) == 0);
+    CHECK(HT_epoch_enter() == 0);
+    CHECK(HT_epoch_enter() == 0);
+    HT_epoch_retire(buffer, test_count_destroy, &nb_destroyed);
+    HT_epoch_exit();
+    CHECK(nb_destroyed == 0);
+    HT_epoch_exit();
+    HT_epoch_synchronize();
+    CHECK(nb_destroyed == 1);
+    return 0;
+}
+
+/**
+ * \brief Add and remove keys from a single thread through several resizes,
+ * the lookups walking the slots by reference without any lock.
+ */
+static int test_lockfree_round_trip(void){
+    HT_concurrent_table *ct = HT_concurrent_new_hash(8, 4, HT_hash_wy);
+    test_value value;
+    unsigned int i,
+                 slot_bits;
+    size_t found_size;
+    void *found;
+    CHECK(ct != NULL);
+    CHECK(HT_concurrent_set_lockfree_reads(ct, 1) == 0);
+    slot_bits = ct->_slot_bits;
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        test_make_value(i, &value);
+        CHECK(HT_concurrent_add_element(ct, &i, sizeof(i), &value, sizeof(value)) == 0);
+        if( ct->_resizing ){
+            // The copies done by the migration are found while it goes on
+            CHECK(HT_epoch_enter() == 0);
+            CHECK(HT_concurrent_get_element_reference(ct, &i, sizeof(i), &found, &found_size, 0, 0) == 0);
+            CHECK(test_is_value(i, found, found_size));
+            HT_epoch_exit();
+        }
+    }
+    CHECK(ct->_slot_bits > slot_bits);
+
+    CHECK(HT_epoch_enter() == 0);
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        CHECK(HT_concurrent_get_element_reference(ct, &i, sizeof(i), &found, &found_size, 0, 0) == 0);
+        CHECK(test_is_value(i, found, found_size));
+    }
+    // A removed value stays readable until the end of the section
+    i = 1;
+    CHECK(HT_concurrent_get_element_reference(ct, &i, sizeof(i), &found, &found_size, 0, 0) == 0);
+    CHECK(HT_concurrent_remove_element_position(ct, &i, sizeof(i), 0, 0) == 0);
+    CHECK(HT_concurrent_get_element_reference(ct, &i, sizeof(i), NULL, NULL, 0, 0) == 1);
+    CHECK(test_is_value(i, found, found_size));
+    HT_epoch_exit();
+
+    for(i = 2; i < TEST_NB_KEYS; ++i)
+        CHECK(HT_concurrent_remove_element_position(ct, &i, sizeof(i), 0, i % 2) == 0);
+    CHECK(HT_concurrent_get_nb_elements(ct) == 1);
+    HT_concurrent_delete_pointer(ct);
+    HT_epoch_synchronize();
+    return 0;
+}
+
+/**
+ * \brief The state shared by the threads of a run.
+ */
+typedef struct{
+    HT_concurrent_table *ct;
+    int lockfree_reads,
+        writers_done,
+        failed;
+} test_shared;
+
+/**
+ * \brief The state of one thread.
+ */
+typedef struct{
+    test_shared *shared;
+    unsigned int id;
+} test_thread;
+
+static void test_fail(test_shared* const shared){
+    __atomic_store_n(&shared->failed, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Look up a key, by copy or by reference inside of an epoch section.
+ * \return The return code of the lookup, 3 if the value is wrong.
+ */
+static int test_lookup(test_shared* const shared, const unsigned int key, const int by_reference){
+    test_value copy;
+    void *found;
+    size_t found_size = sizeof(copy);
+    int retval;
+
+    if( !by_reference ){
+        retval = HT_concurrent_get_element_position(shared->ct, &key, sizeof(key), &copy, &found_size, 0, 0);
+        return retval == 0 && !test_is_value(key, &copy, found_size) ? 3 : retval;
+    }
+    if( HT_epoch_enter() != 0 )
+        return 2;
+    retval = HT_concurrent_get_element_reference(shared->ct, &key, sizeof(key), &found, &found_size, 0, 0);
+    if( retval == 0 && !test_is_value(key, found, found_size) )
+        retval = 3;
+    HT_epoch_exit();
+    return retval;
+}
+
+static void* test_reader(void* data){
+    test_thread *thread = data;
+    test_shared *shared = thread->shared;
+    unsigned int key,
+                 round = 0;
+    int by_reference,
+        retval;
+
+    while( !__atomic_load_n(&shared->writers_done, __ATOMIC_ACQUIRE) || round < 2 ){
+        if( __atomic_load_n(&shared->writers_done, __ATOMIC_ACQUIRE) )
+            ++round;
+        for(key = thread->id; key < TEST_NB_STABLE_KEYS + TEST_NB_WRITERS * TEST_NB_CHURN_KEYS; key += 7){
+            by_reference = shared->lockfree_reads && key % 2 == 0;
+            retval = test_lookup(shared, key, by_reference);
+            // A stable key is always found, a churned key may be missing but never wrong
+            if( retval == 2 || retval == 3 || ( key < TEST_NB_STABLE_KEYS && retval != 0 ) )
+                test_fail(shared);
+        }
+    }
+    return NULL;
+}
+
+static void* test_writer(void* data){
+    test_thread *thread = data;
+    test_shared *shared = thread->shared;
+    const unsigned int first = TEST_NB_STABLE_KEYS + thread->id * TEST_NB_CHURN_KEYS;
+    test_value value;
+    unsigned int key,
+                 round;
+
+    for(round = 0; round < TEST_NB_ROUNDS; ++round){
+        for(key = first; key < first + TEST_NB_CHURN_KEYS; ++key){
+            test_make_value(key, &value);
+            if( HT_concurrent_add_element(shared->ct, &key, sizeof(key), &value, sizeof(value)) != 0 )
+                test_fail(shared);
+        }
+        for(key = first; key < first + TEST_NB_CHURN_KEYS; ++key){
+            if( HT_concurrent_remove_element_position(shared->ct, &key, sizeof(key), 0, round % 2) != 0 )
+                test_fail(shared);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * \brief Run readers and writers on one table growing from a few slots.
+ */
+static int test_stress(const int lockfree_reads){
+    pthread_t readers[TEST_NB_READERS],
+              writers[TEST_NB_WRITERS];
+    test_thread reader_states[TEST_NB_READERS],
+                writer_states[TEST_NB_WRITERS];
+    test_shared shared;
+    test_value value;
+    unsigned int key,
+                 i;
+    int retval;
+
+    shared.ct = HT_concurrent_new_hash(8, 8, HT_hash_wy);
+    shared.lockfree_reads = lockfree_reads;
+    shared.writers_done = 0;
+    shared.failed = 0;
+    CHECK(shared.ct != NULL);
+    CHECK(HT_concurrent_set_lockfree_reads(shared.ct, lockfree_reads) == 0);
+    for(key = 0; key < TEST_NB_STABLE_KEYS; ++key){
+        test_make_value(key, &value);
+        CHECK(HT_concurrent_add_element(shared.ct, &key, sizeof(key), &value, sizeof(value)) == 0);
+    }
+
+    for(i = 0; i < TEST_NB_READERS; ++i){
+        reader_states[i].shared = &shared;
+        reader_states[i].id = i;
+        CHECK(pthread_create(&readers[i], NULL, test_reader, &reader_states[i]) == 0);
+    }
+    for(i = 0; i < TEST_NB_WRITERS; ++i){
+        writer_states[i].shared = &shared;
+        writer_states[i].id = i;
+        CHECK(pthread_create(&writers[i], NULL, test_writer, &writer_states[i]) == 0);
+    }
+    for(i = 0; i < TEST_NB_WRITERS; ++i)
+        pthread_join(writers[i], NULL);
+    __atomic_store_n(&shared.writers_done, 1, __ATOMIC_RELEASE);
+    for(i = 0; i < TEST_NB_READERS; ++i)
+        pthread_join(readers[i], NULL);
+
+    retval = shared.failed || HT_concurrent_get_nb_elements(shared.ct) != TEST_NB_STABLE_KEYS;
+    for(key = 0; key < TEST_NB_STABLE_KEYS + TEST_NB_WRITERS * TEST_NB_CHURN_KEYS && retval == 0; ++key)
+        retval = test_lookup(&shared, key, 0) != ( key < TEST_NB_STABLE_KEYS ? 0 : 1 );
+    HT_concurrent_delete_pointer(shared.ct);
+    HT_epoch_synchronize();
+    return retval;
+}
+
+/**
+ * \brief Run readers locking the stripes against the writers.
+ */
+static int test_locked_stress(void){
+    return test_stress(0);
+}
+
+/**
+ * \brief Run readers walking the slots without locks against the writers.
+ */
+static int test_lockfree_stress(void){
+    return test_stress(1);
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_locked_round_trip(), failures);
+    RUN(test_locked_stress(), failures);
+    RUN(test_epoch_retire(), failures);
+    RUN(test_lockfree_round_trip(), failures);
+    RUN(test_lockfree_stress(), failures);
+    return failures != 0;
+}
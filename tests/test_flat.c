@@ -0,0 +1,181 @@
+/**
+ * \file test_flat.c
+ * \brief Check the open addressing table, its inlined entries and its rehashes.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "flat_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys inserted, enough for several rehashes.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The number of keys present during the churn, under half of the capacity.
+ */
+#define TEST_CHURN_KEYS 50
+
+/**
+ * \brief The size of a large key or value, never inlined.
+ */
+#define TEST_LARGE_SIZE 64
+
+/**
+ * \brief Fill the key of an index, its size depending on the index.
+ * \return The size of the key.
+ */
+static size_t test_key(const unsigned int index, unsigned char key[TEST_LARGE_SIZE]){
+    const size_t size = index % 2 == 0 ? sizeof(index) : TEST_LARGE_SIZE;
+    memset(key, 0x5A, size);
+    memcpy(key, &index, sizeof(index));
+    return size;
+}
+
+/**
+ * \brief Fill the value of an index, its size depending on the index.
+ * \return The size of the value.
+ */
+static size_t test_value(const unsigned int index, unsigned char value[TEST_LARGE_SIZE]){
+    const size_t size = index % 4 < 2 ? 1 + index % HT_INLINE_VALUE_SIZE : TEST_LARGE_SIZE;
+    memset(value, (int) (index & 0xFF), size);
+    return size;
+}
+
+/**
+ * \brief Test if a pointer is inside of the entries of a table.
+ */
+static int test_in_entries(const HT_flat_table* const ft, const void* const pointer){
+    const unsigned char *begin = (const unsigned char*) ft->_entries,
+                        *end = (const unsigned char*) &ft->_entries[(size_t) ft->_nb_groups * HT_FLAT_GROUP_SIZE];
+    return (const unsigned char*) pointer >= begin && (const unsigned char*) pointer < end;
+}
+
+/**
+ * \brief Check the value of every key still present and whether it is inlined.
+ * \param removed True if the keys multiple of 3 were removed.
+ */
+static int test_check_all(const HT_flat_table* const ft, const int removed){
+    unsigned char key[TEST_LARGE_SIZE],
+                  value[TEST_LARGE_SIZE];
+    size_t key_size,
+           value_size,
+           found_size;
+    void *found;
+    unsigned int i;
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        key_size = test_key(i, key);
+        value_size = test_value(i, value);
+        if( removed && i % 3 == 0 ){
+            CHECK(HT_flat_get_element(ft, key, key_size, &found, &found_size) == 1);
+            continue;
+        }
+        CHECK(HT_flat_get_element(ft, key, key_size, &found, &found_size) == 0);
+        CHECK(found_size == value_size && memcmp(found, value, value_size) == 0);
+        CHECK(test_in_entries(ft, found) == (value_size <= HT_INLINE_VALUE_SIZE));
+    }
+    return 0;
+}
+
+/**
+ * \brief Mix inlined and heap keys and values across rehashes.
+ */
+static int test_inline(void){
+    HT_flat_table *ft = HT_flat_new_hash(16, HT_hash_wy);
+    unsigned char key[TEST_LARGE_SIZE],
+                  value[TEST_LARGE_SIZE];
+    size_t key_size,
+           value_size;
+    unsigned int i,
+                 nb_groups;
+    CHECK(ft != NULL);
+    nb_groups = ft->_nb_groups;
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        key_size = test_key(i, key);
+        value_size = test_value(i, value);
+        CHECK(HT_flat_add_element(ft, key, key_size, value, value_size) == 0);
+    }
+    CHECK(ft->_nb_groups > nb_groups);
+    CHECK(test_check_all(ft, 0) == 0);
+
+    // The first value wins, a key is stored once
+    key_size = test_key(1, key);
+    CHECK(HT_flat_add_element(ft, key, key_size, "other", 5) == 1);
+
+    for(i = 0; i < TEST_NB_KEYS; i += 3){
+        key_size = test_key(i, key);
+        CHECK(HT_flat_remove_element(ft, key, key_size) == 0);
+        CHECK(HT_flat_remove_element(ft, key, key_size) == 1);
+    }
+    CHECK(HT_flat_get_nb_elements(ft) == TEST_NB_KEYS - (TEST_NB_KEYS + 2) / 3);
+    CHECK(test_check_all(ft, 1) == 0);
+    HT_flat_delete_pointer(ft);
+    return 0;
+}
+
+/**
+ * \brief Churn keys in a half full table, its deleted markers are dropped without growing it.
+ */
+static int test_churn(void){
+    HT_flat_table *ft = HT_flat_new_hash(2 * TEST_CHURN_KEYS, HT_hash_wy);
+    unsigned int i,
+                 nb_groups,
+                 value;
+    void *found;
+    size_t found_size;
+    CHECK(ft != NULL);
+    nb_groups = ft->_nb_groups;
+
+    for(i = 0; i < TEST_CHURN_KEYS; ++i)
+        CHECK(HT_flat_add_element(ft, &i, sizeof(i), &i, sizeof(i)) == 0);
+    for(i = TEST_CHURN_KEYS; i < TEST_CHURN_KEYS * 100; ++i){
+        value = i - TEST_CHURN_KEYS;
+        CHECK(HT_flat_remove_element(ft, &value, sizeof(value)) == 0);
+        CHECK(HT_flat_add_element(ft, &i, sizeof(i), &i, sizeof(i)) == 0);
+    }
+    CHECK(ft->_nb_groups == nb_groups);
+    for(i = TEST_CHURN_KEYS * 99; i < TEST_CHURN_KEYS * 100; ++i){
+        CHECK(HT_flat_get_element(ft, &i, sizeof(i), &found, &found_size) == 0);
+        CHECK(found_size == sizeof(i) && memcmp(found, &i, sizeof(i)) == 0);
+    }
+    HT_flat_reset_table(ft);
+    CHECK(HT_flat_get_nb_elements(ft) == 0);
+    CHECK(HT_flat_get_element(ft, &i, sizeof(i), NULL, NULL) == 1);
+    HT_flat_delete_pointer(ft);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_inline(), failures);
+    RUN(test_churn(), failures);
+    return failures != 0;
+}
@@ -0,0 +1,455 @@
+/**
+ * \file test_generic.c
+ * \brief Check the chained table, its duplicates and its incremental resizes.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys inserted, enough for several resizes.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The key holding the duplicates.
+ */
+#define TEST_KEY 7
+
+/**
+ * \brief The number of buffers released by ::test_free.
+ */
+static unsigned int test_nb_freed = 0;
+
+/**
+ * \brief Release a taken buffer, counting it.
+ */
+static void test_free(void* buffer){
+    ++test_nb_freed;
+    free(buffer);
+}
+
+/**
+ * \brief A hash sending every key to the same slot, which keeps the order of the pairs visible.
+ */
+static uint64_t test_constant_hash(const void* const key, const size_t key_size){
+    (void) key;
+    (void) key_size;
+    return 42;
+}
+
+/**
+ * \brief Add the integer given as data to the first integer of a value, recording the insertion.
+ */
+static void test_add_to_value(void* value, const size_t value_size, int inserted, void* data){
+    const int *increment = data;
+    int current;
+    (void) value_size;
+    memcpy(&current, value, sizeof(current));
+    current += inserted ? 1000 * *increment : *increment;
+    memcpy(value, &current, sizeof(current));
+}
+
+/**
+ * \brief Get the number of slots of a table once its resize in progress is done.
+ */
+static unsigned int test_nb_slots(const HT_hash_table* const ht){
+    return ht->_new_slots != NULL ? ht->_nb_new_slots : ht->_nb_slots;
+}
+
+/**
+ * \brief Check the value of a key at a position.
+ */
+static int test_get(const HT_hash_table* const ht, const int key, const unsigned int position, const int reverse, const int expected){
+    size_t found_size;
+    void *found;
+    CHECK(HT_get_element_position(ht, &key, sizeof(key), &found, &found_size, position, reverse) == 0);
+    CHECK(found_size == sizeof(expected) && memcmp(found, &expected, sizeof(expected)) == 0);
+    return 0;
+}
+
+/**
+ * \brief Check every key below nb_keys, the removed ones being absent.
+ * \param step Only the multiples of step are present.
+ */
+static int test_check_keys(const HT_hash_table* const ht, const int nb_keys, const int step){
+    int key;
+    for(key = 0; key < nb_keys; ++key){
+        if( key % step == 0 )
+            CHECK(test_get(ht, key, 0, 0, key * 3) == 0);
+        else
+            CHECK(HT_get_element(ht, &key, sizeof(key), NULL, NULL) == 1);
+    }
+    return 0;
+}
+
+/**
+ * \brief Check the values of the duplicates of ::TEST_KEY in both directions.
+ */
+static int test_check_order(const HT_hash_table* const ht, const int* const expected, const unsigned int nb_expected){
+    unsigned int i;
+    for(i = 0; i < nb_expected; ++i){
+        CHECK(test_get(ht, TEST_KEY, i, 0, expected[i]) == 0);
+        CHECK(test_get(ht, TEST_KEY, i, 1, expected[nb_expected - 1 - i]) == 0);
+    }
+    // Past the last match, the last match is returned
+    CHECK(test_get(ht, TEST_KEY, nb_expected, 0, expected[nb_expected - 1]) == 0);
+    return 0;
+}
+
+/**
+ * \brief Check the first integer of the values of a table holding a single slot, in the order of the slot.
+ */
+static int test_check_slot(const HT_hash_table* const ht, const int* const expected, const unsigned int nb_expected){
+    HT_iterator it;
+    unsigned int i = 0;
+    size_t value_size;
+    const void *value;
+    int first;
+    for(HT_iterator_begin(ht, &it); !HT_iterator_end(&it); HT_iterator_next(&it)){
+        value = HT_iterator_value(&it, &value_size);
+        CHECK(i < nb_expected && value_size >= sizeof(first));
+        memcpy(&first, value, sizeof(first));
+        CHECK(first == expected[i]);
+        ++i;
+    }
+    CHECK(i == nb_expected);
+    return 0;
+}
+
+/**
+ * \brief Insert duplicates at several positions from both ends, then remove them.
+ */
+static int test_duplicates(void){
+    static const struct{
+        int value;
+        unsigned int position;
+        int reverse;
+    } adds[] = { {1, 0, 0}, {2, 0, 0}, {3, 0, 1}, {4, 1, 0}, {5, 1, 1}, {6, 9, 0} };
+    static const int after_adds[] = {2, 1, 5, 4, 3, 6},
+                     after_removes[] = {2, 1, 4, 3};
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    const int key = TEST_KEY,
+              other = TEST_KEY + 1,
+              other_value = 42;
+    unsigned int i;
+    CHECK(ht != NULL);
+
+    CHECK(HT_add_element(ht, &other, sizeof(other), &other_value, sizeof(other_value)) == 0);
+    for(i = 0; i < sizeof(adds) / sizeof(adds[0]); ++i)
+        CHECK(HT_add_element_position(ht, &key, sizeof(key), &adds[i].value, sizeof(adds[i].value), adds[i].position, adds[i].reverse) == 0);
+    CHECK(HT_get_nb_elements(ht) == 7);
+    CHECK(test_check_order(ht, after_adds, 6) == 0);
+
+    CHECK(HT_remove_element_position(ht, &key, sizeof(key), 2, 0) == 0);
+    CHECK(HT_remove_element_position(ht, &key, sizeof(key), 0, 1) == 0);
+    CHECK(test_check_order(ht, after_removes, 4) == 0);
+
+    for(i = 0; i < 4; ++i)
+        CHECK(HT_remove_element_position(ht, &key, sizeof(key), 0, 0) == 0);
+    CHECK(HT_get_element(ht, &key, sizeof(key), NULL, NULL) == 1);
+    CHECK(HT_remove_element_position(ht, &key, sizeof(key), 0, 0) == 1);
+    CHECK(test_get(ht, other, 0, 0, other_value) == 0);
+    CHECK(HT_get_nb_elements(ht) == 1);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief Grow through several sizes, each resize spread over the following
+ * operations, then shrink back once the minimum load factor is set.
+ */
+static int test_incremental_resize(void){
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    unsigned int nb_resizes = 0,
+                 nb_slots;
+    int key,
+        value;
+    CHECK(ht != NULL);
+
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        value = key * 3;
+        nb_slots = ht->_nb_slots;
+        CHECK(HT_add_element(ht, &key, sizeof(key), &value, sizeof(value)) == 0);
+        if( ht->_new_slots != NULL && ht->_rehash_index == 0 ){
+            // A resize starts, the old slots are only moved by the next operations
+            ++nb_resizes;
+            CHECK(ht->_nb_slots == nb_slots && ht->_nb_new_slots == 2 * nb_slots);
+            CHECK(test_check_keys(ht, key + 1, 1) == 0);
+        }
+        CHECK(HT_get_nb_elements(ht) == (size_t) key + 1);
+        CHECK((double) ht->_nb_elements <= (double) ht->_max_load_factor * (double) ht->_nb_slots ||
+                ht->_new_slots != NULL);
+    }
+    CHECK(nb_resizes >= 8);
+    CHECK(test_check_keys(ht, TEST_NB_KEYS, 1) == 0);
+
+    CHECK(HT_set_load_factors(ht, 1.0f, 0.5f) == 1 && errno == EINVAL);
+    CHECK(HT_set_load_factors(ht, 1.0f, 0.25f) == 0);
+    nb_slots = test_nb_slots(ht);
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        if( key % 16 != 0 )
+            CHECK(HT_remove_element_position(ht, &key, sizeof(key), 0, 0) == 0);
+    }
+    CHECK(test_nb_slots(ht) < nb_slots);
+    CHECK(test_check_keys(ht, TEST_NB_KEYS, 16) == 0);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief Resize on demand, lookups finding the keys in both slot arrays.
+ */
+static int test_explicit_resize(void){
+    HT_hash_table *ht = HT_new_hash(1024, HT_hash_wy);
+    unsigned int i;
+    int key,
+        value;
+    CHECK(ht != NULL);
+    CHECK(HT_set_load_factors(ht, 0.0f, 0.0f) == 0);
+
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        value = key * 3;
+        CHECK(HT_add_element(ht, &key, sizeof(key), &value, sizeof(value)) == 0);
+    }
+    CHECK(ht->_nb_slots == 1024 && ht->_new_slots == NULL);
+
+    CHECK(HT_resize(ht, 3000) == 0);
+    CHECK(ht->_new_slots != NULL && ht->_nb_new_slots == 4096 && ht->_rehash_index == 0);
+    for(i = 0; ht->_new_slots != NULL; ++i){
+        CHECK(test_check_keys(ht, TEST_NB_KEYS, 1) == 0);
+        key = TEST_NB_KEYS;
+        CHECK(HT_remove_element_position(ht, &key, sizeof(key), 0, 0) == 1);
+    }
+    CHECK(i == 1024 / HT_REHASH_SLOTS_PER_STEP);
+    CHECK(ht->_nb_slots == 4096);
+    CHECK(test_check_keys(ht, TEST_NB_KEYS, 1) == 0);
+
+    // A resize in progress is completed before the next one starts
+    CHECK(HT_resize(ht, 16) == 0);
+    CHECK(HT_resize(ht, 64) == 0);
+    CHECK(ht->_nb_slots == 16 && ht->_nb_new_slots == 64);
+    CHECK(test_check_keys(ht, TEST_NB_KEYS, 1) == 0);
+
+    HT_reset_table(ht);
+    CHECK(HT_get_nb_elements(ht) == 0 && ht->_new_slots == NULL);
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(HT_get_element(ht, &key, sizeof(key), NULL, NULL) == 1);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief Replace the first value of a key in place or in a new pair at the
+ * same place, whether the pair was copied, bulk built, taken or borrowed.
+ */
+static int test_upsert(void){
+    static const int before[] = {1, 2, 3, 42},
+                     after_resize[] = {10, 2, 3, 42},
+                     after_taken[] = {10, 2, 3, 42, 21, 30};
+    const void *keys[4],
+               *values[4];
+    size_t key_sizes[4],
+           value_sizes[4];
+    HT_hash_table *ht = HT_new_hash(16, test_constant_hash);
+    const int key = TEST_KEY,
+              other = TEST_KEY + 1,
+              taken_key = TEST_KEY + 2,
+              borrowed_key = TEST_KEY + 3,
+              other_value = 42;
+    int value,
+        larger[2] = {10, 11},
+        borrowed = 30,
+        bulk_keys[4],
+        bulk_values[4],
+        *taken,
+        i;
+    size_t found_size;
+    void *found,
+         *stored;
+    CHECK(ht != NULL);
+    CHECK(HT_set_free_function(ht, test_free) == 0);
+    test_nb_freed = 0;
+
+    value = 1;
+    CHECK(HT_upsert(ht, &key, sizeof(key), &value, sizeof(value)) == 0);
+    for(value = 2; value <= 3; ++value)
+        CHECK(HT_add_element_position(ht, &key, sizeof(key), &value, sizeof(value), 0, 1) == 0);
+    CHECK(HT_add_element_position(ht, &other, sizeof(other), &other_value, sizeof(other_value), 0, 1) == 0);
+    CHECK(HT_get_nb_elements(ht) == 4);
+    CHECK(test_check_slot(ht, before, 4) == 0);
+
+    // A value of the same size is overwritten in the same pair
+    CHECK(HT_get_element(ht, &key, sizeof(key), &stored, &found_size) == 0);
+    value = 5;
+    CHECK(HT_upsert(ht, &key, sizeof(key), &value, sizeof(value)) == 1);
+    CHECK(HT_get_element(ht, &key, sizeof(key), &found, &found_size) == 0);
+    CHECK(found == stored && found_size == sizeof(value) && *(int*) found == 5);
+
+    // Another size moves the first duplicate to a new pair at the same place
+    CHECK(HT_upsert(ht, &key, sizeof(key), larger, sizeof(larger)) == 1);
+    CHECK(HT_get_element(ht, &key, sizeof(key), &found, &found_size) == 0);
+    CHECK(found_size == sizeof(larger) && memcmp(found, larger, sizeof(larger)) == 0);
+    CHECK(HT_get_nb_elements(ht) == 4);
+    CHECK(test_check_slot(ht, after_resize, 4) == 0);
+    CHECK(test_get(ht, key, 1, 0, 2) == 0 && test_get(ht, key, 2, 0, 3) == 0);
+
+    // A taken value is overwritten in its buffer, or released when replaced
+    taken = malloc(sizeof(*taken));
+    CHECK(taken != NULL);
+    *taken = 20;
+    CHECK(HT_add_element_mode(ht, &taken_key, sizeof(taken_key), taken, sizeof(*taken), 0, 1, HT_MODE_TAKE_VALUE) == 0);
+    value = 21;
+    CHECK(HT_upsert(ht, &taken_key, sizeof(taken_key), &value, sizeof(value)) == 1);
+    CHECK(HT_get_element(ht, &taken_key, sizeof(taken_key), &found, &found_size) == 0);
+    CHECK(found == (void*) taken && *taken == 21 && test_nb_freed == 0);
+
+    // A borrowed value is never written, the pair is replaced even for the same size
+    CHECK(HT_add_element_mode(ht, &borrowed_key, sizeof(borrowed_key), &borrowed, sizeof(borrowed), 0, 1, HT_MODE_BORROW_VALUE) == 0);
+    CHECK(test_check_slot(ht, after_taken, 6) == 0);
+    value = 31;
+    CHECK(HT_upsert(ht, &borrowed_key, sizeof(borrowed_key), &value, sizeof(value)) == 1);
+    CHECK(borrowed == 30);
+    CHECK(HT_get_element(ht, &borrowed_key, sizeof(borrowed_key), &found, &found_size) == 0);
+    CHECK(found != (void*) &borrowed && *(int*) found == 31);
+    CHECK(HT_upsert(ht, &taken_key, sizeof(taken_key), larger, sizeof(larger)) == 1);
+    CHECK(test_nb_freed == 1);
+    CHECK(test_get(ht, other, 0, 0, other_value) == 0);
+    CHECK(HT_get_nb_elements(ht) == 6);
+
+    // The pairs of a bulk build share a block, released with its last pair
+    HT_reset_table(ht);
+    for(i = 0; i < 4; ++i){
+        bulk_keys[i] = i;
+        bulk_values[i] = i * 3;
+        keys[i] = &bulk_keys[i];
+        values[i] = &bulk_values[i];
+        key_sizes[i] = value_sizes[i] = sizeof(int);
+    }
+    CHECK(HT_bulk_build(ht, 4, keys, key_sizes, values, value_sizes, 1) == 0);
+    CHECK(HT_get_element(ht, &bulk_keys[1], sizeof(int), &stored, &found_size) == 0);
+    value = 100;
+    CHECK(HT_upsert(ht, &bulk_keys[1], sizeof(int), &value, sizeof(value)) == 1);
+    CHECK(HT_get_element(ht, &bulk_keys[1], sizeof(int), &found, &found_size) == 0);
+    CHECK(found == stored && *(int*) found == 100);
+    for(i = 0; i < 4; ++i)
+        CHECK(HT_upsert(ht, &bulk_keys[i], sizeof(int), larger, sizeof(larger)) == 1);
+    for(i = 0; i < 4; ++i){
+        CHECK(HT_get_element(ht, &bulk_keys[i], sizeof(int), &found, &found_size) == 0);
+        CHECK(found_size == sizeof(larger) && memcmp(found, larger, sizeof(larger)) == 0);
+    }
+    CHECK(HT_get_nb_elements(ht) == 4);
+
+    value = 1;
+    CHECK(HT_upsert(ht, &key, 0, &value, sizeof(value)) == 2 && errno == EINVAL);
+    CHECK(HT_upsert(ht, &key, sizeof(key), NULL, sizeof(value)) == 2 && errno == EINVAL);
+    HT_delete_pointer(ht);
+    CHECK(test_nb_freed == 1);
+    return 0;
+}
+
+/**
+ * \brief Modify the first value of a key in place, adding the key first if it is absent.
+ */
+static int test_update_with(void){
+    HT_hash_table *ht = HT_new_hash(16, test_constant_hash);
+    const void *keys[1],
+               *values[1];
+    size_t key_sizes[1],
+           value_sizes[1];
+    const int key = TEST_KEY,
+              taken_key = TEST_KEY + 1,
+              borrowed_key = TEST_KEY + 2,
+              bulk_key = TEST_KEY + 3,
+              bulk_value = 60;
+    int value = 1,
+        increment = 1,
+        borrowed = 40,
+        *taken;
+    size_t found_size;
+    void *found;
+    CHECK(ht != NULL);
+    CHECK(HT_set_free_function(ht, test_free) == 0);
+    test_nb_freed = 0;
+
+    CHECK(HT_update_with(ht, &key, sizeof(key), &value, sizeof(value), test_add_to_value, &increment) == 0);
+    CHECK(test_get(ht, key, 0, 0, 1001) == 0);
+    value = 3;
+    CHECK(HT_add_element_position(ht, &key, sizeof(key), &value, sizeof(value), 0, 1) == 0);
+    increment = 2;
+    CHECK(HT_update_with(ht, &key, sizeof(key), &value, sizeof(value), test_add_to_value, &increment) == 1);
+    CHECK(HT_update_with(ht, &key, sizeof(key), &value, sizeof(value), test_add_to_value, &increment) == 1);
+    CHECK(test_get(ht, key, 0, 0, 1005) == 0 && test_get(ht, key, 1, 0, 3) == 0);
+    increment = -4;
+    CHECK(HT_update_with(ht, &key, sizeof(key), &value, sizeof(value), test_add_to_value, &increment) == 1);
+    CHECK(HT_get_nb_elements(ht) == 2);
+
+    // Taken and borrowed values are updated in their own buffers
+    taken = malloc(sizeof(*taken));
+    CHECK(taken != NULL);
+    *taken = 20;
+    CHECK(HT_add_element_mode(ht, &taken_key, sizeof(taken_key), taken, sizeof(*taken), 0, 1, HT_MODE_TAKE_VALUE) == 0);
+    CHECK(HT_add_element_mode(ht, &borrowed_key, sizeof(borrowed_key), &borrowed, sizeof(borrowed), 0, 1, HT_MODE_BORROW_VALUE) == 0);
+    increment = 1;
+    CHECK(HT_update_with(ht, &taken_key, sizeof(taken_key), &value, sizeof(value), test_add_to_value, &increment) == 1);
+    CHECK(HT_update_with(ht, &borrowed_key, sizeof(borrowed_key), &value, sizeof(value), test_add_to_value, &increment) == 1);
+    CHECK(*taken == 21 && borrowed == 41 && test_nb_freed == 0);
+
+    // So is a pair of a bulk build
+    keys[0] = &bulk_key;
+    values[0] = &bulk_value;
+    key_sizes[0] = value_sizes[0] = sizeof(int);
+    CHECK(HT_bulk_build(ht, 1, keys, key_sizes, values, value_sizes, 1) == 0);
+    CHECK(HT_update_with(ht, &bulk_key, sizeof(bulk_key), &value, sizeof(value), test_add_to_value, &increment) == 1);
+    CHECK(test_get(ht, bulk_key, 0, 0, 61) == 0);
+    CHECK(HT_get_nb_elements(ht) == 5);
+
+    // An error leaves the table untouched and update uncalled
+    increment = 0;
+    CHECK(HT_update_with(ht, &key, sizeof(key), &value, sizeof(value), NULL, &increment) == 2 && errno == EINVAL);
+    CHECK(HT_update_with(ht, &key, 0, &value, sizeof(value), test_add_to_value, &increment) == 2 && errno == EINVAL);
+    CHECK(HT_update_with(ht, &key, sizeof(key), NULL, sizeof(value), test_add_to_value, &increment) == 2 && errno == EINVAL);
+    CHECK(test_get(ht, key, 0, 0, 1001) == 0);
+    CHECK(HT_get_element(ht, &key, sizeof(key), &found, &found_size) == 0 && found_size == sizeof(value));
+
+    HT_delete_pointer(ht);
+    CHECK(test_nb_freed == 1);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_duplicates(), failures);
+    RUN(test_incremental_resize(), failures);
+    RUN(test_explicit_resize(), failures);
+    RUN(test_upsert(), failures);
+    RUN(test_update_with(), failures);
+    return failures != 0;
+}
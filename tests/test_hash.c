@@ -0,0 +1,161 @@
+/**
+ * \file test_hash.c
+ * \brief Check the hash functions against known answers.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The longest key whose CRC is compared with the reference one.
+ */
+#define TEST_CRC_MAX_SIZE 64
+
+/**
+ * \brief The key of the SipHash reference vectors, the bytes 0 to 15.
+ */
+static const uint64_t test_sip_key[2] = { UINT64_C(0x0706050403020100), UINT64_C(0x0f0e0d0c0b0a0908) };
+
+/**
+ * \brief Fill a buffer with the bytes 0, 1, 2... of the reference messages.
+ */
+static void test_fill_bytes(unsigned char* const bytes, const size_t size){
+    size_t i;
+    for(i = 0; i < size; ++i)
+        bytes[i] = (unsigned char) i;
+}
+
+/**
+ * \brief CRC32C of a buffer with a byte table, independent of the library.
+ */
+static uint32_t test_crc32c(const unsigned char* p, size_t size){
+    static uint32_t table[256];
+    static int ready = 0;
+    uint32_t crc;
+    unsigned int i,
+                 bit;
+    if( !ready ){
+        for(i = 0; i < 256; ++i){
+            crc = i;
+            for(bit = 0; bit < 8; ++bit)
+                crc = crc & 1u ? (crc >> 1) ^ UINT32_C(0x82F63B78) : crc >> 1;
+            table[i] = crc;
+        }
+        ready = 1;
+    }
+    crc = UINT32_MAX;
+    for(; size != 0; --size, ++p)
+        crc = (crc >> 8) ^ table[(crc ^ *p) & 0xff];
+    return ~crc;
+}
+
+/**
+ * \brief Undo the fold of ::HT_hash_crc32c, the CRC in the low bits and the key size in the high ones.
+ */
+static uint64_t test_unfold(const uint64_t hash){
+    const uint64_t golden = UINT64_C(0x9E3779B97F4A7C15);
+    uint64_t inverse = golden;
+    unsigned int i;
+    // Each Newton step doubles the number of correct low bits, from 3
+    for(i = 0; i < 5; ++i)
+        inverse *= 2 - golden * inverse;
+    return hash * inverse;
+}
+
+/**
+ * \brief xxHash64 with a zero seed, the empty key and keys on both sides of its 32 bytes stripes.
+ */
+static int test_xxh64(void){
+    static const char long_key[] = "Nobody inspects the spammish repetition";
+    CHECK(HT_hash_xxh64("", 0) == UINT64_C(0xef46db3751d8e999));
+    CHECK(HT_hash_xxh64("a", 1) == UINT64_C(0xd24ec4f1a98c6e5b));
+    CHECK(HT_hash_xxh64("abc", 3) == UINT64_C(0x44bc2cf5ad770999));
+    CHECK(HT_hash_xxh64(long_key, sizeof(long_key) - 1) == UINT64_C(0xfbcea83c8a378bf1));
+    return 0;
+}
+
+/**
+ * \brief SipHash on the messages 0, 1, 2... of the reference vectors, with
+ * the rounds the library is built with.
+ */
+static int test_sip(void){
+    const uint64_t zero_key[2] = {0, 0};
+    unsigned char message[64];
+    test_fill_bytes(message, sizeof(message));
+#if defined(HT_SIP_COMPRESSION_ROUNDS) && HT_SIP_COMPRESSION_ROUNDS == 2 && HT_SIP_FINALIZATION_ROUNDS == 4
+    // SipHash-2-4, from the paper
+    CHECK(HT_hash_sip(message, 0, test_sip_key) == UINT64_C(0x726fdb47dd0e0e31));
+    CHECK(HT_hash_sip(message, 15, test_sip_key) == UINT64_C(0xa129ca6149be45e5));
+    (void) zero_key;
+#else
+    // SipHash-1-3, the default, as used by the hash of CPython
+    CHECK(HT_hash_sip(message, 0, test_sip_key) == UINT64_C(0xabac0158050fc4dc));
+    CHECK(HT_hash_sip(message, 1, zero_key) == UINT64_C(0x68a914128e01e473));
+    CHECK(HT_hash_sip(message, 7, zero_key) == UINT64_C(0x2f098ab0c751325a));
+    CHECK(HT_hash_sip(message, 8, zero_key) == UINT64_C(0xead411e67ebe2eea));
+    CHECK(HT_hash_sip(message, 15, zero_key) == UINT64_C(0xf30eb725bb91c9ea));
+    CHECK(HT_hash_sip(message, 16, zero_key) == UINT64_C(0x8972188433a5c5b7));
+    CHECK(HT_hash_sip(message, 63, zero_key) == UINT64_C(0x385d3e39e5f37359));
+#endif
+    return 0;
+}
+
+/**
+ * \brief CRC32C through the fold of ::HT_hash_crc32c, whichever path the
+ * processor and the build select, on every size up to ::TEST_CRC_MAX_SIZE
+ * and every alignment.
+ */
+static int test_crc32c_fold(void){
+    unsigned char bytes[TEST_CRC_MAX_SIZE + 8];
+    uint64_t unfolded;
+    size_t size,
+           offset;
+
+    unfolded = test_unfold(HT_hash_crc32c("123456789", 9));
+    CHECK((uint32_t) unfolded == UINT32_C(0xe3069283) && unfolded >> 32 == 9);
+    CHECK(test_crc32c((const unsigned char*) "123456789", 9) == UINT32_C(0xe3069283));
+    CHECK(test_unfold(HT_hash_crc32c("", 0)) == 0);
+
+    for(size = 0; size < sizeof(bytes); ++size)
+        bytes[size] = (unsigned char) (size * 37 + 11);
+    for(offset = 0; offset < 8; ++offset){
+        for(size = 0; size <= TEST_CRC_MAX_SIZE; ++size){
+            unfolded = test_unfold(HT_hash_crc32c(bytes + offset, size));
+            CHECK((uint32_t) unfolded == test_crc32c(bytes + offset, size) && unfolded >> 32 == size);
+        }
+    }
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_xxh64(), failures);
+    RUN(test_sip(), failures);
+    RUN(test_crc32c_fold(), failures);
+    return failures != 0;
+}
@@ -0,0 +1,291 @@
+/**
+ * \file test_merge.c
+ * \brief Merge hash tables with every policy, walk, fold and clear them from several threads.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "arena_allocator.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys of each table, the second half of the source keys are in the destination too.
+ */
+#define TEST_NB_KEYS 6000
+
+/**
+ * \brief The key holding duplicates in both tables.
+ */
+#define TEST_KEY (3 * TEST_NB_KEYS)
+
+/**
+ * \brief The value of a key in the source table.
+ */
+#define TEST_SOURCE_VALUE(key) ((key) + 1000000u)
+
+/**
+ * \brief Fill the tables, the source with the keys [0, TEST_NB_KEYS[, the
+ * destination with the keys [TEST_NB_KEYS / 2, TEST_NB_KEYS * 3 / 2[.
+ */
+static int test_fill(HT_hash_table* const destination, HT_hash_table* const source){
+    unsigned int key,
+                 value;
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        value = TEST_SOURCE_VALUE(key);
+        CHECK(HT_add_element(source, &key, sizeof(key), &value, sizeof(value)) == 0);
+        value = key + TEST_NB_KEYS / 2;
+        CHECK(HT_add_element(destination, &value, sizeof(value), &value, sizeof(value)) == 0);
+    }
+    key = TEST_KEY;
+    for(value = 1; value <= 4; ++value)
+        CHECK(HT_add_element_position(value <= 2 ? destination : source, &key, sizeof(key), &value, sizeof(value), 9, 0) == 0);
+    return 0;
+}
+
+/**
+ * \brief Check the value of a key.
+ */
+static int test_check_value(const HT_hash_table* const ht, const unsigned int key, const unsigned int position, const unsigned int expected){
+    void *value;
+    size_t value_size;
+    CHECK(HT_get_element_position(ht, &key, sizeof(key), &value, &value_size, position, 0) == 0);
+    CHECK(value_size == sizeof(expected) && memcmp(value, &expected, sizeof(expected)) == 0);
+    return 0;
+}
+
+/**
+ * \brief Check the destination after a merge.
+ */
+static int test_check_merged(const HT_hash_table* const destination, const unsigned int policy){
+    static const unsigned int duplicates[][4] = {
+        [HT_MERGE_KEEP] = {1, 2, 0, 0},
+        [HT_MERGE_REPLACE] = {4, 2, 0, 0},
+        [HT_MERGE_APPEND] = {1, 2, 3, 4},
+    };
+    const unsigned int nb_duplicates = policy == HT_MERGE_APPEND ? 4 : 2;
+    unsigned int key;
+
+    CHECK(HT_get_nb_elements(destination) == TEST_NB_KEYS * 3 / 2 + nb_duplicates +
+            ( policy == HT_MERGE_APPEND ? TEST_NB_KEYS / 2 : 0 ));
+    for(key = 0; key < TEST_NB_KEYS / 2; ++key)
+        CHECK(test_check_value(destination, key, 0, TEST_SOURCE_VALUE(key)) == 0);
+    for(key = TEST_NB_KEYS / 2; key < TEST_NB_KEYS; ++key){
+        CHECK(test_check_value(destination, key, 0, policy == HT_MERGE_REPLACE ? TEST_SOURCE_VALUE(key) : key) == 0);
+        if( policy == HT_MERGE_APPEND )
+            CHECK(test_check_value(destination, key, 1, TEST_SOURCE_VALUE(key)) == 0);
+    }
+    for(key = TEST_NB_KEYS; key < TEST_NB_KEYS * 3 / 2; ++key)
+        CHECK(test_check_value(destination, key, 0, key) == 0);
+    for(key = 0; key < nb_duplicates; ++key)
+        CHECK(test_check_value(destination, TEST_KEY, key, duplicates[policy][key]) == 0);
+    return 0;
+}
+
+/**
+ * \brief Merge two tables and check the result.
+ * \param policy The merge policy.
+ * \param nb_threads The number of threads of the merge.
+ * \param use_arena Give the destination an arena so that the pairs are copied.
+ * \param other_hash Hash the source keys with an other function so that they are hashed again.
+ */
+static int test_merge(const unsigned int policy, const unsigned int nb_threads, const int use_arena, const int other_hash){
+    HT_hash_table destination,
+                  *source = HT_new_hash(64, other_hash ? HT_hash_xxh64 : HT_hash_wy);
+    HT_allocator allocator;
+    HT_arena arena;
+    int retval;
+
+    CHECK(source != NULL);
+    CHECK(!use_arena || HT_arena_init(&arena, 0) == 0);
+    allocator = HT_arena_allocator(&arena);
+    CHECK(HT_init_allocator(&destination, 64, HT_hash_wy, use_arena ? &allocator : NULL) == 0);
+    retval = test_fill(&destination, source);
+    retval = retval || HT_merge(&destination, source, policy, nb_threads) != 0;
+    retval = retval || HT_get_nb_elements(source) != 0;
+    retval = retval || test_check_merged(&destination, policy);
+    HT_delete(&destination);
+    HT_delete_pointer(source);
+    if( use_arena )
+        HT_arena_delete(&arena);
+    return retval;
+}
+
+/**
+ * \brief The sums of the keys and values folded by a thread.
+ */
+typedef struct{
+    uint64_t nb_elements,
+             key_sum,
+             value_sum;
+} test_sums;
+
+static void test_reduce(const void* key, const size_t key_size, const void* value, const size_t value_size, void* accumulator){
+    test_sums *sums = accumulator;
+    unsigned int k,
+                 v;
+    (void) key_size;
+    (void) value_size;
+    memcpy(&k, key, sizeof(k));
+    memcpy(&v, value, sizeof(v));
+    ++sums->nb_elements;
+    sums->key_sum += k;
+    sums->value_sum += v;
+}
+
+static void test_combine(void* result, const void* accumulator){
+    test_sums *sums = result;
+    const test_sums *other = accumulator;
+    sums->nb_elements += other->nb_elements;
+    sums->key_sum += other->key_sum;
+    sums->value_sum += other->value_sum;
+}
+
+/**
+ * \brief Count the elements visited from every thread.
+ */
+static int test_count(const void* key, const size_t key_size, void* value, const size_t value_size, void* data){
+    (void) key;
+    (void) key_size;
+    (void) value;
+    (void) value_size;
+    __atomic_add_fetch((uint64_t*) data, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * \brief Stop the walk on the first key above ::TEST_NB_KEYS.
+ */
+static int test_stop(const void* key, const size_t key_size, void* value, const size_t value_size, void* data){
+    unsigned int k;
+    (void) key_size;
+    (void) value;
+    (void) value_size;
+    (void) data;
+    memcpy(&k, key, sizeof(k));
+    return k >= TEST_NB_KEYS ? 5 : 0;
+}
+
+/**
+ * \brief The number of values released by ::test_free.
+ */
+static uint64_t test_nb_freed = 0;
+
+static void test_free(void* buffer){
+    __atomic_add_fetch(&test_nb_freed, 1, __ATOMIC_RELAXED);
+    free(buffer);
+}
+
+/**
+ * \brief Walk and fold a table from several threads, each element seen once.
+ * \param nb_threads The number of threads.
+ */
+static int test_foreach_reduce(const unsigned int nb_threads){
+    HT_hash_table *ht = HT_new_hash(64, HT_hash_wy);
+    test_sums sums = {0, 0, 0};
+    uint64_t nb_visited = 0;
+    unsigned int key,
+                 value;
+    CHECK(ht != NULL);
+
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        value = 2 * key;
+        CHECK(HT_add_element(ht, &key, sizeof(key), &value, sizeof(value)) == 0);
+    }
+    CHECK(HT_parallel_foreach(ht, test_count, &nb_visited, nb_threads) == 0);
+    CHECK(nb_visited == TEST_NB_KEYS);
+    CHECK(HT_parallel_reduce(ht, test_reduce, test_combine, &sums, sizeof(sums), nb_threads) == 0);
+    CHECK(sums.nb_elements == TEST_NB_KEYS);
+    CHECK(sums.key_sum == (uint64_t) TEST_NB_KEYS * (TEST_NB_KEYS - 1) / 2);
+    CHECK(sums.value_sum == 2 * sums.key_sum);
+
+    CHECK(HT_parallel_foreach(ht, test_stop, NULL, nb_threads) == 0);
+    key = TEST_NB_KEYS;
+    CHECK(HT_add_element(ht, &key, sizeof(key), &key, sizeof(key)) == 0);
+    CHECK(HT_parallel_foreach(ht, test_stop, NULL, nb_threads) == 5);
+    CHECK(HT_parallel_foreach(NULL, test_count, &nb_visited, nb_threads) == 2 && errno == EINVAL);
+    CHECK(HT_parallel_foreach(ht, NULL, &nb_visited, nb_threads) == 2 && errno == EINVAL);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief Clear and delete tables from several threads, each taken value
+ * released once by the free function.
+ * \param nb_threads The number of threads.
+ */
+static int test_parallel_clear(const unsigned int nb_threads){
+    HT_hash_table ht;
+    unsigned int key,
+                 *value;
+    CHECK(HT_init(&ht, 64, HT_hash_wy) == 0);
+    CHECK(HT_set_free_function(&ht, test_free) == 0);
+
+    test_nb_freed = 0;
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        value = malloc(sizeof(*value));
+        CHECK(value != NULL);
+        *value = key;
+        CHECK(HT_add_element_mode(&ht, &key, sizeof(key), value, sizeof(*value), 0, 0, HT_MODE_TAKE_VALUE) == 0);
+    }
+    HT_parallel_reset_table(&ht, nb_threads);
+    CHECK(HT_get_nb_elements(&ht) == 0 && test_nb_freed == TEST_NB_KEYS);
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(HT_get_element(&ht, &key, sizeof(key), NULL, NULL) == 1);
+
+    // Still usable, then deleted with its elements
+    for(key = 0; key < TEST_NB_KEYS / 2; ++key){
+        value = malloc(sizeof(*value));
+        CHECK(value != NULL);
+        *value = key;
+        CHECK(HT_add_element_mode(&ht, &key, sizeof(key), value, sizeof(*value), 0, 0, HT_MODE_TAKE_VALUE) == 0);
+    }
+    CHECK(test_check_value(&ht, 1, 0, 1) == 0);
+    HT_parallel_delete(&ht, nb_threads);
+    CHECK(test_nb_freed == TEST_NB_KEYS + TEST_NB_KEYS / 2);
+    return 0;
+}
+
+int main(void){
+    unsigned int policy;
+    int failures = 0;
+    for(policy = HT_MERGE_KEEP; policy <= HT_MERGE_APPEND; ++policy){
+        RUN(test_merge(policy, 1, 0, 0), failures);
+        RUN(test_merge(policy, 4, 0, 0), failures);
+        RUN(test_merge(policy, 4, 0, 1), failures);
+        // The arena is not thread safe, one thread only
+        RUN(test_merge(policy, 1, 1, 0), failures);
+    }
+    RUN(test_foreach_reduce(1), failures);
+    RUN(test_foreach_reduce(4), failures);
+    RUN(test_foreach_reduce(0), failures);
+    RUN(test_parallel_clear(1), failures);
+    RUN(test_parallel_clear(4), failures);
+    return failures != 0;
+}
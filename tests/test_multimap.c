@@ -0,0 +1,228 @@
+/**
+ * \file test_multimap.c
+ * \brief Check the multimap table, its access at both ends and its value spans.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "multimap_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of values of the key, enough for many grows of its group.
+ */
+#define TEST_NB_VALUES 5000
+
+/**
+ * \brief The key holding the duplicates.
+ */
+#define TEST_KEY 7
+
+/**
+ * \brief Get the group of values of a key.
+ */
+static const HT_value_group* test_group(const HT_multimap* const mm, const int key){
+    const HT_value_group *group;
+    size_t found_size;
+    void *found;
+    if( HT_get_element(&mm->_keys, &key, sizeof(key), &found, &found_size) != 0 || found_size != sizeof(group) )
+        return NULL;
+    memcpy(&group, found, sizeof(group));
+    return group;
+}
+
+/**
+ * \brief Check the value of a key at a position.
+ */
+static int test_get(const HT_multimap* const mm, const int key, const unsigned int position, const int reverse, const int expected){
+    size_t found_size;
+    void *found;
+    CHECK(HT_multimap_get_element_position(mm, &key, sizeof(key), &found, &found_size, position, reverse) == 0);
+    CHECK(found_size == sizeof(expected) && memcmp(found, &expected, sizeof(expected)) == 0);
+    return 0;
+}
+
+/**
+ * \brief Check that the span of the values of ::TEST_KEY holds the expected values.
+ */
+static int test_check_span(const HT_multimap* const mm, const int* const expected, const size_t nb_expected){
+    const HT_container *values;
+    const int key = TEST_KEY;
+    size_t nb_values,
+           i;
+    CHECK(HT_multimap_get_all_values(mm, &key, sizeof(key), &values, &nb_values) == 0);
+    CHECK(nb_values == nb_expected);
+    for(i = 0; i < nb_values; ++i){
+        CHECK(values[i]._size_buffer == sizeof(int));
+        CHECK(memcmp(values[i]._buffer, &expected[i], sizeof(int)) == 0);
+    }
+    return 0;
+}
+
+/**
+ * \brief Push values at both ends of a key, the group moving only when it
+ * doubles, then pop them from both ends.
+ * \param front_only True to push every value in front.
+ */
+static int test_ends(const int front_only){
+    HT_multimap *mm = HT_multimap_new_hash(16, HT_hash_wy);
+    const HT_value_group *group = NULL,
+                         *moved;
+    int *expected = malloc(TEST_NB_VALUES * sizeof(int));
+    const int key = TEST_KEY;
+    unsigned int nb_moves = 0,
+                 nb_front = 0,
+                 i;
+    int value,
+        front;
+    CHECK(mm != NULL && expected != NULL);
+
+    for(value = 0; value < TEST_NB_VALUES; ++value){
+        front = front_only || value % 2 == 0;
+        CHECK(HT_multimap_add_element_position(mm, &key, sizeof(key), &value, sizeof(value), 0, !front) == 0);
+        nb_front += (unsigned int) front;
+        CHECK(test_get(mm, key, 0, !front, value) == 0);
+        moved = test_group(mm, key);
+        CHECK(moved != NULL && moved->_nb_values == (size_t) value + 1);
+        if( moved != group )
+            ++nb_moves;
+        group = moved;
+    }
+    // Amortized constant time: the group is copied a logarithmic number of times
+    CHECK(nb_moves <= 2 * 13);
+    CHECK(group->_capacity < 4 * TEST_NB_VALUES);
+    CHECK(HT_multimap_get_nb_elements(mm) == TEST_NB_VALUES && HT_multimap_get_nb_keys(mm) == 1);
+
+    // The front values in the reverse order of their insertion, then the back values
+    for(value = 0, i = 0; value < TEST_NB_VALUES; ++value){
+        if( front_only || value % 2 == 0 )
+            expected[nb_front - 1 - i++] = value;
+        else
+            expected[nb_front + (unsigned int) value / 2] = value;
+    }
+    CHECK(test_check_span(mm, expected, TEST_NB_VALUES) == 0);
+    for(i = 0; i < TEST_NB_VALUES; i += 97){
+        CHECK(test_get(mm, key, i, 0, expected[i]) == 0);
+        CHECK(test_get(mm, key, i, 1, expected[TEST_NB_VALUES - 1 - i]) == 0);
+    }
+
+    for(i = 0; i < TEST_NB_VALUES / 2; ++i){
+        CHECK(test_get(mm, key, 0, 0, expected[i]) == 0);
+        CHECK(test_get(mm, key, 0, 1, expected[TEST_NB_VALUES - 1 - i]) == 0);
+        CHECK(HT_multimap_remove_element_position(mm, &key, sizeof(key), 0, 0) == 0);
+        CHECK(HT_multimap_remove_element_position(mm, &key, sizeof(key), 0, 1) == 0);
+        // Removals never move the group
+        CHECK(test_group(mm, key) == group || HT_multimap_get_nb_elements(mm) == 0);
+    }
+    CHECK(HT_multimap_get_nb_elements(mm) == 0 && HT_multimap_get_nb_keys(mm) == 0);
+    CHECK(HT_multimap_remove_element_position(mm, &key, sizeof(key), 0, 0) == 1);
+    free(expected);
+    HT_multimap_delete_pointer(mm);
+    return 0;
+}
+
+/**
+ * \brief Insert and remove values at positions from both ends, like the duplicates of the generic table.
+ */
+static int test_duplicates(void){
+    static const struct{
+        int value;
+        unsigned int position;
+        int reverse;
+    } adds[] = { {1, 0, 0}, {2, 0, 0}, {3, 0, 1}, {4, 1, 0}, {5, 1, 1}, {6, 9, 0} };
+    static const int after_adds[] = {2, 1, 5, 4, 3, 6},
+                     after_removes[] = {2, 1, 4, 3};
+    HT_multimap mm;
+    const int key = TEST_KEY,
+              other = TEST_KEY + 1,
+              other_value = 42;
+    unsigned int i;
+    CHECK(HT_multimap_init(&mm, 16, HT_hash_wy) == 0);
+
+    CHECK(HT_multimap_add_element(&mm, &other, sizeof(other), &other_value, sizeof(other_value)) == 0);
+    for(i = 0; i < sizeof(adds) / sizeof(adds[0]); ++i)
+        CHECK(HT_multimap_add_element_position(&mm, &key, sizeof(key), &adds[i].value, sizeof(adds[i].value), adds[i].position, adds[i].reverse) == 0);
+    CHECK(test_check_span(&mm, after_adds, 6) == 0);
+    for(i = 0; i < 6; ++i){
+        CHECK(test_get(&mm, key, i, 0, after_adds[i]) == 0);
+        CHECK(test_get(&mm, key, i, 1, after_adds[5 - i]) == 0);
+    }
+    // Past the last match, the last match is returned
+    CHECK(test_get(&mm, key, 6, 0, after_adds[5]) == 0);
+    CHECK(HT_multimap_get_nb_elements(&mm) == 7 && HT_multimap_get_nb_keys(&mm) == 2);
+
+    CHECK(HT_multimap_remove_element_position(&mm, &key, sizeof(key), 2, 0) == 0);
+    CHECK(HT_multimap_remove_element_position(&mm, &key, sizeof(key), 0, 1) == 0);
+    CHECK(test_check_span(&mm, after_removes, 4) == 0);
+
+    HT_multimap_reset_table(&mm);
+    CHECK(HT_multimap_get_nb_elements(&mm) == 0 && HT_multimap_get_nb_keys(&mm) == 0);
+    CHECK(HT_multimap_get_element_position(&mm, &key, sizeof(key), NULL, NULL, 0, 0) == 1);
+    HT_multimap_delete(&mm);
+    return 0;
+}
+
+/**
+ * \brief Get the values of many keys at once, absent keys and bad arguments refused.
+ */
+static int test_all_values(void){
+    HT_multimap *mm = HT_multimap_new_hash(4, HT_hash_wy);
+    const HT_container *values;
+    size_t nb_values;
+    int key,
+        value;
+    CHECK(mm != NULL);
+
+    for(key = 0; key < 500; ++key){
+        for(value = 0; value < key % 5 + 1; ++value)
+            CHECK(HT_multimap_add_element_position(mm, &key, sizeof(key), &value, sizeof(value), 0, 1) == 0);
+    }
+    CHECK(HT_multimap_get_nb_keys(mm) == 500);
+    for(key = 0; key < 500; ++key){
+        CHECK(HT_multimap_get_all_values(mm, &key, sizeof(key), &values, &nb_values) == 0);
+        CHECK(nb_values == (size_t) key % 5 + 1);
+        for(value = 0; value < key % 5 + 1; ++value)
+            CHECK(memcmp(values[value]._buffer, &value, sizeof(value)) == 0);
+    }
+    key = 500;
+    CHECK(HT_multimap_get_all_values(mm, &key, sizeof(key), &values, &nb_values) == 1);
+    CHECK(HT_multimap_get_all_values(mm, &key, sizeof(key), NULL, &nb_values) == 2 && errno == EINVAL);
+    CHECK(HT_multimap_get_all_values(mm, &key, 0, &values, &nb_values) == 2 && errno == EINVAL);
+    HT_multimap_delete_pointer(mm);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_ends(0), failures);
+    RUN(test_ends(1), failures);
+    RUN(test_duplicates(), failures);
+    RUN(test_all_values(), failures);
+    return failures != 0;
+}
@@ -0,0 +1,382 @@
+/**
+ * \file test_robin.c
+ * \brief Check the Robin Hood table, its probe bound, its grows and reseeds, and its use behind the generic table.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "robin_hood_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys inserted, enough for several grows.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The size of the odd keys, not a multiple of the value alignment.
+ */
+#define TEST_ODD_KEY_SIZE 13
+
+/**
+ * \brief The number of elements visited by a call to the scan.
+ */
+#define TEST_SCAN_COUNT 16
+
+/**
+ * \brief The number of keys added after each call to the scan, enough to grow the table meanwhile.
+ */
+#define TEST_SCAN_ADDED 64
+
+/**
+ * \brief The seed known to the attacker, the first one the flooded hash sees.
+ */
+static uint64_t test_known_seed[2];
+
+/**
+ * \brief True once ::test_known_seed is set.
+ */
+static int test_seed_known = 0;
+
+/**
+ * \brief The visits of a walk over the Robin Hood backend.
+ */
+typedef struct{
+    unsigned char visits[TEST_NB_KEYS];
+    unsigned int nb_visited,
+                 stop_after;
+    int bad_element;
+} test_visits;
+
+/**
+ * \brief Count the visits of each key below ::TEST_NB_KEYS, the value being the key.
+ * \return 1 to stop once stop_after elements are visited, 0 otherwise.
+ */
+static int test_visit(const void* key, const size_t key_size, void* value, const size_t value_size, void* data){
+    test_visits *visits = data;
+    unsigned int k;
+    if( key_size != sizeof(k) || value_size != sizeof(k) || memcmp(key, value, sizeof(k)) != 0 ){
+        visits->bad_element = 1;
+        return 0;
+    }
+    memcpy(&k, key, sizeof(k));
+    if( k < TEST_NB_KEYS && visits->visits[k] < 255 )
+        ++visits->visits[k];
+    return ++visits->nb_visited == visits->stop_after;
+}
+
+/**
+ * \brief Check that the odd keys below ::TEST_NB_KEYS, and only them, are visited once.
+ */
+static int test_check_odd_visits(const test_visits* const visits){
+    unsigned int k;
+    CHECK(!visits->bad_element);
+    for(k = 0; k < TEST_NB_KEYS; ++k)
+        CHECK(visits->visits[k] == k % 2);
+    return 0;
+}
+
+/**
+ * \brief A hash sending every key to the same entry.
+ */
+static uint64_t test_constant_hash(const void* const key, const size_t key_size){
+    (void) key;
+    (void) key_size;
+    return 42;
+}
+
+/**
+ * \brief A seeded hash sending every key to the same entry under the first seed it is given.
+ */
+static uint64_t test_flooded_hash(const void* const key, const size_t key_size, const uint64_t seed[2]){
+    if( !test_seed_known ){
+        test_known_seed[0] = seed[0];
+        test_known_seed[1] = seed[1];
+        test_seed_known = 1;
+    }
+    if( seed[0] == test_known_seed[0] && seed[1] == test_known_seed[1] )
+        return 42;
+    return HT_hash_sip(key, key_size, seed);
+}
+
+/**
+ * \brief Fill the key of an index, its size depending on the index.
+ * \return The size of the key.
+ */
+static size_t test_key(const unsigned int index, unsigned char key[TEST_ODD_KEY_SIZE]){
+    const size_t size = index % 2 == 0 ? sizeof(index) : TEST_ODD_KEY_SIZE;
+    memset(key, 0x5A, size);
+    memcpy(key, &index, sizeof(index));
+    return size;
+}
+
+/**
+ * \brief Check that no entry is further than the bound from its home.
+ */
+static int test_check_bound(const HT_robin_table* const rt){
+    const size_t nb_entries = (size_t) 1 << rt->_entry_bits;
+    size_t i,
+           nb_used = 0;
+    for(i = 0; i < nb_entries; ++i){
+        CHECK(rt->_distances[i] <= HT_ROBIN_MAX_PROBES);
+        if( rt->_distances[i] != 0 )
+            ++nb_used;
+    }
+    CHECK(nb_used == rt->_nb_elements);
+    return 0;
+}
+
+/**
+ * \brief Check every key, its value sharing the buffer of the key.
+ * \param nb_keys The keys below this one were inserted.
+ * \param step Only the multiples of step are still present.
+ */
+static int test_check_keys(const HT_robin_table* const rt, const unsigned int nb_keys, const unsigned int step){
+    unsigned char key[TEST_ODD_KEY_SIZE];
+    unsigned int i;
+    size_t key_size,
+           found_size;
+    void *found;
+    for(i = 0; i < nb_keys; ++i){
+        key_size = test_key(i, key);
+        if( i % step != 0 ){
+            CHECK(HT_robin_get_element(rt, key, key_size, &found, &found_size) == 1);
+            continue;
+        }
+        CHECK(HT_robin_get_element(rt, key, key_size, &found, &found_size) == 0);
+        CHECK(found_size == sizeof(i) && memcmp(found, &i, sizeof(i)) == 0);
+        CHECK((uintptr_t) found % 8 == 0);
+    }
+    return 0;
+}
+
+/**
+ * \brief Grow through several sizes, the probe sequences staying bounded,
+ * then remove keys and check that the runs are shifted back.
+ */
+static int test_grow(void){
+    HT_robin_table *rt = HT_robin_new_hash(8, HT_hash_wy);
+    unsigned char key[TEST_ODD_KEY_SIZE];
+    unsigned int i,
+                 entry_bits;
+    size_t key_size;
+    CHECK(rt != NULL);
+    entry_bits = rt->_entry_bits;
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        key_size = test_key(i, key);
+        CHECK(HT_robin_add_element(rt, key, key_size, &i, sizeof(i)) == 0);
+    }
+    CHECK(rt->_entry_bits > entry_bits);
+    CHECK(HT_robin_get_nb_elements(rt) == TEST_NB_KEYS);
+    CHECK(test_check_bound(rt) == 0);
+    CHECK(test_check_keys(rt, TEST_NB_KEYS, 1) == 0);
+    key_size = test_key(3, key);
+    CHECK(HT_robin_add_element(rt, key, key_size, &i, sizeof(i)) == 1);
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        if( i % 3 != 0 ){
+            key_size = test_key(i, key);
+            CHECK(HT_robin_remove_element(rt, key, key_size) == 0);
+            CHECK(HT_robin_remove_element(rt, key, key_size) == 1);
+        }
+    }
+    CHECK(test_check_bound(rt) == 0);
+    CHECK(test_check_keys(rt, TEST_NB_KEYS, 3) == 0);
+
+    HT_robin_reset_table(rt);
+    CHECK(HT_robin_get_nb_elements(rt) == 0);
+    CHECK(test_check_bound(rt) == 0);
+    HT_robin_delete_pointer(rt);
+    return 0;
+}
+
+/**
+ * \brief Keys sharing their whole hash fill one run up to the bound, the
+ * table refuses them instead of growing for nothing.
+ */
+static int test_flooded_unseeded(void){
+    HT_robin_table *rt = HT_robin_new_hash(8, test_constant_hash);
+    unsigned int i;
+    int retval = 0;
+    CHECK(rt != NULL);
+    for(i = 0; i < 4 * HT_ROBIN_MAX_PROBES && retval == 0; ++i)
+        retval = HT_robin_add_element(rt, &i, sizeof(i), &i, sizeof(i));
+    CHECK(retval == 2 && errno == ENOSPC);
+    CHECK(HT_robin_get_nb_elements(rt) == HT_ROBIN_MAX_PROBES);
+    CHECK(test_check_bound(rt) == 0);
+    for(i = 0; i < HT_ROBIN_MAX_PROBES; ++i)
+        CHECK(HT_robin_get_element(rt, &i, sizeof(i), NULL, NULL) == 0);
+    HT_robin_delete_pointer(rt);
+    return 0;
+}
+
+/**
+ * \brief Keys sharing their hash under the seed an attacker learnt make the
+ * table draw another seed, every key is stored.
+ */
+static int test_flooded_seeded(void){
+    HT_robin_table *rt = HT_robin_new_hash(8, HT_hash_wy);
+    unsigned int i;
+    CHECK(rt != NULL);
+    for(i = 0; i < 16; ++i)
+        CHECK(HT_robin_add_element(rt, &i, sizeof(i), &i, sizeof(i)) == 0);
+
+    test_seed_known = 0;
+    CHECK(HT_robin_set_seeded_hash(rt, test_flooded_hash) == 0);
+    CHECK(test_seed_known);
+    for(i = 16; i < TEST_NB_KEYS; ++i)
+        CHECK(HT_robin_add_element(rt, &i, sizeof(i), &i, sizeof(i)) == 0);
+    CHECK(rt->_seed[0] != test_known_seed[0] || rt->_seed[1] != test_known_seed[1]);
+    CHECK(test_check_bound(rt) == 0);
+    for(i = 0; i < TEST_NB_KEYS; ++i)
+        CHECK(HT_robin_get_element(rt, &i, sizeof(i), NULL, NULL) == 0);
+
+    // Back to the hash function of the table
+    CHECK(HT_robin_set_seeded_hash(rt, NULL) == 0);
+    for(i = 0; i < TEST_NB_KEYS; ++i)
+        CHECK(HT_robin_get_element(rt, &i, sizeof(i), NULL, NULL) == 0);
+    HT_robin_delete_pointer(rt);
+    return 0;
+}
+
+/**
+ * \brief Use the Robin Hood table through the generic unique key functions.
+ */
+static int test_backend(void){
+    HT_hash_table ht;
+    HT_iterator it;
+    test_visits *visits;
+    unsigned int i,
+                 stop,
+                 entry_bits,
+                 value = 0;
+    uint64_t key64,
+             cursor;
+    size_t key_size,
+           found_size;
+    const void *key;
+    void *found;
+
+    CHECK(HT_init(&ht, 16, HT_hash_wy) == 0);
+    CHECK(HT_add_element(&ht, &value, sizeof(value), &value, sizeof(value)) == 0);
+    CHECK(HT_set_robin_backend(&ht) == 1 && errno == EINVAL);
+    HT_reset_table(&ht);
+    CHECK(HT_set_robin_backend(&ht) == 0);
+
+    for(i = 0; i < TEST_NB_KEYS; ++i)
+        CHECK(HT_add_element(&ht, &i, sizeof(i), &i, sizeof(i)) == 0);
+    CHECK(HT_get_nb_elements(&ht) == TEST_NB_KEYS);
+    CHECK(ht._nb_elements == HT_robin_get_nb_elements(ht._robin));
+    CHECK(HT_add_element(&ht, &value, sizeof(value), &value, sizeof(value)) == 1);
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        CHECK(HT_get_element(&ht, &i, sizeof(i), &found, &found_size) == 0);
+        CHECK(found_size == sizeof(i) && memcmp(found, &i, sizeof(i)) == 0);
+    }
+
+    i = TEST_NB_KEYS;
+    value = 7;
+    CHECK(HT_find_or_insert(&ht, &i, sizeof(i), &value, sizeof(value), &found, &found_size) == 0);
+    CHECK(found_size == sizeof(value) && memcmp(found, &value, sizeof(value)) == 0);
+    value = 8;
+    CHECK(HT_find_or_insert(&ht, &i, sizeof(i), &value, sizeof(value), &found, &found_size) == 1);
+    CHECK(*(unsigned int*) found == 7);
+    CHECK(HT_upsert(&ht, &i, sizeof(i), &value, sizeof(value)) == 2 && errno == EINVAL);
+
+    for(i = 0; i <= TEST_NB_KEYS; i += 2){
+        CHECK(HT_remove_element_position(&ht, &i, sizeof(i), 0, 0) == 0);
+        CHECK(HT_remove_element_position(&ht, &i, sizeof(i), 0, 0) == 1);
+    }
+    CHECK(HT_get_nb_elements(&ht) == TEST_NB_KEYS / 2);
+
+    // The iterators, HT_foreach and HT_scan walk the Robin Hood entries
+    visits = calloc(1, sizeof(*visits));
+    CHECK(visits != NULL);
+    for(HT_iterator_begin(&ht, &it); !HT_iterator_end(&it); HT_iterator_next(&it)){
+        key = HT_iterator_key(&it, &key_size);
+        found = HT_iterator_value(&it, &found_size);
+        test_visit(key, key_size, found, found_size, visits);
+    }
+    CHECK(test_check_odd_visits(visits) == 0);
+    memset(visits, 0, sizeof(*visits));
+    CHECK(HT_foreach(&ht, test_visit, visits) == 0);
+    CHECK(test_check_odd_visits(visits) == 0);
+    memset(visits, 0, sizeof(*visits));
+    visits->stop_after = 10;
+    CHECK(HT_foreach(&ht, test_visit, visits) == 1 && visits->nb_visited == 10);
+
+    // Keys added between two calls make the table grow under the cursor
+    memset(visits, 0, sizeof(*visits));
+    entry_bits = ht._robin->_entry_bits;
+    i = TEST_NB_KEYS + 1;
+    cursor = HT_SCAN_CURSOR_START;
+    do{
+        cursor = HT_scan(&ht, cursor, TEST_SCAN_COUNT, test_visit, visits);
+        for(stop = i + TEST_SCAN_ADDED; i < stop; ++i)
+            CHECK(HT_add_element(&ht, &i, sizeof(i), &i, sizeof(i)) == 0);
+    }
+    while( cursor != HT_SCAN_CURSOR_START );
+    CHECK(ht._robin->_entry_bits > entry_bits);
+    CHECK(test_check_odd_visits(visits) == 0);
+    CHECK(HT_scan(&ht, UINT64_C(1) << 32, TEST_SCAN_COUNT, test_visit, visits) == HT_SCAN_CURSOR_START && errno == EINVAL);
+    for(stop = i, i = TEST_NB_KEYS + 1; i < stop; ++i)
+        CHECK(HT_remove_element_position(&ht, &i, sizeof(i), 0, 0) == 0);
+    free(visits);
+    CHECK(HT_get_nb_elements(&ht) == TEST_NB_KEYS / 2);
+
+    // The seeded hash function goes to the Robin Hood table
+    CHECK(HT_set_seeded_hash(&ht, HT_hash_sip) == 0);
+    CHECK(ht._robin->seeded_hash_function == HT_hash_sip);
+    for(i = 1; i < TEST_NB_KEYS; i += 2)
+        CHECK(HT_get_element(&ht, &i, sizeof(i), NULL, NULL) == 0);
+
+    key64 = UINT64_C(1) << 40;
+    CHECK(HT_add_element_u64(&ht, key64, &value, sizeof(value)) == 0);
+    CHECK(HT_add_element_u64(&ht, key64, &value, sizeof(value)) == 1);
+    CHECK(HT_get_element_u64(&ht, key64, &found, &found_size) == 0);
+    CHECK(*(unsigned int*) found == 8);
+    CHECK(HT_remove_element_u64(&ht, key64) == 0);
+    CHECK(HT_get_element_u64(&ht, key64, NULL, NULL) == 1);
+
+    HT_reset_table(&ht);
+    CHECK(HT_get_nb_elements(&ht) == 0);
+    i = 1;
+    CHECK(HT_get_element(&ht, &i, sizeof(i), NULL, NULL) == 1);
+    HT_delete(&ht);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_grow(), failures);
+    RUN(test_flooded_unseeded(), failures);
+    RUN(test_flooded_seeded(), failures);
+    RUN(test_backend(), failures);
+    return failures != 0;
+}
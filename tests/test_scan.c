@@ -0,0 +1,282 @@
+/**
+ * \file test_scan.c
+ * \brief Walk hash tables with iterators, foreach and scans resized between the calls.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "concurrent_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys present during the whole scan.
+ */
+#define TEST_NB_KEYS 4000
+
+/**
+ * \brief The number of keys added and removed while the scan runs.
+ */
+#define TEST_NB_TRANSIENT_KEYS 20000
+
+/**
+ * \brief The number of elements visited by a call to the scan.
+ */
+#define TEST_SCAN_COUNT 16
+
+/**
+ * \brief The number of visits of each key.
+ */
+typedef struct{
+    unsigned char visits[TEST_NB_KEYS + TEST_NB_TRANSIENT_KEYS];
+    int bad_element;
+} test_visits;
+
+static int test_visit(const void* key, const size_t key_size, void* value, const size_t value_size, void* data){
+    test_visits *visits = data;
+    unsigned int k;
+    if( key_size != sizeof(k) || value_size != sizeof(k) || memcmp(key, value, sizeof(k)) != 0 ){
+        visits->bad_element = 1;
+        return 0;
+    }
+    memcpy(&k, key, sizeof(k));
+    if( k >= TEST_NB_KEYS + TEST_NB_TRANSIENT_KEYS )
+        visits->bad_element = 1;
+    else if( visits->visits[k] < 255 )
+        ++visits->visits[k];
+    return 0;
+}
+
+/**
+ * \brief Check that every stable key is visited, once unless duplicates are allowed.
+ */
+static int test_check_visits(const test_visits* const visits, const int allow_duplicates){
+    unsigned int k;
+    CHECK(!visits->bad_element);
+    for(k = 0; k < TEST_NB_KEYS; ++k){
+        CHECK(visits->visits[k] >= 1);
+        CHECK(allow_duplicates || visits->visits[k] == 1);
+    }
+    return 0;
+}
+
+/**
+ * \brief Count the elements walked by ::HT_foreach, each value being its key plus one.
+ */
+static int test_count_incremented(const void* key, const size_t key_size, void* value, const size_t value_size, void* data){
+    unsigned int k,
+                 v;
+    (void) key_size;
+    (void) value_size;
+    memcpy(&k, key, sizeof(k));
+    memcpy(&v, value, sizeof(v));
+    if( v != k + 1 )
+        return -1;
+    ++*(unsigned int*) data;
+    return 0;
+}
+
+/**
+ * \brief Stop ::HT_foreach after ten elements.
+ */
+static int test_stop(const void* key, const size_t key_size, void* value, const size_t value_size, void* data){
+    (void) key;
+    (void) key_size;
+    (void) value;
+    (void) value_size;
+    return ++*(unsigned int*) data == 10 ? 7 : 0;
+}
+
+/**
+ * \brief Walk a table in the middle of a resize with an iterator, modifying
+ * the values in place, then with ::HT_foreach.
+ */
+static int test_iterator(void){
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    test_visits *visits = calloc(1, sizeof(*visits));
+    HT_iterator it;
+    size_t key_size,
+           value_size;
+    unsigned int k,
+                 nb_walked = 0;
+    const void *key;
+    void *value;
+
+    CHECK(ht != NULL && visits != NULL);
+    HT_iterator_begin(ht, &it);
+    CHECK(HT_iterator_end(&it));
+    CHECK(HT_foreach(ht, test_stop, &nb_walked) == 0 && nb_walked == 0);
+
+    CHECK(HT_set_load_factors(ht, 0.0f, 0.0f) == 0);
+    for(k = 0; k < TEST_NB_KEYS; ++k)
+        CHECK(HT_add_element(ht, &k, sizeof(k), &k, sizeof(k)) == 0);
+    // Some slots migrated, the others not yet
+    CHECK(HT_resize(ht, 1024) == 0);
+    CHECK(HT_remove_element_position(ht, &k, sizeof(k), 0, 0) == 1);
+    CHECK(ht->_new_slots != NULL && ht->_rehash_index != 0);
+
+    for(HT_iterator_begin(ht, &it); !HT_iterator_end(&it); HT_iterator_next(&it)){
+        key = HT_iterator_key(&it, &key_size);
+        value = HT_iterator_value(&it, &value_size);
+        CHECK(test_visit(key, key_size, value, value_size, visits) == 0);
+        memcpy(&k, value, sizeof(k));
+        ++k;
+        memcpy(value, &k, sizeof(k));
+    }
+    CHECK(test_check_visits(visits, 0) == 0);
+
+    CHECK(HT_foreach(ht, test_count_incremented, &nb_walked) == 0);
+    CHECK(nb_walked == TEST_NB_KEYS);
+    nb_walked = 0;
+    CHECK(HT_foreach(ht, test_stop, &nb_walked) == 7 && nb_walked == 10);
+    HT_delete_pointer(ht);
+    free(visits);
+    return 0;
+}
+
+/**
+ * \brief Scan a table that is not modified, each element visited once and
+ * each call visiting about count elements.
+ */
+static int test_scan_stable(void){
+    HT_hash_table *ht = HT_new_hash(1024, HT_hash_wy);
+    test_visits *visits = calloc(1, sizeof(*visits));
+    uint64_t cursor = HT_SCAN_CURSOR_START;
+    unsigned int k,
+                 calls = 0;
+
+    CHECK(ht != NULL && visits != NULL);
+    for(k = 0; k < TEST_NB_KEYS; ++k)
+        CHECK(HT_add_element(ht, &k, sizeof(k), &k, sizeof(k)) == 0);
+    do{
+        cursor = HT_scan(ht, cursor, TEST_SCAN_COUNT, test_visit, visits);
+        ++calls;
+    }while( cursor != HT_SCAN_CURSOR_START );
+    CHECK(test_check_visits(visits, 0) == 0);
+    // Whole slots are visited, so a call may visit more than count elements
+    CHECK(calls <= TEST_NB_KEYS / TEST_SCAN_COUNT + 1);
+    CHECK(calls >= TEST_NB_KEYS / (4 * TEST_SCAN_COUNT));
+    HT_delete_pointer(ht);
+    free(visits);
+    return 0;
+}
+
+/**
+ * \brief Scan a table growing, shrinking and churning between the calls.
+ */
+static int test_scan_resize(void){
+    static const unsigned int sizes[] = {4096, 64, 16384, 8, 1024, 2};
+    HT_hash_table *ht = HT_new_hash(32, HT_hash_wy);
+    test_visits *visits = calloc(1, sizeof(*visits));
+    uint64_t cursor = HT_SCAN_CURSOR_START;
+    unsigned int k,
+                 transient = TEST_NB_KEYS,
+                 calls = 0;
+    int retval;
+
+    CHECK(ht != NULL && visits != NULL);
+    for(k = 0; k < TEST_NB_KEYS; ++k)
+        CHECK(HT_add_element(ht, &k, sizeof(k), &k, sizeof(k)) == 0);
+    do{
+        cursor = HT_scan(ht, cursor, TEST_SCAN_COUNT, test_visit, visits);
+        if( calls % 8 == 0 )
+            CHECK(HT_resize(ht, sizes[calls / 8 % (sizeof(sizes) / sizeof(*sizes))]) == 0);
+        if( transient < TEST_NB_KEYS + TEST_NB_TRANSIENT_KEYS ){
+            CHECK(HT_add_element(ht, &transient, sizeof(transient), &transient, sizeof(transient)) == 0);
+            if( transient % 3 == 0 )
+                CHECK(HT_remove_element_position(ht, &transient, sizeof(transient), 0, 0) == 0);
+            ++transient;
+        }
+        ++calls;
+    }while( cursor != HT_SCAN_CURSOR_START );
+    // The table shrinks meanwhile, so a slot may be visited twice
+    retval = test_check_visits(visits, 1);
+    HT_delete_pointer(ht);
+    free(visits);
+    return retval;
+}
+
+/**
+ * \brief The state of a thread adding keys to a concurrent table.
+ */
+typedef struct{
+    HT_concurrent_table *ct;
+    int failed;
+} test_writer;
+
+static void* test_writer_thread(void* data){
+    test_writer *writer = data;
+    unsigned int k;
+    for(k = TEST_NB_KEYS; k < TEST_NB_KEYS + TEST_NB_TRANSIENT_KEYS; ++k){
+        if( HT_concurrent_add_element(writer->ct, &k, sizeof(k), &k, sizeof(k)) != 0 )
+            writer->failed = 1;
+        if( k % 2 == 0 && HT_concurrent_remove_element_position(writer->ct, &k, sizeof(k), 0, 0) != 0 )
+            writer->failed = 1;
+    }
+    return NULL;
+}
+
+/**
+ * \brief Scan a concurrent table while an other thread makes it grow.
+ */
+static int test_concurrent_scan(const int lockfree_reads){
+    HT_concurrent_table *ct = HT_concurrent_new_hash(16, 4, HT_hash_wy);
+    test_visits *visits = calloc(1, sizeof(*visits));
+    test_writer writer;
+    pthread_t thread;
+    uint64_t cursor = HT_SCAN_CURSOR_START;
+    unsigned int k;
+    int retval;
+
+    CHECK(ct != NULL && visits != NULL);
+    CHECK(HT_concurrent_set_lockfree_reads(ct, lockfree_reads) == 0);
+    for(k = 0; k < TEST_NB_KEYS; ++k)
+        CHECK(HT_concurrent_add_element(ct, &k, sizeof(k), &k, sizeof(k)) == 0);
+    writer.ct = ct;
+    writer.failed = 0;
+    CHECK(pthread_create(&thread, NULL, test_writer_thread, &writer) == 0);
+    do{
+        cursor = HT_concurrent_scan(ct, cursor, TEST_SCAN_COUNT, test_visit, visits);
+    }while( cursor != HT_SCAN_CURSOR_START );
+    pthread_join(thread, NULL);
+    retval = writer.failed || test_check_visits(visits, 0);
+    retval = retval || HT_concurrent_get_nb_elements(ct) != TEST_NB_KEYS + TEST_NB_TRANSIENT_KEYS / 2;
+    HT_concurrent_delete_pointer(ct);
+    free(visits);
+    return retval;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_iterator(), failures);
+    RUN(test_scan_stable(), failures);
+    RUN(test_scan_resize(), failures);
+    RUN(test_concurrent_scan(0), failures);
+    RUN(test_concurrent_scan(1), failures);
+    return failures != 0;
+}
@@ -0,0 +1,255 @@
+/**
+ * \file test_seed.c
+ * \brief Check the seeded hashing, its incremental reseeds and the chain length watchdog.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of distinct keys.
+ */
+#define TEST_NB_KEYS 4000
+
+/**
+ * \brief The key holding the duplicates.
+ */
+#define TEST_KEY 7u
+
+/**
+ * \brief The number of duplicates of ::TEST_KEY.
+ */
+#define TEST_NB_DUPLICATES 5u
+
+/**
+ * \brief The seed known to the attacker, the first one the flooded hash sees.
+ */
+static uint64_t test_known_seed[2];
+
+/**
+ * \brief True once ::test_known_seed is set.
+ */
+static int test_seed_known = 0;
+
+/**
+ * \brief A seeded hash sending every key to the same slot under the first seed it is given.
+ */
+static uint64_t test_flooded_hash(const void* const key, const size_t key_size, const uint64_t seed[2]){
+    if( !test_seed_known ){
+        test_known_seed[0] = seed[0];
+        test_known_seed[1] = seed[1];
+        test_seed_known = 1;
+    }
+    if( seed[0] == test_known_seed[0] && seed[1] == test_known_seed[1] )
+        return 42;
+    return HT_hash_sip(key, key_size, seed);
+}
+
+/**
+ * \brief Check every key, and the order of the duplicates of ::TEST_KEY.
+ * \param nb_keys The keys below this one are present.
+ */
+static int test_check_keys(const HT_hash_table* const ht, const unsigned int nb_keys){
+    unsigned int key,
+                 i;
+    size_t found_size;
+    void *found;
+
+    for(key = 0; key < nb_keys; ++key){
+        CHECK(HT_get_element(ht, &key, sizeof(key), &found, &found_size) == 0);
+        CHECK(found_size == sizeof(key) && memcmp(found, &key, sizeof(key)) == 0);
+    }
+    key = nb_keys;
+    CHECK(HT_get_element(ht, &key, sizeof(key), NULL, NULL) == 1);
+    key = TEST_KEY;
+    for(i = 0; i < TEST_NB_DUPLICATES; ++i){
+        CHECK(HT_get_element_position(ht, &key, sizeof(key), &found, &found_size, i + 1, 0) == 0);
+        CHECK(memcmp(found, &i, sizeof(i)) == 0);
+    }
+    return 0;
+}
+
+/**
+ * \brief Add the keys and the duplicates of ::TEST_KEY.
+ */
+static int test_fill(HT_hash_table* const ht, const unsigned int nb_keys){
+    unsigned int key,
+                 i;
+    for(key = 0; key < nb_keys; ++key)
+        CHECK(HT_add_element(ht, &key, sizeof(key), &key, sizeof(key)) == 0);
+    key = TEST_KEY;
+    for(i = 0; i < TEST_NB_DUPLICATES; ++i)
+        CHECK(HT_add_element_position(ht, &key, sizeof(key), &i, sizeof(i), 0, 1) == 0);
+    return 0;
+}
+
+/**
+ * \brief Get the longest chain of a table once its migration is over.
+ */
+static size_t test_longest_chain(HT_hash_table* const ht){
+    HT_stats stats;
+    HT_resize(ht, ht->_nb_slots);
+    if( ht->_new_slots != NULL || HT_get_stats(ht, &stats) != 0 )
+        return (size_t) -1;
+    return stats.longest_chain;
+}
+
+/**
+ * \brief A new seed moves the pairs a few slots per operation, every key stays reachable.
+ */
+static int test_incremental_reseed(void){
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    uint64_t seed[2];
+    unsigned int key,
+                 removed,
+                 nb_keys = TEST_NB_KEYS;
+    int retval = 0;
+    CHECK(ht != NULL);
+    CHECK(HT_set_seeded_hash(ht, HT_hash_sip) == 0);
+    CHECK(test_fill(ht, TEST_NB_KEYS) == 0);
+    HT_resize(ht, ht->_nb_slots);
+
+    memcpy(seed, ht->_seed, sizeof(seed));
+    CHECK(HT_set_seeded_hash(ht, HT_hash_sip) == 0);
+    CHECK(ht->_reseeding && ht->_rehash_index == 0);
+    CHECK(memcmp(seed, ht->_seed, sizeof(seed)) != 0);
+    // Add and remove keys while the slots move, check everything in between
+    while( ht->_reseeding && retval == 0 ){
+        CHECK(HT_add_element(ht, &nb_keys, sizeof(nb_keys), &nb_keys, sizeof(nb_keys)) == 0);
+        ++nb_keys;
+        if( nb_keys % 64 == 0 )
+            retval = test_check_keys(ht, nb_keys);
+    }
+    CHECK(retval == 0);
+    CHECK(nb_keys - TEST_NB_KEYS <= ht->_nb_slots / HT_REHASH_SLOTS_PER_STEP + 1);
+    CHECK(test_check_keys(ht, nb_keys) == 0);
+
+    // Back to the plain hash function the same way, removing keys meanwhile
+    CHECK(HT_set_seeded_hash(ht, NULL) == 0);
+    CHECK(ht->_reseeding);
+    for(removed = 0; removed < nb_keys && ht->_reseeding; removed += 2)
+        CHECK(HT_remove_element_position(ht, &removed, sizeof(removed), 0, 0) == 0);
+    CHECK(!ht->_reseeding && ht->seeded_hash_function == NULL);
+    for(key = 0; key < nb_keys; ++key)
+        CHECK(HT_get_element(ht, &key, sizeof(key), NULL, NULL) == (key < removed && key % 2 == 0));
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief Keys colliding under a known seed make an insertion draw a new one.
+ */
+static int test_watchdog(void){
+    HT_hash_table *ht = HT_new_hash(64, HT_hash_wy);
+    CHECK(ht != NULL);
+    test_seed_known = 0;
+    CHECK(HT_set_seeded_hash(ht, test_flooded_hash) == 0);
+    CHECK(test_fill(ht, TEST_NB_KEYS) == 0);
+    CHECK(test_seed_known);
+    CHECK(ht->_seed[0] != test_known_seed[0] || ht->_seed[1] != test_known_seed[1]);
+    CHECK(test_check_keys(ht, TEST_NB_KEYS) == 0);
+    CHECK(test_longest_chain(ht) < HT_WATCHDOG_CHAIN_LENGTH);
+    CHECK(test_check_keys(ht, TEST_NB_KEYS) == 0);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief The state of ::test_read_record.
+ */
+typedef struct{
+    unsigned int current,       /**<- The key given last. */
+                 next,          /**<- The next key given. */
+                 end;           /**<- The key after the last one. */
+} test_records;
+
+/**
+ * \brief Give the keys of a ::test_records, each key being its own value.
+ */
+static int test_read_record(void* context, const void** key, size_t* key_size, const void** value, size_t* value_size){
+    test_records *records = context;
+    if( records->next == records->end )
+        return 1;
+    records->current = records->next++;
+    *key = &records->current;
+    *key_size = sizeof(records->current);
+    *value = &records->current;
+    *value_size = sizeof(records->current);
+    return 0;
+}
+
+/**
+ * \brief A bulk build of colliding keys draws a new seed too.
+ * \param stream True to read the records one by one.
+ */
+static int test_bulk_watchdog(const int stream){
+    HT_hash_table *ht = HT_new_hash(64, HT_hash_wy);
+    test_records records = {0, 0, TEST_NB_KEYS};
+    const void *keys[TEST_NB_KEYS];
+    size_t sizes[TEST_NB_KEYS];
+    unsigned int values[TEST_NB_KEYS],
+                 i,
+                 key;
+    CHECK(ht != NULL);
+    test_seed_known = 0;
+    CHECK(HT_set_seeded_hash(ht, test_flooded_hash) == 0);
+    if( stream )
+        CHECK(HT_bulk_build_stream(ht, test_read_record, &records, 2) == 0);
+    else{
+        for(i = 0; i < TEST_NB_KEYS; ++i){
+            values[i] = i;
+            keys[i] = &values[i];
+            sizes[i] = sizeof(values[i]);
+        }
+        CHECK(HT_bulk_build(ht, TEST_NB_KEYS, keys, sizes, keys, sizes, 2) == 0);
+    }
+    CHECK(ht->_seed[0] != test_known_seed[0] || ht->_seed[1] != test_known_seed[1]);
+    CHECK(test_longest_chain(ht) < HT_WATCHDOG_CHAIN_LENGTH);
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(HT_get_element(ht, &key, sizeof(key), NULL, NULL) == 0);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+static int test_bulk_watchdog_array(void){
+    return test_bulk_watchdog(0);
+}
+
+static int test_bulk_watchdog_stream(void){
+    return test_bulk_watchdog(1);
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_incremental_reseed(), failures);
+    RUN(test_watchdog(), failures);
+    RUN(test_bulk_watchdog_array(), failures);
+    RUN(test_bulk_watchdog_stream(), failures);
+    return failures != 0;
+}
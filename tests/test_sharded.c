@@ -0,0 +1,194 @@
+/**
+ * \file test_sharded.c
+ * \brief Check the sharded table, its duplicates and the grows of its shards.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "sharded_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys inserted, enough for several grows of each shard.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The key holding the duplicates.
+ */
+#define TEST_KEY 7
+
+/**
+ * \brief Check the value of a key at a position.
+ */
+static int test_get(HT_sharded_table* const st, const int key, const unsigned int position, const int reverse, const int expected){
+    size_t value_size = sizeof(int);
+    int value;
+    CHECK(HT_sharded_get_element_position(st, &key, sizeof(key), &value, &value_size, position, reverse) == 0);
+    CHECK(value_size == sizeof(value) && value == expected);
+    return 0;
+}
+
+/**
+ * \brief Count the shards being resized and the elements of every shard.
+ * \param nb_elements Set to the sum of the elements of the shards.
+ * \param nb_empty Set to the number of shards without element.
+ * \return The number of shards with a resize in progress.
+ */
+static unsigned int test_count_shards(const HT_sharded_table* const st, size_t* const nb_elements, unsigned int* const nb_empty){
+    unsigned int i,
+                 nb_resizing = 0;
+    *nb_elements = 0;
+    *nb_empty = 0;
+    for(i = 0; i < (1u << st->_shard_bits); ++i){
+        if( st->_shards[i]._table._new_slots != NULL )
+            ++nb_resizing;
+        if( st->_shards[i]._table._nb_elements == 0 )
+            ++*nb_empty;
+        *nb_elements += st->_shards[i]._table._nb_elements;
+    }
+    return nb_resizing;
+}
+
+/**
+ * \brief Spread keys over the shards, only one of them resizing at a time.
+ */
+static int test_shards(void){
+    HT_sharded_table *st = HT_sharded_new_hash(16, 3, HT_hash_wy);
+    unsigned int nb_empty,
+                 nb_slots = 0,
+                 i;
+    size_t nb_elements;
+    int key,
+        value;
+    CHECK(st != NULL);
+    // Rounded up to a power of two
+    CHECK(st->_shard_bits == 2 && st->_shards[0]._table._nb_slots == 4);
+
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        value = key * 3;
+        CHECK(HT_sharded_add_element(st, &key, sizeof(key), &value, sizeof(value)) == 0);
+        CHECK(test_count_shards(st, &nb_elements, &nb_empty) <= 1);
+        CHECK(nb_elements == (size_t) key + 1);
+        CHECK(st->_resizing_shard == -1 || st->_shards[st->_resizing_shard]._table._new_slots != NULL);
+    }
+    CHECK(HT_sharded_get_nb_elements(st) == TEST_NB_KEYS);
+    CHECK(nb_empty == 0);
+    for(i = 0; i < 4; ++i)
+        nb_slots += st->_shards[i]._table._nb_slots;
+    CHECK(nb_slots >= 256);
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        CHECK(test_get(st, key, 0, 0, key * 3) == 0);
+        CHECK(HT_sharded_add_element(st, &key, sizeof(key), &value, sizeof(value)) == 1);
+    }
+    key = TEST_NB_KEYS;
+    CHECK(HT_sharded_get_element_position(st, &key, sizeof(key), NULL, NULL, 0, 0) == 1);
+
+    for(key = 0; key < TEST_NB_KEYS; key += 2){
+        CHECK(HT_sharded_remove_element_position(st, &key, sizeof(key), 0, 0) == 0);
+        CHECK(HT_sharded_remove_element_position(st, &key, sizeof(key), 0, 0) == 1);
+    }
+    for(key = 1; key < TEST_NB_KEYS; key += 2)
+        CHECK(test_get(st, key, 0, 0, key * 3) == 0);
+    CHECK(HT_sharded_get_nb_elements(st) == TEST_NB_KEYS / 2);
+
+    HT_sharded_reset_table(st);
+    CHECK(HT_sharded_get_nb_elements(st) == 0);
+    key = 1;
+    CHECK(HT_sharded_get_element_position(st, &key, sizeof(key), NULL, NULL, 0, 0) == 1);
+    HT_sharded_delete_pointer(st);
+    return 0;
+}
+
+/**
+ * \brief Insert duplicates at several positions from both ends, like the generic table.
+ */
+static int test_duplicates(void){
+    static const struct{
+        int value;
+        unsigned int position;
+        int reverse;
+    } adds[] = { {1, 0, 0}, {2, 0, 0}, {3, 0, 1}, {4, 1, 0}, {5, 1, 1}, {6, 9, 0} };
+    static const int after_adds[] = {2, 1, 5, 4, 3, 6},
+                     after_removes[] = {2, 1, 4, 3};
+    HT_sharded_table st;
+    const int key = TEST_KEY;
+    unsigned int i;
+    CHECK(HT_sharded_init(&st, 16, 4, HT_hash_wy) == 0);
+
+    for(i = 0; i < sizeof(adds) / sizeof(adds[0]); ++i)
+        CHECK(HT_sharded_add_element_position(&st, &key, sizeof(key), &adds[i].value, sizeof(adds[i].value), adds[i].position, adds[i].reverse) == 0);
+    for(i = 0; i < 6; ++i){
+        CHECK(test_get(&st, key, i, 0, after_adds[i]) == 0);
+        CHECK(test_get(&st, key, i, 1, after_adds[5 - i]) == 0);
+    }
+    CHECK(test_get(&st, key, 6, 0, after_adds[5]) == 0);
+    CHECK(HT_sharded_add_element(&st, &key, sizeof(key), &key, sizeof(key)) == 1);
+
+    CHECK(HT_sharded_remove_element_position(&st, &key, sizeof(key), 2, 0) == 0);
+    CHECK(HT_sharded_remove_element_position(&st, &key, sizeof(key), 0, 1) == 0);
+    for(i = 0; i < 4; ++i)
+        CHECK(test_get(&st, key, i, 0, after_removes[i]) == 0);
+    for(i = 0; i < 4; ++i)
+        CHECK(HT_sharded_remove_element_position(&st, &key, sizeof(key), 0, 0) == 0);
+    CHECK(HT_sharded_remove_element_position(&st, &key, sizeof(key), 0, 0) == 1);
+    CHECK(HT_sharded_get_nb_elements(&st) == 0);
+    HT_sharded_delete(&st);
+    return 0;
+}
+
+/**
+ * \brief Place the shards, keep them at their size once the grows are disabled.
+ */
+static int test_placed(void){
+    const HT_shard_placement placements[2] = { {0, NULL}, {-1, NULL} };
+    HT_sharded_table st;
+    int key;
+    CHECK(HT_sharded_init_placed(&st, 64, 2, HT_hash_wy, placements) == 0);
+    CHECK(HT_sharded_set_load_factor(&st, -1.0f) == 1 && errno == EINVAL);
+    CHECK(HT_sharded_set_load_factor(&st, 0.0f) == 0);
+
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(HT_sharded_add_element(&st, &key, sizeof(key), &key, sizeof(key)) == 0);
+    CHECK(st._shards[0]._table._nb_slots == 32 && st._shards[1]._table._nb_slots == 32);
+    CHECK(st._resizing_shard == -1);
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(test_get(&st, key, 0, 0, key) == 0);
+    HT_sharded_delete(&st);
+
+    CHECK(HT_sharded_new_hash(0, 4, HT_hash_wy) == NULL && errno == EINVAL);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_shards(), failures);
+    RUN(test_duplicates(), failures);
+    RUN(test_placed(), failures);
+    return failures != 0;
+}
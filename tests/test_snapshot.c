@@ -0,0 +1,291 @@
+/**
+ * \file test_snapshot.c
+ * \brief Save a hash table and map it back.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "snapshot_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of distinct keys saved.
+ */
+#define TEST_NB_KEYS 3000
+
+/**
+ * \brief The key holding the duplicates.
+ */
+#define TEST_KEY (TEST_NB_KEYS + 1)
+
+/**
+ * \brief The position of the first slot offset in the file, after the 48 bytes header.
+ */
+#define TEST_OFFSETS_POSITION 48
+
+/**
+ * \brief Fill a value whose size and bytes depend on its key.
+ * \return The size of the value.
+ */
+static size_t test_value(const unsigned int key, unsigned char value[40]){
+    const size_t size = 1 + key % 40;
+    memset(value, (int) (key & 0xFF), size);
+    return size;
+}
+
+/**
+ * \brief Write a file.
+ */
+static int test_write_file(const char* const path, const unsigned char* const content, const size_t size){
+    FILE *file = fopen(path, "wb");
+    size_t written;
+    if( file == NULL )
+        return 1;
+    written = fwrite(content, 1, size, file);
+    return fclose(file) != 0 || written != size;
+}
+
+/**
+ * \brief Read a whole file.
+ * \return The content, NULL on failure.
+ */
+static unsigned char* test_read_file(const char* const path, size_t* const size){
+    FILE *file = fopen(path, "rb");
+    unsigned char *content;
+    long length;
+    if( file == NULL )
+        return NULL;
+    if( fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0 ){
+        fclose(file);
+        return NULL;
+    }
+    *size = (size_t) length;
+    content = malloc(*size);
+    if( content != NULL && fread(content, 1, *size, file) != *size ){
+        free(content);
+        content = NULL;
+    }
+    fclose(file);
+    return content;
+}
+
+/**
+ * \brief Check every element of a mapped snapshot.
+ */
+static int test_check_snapshot(const HT_snapshot* const snapshot){
+    static const int duplicates[] = {30, 10, 20};
+    unsigned char expected[40];
+    const void *value;
+    size_t value_size;
+    unsigned int key,
+                 i;
+
+    CHECK(HT_snapshot_get_nb_elements(snapshot) == TEST_NB_KEYS + 3);
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        CHECK(HT_snapshot_get_element(snapshot, &key, sizeof(key), &value, &value_size) == 0);
+        CHECK(value_size == test_value(key, expected) && memcmp(value, expected, value_size) == 0);
+    }
+    key = TEST_KEY + 1;
+    CHECK(HT_snapshot_get_element(snapshot, &key, sizeof(key), &value, &value_size) == 1);
+
+    key = TEST_KEY;
+    for(i = 0; i < 3; ++i){
+        CHECK(HT_snapshot_get_element_position(snapshot, &key, sizeof(key), &value, &value_size, i, 0) == 0);
+        CHECK(value_size == sizeof(int) && memcmp(value, &duplicates[i], sizeof(int)) == 0);
+        CHECK(HT_snapshot_get_element_position(snapshot, &key, sizeof(key), &value, &value_size, i, 1) == 0);
+        CHECK(value_size == sizeof(int) && memcmp(value, &duplicates[2 - i], sizeof(int)) == 0);
+    }
+    return 0;
+}
+
+/**
+ * \brief Save a table with duplicates and values of several sizes, map it back and check it.
+ */
+static int test_save_load(const char* const path){
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    HT_snapshot snapshot;
+    unsigned char value[40];
+    unsigned int key;
+    int duplicate,
+        retval;
+
+    CHECK(ht != NULL);
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(HT_add_element(ht, &key, sizeof(key), value, test_value(key, value)) == 0);
+    key = TEST_KEY;
+    duplicate = 10;
+    CHECK(HT_add_element_position(ht, &key, sizeof(key), &duplicate, sizeof(duplicate), 0, 0) == 0);
+    duplicate = 20;
+    CHECK(HT_add_element_position(ht, &key, sizeof(key), &duplicate, sizeof(duplicate), 0, 1) == 0);
+    duplicate = 30;
+    CHECK(HT_add_element_position(ht, &key, sizeof(key), &duplicate, sizeof(duplicate), 0, 0) == 0);
+    retval = HT_save(ht, path);
+    HT_delete_pointer(ht);
+    CHECK(retval == 0);
+
+    CHECK(HT_mmap_load(&snapshot, path, HT_hash_wy) == 0);
+    retval = test_check_snapshot(&snapshot);
+    HT_snapshot_unmap(&snapshot);
+    return retval;
+}
+
+/**
+ * \brief Check that a value is read in place from the mapping, aligned on 8 bytes.
+ */
+static int test_in_map(const HT_snapshot* const snapshot, const void* const value, const size_t value_size){
+    const unsigned char *map = snapshot->_map,
+                        *at = value;
+    CHECK(at >= map && at + value_size <= map + snapshot->_map_size);
+    CHECK((uintptr_t) at % 8 == 0);
+    return 0;
+}
+
+/**
+ * \brief Save a table in the middle of a resize, map it twice at different
+ * addresses and read the values in place from both mappings.
+ */
+static int test_zero_copy(const char* const path){
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    HT_snapshot first,
+                second;
+    unsigned char expected[40];
+    const void *first_value,
+               *second_value;
+    size_t first_size,
+           second_size;
+    unsigned int key;
+    int retval;
+
+    CHECK(ht != NULL);
+    CHECK(HT_save(ht, path) == 0);
+    CHECK(HT_mmap_load(&first, path, HT_hash_wy) == 0);
+    key = 0;
+    retval = HT_snapshot_get_nb_elements(&first) != 0 ||
+        HT_snapshot_get_element(&first, &key, sizeof(key), &first_value, &first_size) != 1;
+    HT_snapshot_unmap(&first);
+    CHECK(retval == 0);
+
+    CHECK(HT_set_load_factors(ht, 0.0f, 0.0f) == 0);
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(HT_add_element(ht, &key, sizeof(key), expected, test_value(key, expected)) == 0);
+    CHECK(HT_resize(ht, 1024) == 0);
+    CHECK(HT_remove_element_position(ht, &key, sizeof(key), 0, 0) == 1);
+    CHECK(ht->_new_slots != NULL);
+    retval = HT_save(ht, path);
+    HT_delete_pointer(ht);
+    CHECK(retval == 0);
+
+    CHECK(HT_mmap_load(&first, path, HT_hash_wy) == 0);
+    CHECK(HT_mmap_load(&second, path, HT_hash_wy) == 0);
+    // Both slot arrays of the resizing table are saved
+    CHECK(HT_snapshot_get_nb_elements(&first) == TEST_NB_KEYS);
+    for(key = 0; key < TEST_NB_KEYS && retval == 0; ++key){
+        retval = HT_snapshot_get_element(&first, &key, sizeof(key), &first_value, &first_size) != 0 ||
+            HT_snapshot_get_element(&second, &key, sizeof(key), &second_value, &second_size) != 0 ||
+            test_in_map(&first, first_value, first_size) != 0 ||
+            test_in_map(&second, second_value, second_size) != 0 ||
+            first_value == second_value ||
+            first_size != test_value(key, expected) || second_size != first_size ||
+            memcmp(first_value, expected, first_size) != 0 ||
+            memcmp(second_value, expected, second_size) != 0;
+    }
+    HT_snapshot_unmap(&first);
+    HT_snapshot_unmap(&second);
+    CHECK(retval == 0);
+    return 0;
+}
+
+/**
+ * \brief Check that the load refuses an other hash function and damaged files.
+ */
+static int test_refused(const char* const path, const char* const damaged_path){
+    HT_snapshot snapshot;
+    unsigned char *content;
+    uint64_t offset = UINT64_C(1) << 40;
+    size_t size;
+    int retval;
+
+    errno = 0;
+    CHECK(HT_mmap_load(&snapshot, path, HT_hash_xxh64) == 1 && errno == EINVAL);
+    CHECK(HT_mmap_load(&snapshot, "/nonexistent/snapshot", HT_hash_wy) == 1);
+
+    content = test_read_file(path, &size);
+    CHECK(content != NULL && size > TEST_OFFSETS_POSITION + 2 * sizeof(offset));
+    // A slot offset past the entries
+    memcpy(&content[TEST_OFFSETS_POSITION + sizeof(offset)], &offset, sizeof(offset));
+    retval = test_write_file(damaged_path, content, size);
+    if( retval == 0 ){
+        errno = 0;
+        retval = HT_mmap_load(&snapshot, damaged_path, HT_hash_wy) != 1 || errno != EINVAL;
+    }
+    // A truncated file
+    if( retval == 0 )
+        retval = test_write_file(damaged_path, content, size / 2);
+    if( retval == 0 ){
+        errno = 0;
+        retval = HT_mmap_load(&snapshot, damaged_path, HT_hash_wy) != 1 || errno != EINVAL;
+    }
+    free(content);
+    unlink(damaged_path);
+    CHECK(retval == 0);
+    return 0;
+}
+
+/**
+ * \brief Check that a table hashing with a random seed is not saved.
+ */
+static int test_seeded_refused(const char* const path){
+    HT_hash_table *ht = HT_new_hash(16, HT_hash_wy);
+    int retval;
+    CHECK(ht != NULL);
+    retval = HT_set_seeded_hash(ht, HT_hash_sip) != 0;
+    if( retval == 0 ){
+        errno = 0;
+        retval = HT_save(ht, path) != 2 || errno != EINVAL;
+    }
+    HT_delete_pointer(ht);
+    return retval;
+}
+
+int main(void){
+    char path[64],
+         damaged_path[64];
+    int failures = 0;
+
+    snprintf(path, sizeof(path), "test_snapshot_%ld.bin", (long) getpid());
+    snprintf(damaged_path, sizeof(damaged_path), "test_snapshot_%ld_damaged.bin", (long) getpid());
+    RUN(test_save_load(path), failures);
+    RUN(test_refused(path, damaged_path), failures);
+    RUN(test_zero_copy(damaged_path), failures);
+    RUN(test_seeded_refused(damaged_path), failures);
+    unlink(path);
+    unlink(damaged_path);
+    return failures != 0;
+}
@@ -0,0 +1,223 @@
+/**
+ * \file test_stats.c
+ * \brief Check the layout measures of a table and the lookup counters of the library.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+
+/**
+ * \brief The number of keys of each slot of the known layout, the last one
+ * longer than the histogram.
+ */
+static const unsigned int test_chain_lengths[] = {17, 3, 1, 1};
+
+/**
+ * \brief The number of keys of the known layout, the sum of ::test_chain_lengths.
+ */
+#define TEST_NB_ELEMENTS 22
+
+/**
+ * \brief The base 2 logarithm of the number of slots of the known layout.
+ */
+#define TEST_SLOT_BITS 4
+
+/**
+ * \brief The number of lookups of present keys by each thread counting lookups.
+ */
+#define TEST_NB_HITS 10
+
+/**
+ * \brief The number of lookups of absent keys by each thread counting lookups.
+ */
+#define TEST_NB_MISSES 5
+
+/**
+ * \brief A hash giving the key itself, so the slot of a key is known.
+ */
+static uint64_t test_identity_hash(const void* const key, const size_t key_size){
+    unsigned int k;
+    (void) key_size;
+    memcpy(&k, key, sizeof(k));
+    return k;
+}
+
+/**
+ * \brief Fill an empty table of 2^::TEST_SLOT_BITS slots with ::test_chain_lengths keys in its first slots.
+ * \param last_key Set to the largest key added.
+ */
+static int test_fill(HT_hash_table* const ht, unsigned int* const last_key){
+    unsigned int filled[sizeof(test_chain_lengths) / sizeof(test_chain_lengths[0])] = {0},
+                 nb_keys = 0,
+                 slot,
+                 key;
+    for(key = 0; nb_keys < TEST_NB_ELEMENTS; ++key){
+        slot = HT_hash_fold(key, TEST_SLOT_BITS);
+        if( slot >= sizeof(filled) / sizeof(filled[0]) || filled[slot] == test_chain_lengths[slot] )
+            continue;
+        CHECK(HT_add_element(ht, &key, sizeof(key), &key, sizeof(key)) == 0);
+        ++filled[slot];
+        ++nb_keys;
+        *last_key = key;
+    }
+    return 0;
+}
+
+/**
+ * \brief Check that the histogram counts every slot and sums up to the elements.
+ */
+static int test_check_histogram(const HT_stats* const stats){
+    size_t nb_slots = 0;
+    unsigned int i;
+    for(i = 0; i < HT_STATS_HISTOGRAM_SIZE; ++i)
+        nb_slots += stats->chain_histogram[i];
+    CHECK(nb_slots == stats->nb_slots);
+    CHECK(stats->chain_histogram[0] == stats->nb_empty_slots);
+    return 0;
+}
+
+/**
+ * \brief Measure a known layout, then the same elements while a resize spreads them.
+ */
+static int test_layout(void){
+    HT_hash_table *ht = HT_new_hash(1u << TEST_SLOT_BITS, test_identity_hash);
+    HT_stats stats;
+    unsigned int last_key,
+                 absent;
+    CHECK(ht != NULL);
+    CHECK(HT_set_load_factors(ht, 0.0f, 0.0f) == 0);
+    CHECK(ht->_nb_slots == 1u << TEST_SLOT_BITS);
+
+    CHECK(HT_get_stats(ht, &stats) == 0);
+    CHECK(stats.nb_elements == 0 && stats.nb_slots == 16 && stats.nb_empty_slots == 16);
+    CHECK(stats.longest_chain == 0 && stats.chain_histogram[0] == 16 && !stats.resizing);
+
+    CHECK(test_fill(ht, &last_key) == 0);
+    CHECK(HT_get_stats(ht, &stats) == 0);
+    CHECK(stats.nb_elements == TEST_NB_ELEMENTS && stats.nb_slots == 16 && stats.nb_empty_slots == 12);
+    CHECK(stats.longest_chain == test_chain_lengths[0] && !stats.resizing);
+    CHECK(stats.chain_histogram[0] == 12 && stats.chain_histogram[1] == 2 && stats.chain_histogram[3] == 1);
+    CHECK(stats.chain_histogram[HT_STATS_HISTOGRAM_SIZE - 1] == 1);
+    CHECK(test_check_histogram(&stats) == 0);
+    CHECK(stats.load_factor > (double) TEST_NB_ELEMENTS / 16 - 1e-9 && stats.load_factor < (double) TEST_NB_ELEMENTS / 16 + 1e-9);
+    CHECK(stats.average_chain > (double) TEST_NB_ELEMENTS / 4 - 1e-9 && stats.average_chain < (double) TEST_NB_ELEMENTS / 4 + 1e-9);
+    CHECK(stats.allocated_bytes >= 16 * sizeof(HT_slot) + TEST_NB_ELEMENTS * sizeof(HT_pair));
+
+    // The new slots and the old ones not migrated yet are both counted
+    CHECK(HT_resize(ht, 64) == 0);
+    CHECK(HT_get_stats(ht, &stats) == 0);
+    CHECK(stats.resizing && stats.nb_elements == TEST_NB_ELEMENTS && stats.nb_slots == 16 + 64);
+    CHECK(stats.longest_chain == test_chain_lengths[0]);
+    CHECK(test_check_histogram(&stats) == 0);
+    absent = last_key + 1;
+    CHECK(HT_remove_element_position(ht, &absent, sizeof(absent), 0, 0) == 1);
+    CHECK(HT_get_stats(ht, &stats) == 0);
+    CHECK(stats.resizing && stats.nb_elements == TEST_NB_ELEMENTS && stats.nb_slots == 16 - HT_REHASH_SLOTS_PER_STEP + 64);
+    CHECK(stats.longest_chain < test_chain_lengths[0]);
+    CHECK(test_check_histogram(&stats) == 0);
+    while( ht->_new_slots != NULL )
+        CHECK(HT_remove_element_position(ht, &absent, sizeof(absent), 0, 0) == 1);
+    CHECK(HT_get_stats(ht, &stats) == 0);
+    CHECK(!stats.resizing && stats.nb_elements == TEST_NB_ELEMENTS && stats.nb_slots == 64);
+    CHECK(test_check_histogram(&stats) == 0);
+
+    CHECK(HT_get_stats(NULL, &stats) == 2 && errno == EINVAL);
+    CHECK(HT_get_stats(ht, NULL) == 2 && errno == EINVAL);
+    HT_reset_table(ht);
+    CHECK(HT_set_robin_backend(ht) == 0);
+    CHECK(HT_get_stats(ht, &stats) == 2 && errno == EINVAL);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief Look up ::TEST_NB_HITS present keys and ::TEST_NB_MISSES absent ones.
+ * \param table The hash table, holding the keys below ::TEST_NB_HITS.
+ * \return NULL on success, the table otherwise.
+ */
+static void* test_lookups(void* table){
+    const HT_hash_table *ht = table;
+    unsigned int key;
+    for(key = 0; key < TEST_NB_HITS + TEST_NB_MISSES; ++key){
+        if( HT_get_element(ht, &key, sizeof(key), NULL, NULL) != (key < TEST_NB_HITS ? 0 : 1) )
+            return table;
+    }
+    return NULL;
+}
+
+/**
+ * \brief Count the lookups of this thread and of another one, the counters being zero without HT_STATS.
+ */
+static int test_counters(void){
+    HT_hash_table *ht = HT_new_hash(64, test_identity_hash);
+    HT_counters before,
+                after;
+    pthread_t thread;
+    void *retval;
+    unsigned int key;
+    CHECK(ht != NULL);
+    for(key = 0; key < TEST_NB_HITS; ++key)
+        CHECK(HT_add_element(ht, &key, sizeof(key), &key, sizeof(key)) == 0);
+
+    HT_get_counters(&before);
+    CHECK(test_lookups(ht) == NULL);
+    HT_get_counters(&after);
+#ifdef HT_STATS
+    CHECK(after.hits - before.hits == TEST_NB_HITS);
+    CHECK(after.misses - before.misses == TEST_NB_MISSES);
+    CHECK(after.searches - before.searches >= TEST_NB_HITS + TEST_NB_MISSES);
+    CHECK(after.hashes - before.hashes >= TEST_NB_HITS + TEST_NB_MISSES);
+    CHECK(after.probes - before.probes >= TEST_NB_HITS);
+#else
+    CHECK(after.hits == 0 && after.misses == 0 && after.searches == 0);
+    CHECK(after.probes == 0 && after.hashes == 0 && after.hash_cycles == 0);
+#endif
+
+    // A thread keeps its own counters, still summed once it is gone
+    before = after;
+    CHECK(pthread_create(&thread, NULL, test_lookups, ht) == 0);
+    CHECK(pthread_join(thread, &retval) == 0 && retval == NULL);
+    HT_get_counters(&after);
+#ifdef HT_STATS
+    CHECK(after.hits - before.hits == TEST_NB_HITS);
+    CHECK(after.misses - before.misses == TEST_NB_MISSES);
+#else
+    CHECK(after.hits == 0 && after.misses == 0);
+#endif
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_layout(), failures);
+    RUN(test_counters(), failures);
+    return failures != 0;
+}
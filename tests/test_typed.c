@@ -0,0 +1,208 @@
+/**
+ * \file test_typed.c
+ * \brief Check the tables defined by HT_DEFINE_TABLE against the generic table.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "typed_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys inserted, enough for several grows.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief The key holding the duplicates.
+ */
+#define TEST_KEY 7
+
+/**
+ * \brief A key compared field by field.
+ */
+typedef struct{
+    int x,
+        y;
+} test_point;
+
+static inline uint64_t test_hash_int(const int key){
+    return HT_hash_wy(&key, sizeof(key));
+}
+
+/**
+ * \brief A weak hash, every point of a column shares its hash.
+ */
+static inline uint64_t test_hash_point(const test_point key){
+    return HT_hash_wy(&key.x, sizeof(key.x));
+}
+
+#define TEST_POINT_EQUAL(a, b) ((a).x == (b).x && (a).y == (b).y)
+
+HT_DEFINE_TABLE(test_int_table, int, int, test_hash_int, HT_TYPED_EQUAL)
+HT_DEFINE_TABLE(test_point_table, test_point, long, test_hash_point, TEST_POINT_EQUAL)
+
+/**
+ * \brief Check that the duplicates of ::TEST_KEY are the same in both tables, in both directions.
+ */
+static int test_same_order(const test_int_table* const t, const HT_hash_table* const ht, const unsigned int nb_duplicates){
+    const int key = TEST_KEY;
+    unsigned int i;
+    int reverse,
+        *value;
+    size_t expected_size;
+    void *expected;
+    for(reverse = 0; reverse <= 1; ++reverse){
+        // Past the last match, both return the last match
+        for(i = 0; i <= nb_duplicates; ++i){
+            CHECK(HT_get_element_position(ht, &key, sizeof(key), &expected, &expected_size, i, reverse) == 0);
+            CHECK(test_int_table_get_element_position(t, key, &value, i, reverse) == 0);
+            CHECK(*value == *(int*) expected);
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Insert and remove duplicates at positions from both ends, like the generic table.
+ */
+static int test_duplicates(void){
+    static const struct{
+        int value;
+        unsigned int position;
+        int reverse;
+    } adds[] = { {1, 0, 0}, {2, 0, 0}, {3, 0, 1}, {4, 1, 0}, {5, 1, 1}, {6, 9, 0} };
+    const int key = TEST_KEY;
+    test_int_table t;
+    HT_hash_table ht;
+    unsigned int i;
+    int *value;
+    CHECK(test_int_table_init(&t, 16) == 0);
+    CHECK(HT_init(&ht, 16, HT_hash_wy) == 0);
+
+    for(i = 0; i < sizeof(adds) / sizeof(adds[0]); ++i){
+        CHECK(test_int_table_add_element_position(&t, key, adds[i].value, adds[i].position, adds[i].reverse) == 0);
+        CHECK(HT_add_element_position(&ht, &key, sizeof(key), &adds[i].value, sizeof(adds[i].value), adds[i].position, adds[i].reverse) == 0);
+    }
+    CHECK(test_same_order(&t, &ht, 6) == 0);
+    CHECK(test_int_table_add_element(&t, key, 0) == 1);
+
+    CHECK(test_int_table_remove_element_position(&t, key, 2, 0) == 0);
+    CHECK(HT_remove_element_position(&ht, &key, sizeof(key), 2, 0) == 0);
+    CHECK(test_int_table_remove_element_position(&t, key, 0, 1) == 0);
+    CHECK(HT_remove_element_position(&ht, &key, sizeof(key), 0, 1) == 0);
+    CHECK(test_same_order(&t, &ht, 4) == 0);
+    CHECK(test_int_table_get_nb_elements(&t) == 4);
+
+    for(i = 0; i < 4; ++i)
+        CHECK(test_int_table_remove_element_position(&t, key, 0, 0) == 0);
+    CHECK(test_int_table_remove_element_position(&t, key, 0, 0) == 1);
+    CHECK(test_int_table_get_element(&t, key, &value) == 1);
+    HT_delete(&ht);
+    test_int_table_delete(&t);
+    return 0;
+}
+
+/**
+ * \brief Grow through several sizes, the values stored in the pairs and
+ * modified through the returned pointer.
+ */
+static int test_grow(void){
+    test_int_table t;
+    unsigned int slot_bits;
+    int key,
+        *value;
+    CHECK(test_int_table_init(&t, 16) == 0);
+    slot_bits = t._slot_bits;
+
+    for(key = 0; key < TEST_NB_KEYS; ++key)
+        CHECK(test_int_table_add_element(&t, key, key * 3) == 0);
+    CHECK(t._slot_bits > slot_bits);
+    CHECK(test_int_table_get_nb_elements(&t) <= (size_t) 1 << t._slot_bits);
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        CHECK(test_int_table_get_element(&t, key, &value) == 0 && *value == key * 3);
+        ++*value;
+    }
+    for(key = 0; key < TEST_NB_KEYS; key += 2)
+        CHECK(test_int_table_remove_element_position(&t, key, 0, 0) == 0);
+    for(key = 0; key < TEST_NB_KEYS; ++key){
+        if( key % 2 == 0 )
+            CHECK(test_int_table_get_element(&t, key, NULL) == 1);
+        else
+            CHECK(test_int_table_get_element(&t, key, &value) == 0 && *value == key * 3 + 1);
+    }
+
+    test_int_table_reset_table(&t);
+    CHECK(test_int_table_get_nb_elements(&t) == 0);
+    CHECK(test_int_table_get_element(&t, 1, NULL) == 1);
+    test_int_table_delete(&t);
+    CHECK(test_int_table_init(&t, 0) == 1 && errno == EINVAL);
+    return 0;
+}
+
+/**
+ * \brief Store structure keys sharing their hash, told apart by the equal macro.
+ */
+static int test_struct_keys(void){
+    test_point_table t;
+    test_point key;
+    long *value;
+    CHECK(test_point_table_init(&t, 4) == 0);
+
+    for(key.x = 0; key.x < 8; ++key.x){
+        for(key.y = 0; key.y < 64; ++key.y)
+            CHECK(test_point_table_add_element(&t, key, key.x * 100L + key.y) == 0);
+    }
+    CHECK(test_point_table_get_nb_elements(&t) == 8 * 64);
+    for(key.x = 0; key.x < 8; ++key.x){
+        for(key.y = 0; key.y < 64; ++key.y){
+            CHECK(test_point_table_get_element(&t, key, &value) == 0);
+            CHECK(*value == key.x * 100L + key.y);
+            CHECK(test_point_table_add_element(&t, key, 0) == 1);
+        }
+    }
+    key.x = 3;
+    key.y = 64;
+    CHECK(test_point_table_get_element(&t, key, &value) == 1);
+    key.y = 10;
+    CHECK(test_point_table_remove_element_position(&t, key, 0, 0) == 0);
+    CHECK(test_point_table_get_element(&t, key, &value) == 1);
+    key.y = 11;
+    CHECK(test_point_table_get_element(&t, key, &value) == 0 && *value == 311);
+    test_point_table_delete(&t);
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_duplicates(), failures);
+    RUN(test_grow(), failures);
+    RUN(test_struct_keys(), failures);
+    return failures != 0;
+}
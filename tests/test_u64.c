@@ -0,0 +1,129 @@
+/**
+ * \file test_u64.c
+ * \brief Check the 64 bits integer key entry points mixed with the generic ones.
+ * \author Maxime SCHMITT
+ * \version 0.1
+ * \date 2014
+ * \copyright LGPL v3, or any later version.
+ */
+
+/*
+   Copyright (C) 2014 SCHMITT Maxime.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   and the GNU General Public License along with this program.
+   If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "generic_hash_table.h"
+#include "hash_functions.h"
+
+/**
+ * \brief The number of keys inserted, enough for several resizes.
+ */
+#define TEST_NB_KEYS 5000
+
+/**
+ * \brief Spread the keys over the whole 64 bits.
+ */
+static inline uint64_t test_key(const unsigned int index){
+    return (uint64_t) index * UINT64_C(0x9E3779B97F4A7C15);
+}
+
+/**
+ * \brief Add half of the keys with each API, then find and remove them with the other one.
+ * \param hash_function The hash function of the table, ::HT_hash_u64 for the inlined hash.
+ * \param seeded_hash_function A seeded hash function, NULL for none.
+ */
+static int test_mix(HT_hash_function hash_function, HT_seeded_hash_function seeded_hash_function){
+    HT_hash_table *ht = HT_new_hash(16, hash_function);
+    unsigned int i;
+    uint64_t key;
+    uint32_t short_key;
+    size_t found_size;
+    void *found;
+    CHECK(ht != NULL);
+    if( seeded_hash_function != NULL )
+        CHECK(HT_set_seeded_hash(ht, seeded_hash_function) == 0);
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        key = test_key(i);
+        if( i % 2 == 0 )
+            CHECK(HT_add_element_u64(ht, key, &i, sizeof(i)) == 0);
+        else
+            CHECK(HT_add_element(ht, &key, sizeof(key), &i, sizeof(i)) == 0);
+    }
+    CHECK(HT_get_nb_elements(ht) == TEST_NB_KEYS);
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        key = test_key(i);
+        CHECK(HT_get_element_u64(ht, key, &found, &found_size) == 0);
+        CHECK(found_size == sizeof(i) && memcmp(found, &i, sizeof(i)) == 0);
+        CHECK(HT_get_element(ht, &key, sizeof(key), &found, &found_size) == 0);
+        CHECK(found_size == sizeof(i) && memcmp(found, &i, sizeof(i)) == 0);
+        // Present whichever API added it
+        CHECK(HT_add_element_u64(ht, key, &i, sizeof(i)) == 1);
+        CHECK(HT_find_or_insert(ht, &key, sizeof(key), &i, sizeof(i), NULL, NULL) == 1);
+    }
+
+    // A key of another size holding the same first bytes is another key
+    key = test_key(2);
+    memcpy(&short_key, &key, sizeof(short_key));
+    CHECK(HT_get_element(ht, &short_key, sizeof(short_key), NULL, NULL) == 1);
+    CHECK(HT_add_element(ht, &short_key, sizeof(short_key), &i, sizeof(i)) == 0);
+    CHECK(HT_remove_element_position(ht, &short_key, sizeof(short_key), 0, 0) == 0);
+    key = TEST_NB_KEYS;
+    CHECK(HT_get_element_u64(ht, key, NULL, NULL) == 1);
+
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        key = test_key(i);
+        if( i % 2 == 0 )
+            CHECK(HT_remove_element_position(ht, &key, sizeof(key), 0, 0) == 0);
+        else
+            CHECK(HT_remove_element_u64(ht, key) == 0);
+        CHECK(HT_remove_element_u64(ht, key) == 1);
+        CHECK(HT_get_element(ht, &key, sizeof(key), NULL, NULL) == 1);
+    }
+    CHECK(HT_get_nb_elements(ht) == 0);
+    HT_delete_pointer(ht);
+    return 0;
+}
+
+/**
+ * \brief Check that the inlined hash is the one of ::HT_hash_u64.
+ */
+static int test_hash(void){
+    unsigned int i;
+    uint64_t key;
+    for(i = 0; i < TEST_NB_KEYS; ++i){
+        key = test_key(i);
+        CHECK(HT_hash_u64(&key, sizeof(key)) == HT_hash_mix64(key));
+    }
+    // Distinct integers never share their hash
+    CHECK(HT_hash_mix64(1) != HT_hash_mix64(2));
+    return 0;
+}
+
+int main(void){
+    int failures = 0;
+    RUN(test_hash(), failures);
+    RUN(test_mix(HT_hash_u64, NULL), failures);
+    RUN(test_mix(HT_hash_wy, NULL), failures);
+    RUN(test_mix(HT_hash_u64, HT_hash_sip), failures);
+    return failures != 0;
+}